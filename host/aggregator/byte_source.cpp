@@ -0,0 +1,138 @@
+#include "byte_source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+FdSource::FdSource(const std::string &name, int fd) : ByteSource(name), fd(fd) {}
+
+FdSource::~FdSource() {
+    ::close(fd);
+}
+
+long FdSource::read(uint8_t *data, size_t size) {
+    for (;;) {
+        struct pollfd ready = { fd, POLLIN, 0 };
+        int events = poll(&ready, 1, 100);
+        if (events == 0) return IDLE;
+        if (events < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        ssize_t n = ::read(fd, data, size);
+        if (n >= 0) return (long)n;
+        if (errno != EINTR) return -1;
+    }
+}
+
+MemorySource::MemorySource(const std::string &name, const uint8_t *data, size_t size, size_t chunk, bool holdOpen)
+    : ByteSource(name), bytes(data), size(size), pos(0), chunk(chunk), held(holdOpen) {}
+
+long MemorySource::read(uint8_t *data, size_t max) {
+    size_t n = size - pos;
+    if (n == 0 && held.load()) {
+        usleep(100000);
+        return IDLE;
+    }
+    if (n > chunk) n = chunk;
+    if (n > max) n = max;
+    memcpy(data, bytes + pos, n);
+    pos += n;
+    return (long)n;
+}
+
+static speed_t baudConstant(long baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return 0;
+    }
+}
+
+static std::unique_ptr<ByteSource> openSerial(const std::string &spec, const std::string &path, long baud,
+                                              std::string &error) {
+    speed_t speed = baudConstant(baud);
+    if (!speed) {
+        error = "unsupported baud rate " + std::to_string(baud);
+        return nullptr;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        error = path + ": " + strerror(errno);
+        return nullptr;
+    }
+    struct termios tty;
+    if (tcgetattr(fd, &tty) == 0) {
+        cfmakeraw(&tty);
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+        tty.c_cflag |= CLOCAL | CREAD;
+        tty.c_cc[VMIN] = 1;
+        tty.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tty);
+    }
+    return std::unique_ptr<ByteSource>(new FdSource(spec, fd));
+}
+
+static std::unique_ptr<ByteSource> openFile(const std::string &spec, const std::string &path, std::string &error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = path + ": " + strerror(errno);
+        return nullptr;
+    }
+    return std::unique_ptr<ByteSource>(new FdSource(spec, fd));
+}
+
+static std::unique_ptr<ByteSource> openUnix(const std::string &spec, const std::string &path, std::string &error) {
+    struct sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = path + ": socket path too long";
+        return nullptr;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        error = path + ": " + strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<ByteSource>(new FdSource(spec, fd));
+}
+
+std::unique_ptr<ByteSource> openByteSource(const std::string &spec, std::string &error) {
+    if (spec.compare(0, 7, "serial:") == 0) {
+        std::string path = spec.substr(7);
+        long baud = 115200;
+        size_t at = path.rfind('@');
+        if (at != std::string::npos) {
+            baud = strtol(path.c_str() + at + 1, NULL, 10);
+            path.resize(at);
+        }
+        return openSerial(spec, path, baud, error);
+    }
+    if (spec.compare(0, 5, "file:") == 0) return openFile(spec, spec.substr(5), error);
+    if (spec.compare(0, 5, "unix:") == 0) return openUnix(spec, spec.substr(5), error);
+
+    struct stat info;
+    if (stat(spec.c_str(), &info) != 0) {
+        error = spec + ": " + strerror(errno);
+        return nullptr;
+    }
+    if (S_ISCHR(info.st_mode)) return openSerial(spec, spec, 115200, error);
+    if (S_ISSOCK(info.st_mode)) return openUnix(spec, spec, error);
+    return openFile(spec, spec, error);
+}
@@ -0,0 +1,70 @@
+#ifndef ZIGBEE_SCANNER_BYTE_SOURCE_H
+#define ZIGBEE_SCANNER_BYTE_SOURCE_H
+
+/*
+ * Where a scanner's telemetry stream comes from. A source spec is one of
+ *   serial:/dev/ttyACM0[@baud]   raw 8N1, 115200 baud unless given
+ *   file:capture.bin             read to the end
+ *   unix:/run/scanner.sock       connected local stream socket
+ *   /dev/ttyACM0, capture.bin    picked by the file type
+ * Reads wait for bytes to arrive, so each source gets its own thread.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+class ByteSource {
+public:
+    // read() found nothing within its wait, try again
+    static const long IDLE = -2;
+
+    virtual ~ByteSource() {}
+    // Bytes read into data, 0 at the end of the stream, -1 on an error or
+    // IDLE after about 100 ms without data, so readers can be stopped
+    virtual long read(uint8_t *data, size_t size) = 0;
+    const std::string &name() const { return label; }
+
+protected:
+    explicit ByteSource(const std::string &name) : label(name) {}
+
+private:
+    std::string label;
+};
+
+// A file descriptor the source owns: file, serial device or socket
+class FdSource : public ByteSource {
+public:
+    FdSource(const std::string &name, int fd);
+    ~FdSource() override;
+    long read(uint8_t *data, size_t size) override;
+
+private:
+    int fd;
+};
+
+// Bytes already in memory (not copied), handed out at most chunk at a time
+// the way a serial port returns them; for tests and load runs. Held open,
+// the stream stays IDLE after the bytes until finish().
+class MemorySource : public ByteSource {
+public:
+    MemorySource(const std::string &name, const uint8_t *data, size_t size, size_t chunk = 512,
+                 bool holdOpen = false);
+    long read(uint8_t *data, size_t size) override;
+    // Lets a held stream end, from any thread
+    void finish() { held.store(false); }
+
+private:
+    const uint8_t *bytes;
+    size_t size;
+    size_t pos;
+    size_t chunk;
+    std::atomic<bool> held;
+};
+
+// Opens a source spec; NULL with the reason in error when it fails
+std::unique_ptr<ByteSource> openByteSource(const std::string &spec, std::string &error);
+
+#endif // ZIGBEE_SCANNER_BYTE_SOURCE_H
@@ -0,0 +1,303 @@
+#include "site_aggregator.h"
+
+#include <algorithm>
+#include <chrono>
+
+// NETWORK_FLAG_GONE of the sketch (block_definitions.h needs Arduino.h)
+static const uint8_t SITE_FLAG_GONE = 0x20;
+
+// Records the merger takes from one queue before moving to the next
+static const size_t MERGE_BATCH = 256;
+
+int SiteNetwork::strongest() const {
+    int best = -1;
+    for (size_t i = 0; i < sightings.size(); i++) {
+        if (best < 0 || sightings[i].meanSignal() > sightings[best].meanSignal()) best = (int)i;
+    }
+    return best;
+}
+
+uint16_t SiteView::addScanner(const std::string &name) {
+    SiteScanner scanner = {};
+    scanner.name = name;
+    sources.push_back(scanner);
+    return (uint16_t)(sources.size() - 1);
+}
+
+void SiteView::setDecoderStats(uint16_t scanner, const TelemetryDecoderStats &stats) {
+    sources[scanner].decoder = stats;
+}
+
+void SiteView::add(const SiteRecord &r) {
+    total++;
+    SiteScanner &scanner = sources[r.scanner];
+    scanner.records++;
+    if (r.type == SITE_RECORD_SCAN) {
+        scanner.frames++;
+        scanner.keyframeMask = r.keyframe ? r.channelMask : 0;
+        scanner.keyframeLeft = r.panId;
+        scanner.listed = 0;
+        if (scanner.keyframeMask && scanner.keyframeLeft == 0) forget(r.scanner, scanner.keyframeMask, scanner.frames);
+        return;
+    }
+    if (r.type == SITE_RECORD_END) {
+        scanner.ended = true;
+        scanner.failed = r.flags != 0;
+        scanner.keyframeMask = 0;
+        forget(r.scanner, ~0u, 0);
+        return;
+    }
+
+    addNetwork(r);
+    if (scanner.keyframeMask && --scanner.keyframeLeft == 0) {
+        // Nothing to drop when the keyframe refreshed every sighting
+        if (scanner.listed < scanner.sightings) forget(r.scanner, scanner.keyframeMask, scanner.frames);
+        scanner.keyframeMask = 0;
+    }
+}
+
+void SiteView::addNetwork(const SiteRecord &r) {
+    SiteScanner &scanner = sources[r.scanner];
+    uint32_t key = (uint32_t)r.panId << 8 | r.channel;
+    auto found = index.find(key);
+    if (found == index.end()) {
+        if (r.flags & SITE_FLAG_GONE) return;
+        found = index.emplace(key, entries.size()).first;
+        SiteNetwork network;
+        network.panId = r.panId;
+        network.channel = r.channel;
+        network.flags = 0;
+        network.extendedPanId = 0;
+        entries.push_back(network);
+    }
+    SiteNetwork &network = entries[found->second];
+
+    auto sighting = std::find_if(network.sightings.begin(), network.sightings.end(),
+        [&](const SiteSighting &s) { return s.scanner == r.scanner; });
+    if (r.flags & SITE_FLAG_GONE) {
+        if (sighting != network.sightings.end()) {
+            if (sighting->lastFrame == scanner.frames) scanner.listed--;
+            network.sightings.erase(sighting);
+            scanner.sightings--;
+        }
+        return;
+    }
+    if (sighting == network.sightings.end()) {
+        SiteSighting fresh = {};
+        fresh.scanner = r.scanner;
+        network.sightings.push_back(fresh);
+        sighting = network.sightings.end() - 1;
+        scanner.sightings++;
+    }
+    if (sighting->lastFrame != scanner.frames) scanner.listed++;
+    network.flags = r.flags;
+    network.extendedPanId = r.extendedPanId;
+    sighting->lastSignal = r.signal;
+    sighting->load = r.load;
+    sighting->count++;
+    sighting->sumSignal += r.signal;
+    sighting->lastSeen = r.timestamp;
+    sighting->lastFrame = scanner.frames;
+}
+
+void SiteView::forget(uint16_t scanner, uint32_t channelMask, uint64_t frame) {
+    for (SiteNetwork &network : entries) {
+        bool covered = channelMask == ~0u || (network.channel < 32 && (channelMask >> network.channel & 1));
+        if (!covered) continue;
+        auto sighting = std::find_if(network.sightings.begin(), network.sightings.end(),
+            [&](const SiteSighting &s) { return s.scanner == scanner; });
+        if (sighting == network.sightings.end() || sighting->lastFrame == frame) continue;
+        network.sightings.erase(sighting);
+        sources[scanner].sightings--;
+    }
+}
+
+size_t SiteView::heard() const {
+    size_t count = 0;
+    for (const SiteNetwork &network : entries) {
+        if (!network.sightings.empty()) count++;
+    }
+    return count;
+}
+
+void SiteView::print(FILE *out) const {
+    const size_t columns = sources.size() <= 8 ? sources.size() : 0;
+
+    fprintf(out, "\n=== SITE VIEW: %zu networks, %zu scanners ===\n", heard(), sources.size());
+    fprintf(out, "Signal: the scanners' beacon signal index, not a measured level\n");
+    fprintf(out, "PAN     Ch  Heard  Strongest  Mean   Margin");
+    for (size_t s = 0; s < columns; s++) fprintf(out, "   s%-3zu", s);
+    fprintf(out, "\n");
+
+    std::vector<const SiteNetwork *> order;
+    for (const SiteNetwork &network : entries) {
+        if (!network.sightings.empty()) order.push_back(&network);
+    }
+    std::sort(order.begin(), order.end(), [](const SiteNetwork *a, const SiteNetwork *b) {
+        return a->channel != b->channel ? a->channel < b->channel : a->panId < b->panId;
+    });
+
+    std::vector<size_t> only(sources.size(), 0);
+    std::vector<size_t> hears(sources.size(), 0);
+    for (const SiteNetwork *network : order) {
+        const SiteSighting &best = network->sightings[network->strongest()];
+        // Index margin over the runner-up; the index is no measured level,
+        // so this says which scanner reports more, not which is nearer
+        double margin = 0;
+        bool second = false;
+        for (const SiteSighting &s : network->sightings) {
+            hears[s.scanner]++;
+            if (&s == &best) continue;
+            double gap = best.meanSignal() - s.meanSignal();
+            if (!second || gap < margin) margin = gap;
+            second = true;
+        }
+        if (network->sightings.size() == 1) only[best.scanner]++;
+
+        fprintf(out, "0x%04x  %2u  %2zu/%-2zu  s%-8u %6.1f ", network->panId, network->channel,
+            network->sightings.size(), sources.size(), best.scanner, best.meanSignal());
+        if (second) fprintf(out, " %5.1f ", margin);
+        else fprintf(out, " %5s ", "-");
+        for (size_t s = 0; s < columns; s++) {
+            const SiteSighting *sighting = NULL;
+            for (const SiteSighting &candidate : network->sightings) {
+                if (candidate.scanner == s) sighting = &candidate;
+            }
+            if (sighting) fprintf(out, " %6.1f", sighting->meanSignal());
+            else fprintf(out, " %6s", "-");
+        }
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "\nScanner  Frames    Hears  Only here  Lost frames  CRC errors  Source\n");
+    for (size_t s = 0; s < sources.size(); s++) {
+        const SiteScanner &scanner = sources[s];
+        fprintf(out, "s%-6zu  %-8llu  %5zu  %9zu  %11llu  %10llu  %s%s\n", s, (unsigned long long)scanner.frames,
+            hears[s], only[s], (unsigned long long)scanner.decoder.sequenceGaps,
+            (unsigned long long)scanner.decoder.crcErrors, scanner.name.c_str(),
+            scanner.failed ? " (read error)" : (scanner.ended ? " (ended)" : ""));
+    }
+}
+
+SiteAggregator::SiteAggregator(size_t queueCapacity) : queueCapacity(queueCapacity) {}
+
+SiteAggregator::~SiteAggregator() {
+    stop();
+    for (auto &stream : streams) {
+        if (stream->reader.joinable()) stream->reader.join();
+    }
+}
+
+uint16_t SiteAggregator::addSource(std::unique_ptr<ByteSource> source) {
+    std::string name = source->name();
+    streams.emplace_back(new Stream(std::move(source), queueCapacity));
+    return merged.addScanner(name);
+}
+
+bool SiteAggregator::push(Stream &stream, const SiteRecord &record) {
+    while (!stream.queue.push(record)) {
+        stream.fullWaits.fetch_add(1, std::memory_order_relaxed);
+        if (stopping.load(std::memory_order_relaxed)) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+// Reader thread: bytes to frames to records
+void SiteAggregator::read(uint16_t scanner) {
+    Stream &stream = *streams[scanner];
+    bool open = true;
+    TelemetryDecoder decoder([&](const TelemetryScan &scan) {
+        SiteRecord record = {};
+        record.type = SITE_RECORD_SCAN;
+        record.scanner = scanner;
+        record.panId = (uint16_t)scan.networks.size();
+        record.timestamp = scan.timestamp;
+        // A truncated scan does not list everything it heard
+        record.keyframe = scan.keyframe && scan.truncated == 0;
+        record.channelMask = scan.channelMask;
+        open = open && push(stream, record);
+
+        record.type = SITE_RECORD_NETWORK;
+        for (const TelemetryNetwork &n : scan.networks) {
+            if (!open) break;
+            record.channel = n.channel;
+            record.signal = n.signal;
+            record.load = n.load;
+            record.flags = n.flags;
+            record.panId = n.panId;
+            record.extendedPanId = n.extendedPanId;
+            open = push(stream, record);
+        }
+    });
+
+    uint8_t buffer[4096];
+    long n = 0;
+    while (open && !stopping.load(std::memory_order_relaxed)) {
+        n = stream.source->read(buffer, sizeof(buffer));
+        if (n == ByteSource::IDLE) continue;
+        if (n <= 0) break;
+        decoder.feed(buffer, (size_t)n);
+    }
+
+    stream.decoderStats = decoder.stats();
+    SiteRecord end = {};
+    end.type = SITE_RECORD_END;
+    end.scanner = scanner;
+    end.flags = n == -1 ? 1 : 0;
+    push(stream, end);
+}
+
+void SiteAggregator::run(const TickHandler &onTick, unsigned intervalMs) {
+    typedef std::chrono::steady_clock Clock;
+    for (uint16_t s = 0; s < streams.size(); s++) {
+        streams[s]->reader = std::thread(&SiteAggregator::read, this, s);
+    }
+
+    std::vector<SiteRecord> batch(MERGE_BATCH);
+    size_t open = streams.size();
+    unsigned emptyRounds = 0;
+    Clock::time_point nextTick = Clock::now() + std::chrono::milliseconds(intervalMs);
+    while (open > 0 && !stopping.load(std::memory_order_relaxed)) {
+        size_t taken = 0;
+        for (uint16_t s = 0; s < streams.size(); s++) {
+            size_t count = streams[s]->queue.pop(batch.data(), batch.size());
+            for (size_t i = 0; i < count; i++) {
+                merged.add(batch[i]);
+                if (batch[i].type == SITE_RECORD_END) {
+                    merged.setDecoderStats(s, streams[s]->decoderStats);
+                    open--;
+                }
+            }
+            taken += count;
+        }
+
+        if (taken == 0) {
+            // Spin briefly for bursts, then back off so an idle site costs
+            // next to no CPU
+            idleRounds++;
+            if (++emptyRounds < 64) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(500));
+        } else {
+            emptyRounds = 0;
+        }
+
+        if (onTick && intervalMs && Clock::now() >= nextTick) {
+            onTick(merged);
+            nextTick += std::chrono::milliseconds(intervalMs);
+        }
+    }
+
+    stop();
+    for (auto &stream : streams) {
+        if (stream->reader.joinable()) stream->reader.join();
+    }
+}
+
+SiteAggregatorStats SiteAggregator::stats() const {
+    SiteAggregatorStats stats = {};
+    stats.records = merged.records();
+    stats.mergerIdleRounds = idleRounds;
+    for (const auto &stream : streams) stats.queueFullWaits += stream->fullWaits.load();
+    return stats;
+}
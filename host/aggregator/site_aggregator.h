@@ -0,0 +1,174 @@
+#ifndef ZIGBEE_SCANNER_SITE_AGGREGATOR_H
+#define ZIGBEE_SCANNER_SITE_AGGREGATOR_H
+
+/*
+ * Merges the binary telemetry streams (REPORT_MODE_BINARY) of several
+ * scanners into one site-wide view: every network by PAN and channel, with
+ * the scanners hearing it (its coverage) and the signal each reports. The
+ * scanners' signal is an index taken from the beacon descriptor, not a
+ * measured level, so the strongest scanner is no location until scanners
+ * report a measured one.
+ *
+ * One reader thread per stream decodes frames and pushes compact records
+ * into its own lock-free queue; one merger (the thread calling run()) drains
+ * all queues into the view, so the view needs no lock. A full queue makes
+ * its reader wait, nothing is dropped. Independent of the Arduino mock.
+ *
+ * A network leaves a scanner's sightings when its frame says it is gone,
+ * when a keyframe of that scanner covers its channel without listing it
+ * (so a lost frame is put right by the next keyframe) or when the
+ * scanner's stream ends.
+ */
+
+#include "byte_source.h"
+#include "spsc_queue.h"
+#include "telemetry/telemetry_decoder.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// SiteRecord::type
+#define SITE_RECORD_SCAN    1       // a decoded frame, its networks follow
+#define SITE_RECORD_NETWORK 2
+#define SITE_RECORD_END     3       // the stream ended or failed
+
+// What a reader passes to the merger, one per frame and per network
+struct SiteRecord {
+    uint8_t type;
+    uint8_t channel;
+    uint8_t signal;
+    uint8_t load;
+    uint8_t flags;                  // NETWORK_FLAG_*; GONE drops the sighting
+    uint8_t keyframe;               // SITE_RECORD_SCAN: lists every network on channelMask
+    uint16_t scanner;
+    uint16_t panId;                 // networks in the frame for SITE_RECORD_SCAN
+    uint32_t timestamp;             // scanner millis()
+    uint32_t channelMask;           // SITE_RECORD_SCAN: channels the scan covered
+    uint64_t extendedPanId;
+};
+
+// One scanner hearing one network
+struct SiteSighting {
+    uint16_t scanner;
+    uint8_t lastSignal;
+    uint8_t load;
+    uint32_t count;
+    int64_t sumSignal;
+    uint32_t lastSeen;              // scanner millis()
+    uint64_t lastFrame;             // SiteScanner::frames of the last frame listing it
+
+    double meanSignal() const { return count ? (double)sumSignal / count : 0; }
+};
+
+struct SiteNetwork {
+    uint16_t panId;
+    uint8_t channel;
+    uint8_t flags;
+    uint64_t extendedPanId;
+    std::vector<SiteSighting> sightings;    // scanners hearing it now
+
+    // Index into sightings of the scanner with the highest mean signal, -1 if none
+    int strongest() const;
+};
+
+struct SiteScanner {
+    std::string name;
+    uint64_t frames;
+    uint64_t records;
+    size_t sightings;               // networks it hears now
+    bool ended;                     // its sightings are dropped
+    bool failed;                    // read error rather than end of stream
+    TelemetryDecoderStats decoder;  // final once ended
+
+    // The keyframe being merged: its channels (0 for other frames), its
+    // network records still to come and the sightings they refreshed
+    uint32_t keyframeMask;
+    uint16_t keyframeLeft;
+    size_t listed;
+};
+
+class SiteView {
+public:
+    uint16_t addScanner(const std::string &name);
+    void add(const SiteRecord &record);
+
+    const std::vector<SiteNetwork> &networks() const { return entries; }
+    const std::vector<SiteScanner> &scanners() const { return sources; }
+    // Networks someone hears now
+    size_t heard() const;
+    uint64_t records() const { return total; }
+
+    // Network table (per scanner columns for up to 8 scanners), then scanners
+    void print(FILE *out) const;
+
+    // Set by the merger with the decoder counters of an ended stream
+    void setDecoderStats(uint16_t scanner, const TelemetryDecoderStats &stats);
+
+private:
+    void addNetwork(const SiteRecord &record);
+    // Drops the scanner's sightings on the channels in channelMask (~0 for
+    // every channel) that frame did not list (0 lists none)
+    void forget(uint16_t scanner, uint32_t channelMask, uint64_t frame);
+
+    std::unordered_map<uint32_t, size_t> index;     // panId << 8 | channel
+    std::vector<SiteNetwork> entries;
+    std::vector<SiteScanner> sources;
+    uint64_t total = 0;
+};
+
+struct SiteAggregatorStats {
+    uint64_t records;
+    uint64_t queueFullWaits;        // reader waits on a full queue, summed
+    uint64_t mergerIdleRounds;      // merger rounds that found every queue empty
+};
+
+class SiteAggregator {
+public:
+    typedef std::function<void(const SiteView &)> TickHandler;
+
+    // Records per reader queue
+    explicit SiteAggregator(size_t queueCapacity = 4096);
+    ~SiteAggregator();
+
+    // Before run(); returns the scanner number
+    uint16_t addSource(std::unique_ptr<ByteSource> source);
+
+    // Starts the readers and merges until every stream ended or stop() was
+    // called. onTick runs on the merger every intervalMs (0: never).
+    void run(const TickHandler &onTick = TickHandler(), unsigned intervalMs = 0);
+    // From any thread or a signal handler
+    void stop() { stopping.store(true); }
+
+    const SiteView &view() const { return merged; }
+    SiteAggregatorStats stats() const;
+
+private:
+    struct Stream {
+        std::unique_ptr<ByteSource> source;
+        SpscQueue<SiteRecord> queue;
+        TelemetryDecoderStats decoderStats;     // written before the END record
+        std::atomic<uint64_t> fullWaits{0};
+        std::thread reader;
+
+        Stream(std::unique_ptr<ByteSource> source, size_t capacity)
+            : source(std::move(source)), queue(capacity), decoderStats() {}
+    };
+
+    void read(uint16_t scanner);
+    bool push(Stream &stream, const SiteRecord &record);
+
+    size_t queueCapacity;
+    std::vector<std::unique_ptr<Stream>> streams;
+    SiteView merged;
+    std::atomic<bool> stopping{false};
+    uint64_t idleRounds = 0;
+};
+
+#endif // ZIGBEE_SCANNER_SITE_AGGREGATOR_H
@@ -0,0 +1,71 @@
+#ifndef ZIGBEE_SCANNER_SPSC_QUEUE_H
+#define ZIGBEE_SCANNER_SPSC_QUEUE_H
+
+/*
+ * Bounded lock-free queue for exactly one producer thread and one consumer
+ * thread. Head and tail live on their own cache lines and each side keeps a
+ * cached copy of the other's index, so the shared lines only move when the
+ * cached view runs out (full or empty), not on every element.
+ */
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+template <typename T>
+class SpscQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity) : slots(roundUp(capacity)), mask(slots.size() - 1) {}
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer side; false when full
+    bool push(const T &value) {
+        size_t tail = producer.index.load(std::memory_order_relaxed);
+        if (tail - producer.cached == slots.size()) {
+            producer.cached = consumer.index.load(std::memory_order_acquire);
+            if (tail - producer.cached == slots.size()) return false;
+        }
+        slots[tail & mask] = value;
+        producer.index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; up to max elements into out, returns how many
+    size_t pop(T *out, size_t max) {
+        size_t head = consumer.index.load(std::memory_order_relaxed);
+        if (consumer.cached == head) {
+            consumer.cached = producer.index.load(std::memory_order_acquire);
+            if (consumer.cached == head) return 0;
+        }
+        size_t count = consumer.cached - head;
+        if (count > max) count = max;
+        for (size_t i = 0; i < count; i++) out[i] = slots[(head + i) & mask];
+        consumer.index.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+private:
+    static size_t roundUp(size_t n) {
+        size_t size = 2;
+        while (size < n) size <<= 1;
+        return size;
+    }
+
+    // Own index, written by this side only, and the last seen other index
+    struct alignas(64) Side {
+        std::atomic<size_t> index{0};
+        size_t cached = 0;
+    };
+
+    std::vector<T> slots;
+    size_t mask;
+    Side producer;
+    Side consumer;
+};
+
+#endif // ZIGBEE_SCANNER_SPSC_QUEUE_H
@@ -0,0 +1,121 @@
+/*
+ * Analysis pipeline benchmark: runs generated scans through
+ * printScannedNetworks() with every stage compiled in and an energy sweep
+ * between scans, then prints the per-stage CPU time the pipeline recorded.
+ *
+ * Checks that
+ *  - text reports contain the interference and recommendation sections
+ *  - binary-only reports skip the text stages but keep stats and ranking
+ *  - a scan that finds nothing still runs the energy and ranking stages
+ *
+ * Exits with 1 on a failed check.
+ *
+ * Usage: bench_analysis_pipeline [-v]
+ */
+
+#include <time.h>
+#include <stdint.h>
+
+static unsigned long cpuNanosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (unsigned long)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+#define ANALYSIS_CLOCK() cpuNanosNow()
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <string>
+
+static void runCycle(const ScanCycle &cycle) {
+    startEnergySweep(&energySampler, millis());
+    mockAdvanceMillis(ENERGY_SWEEP_TIMEOUT);
+    pollEnergySweep(&energySampler, millis());
+
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    int16_t status = Zigbee.scanComplete();
+    if (status >= 0) printScannedNetworks(status);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+static uint32_t stageRuns(const char *name) {
+    for (uint8_t i = 0; i < ScanAnalysis::STAGE_COUNT; i++) {
+        if (strcmp(scanAnalysis.timing[i].name, name) == 0) return scanAnalysis.timing[i].runs;
+    }
+    return 0;
+}
+
+static bool check(const char *name, bool ok) {
+    printf("%-52s %s\n", name, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc >= 2 && strcmp(argv[1], "-v") == 0;
+    bool ok = true;
+    const int cycles = 200;
+
+    initializeStats();
+    initEnergySampler(&energySampler, true);
+    CapturePrint capture;
+    Report.setOutput(capture);
+    mockAddInterferer({ MOCK_RF_WIFI, 2437, 20, -60, 30, 400 });
+    mockAddInterferer({ MOCK_RF_BLE, 0, 2, -65, 0, 5 });
+
+    ScanCycle cycle;
+    generateScanCycle(cycle, 40, 4242);
+    for (int i = 0; i < cycles; i++) {
+        perturbScanCycle(cycle, 100 + i);
+        runCycle(cycle);
+    }
+
+    printf("Per-stage CPU time, %d text-reported scans of %u networks\n\n", cycles, (unsigned)cycle.size());
+    printf("Stage                 Runs   Mean us    Max us   Share\n");
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < ScanAnalysis::STAGE_COUNT; i++) total += scanAnalysis.timing[i].totalMicros;
+    for (uint8_t i = 0; i < ScanAnalysis::STAGE_COUNT; i++) {
+        const AnalysisStageTiming *t = &scanAnalysis.timing[i];
+        printf("%-20s %5lu %9.2f %9.2f %6.1f%%\n", t->name, (unsigned long)t->runs,
+            t->runs ? t->totalMicros / 1e3 / t->runs : 0.0, t->maxMicros / 1e3,
+            total ? 100.0 * t->totalMicros / total : 0.0);
+    }
+    printf("\n");
+
+    ok &= check("text reports include channel interference",
+        capture.text.find("=== CHANNEL INTERFERENCE ===") != std::string::npos);
+    ok &= check("text reports include smart recommendations",
+        capture.text.find("SMART RECOMMENDATIONS") != std::string::npos);
+    if (verbose) printf("\n%s\n", capture.text.substr(capture.text.size() > 4000 ? capture.text.size() - 4000 : 0).c_str());
+
+    // Binary-only reports: the text stages are skipped
+    uint32_t textBefore = stageRuns("summary table");
+    uint32_t statsBefore = stageRuns("network stats");
+    setReportMode(REPORT_MODE_BINARY);
+    for (int i = 0; i < 20; i++) {
+        perturbScanCycle(cycle, 5000 + i);
+        runCycle(cycle);
+    }
+    ok &= check("binary reports skip the text stages",
+        stageRuns("summary table") == textBefore && stageRuns("interference") == textBefore);
+    ok &= check("binary reports still update the stats",
+        stageRuns("network stats") == statsBefore + 20);
+
+    // Nothing found: only the stages that run on every scan
+    uint32_t rankingBefore = stageRuns("channel ranking");
+    uint32_t energyBefore = stageRuns("energy window");
+    statsBefore = stageRuns("network stats");
+    ScanCycle empty;
+    runCycle(empty);
+    ok &= check("empty scan runs the energy and ranking stages",
+        stageRuns("channel ranking") == rankingBefore + 1 && stageRuns("energy window") == energyBefore + 1);
+    ok &= check("empty scan skips the report stages", stageRuns("network stats") == statsBefore);
+
+    printf("\nanalysis pipeline checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
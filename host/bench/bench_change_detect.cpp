@@ -0,0 +1,222 @@
+/*
+ * Change detection benchmark: feeds synthetic signal and load traces to the
+ * CUSUM detector and to the fixed rule it replaced (signal range over the
+ * last SIGNAL_HISTORY_SIZE samples above 50 units) and
+ * reports per trace type
+ *  - false alarms per 1000 samples on steady traces
+ *  - detection rate and delay (samples) for steps and slow drifts
+ *
+ * Then runs scans through the sketch to check that events come out with
+ * the network, time and severity, and times one detector update.
+ *
+ * Exits with 1 if the detector misses the limits below.
+ *
+ * Usage: bench_change_detect
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static double uniform() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return ((rngState >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double gaussian() {
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+// Level at sample t: base until start, then a step or a ramp
+struct Trace {
+    const char *name;
+    double base;
+    double sigma;
+    double step;          // at start
+    double slope;         // per sample from start, for ramp samples
+    int start;
+    int ramp;
+    int16_t minSpread;    // Q8
+    int16_t low, high;    // clamp
+    int16_t offset;       // taken off before the detector, as the sketch does
+};
+
+static int16_t sampleAt(const Trace &t, int i) {
+    double level = t.base;
+    if (i >= t.start) level += t.step + t.slope * fmin(i - t.start, t.ramp);
+    double v = round(level + t.sigma * gaussian());
+    return (int16_t)fmax(t.low, fmin(t.high, v));
+}
+
+// The rule the detector replaced: window range over the threshold
+struct RangeRule {
+    int16_t window[SIGNAL_HISTORY_SIZE];
+    int count;
+    int pos;
+    bool add(int16_t v, double threshold) {
+        window[pos] = v;
+        pos = (pos + 1) % SIGNAL_HISTORY_SIZE;
+        if (count < SIGNAL_HISTORY_SIZE) count++;
+        int16_t lo = window[0], hi = window[0];
+        for (int i = 1; i < count; i++) {
+            lo = min(lo, window[i]);
+            hi = max(hi, window[i]);
+        }
+        return hi - lo > threshold;
+    }
+};
+
+struct Outcome {
+    double falseAlarms;   // per 1000 samples before the change
+    double falseMajor;    // the same, major and critical only (text reports)
+    double detected;      // share of runs
+    double delay;         // mean samples from the change to the alarm
+};
+
+static Outcome evaluate(const Trace &t, int runs, int length, bool fixedRule) {
+    double falseAlarms = 0, falseMajor = 0, before = 0, detected = 0, delay = 0;
+    for (int r = 0; r < runs; r++) {
+        ChangeDetector d = {};
+        RangeRule rule = {};
+        bool found = false;
+        for (int i = 0; i < length; i++) {
+            int16_t v = sampleAt(t, i);
+            uint8_t severity;
+            if (fixedRule) {
+                severity = rule.add(v, 50) ? CHANGE_MAJOR : CHANGE_NONE;
+            } else {
+                severity = changeDetectorAdd(&d, v - t.offset, t.minSpread).severity;
+            }
+            bool alarm = severity != CHANGE_NONE;
+            if (i < t.start) {
+                before++;
+                if (alarm) falseAlarms++;
+                if (severity >= CHANGE_MAJOR) falseMajor++;
+            } else if (alarm && !found && (t.step != 0 || t.slope != 0)) {
+                found = true;
+                detected++;
+                delay += i - t.start;
+            }
+        }
+    }
+    Outcome o;
+    o.falseAlarms = before ? falseAlarms * 1000 / before : 0;
+    o.falseMajor = before ? falseMajor * 1000 / before : 0;
+    o.detected = detected / runs;
+    o.delay = detected ? delay / detected : 0;
+    return o;
+}
+
+static void printOutcome(const char *name, const char *detector, const Outcome &o, bool change) {
+    if (change) {
+        printf("%-34s %-8s %10.2f %10.2f %9.0f%% %9.1f\n", name, detector, o.falseAlarms, o.falseMajor,
+            o.detected * 100, o.delay);
+    } else {
+        printf("%-34s %-8s %10.2f %10.2f %10s %9s\n", name, detector, o.falseAlarms, o.falseMajor, "-", "-");
+    }
+}
+
+static bool sketchEvents() {
+    initializeStats();
+    Report.setMuted(true);
+    ScanCycle cycle;
+    generateScanCycle(cycle, 6, 17);
+    for (int i = 0; i < 30; i++) {
+        Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+        Zigbee.scanNetworks();
+        mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+        int16_t status = Zigbee.scanComplete();
+        if (status > 0) printScannedNetworks(status);
+        mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+    }
+    bool steady = changeLog.total == 0;
+
+    // The mock's signal is fixed per network, so the drop is fed to the
+    // snapshot the last scan left behind
+    ScanSnapshot scan = currentScan;
+    uint8_t level = scan.signal[2];
+    int step = level >= 128 ? -64 : 64;
+    uint32_t dropAt = 0;
+    for (int i = 0; i < 12; i++) {
+        scan.timestamp += SCAN_INTERVAL_NORMAL;
+        if (i == 5) dropAt = scan.timestamp;
+        scan.signal[2] = (uint8_t)(level + (i >= 5 ? step : 0) + (i % 3) - 1);
+        detectNetworkChanges(&changeLog, &scan);
+    }
+    const ChangeEvent *e = &changeLog.events[0];
+    bool found = changeLog.total == 1 && e->series == CHANGE_SERIES_SIGNAL && e->panId == scan.panId[2] &&
+        e->direction == (step < 0 ? -1 : 1) && e->severity == CHANGE_CRITICAL && abs(e->before - e->after) >= 45 &&
+        e->time >= dropAt && e->time <= dropAt + 2 * SCAN_INTERVAL_NORMAL &&
+        recentSignalShift(scanStats[2]);
+
+    printf("\n%-52s %s\n", "sketch: 30 steady scans, no changes", steady ? "ok" : "FAIL");
+    printf("%-52s %s\n", "sketch: signal step of 64, one critical event on the PAN", found ? "ok" : "FAIL");
+    return steady && found;
+}
+
+int main() {
+    bool ok = true;
+    const int runs = 400;
+    const int length = 600;
+    const int16_t sig = CHANGE_MIN_SPREAD_SIGNAL;
+    const int16_t pct = CHANGE_MIN_SPREAD_LOAD;
+
+    printf("%d runs of %d samples per trace, change at sample 100\n\n", runs, length);
+    printf("%-34s %-8s %10s %10s %10s %9s\n", "Trace", "Detector", "False/1k", "Major/1k", "Detected", "Delay");
+
+    // Limits: false alarms of any size and of major size per 1000 samples,
+    // share detected within the run and mean delay in samples
+    struct Case { Trace trace; double maxFalse; double maxMajor; double minDetected; double maxDelay; };
+    const Case cases[] = {
+        { { "steady signal, sd 3", 96, 3, 0, 0, length, 0, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0, 0 },
+        { { "steady signal, sd 6", 96, 6, 0, 0, length, 0, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0, 0 },
+        { { "steady signal, sd 12", 96, 12, 0, 0, length, 0, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0, 0 },
+        { { "signal step -10, sd 6", 96, 6, -10, 0, 100, 0, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0.8, 40 },
+        { { "signal step -19, sd 6", 96, 6, -19, 0, 100, 0, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0.98, 8 },
+        { { "signal step -64, sd 6", 96, 6, -64, 0, 100, 0, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0.99, 3 },
+        { { "signal drift -0.16/scan, sd 6", 96, 6, 0, -0.16, 100, 400, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0.95, 150 },
+        { { "signal drift -0.64/scan, sd 6", 96, 6, 0, -0.64, 100, 100, sig, 0, 255, CHANGE_SIGNAL_OFFSET }, 4.0, 0.5, 0.98, 50 },
+        { { "load step 20 -> 60%, sd 3", 20, 3, 40, 0, 100, 0, pct, 0, 100, 0 }, 4.0, 0.5, 0.99, 4 },
+    };
+
+    for (const Case &c : cases) {
+        bool change = c.trace.step != 0 || c.trace.slope != 0;
+        Outcome cusum = evaluate(c.trace, runs, length, false);
+        printOutcome(c.trace.name, "cusum", cusum, change);
+        if (c.trace.minSpread == sig) printOutcome("", "range", evaluate(c.trace, runs, length, true), change);
+        bool pass = cusum.falseAlarms <= c.maxFalse && cusum.falseMajor <= c.maxMajor &&
+            (!change || (cusum.detected >= c.minDetected && cusum.delay <= c.maxDelay));
+        if (!pass) printf("%-34s FAIL (limits: %.1f false/1k, %.1f major/1k, %.0f%% detected, delay %.0f)\n", "",
+            c.maxFalse, c.maxMajor, c.minDetected * 100, c.maxDelay);
+        ok &= pass;
+    }
+
+    ok &= sketchEvents();
+
+    ChangeDetector d = {};
+    const int samples = 2000000;
+    int16_t values[256];
+    for (int i = 0; i < 256; i++) values[i] = (int16_t)round(96 - CHANGE_SIGNAL_OFFSET + 6 * gaussian());
+    uint32_t alarms = 0;
+    double start = cpuMicrosNow();
+    for (int i = 0; i < samples; i++) alarms += changeDetectorAdd(&d, values[i & 255], sig).severity;
+    double micros = cpuMicrosNow() - start;
+    printf("\ncpu: %.1f ns per detector update, %u bytes per detector (%u alarms)\n",
+        micros * 1000 / samples, (unsigned)sizeof(ChangeDetector), (unsigned)alarms);
+
+    printf("\nchange detection checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * Channel planner benchmark: runs the sketch's setup()/loop() for two hours
+ * of virtual time in a world where networks come and go, once with the
+ * adaptive per-channel schedule and once with the fixed full sweep.
+ *
+ * Reports scan airtime per hour and how long it takes to notice a network
+ * appearing (it shows up in the network table) or disappearing (a scan
+ * started after it left covered its channel).
+ *
+ * Usage: bench_channel_planner [event interval s]
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+
+static const unsigned long RUN_TIME = 7200000UL;
+
+// Long-lived networks: two busy channels, one with a single network
+static const uint8_t BASE_CHANNELS[] = { 15, 15, 15, 20, 20, 25 };
+// Where visitors show up, busy and quiet channels alternating
+static const uint8_t EVENT_CHANNELS[] = { 15, 13, 20, 18, 25, 22, 11, 26 };
+
+struct DetectStats {
+    uint32_t count;
+    uint32_t missed;
+    unsigned long sum;
+    unsigned long max;
+
+    void add(unsigned long ms) {
+        count++;
+        sum += ms;
+        if (ms > max) max = ms;
+    }
+};
+
+struct PlannerCost {
+    uint32_t scans;
+    uint32_t fullSweeps;
+    unsigned long airtimeMs;
+    DetectStats appear;
+    DetectStats vanish;
+};
+
+static zigbee_scan_result_t makeNetwork(uint16_t pan, uint8_t channel) {
+    zigbee_scan_result_t n = {};
+    n.short_pan_id = pan;
+    n.logic_channel = channel;
+    n.router_capacity = true;
+    n.end_device_capacity = true;
+    for (int b = 0; b < 8; b++) n.extended_pan_id[b] = (uint8_t)(pan >> (b % 2 * 8)) ^ (uint8_t)(b * 37);
+    return n;
+}
+
+static uint64_t extendedPan(const zigbee_scan_result_t &n) {
+    uint64_t ext = 0;
+    for (int b = 7; b >= 0; b--) ext = (ext << 8) | n.extended_pan_id[b];
+    return ext;
+}
+
+static PlannerCost run(bool adaptive, unsigned long eventInterval) {
+    PlannerCost cost = {};
+    ScanCycle world;
+    for (size_t i = 0; i < sizeof(BASE_CHANNELS); i++) {
+        world.push_back(makeNetwork((uint16_t)(0x1100 + i * 0x0101), BASE_CHANNELS[i]));
+    }
+    Zigbee.mockSetScanResults(world.data(), (uint16_t)world.size());
+
+    setup();
+    channelPlanner.adaptive = adaptive;
+    uint32_t scansBefore = Zigbee.mockScanCount();
+    uint32_t sweepsBefore = channelPlanner.fullSweeps;
+    unsigned long airtimeBefore = Zigbee.mockScanAirtimeMs();
+    uint32_t completed = Zigbee.mockCompletedScans();
+
+    unsigned long start = millis();
+    unsigned long end = start + RUN_TIME;
+    unsigned long nextEvent = start + eventInterval;
+    uint32_t eventNo = 0;
+
+    // The visitor currently being watched for
+    bool visitorPresent = false;
+    bool waiting = false;
+    unsigned long eventTime = 0;
+    zigbee_scan_result_t visitor = {};
+
+    while ((long)(millis() - end) < 0) {
+        unsigned long now = millis();
+
+        if ((long)(now - nextEvent) >= 0) {
+            if (waiting) {
+                if (visitorPresent) cost.appear.missed++;
+                else cost.vanish.missed++;
+            }
+            if (!visitorPresent) {
+                uint8_t channel = EVENT_CHANNELS[eventNo % sizeof(EVENT_CHANNELS)];
+                visitor = makeNetwork((uint16_t)(0x5000 + eventNo), channel);
+                world.push_back(visitor);
+            } else {
+                world.pop_back();
+            }
+            Zigbee.mockSetScanResults(world.data(), (uint16_t)world.size());
+            visitorPresent = !visitorPresent;
+            waiting = true;
+            eventTime = now;
+            eventNo++;
+            nextEvent += eventInterval;
+        }
+
+        loop();
+
+        if (waiting && visitorPresent &&
+            findNetworkStats(&networkTable, visitor.short_pan_id, extendedPan(visitor)) != NULL) {
+            cost.appear.add(millis() - eventTime);
+            waiting = false;
+        }
+        if (Zigbee.mockCompletedScans() != completed) {
+            completed = Zigbee.mockCompletedScans();
+            if (waiting && !visitorPresent &&
+                (long)(scheduler.scanStartTime - eventTime) >= 0 &&
+                (scheduler.scanMask & (1UL << visitor.logic_channel))) {
+                cost.vanish.add(millis() - eventTime);
+                waiting = false;
+            }
+        }
+    }
+
+    cost.scans = Zigbee.mockScanCount() - scansBefore;
+    cost.fullSweeps = channelPlanner.fullSweeps - sweepsBefore;
+    cost.airtimeMs = Zigbee.mockScanAirtimeMs() - airtimeBefore;
+    return cost;
+}
+
+static void print(const char *name, const PlannerCost &cost) {
+    double hours = RUN_TIME / 3600000.0;
+    printf("%-16s %8.1f %8.1f %11.1f %8.1f %9.1f %8.1f %9.1f %8.1f\n", name,
+        cost.scans / hours, cost.fullSweeps / hours,
+        cost.airtimeMs / 1000.0 / hours, 100.0 * cost.airtimeMs / RUN_TIME,
+        cost.appear.count ? cost.appear.sum / 1000.0 / cost.appear.count : 0.0,
+        cost.appear.max / 1000.0,
+        cost.vanish.count ? cost.vanish.sum / 1000.0 / cost.vanish.count : 0.0,
+        cost.vanish.max / 1000.0);
+    if (cost.appear.missed || cost.vanish.missed) {
+        printf("%-16s %u appearances, %u disappearances not seen before the next event\n", "",
+            (unsigned)cost.appear.missed, (unsigned)cost.vanish.missed);
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long eventInterval = (argc >= 2 ? atoi(argv[1]) : 240) * 1000UL;
+
+    printf("%u long-lived networks on channels 15/20/25, a visitor network comes or goes every %lu s,\n"
+        "%lu minutes of virtual time\n\n",
+        (unsigned)sizeof(BASE_CHANNELS), eventInterval / 1000, RUN_TIME / 60000);
+    printf("%-16s %8s %8s %11s %8s %9s %8s %9s %8s\n", "schedule",
+        "scans/h", "full/h", "airtime s/h", "radio %", "appear s", "max s", "vanish s", "max s");
+
+    print("adaptive", run(true, eventInterval));
+    print("fixed 30 s sweep", run(false, eventInterval));
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Channel scoring benchmark: prints the compile-time WiFi overlap table and
+ * ranks channels for a few fixed situations, checking the order against
+ * what the inputs imply:
+ *  - nothing known: the channels clear of WiFi 1/6/11 first (15, 20, 25, 26)
+ *  - Zigbee networks and their load push their channels down
+ *  - measured WiFi and a constant carrier replace the 1/6/11 assumption
+ *  - the same inputs in another network order give the same ranking
+ *  - the WiFi interference advice names the best ranked other channels
+ *
+ * Also reports the CPU time of one ranking pass. Exits with 1 on a mismatch.
+ *
+ * Usage: bench_channel_score [-v]
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void addNetwork(ScanSnapshot *scan, uint16_t pan, uint8_t channel, uint8_t load) {
+    uint16_t n = scan->count++;
+    scan->panId[n] = pan;
+    scan->channel[n] = channel;
+    scan->load[n] = load;
+}
+
+static std::string orderText(const ChannelRanking *r, int count) {
+    std::string text;
+    for (int i = 0; i < count; i++) {
+        char ch[16];            // " " and any int
+        snprintf(ch, sizeof(ch), "%s%d", i ? " " : "", MIN_CHANNEL + r->order[i]);
+        text += ch;
+    }
+    return text;
+}
+
+static bool check(const char *name, const ChannelRanking *r, int count, const char *expected, bool verbose) {
+    std::string got = orderText(r, count);
+    bool ok = got == expected;
+    printf("%-44s %-28s %s\n", name, got.c_str(), ok ? "ok" : "FAIL");
+    if (!ok) printf("%-44s %-28s\n", "", expected);
+    if (verbose || !ok) {
+        CapturePrint table;
+        printChannelRanking(r, table);
+        printf("\n%s\n", table.text.c_str());
+    }
+    return ok;
+}
+
+static void printOverlapTable() {
+    printf("Zigbee channel overlap with 20 MHz WiFi channels (%% of in-band level)\n");
+    printf("ch  ");
+    for (int w = 1; w <= WIFI_CHANNEL_COUNT; w++) printf("%4d", w);
+    printf("\n");
+    for (int z = MIN_CHANNEL; z <= MAX_CHANNEL; z++) {
+        printf("%2d  ", z);
+        for (int w = 1; w <= WIFI_CHANNEL_COUNT; w++) printf("%4u", wifiOverlap20(z, w));
+        printf("\n");
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc >= 2 && strcmp(argv[1], "-v") == 0;
+    bool ok = true;
+    static ScanSnapshot scan;
+    static InterferenceAnalysis analysis[CHANNEL_COUNT];
+
+    printOverlapTable();
+
+    // Nothing seen yet
+    initChannelRanking(&channelRanking);
+    memset(&scan, 0, sizeof(scan));
+    scan.channelMask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+    memset(analysis, 0, sizeof(analysis));
+    rankChannels(&channelRanking, &scan, analysis);
+    ok &= check("empty band, WiFi 1/6/11 assumed", &channelRanking, 5, "15 20 25 26 11", verbose);
+
+    // Networks on 15 and 20, one busy
+    addNetwork(&scan, 0x1501, 15, 10);
+    addNetwork(&scan, 0x1502, 15, 20);
+    addNetwork(&scan, 0x2001, 20, 80);
+    addNetwork(&scan, 0x2501, 25, 0);
+    rankChannels(&channelRanking, &scan, analysis);
+    ok &= check("networks on 15 (2), 20 (load 80), 25", &channelRanking, 6, "26 11 12 13 14 16", verbose);
+    uint8_t free[3];
+    uint8_t n = recommendedChannels(&channelRanking, free, 3, true);
+    bool freeOk = n == 3 && free[0] == 26 && free[1] == 11 && free[2] == 12;
+    printf("%-44s %u %u %u%21s %s\n", "best free channels", free[0], free[1], free[2], "", freeOk ? "ok" : "FAIL");
+    ok &= freeOk;
+
+    // A targeted scan of 15 only: the other channels keep their networks
+    ScanSnapshot targeted = {};
+    targeted.channelMask = 1UL << 15;
+    addNetwork(&targeted, 0x1501, 15, 10);
+    rankChannels(&channelRanking, &targeted, analysis);
+    bool kept = channelRanking.channels[20 - MIN_CHANNEL].networks == 1 &&
+        channelRanking.channels[15 - MIN_CHANNEL].networks == 1;
+    printf("%-44s %-28s %s\n", "targeted scan keeps other channels", kept ? "yes" : "no", kept ? "ok" : "FAIL");
+    ok &= kept;
+
+    // Energy detect: WiFi 6 busy 30%, a carrier on 26, BLE on 12
+    for (int z = 16; z <= 19; z++) {
+        analysis[z - MIN_CHANNEL].dutyCycle = 35;
+        analysis[z - MIN_CHANNEL].wifiOverlap = 30;
+    }
+    analysis[26 - MIN_CHANNEL].dutyCycle = 100;
+    analysis[12 - MIN_CHANNEL].dutyCycle = 15;
+    for (int z = 0; z < CHANNEL_COUNT; z++) analysis[z].samples = 20;
+    rankChannels(&channelRanking, &scan, analysis);
+    ok &= check("measured: WiFi 6 30%, carrier 26, BT on 12", &channelRanking, CHANNEL_COUNT,
+        "11 13 14 21 22 23 24 12 16 17 18 19 25 20 15 26", verbose);
+    bool wifiOk = channelRanking.measured && channelRanking.wifiActivity[6 - 1] == 30 &&
+        channelRanking.wifiActivity[1 - 1] == 0 && channelRanking.wifiActivity[11 - 1] == 0;
+    printf("%-44s %-28s %s\n", "WiFi activity from energy detect", wifiOk ? "WiFi 6 only" : "wrong", wifiOk ? "ok" : "FAIL");
+    ok &= wifiOk;
+
+    // Same inputs, networks reversed
+    std::string before = orderText(&channelRanking, CHANNEL_COUNT);
+    ScanSnapshot reversed = scan;
+    for (uint16_t i = 0; i < scan.count; i++) {
+        uint16_t j = scan.count - 1 - i;
+        reversed.panId[i] = scan.panId[j];
+        reversed.channel[i] = scan.channel[j];
+        reversed.load[i] = scan.load[j];
+    }
+    rankChannels(&channelRanking, &reversed, analysis);
+    bool same = orderText(&channelRanking, CHANNEL_COUNT) == before;
+    printf("%-44s %-28s %s\n", "network order does not matter", same ? "same ranking" : "differs", same ? "ok" : "FAIL");
+    ok &= same;
+
+    // WiFi advice names the best ranked channels other than its own
+    bool adviceOk = true;
+    for (uint8_t channel : { 18, 11 }) {
+        InterferenceAnalysis *a = &currentAnalysis[channel - MIN_CHANNEL];
+        a->wifiOverlap = 90;
+        a->interferenceType = INTERFERENCE_WIFI;
+        CapturePrint advice;
+        analyzeChannelInterference(channel, channelRanking.order, advice);
+        adviceOk &= advice.text.find(channel == 18 ? "Consider using channel 11, 13, 14 (best ranked)"
+                                                   : "Consider using channel 13, 14, 21 (best ranked)") != std::string::npos;
+        if (verbose) printf("%s", advice.text.c_str());
+        memset(a, 0, sizeof(InterferenceAnalysis));
+    }
+    printf("%-44s %-28s %s\n", "WiFi advice from the ranking", adviceOk ? "11 13 14 / 13 14 21" : "wrong",
+        adviceOk ? "ok" : "FAIL");
+    ok &= adviceOk;
+
+    // Cost of a ranking pass over a full scan
+    ScanSnapshot full = {};
+    full.channelMask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+    for (uint16_t i = 0; i < SCAN_SNAPSHOT_CAPACITY; i++) {
+        addNetwork(&full, (uint16_t)(0x4000 + i), (uint8_t)(MIN_CHANNEL + i * 7 % CHANNEL_COUNT), (uint8_t)(i * 13 % 100));
+    }
+    const int passes = 200000;
+    double start = cpuMicrosNow();
+    for (int i = 0; i < passes; i++) {
+        full.load[i % full.count] = (uint8_t)(i % 100);
+        rankChannels(&channelRanking, &full, analysis);
+    }
+    double micros = cpuMicrosNow() - start;
+    printf("\ncpu: %.2f us per ranking pass (%u networks, 16 channels, 14 + 9 WiFi channels)\n",
+        micros / passes, (unsigned)full.count);
+
+    printf("\nchannel score checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/*
+ * Cycle profile benchmark: runs the sketch's setup()/loop() for an hour of
+ * virtual time in binary report mode and checks what the profile recorded
+ * against what the run did: every phase seen in every scan cycle that has
+ * it, histograms that add up, heap and stack water marks that follow the
+ * mock's, and profile frames the host decoder reads back to the same
+ * numbers. Built twice, with CYCLE_PROFILE 1 and 0, to compare the CPU time
+ * per scan cycle; the instrumented build also times the hooks themselves.
+ * Both builds check that the scans kept their schedule and sent a telemetry
+ * frame each, and the build without the profile that it sent no profile
+ * frames.
+ *
+ * Usage: bench_cycle_profile [networks]
+ *
+ * Exits with 1 if a check fails.
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+#include "telemetry/telemetry_decoder.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static const unsigned long RUN_TIME = 3600000UL;
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static uint64_t wakeups = 0;
+
+// Runs loop() until the virtual clock reaches end; returns the CPU time
+static double runUntil(unsigned long end) {
+    double start = cpuMicrosNow();
+    while ((long)(millis() - end) < 0) {
+        loop();
+        wakeups++;
+    }
+    return cpuMicrosNow() - start;
+}
+
+#if CYCLE_PROFILE
+
+static void checkProfile() {
+    const CycleProfile *p = &cycleProfile;
+    check(p->scanCycles > 0, "scan cycles were profiled");
+    check(p->phases[PHASE_AIRTIME].cycles == p->scanCycles, "every scan cycle has airtime");
+    // Planned scans of quiet channels find nothing and have no result to copy
+    check(p->phases[PHASE_RESULT_COPY].cycles > 0, "scan results were copied");
+    check(p->phases[PHASE_DECODE].cycles == p->phases[PHASE_RESULT_COPY].cycles, "every copied result was decoded");
+    check(p->phases[PHASE_STATS].cycles == p->scanCycles, "every scan cycle updated the stats");
+    check(p->phases[PHASE_TELEMETRY].cycles == p->scanCycles, "every scan cycle wrote a frame");
+    check(p->phases[PHASE_TEXT].cycles == 0, "no text stages in binary mode");
+
+    for (uint8_t i = 0; i < CYCLE_PHASES; i++) {
+        const CyclePhaseStats *s = &p->phases[i];
+        uint32_t sum = 0;
+        for (uint8_t b = 0; b < CYCLE_PROFILE_BUCKETS; b++) sum += s->histogram[b];
+        check(sum == s->cycles, "histogram adds up to the phase's cycles");
+        check(s->cycles <= p->scanCycles, "a phase counts once per scan cycle");
+        check(s->cycles == 0 || (s->max >= s->last && s->total >= s->max), "max, last and total agree");
+        check(cycleProfileQuantile(s, 50) <= cycleProfileQuantile(s, 90), "p50 <= p90");
+    }
+    // Airtime covers the scan itself, milliseconds rather than microseconds
+    check(p->phases[PHASE_AIRTIME].total / p->phases[PHASE_AIRTIME].cycles >
+          p->phases[PHASE_DECODE].total / p->phases[PHASE_DECODE].cycles, "airtime dominates decode");
+}
+
+// Cost of one CYCLE_PHASE() scope around nothing, in host nanoseconds
+static double hookNanos() {
+    const int count = 1000000;
+    uint32_t pending = cycleProfile.phases[PHASE_SERIAL].pending;
+    double start = cpuMicrosNow();
+    for (int i = 0; i < count; i++) {
+        CYCLE_PHASE(PHASE_SERIAL);
+        __asm__ __volatile__("" ::: "memory");
+    }
+    double nanos = (cpuMicrosNow() - start) * 1000.0 / count;
+    cycleProfile.phases[PHASE_SERIAL].pending = pending;
+    return nanos;
+}
+
+#endif
+
+int main(int argc, char **argv) {
+    int networks = argc >= 2 ? atoi(argv[1]) : 50;
+    ScanCycle cycle;
+    generateScanCycle(cycle, (uint16_t)networks, 1919);
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+
+    // First half on a roomy heap, second half on a tight one with less stack
+    mockSetHeap(300000, 180000);
+    mockSetStackHeadroom(6000);
+    setup();
+    setReportMode(REPORT_MODE_BINARY);
+    ByteCapturePrint capture;
+    Report.setOutput(capture);
+    double cpu = runUntil(millis() + RUN_TIME / 2);
+    mockSetHeap(120000, 40000);
+    mockSetStackHeadroom(2500);
+    cpu += runUntil(millis() + RUN_TIME / 2);
+    uint32_t scans = Zigbee.mockCompletedScans();
+
+    printf("%d networks, %lu minutes of virtual time, CYCLE_PROFILE %d\n", networks, RUN_TIME / 60000,
+        CYCLE_PROFILE);
+    printf("%u scans, %.1f us CPU per scan cycle\n", (unsigned)scans, scans ? cpu / scans : 0.0);
+
+    // Either build: a scan frame per scan cycle that decodes cleanly, and
+    // profile frames only with the profile
+    uint32_t scanFrames = 0;
+    TelemetryDecoder decoder([&](const TelemetryScan &) { scanFrames++; });
+    std::vector<TelemetryProfile> frames;
+    decoder.setProfileHandler([&](const TelemetryProfile &profile) { frames.push_back(profile); });
+    decoder.feed(capture.bytes.data(), capture.bytes.size());
+    check(scans >= RUN_TIME / SCAN_INTERVAL_NORMAL, "the scanner kept its schedule");
+    check(decoder.stats().crcErrors == 0 && decoder.stats().malformed == 0, "frames decode cleanly");
+    check(scanFrames == scans, "a scan frame per scan");
+    check(CYCLE_PROFILE || frames.empty(), "no profile frames without CYCLE_PROFILE");
+
+#if CYCLE_PROFILE
+    printf("\n");
+    Serial.mockSetEcho(true);
+    printCycleProfile(Serial);
+    Serial.mockSetEcho(false);
+    checkProfile();
+
+    const MemoryWatermarks *m = &cycleProfile.memory;
+    check(m->freeHeapMin == 120000 && m->freeHeapMax == 300000, "free heap water marks");
+    check(m->largestBlockMin == 40000 && m->largestBlockMax == 180000, "largest block water marks");
+    check(m->stackHeadroomMin == 2500, "stack headroom water mark");
+
+    // Profile frames: one per scheduler report, windows that add up to the
+    // totals since boot
+    check(frames.size() >= RUN_TIME / SCHEDULER_REPORT_INTERVAL - 1, "a profile frame per scheduler report");
+    if (!frames.empty()) {
+        const TelemetryProfile &last = frames.back();
+        check(last.cpuMHz == ESP.getCpuFreqMHz(), "frame CPU clock");
+        check(last.phases.size() == CYCLE_PHASES, "frame phase count");
+        check(last.freeHeapMin == m->freeHeapMin && last.largestBlockMin == m->largestBlockMin &&
+              last.stackHeadroomMin == m->stackHeadroomMin, "frame water marks");
+        for (uint8_t i = 0; i < CYCLE_PHASES && i < last.phases.size(); i++) {
+            const CyclePhaseStats *s = &cycleProfile.phases[i];
+            uint64_t windows = 0;
+            bool sameWindow = true;
+            for (const TelemetryProfile &frame : frames) {
+                const TelemetryPhase &phase = frame.phases[i];
+                windows += phase.cycles;
+                // Percentiles of the frame's own window, within its max
+                sameWindow &= phase.p50 <= phase.p90 && phase.p90 <= phase.max && (phase.cycles || phase.p90 == 0);
+            }
+            check(sameWindow, "frame percentiles over the frame's window");
+            // The cycles after the last report are still in the window
+            check(windows + s->windowCycles == s->cycles, "frame windows add up to the phase's cycles");
+        }
+    }
+    printf("\n%zu profile frames, %zu bytes of telemetry\n", frames.size(), capture.bytes.size());
+
+    // The serial phase runs on every wakeup, the others about once a cycle
+    uint64_t hooks = wakeups;
+    for (uint8_t i = 0; i < PHASE_SERIAL; i++) hooks += cycleProfile.phases[i].cycles;
+    double nanos = hookNanos();
+    double perScan = scans ? hooks * nanos / 1000.0 / scans : 0;
+    printf("CYCLE_PHASE() %.1f ns each, about %.2f us (%.2f%%) per scan cycle\n", nanos, perScan,
+        scans ? 100.0 * perScan / (cpu / scans) : 0.0);
+    printf("Compare the CPU per scan cycle with bench_cycle_profile_off\n");
+#endif
+
+    Report.setOutput(Serial);
+    return checkResult();
+}
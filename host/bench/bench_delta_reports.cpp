@@ -0,0 +1,261 @@
+/*
+ * Delta report benchmark: a mostly static world where now and then a
+ * network toggles permit-join, leaves, or a new one shows up. Compares
+ * report bytes per scan for full reports and delta reports (text and
+ * binary), and checks on the decoded binary stream that every such event
+ * made it into a delta frame and that a late-attaching decoder gets a full
+ * keyframe within DELTA_KEYFRAME_INTERVAL frames. Targeted scans over a
+ * full network history must keep the networks they saw and not report one
+ * that moved channel as gone.
+ *
+ * Usage: bench_delta_reports [networks] [cycles]
+ *
+ * Exits with 1 if an event was not reported or the history lost a network.
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+#include "telemetry/telemetry_decoder.h"
+
+#include <stdio.h>
+#include <set>
+
+// What changed before a scan, as the decoder should see it
+struct CycleEvents {
+    std::set<uint16_t> appeared;
+    std::set<uint16_t> left;
+    std::set<uint16_t> changed;
+};
+
+struct World {
+    ScanCycle networks;
+    uint32_t state;
+    uint16_t nextPan;
+};
+
+static uint32_t nextRandom(World &world) {
+    world.state = world.state * 1103515245u + 12345u;
+    return world.state >> 8;
+}
+
+// One step of the world: ~1 in 8 scans has an event
+static CycleEvents stepWorld(World &world) {
+    CycleEvents events;
+    uint32_t r = nextRandom(world);
+    if (r % 8 != 0 || world.networks.empty()) return events;
+
+    size_t victim = nextRandom(world) % world.networks.size();
+    switch ((r >> 3) % 3) {
+        case 0:
+            world.networks[victim].permit_joining = !world.networks[victim].permit_joining;
+            events.changed.insert(world.networks[victim].short_pan_id);
+            break;
+        case 1:
+            events.left.insert(world.networks[victim].short_pan_id);
+            world.networks.erase(world.networks.begin() + victim);
+            break;
+        default: {
+            ScanCycle fresh;
+            generateScanCycle(fresh, 1, world.nextPan);
+            fresh[0].short_pan_id = (uint16_t)(0x4000 + world.nextPan++);
+            world.networks.push_back(fresh[0]);
+            events.appeared.insert(fresh[0].short_pan_id);
+            break;
+        }
+    }
+    return events;
+}
+
+static void runCycle(const ScanCycle &cycle) {
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    int16_t status = Zigbee.scanComplete();
+    if (status > 0) printScannedNetworks(status);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+struct RunResult {
+    double bytesPerScan;
+    uint32_t events;
+    uint32_t missed;
+    uint32_t frames;
+    uint32_t keyframes;
+};
+
+static RunResult run(uint8_t mode, bool delta, uint16_t count, int cycles) {
+    RunResult result = {};
+    World world;
+    generateScanCycle(world.networks, count, 2024);
+    world.state = 5;
+    world.nextPan = 1;
+
+    initializeStats();
+    setReportMode(mode);
+    deltaReports = delta;
+
+    ByteCapturePrint capture;
+    CycleEvents expected;
+    TelemetryDecoder decoder([&](const TelemetryScan &scan) {
+        result.frames++;
+        if (scan.keyframe) result.keyframes++;
+        for (const TelemetryNetwork &n : scan.networks) {
+            if (n.flags & NETWORK_FLAG_GONE) expected.left.erase(n.panId);
+            else {
+                expected.appeared.erase(n.panId);
+                expected.changed.erase(n.panId);
+            }
+        }
+    });
+
+    Report.setOutput(capture);
+    size_t total = 0;
+    for (int i = 0; i < cycles; i++) {
+        // The first scan is the baseline, changes start after it
+        expected = i > 0 ? stepWorld(world) : CycleEvents();
+        result.events += expected.appeared.size() + expected.left.size() + expected.changed.size();
+        perturbScanCycle(world.networks, 300 + i);
+        runCycle(world.networks);
+
+        total += capture.bytes.size();
+        if (mode & REPORT_MODE_BINARY) {
+            decoder.feed(capture.bytes.data(), capture.bytes.size());
+            result.missed += expected.appeared.size() + expected.left.size() + expected.changed.size();
+        }
+        capture.bytes.clear();
+    }
+    Report.setOutput(Serial);
+    setReportMode(REPORT_MODE_TEXT);
+    deltaReports = DELTA_REPORTS;
+
+    result.bytesPerScan = (double)total / cycles;
+    return result;
+}
+
+// Frames a decoder attached at every offset of the stream waits for its
+// first keyframe
+static int worstResync(uint16_t count, int cycles) {
+    World world;
+    generateScanCycle(world.networks, count, 2024);
+    world.state = 5;
+    world.nextPan = 1;
+    initializeStats();
+    setReportMode(REPORT_MODE_BINARY);
+    deltaReports = true;
+
+    ByteCapturePrint capture;
+    std::vector<bool> keyframes;
+    TelemetryDecoder decoder([&](const TelemetryScan &scan) { keyframes.push_back(scan.keyframe); });
+    Report.setOutput(capture);
+    for (int i = 0; i < cycles; i++) {
+        stepWorld(world);
+        runCycle(world.networks);
+        decoder.feed(capture.bytes.data(), capture.bytes.size());
+        capture.bytes.clear();
+    }
+    Report.setOutput(Serial);
+    setReportMode(REPORT_MODE_TEXT);
+    deltaReports = DELTA_REPORTS;
+
+    int worst = 0;
+    for (size_t start = 0; start < keyframes.size(); start++) {
+        size_t i = start;
+        while (i < keyframes.size() && !keyframes[i]) i++;
+        if (i < keyframes.size()) worst = max(worst, (int)(i - start + 1));
+    }
+    return worst;
+}
+
+struct SnapshotNetwork {
+    uint16_t pan;
+    uint8_t channel;
+};
+
+// Reports a scan over mask with these networks, filled in directly so it
+// can cover any channels
+static void snapshotScan(uint32_t mask, const std::vector<SnapshotNetwork> &networks) {
+    beginScanSnapshot(&currentScan, mask);
+    for (const SnapshotNetwork &n : networks) {
+        uint16_t i = currentScan.count++;
+        currentScan.panId[i] = n.pan;
+        currentScan.extendedPanId[i] = n.pan;
+        currentScan.channel[i] = n.channel;
+        currentScan.signal[i] = 0x80;
+        currentScan.load[i] = 10;
+        currentScan.flags[i] = NETWORK_FLAG_SECURED;
+    }
+    reportScannedNetworks((uint16_t)networks.size(), true, &currentScan);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+static bool allStable() {
+    for (uint16_t i = 0; i < currentScan.count; i++) {
+        if (reportSelection.status[i] != NETWORK_STATUS_STABLE) return false;
+    }
+    return true;
+}
+
+// Targeted scans on a full history: what a scan saw is kept before what
+// other channels saw, and a network that moved channel is not reported
+// gone from the old one
+static bool targetedHistory() {
+    initializeStats();
+    setReportMode(REPORT_MODE_NONE);
+    const uint32_t ch15 = 1UL << 15, ch20 = 1UL << 20;
+    std::vector<SnapshotNetwork> all, on15, on20;
+    for (uint16_t i = 0; i < MAX_NETWORKS; i++) {
+        SnapshotNetwork n = { (uint16_t)(0x100 + i), (uint8_t)(i < MAX_NETWORKS / 2 ? 15 : 20) };
+        all.push_back(n);
+        if (n.channel == 20) on20.push_back(n);
+    }
+    for (uint16_t i = 0; i < MAX_NETWORKS / 2; i++) on15.push_back({ (uint16_t)(0x800 + i), 15 });
+    snapshotScan(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, all);
+
+    // Channel 15 turns over completely
+    snapshotScan(ch15, on15);
+    bool turnover = reportSelection.goneCount == MAX_NETWORKS / 2;
+    snapshotScan(ch15, on15);
+    bool kept = allStable() && reportSelection.goneCount == 0;
+
+    // One network moves from 20 to 15
+    on15.push_back({ on20.back().pan, 15 });
+    on20.pop_back();
+    snapshotScan(ch15, on15);
+    snapshotScan(ch20, on20);
+    bool moved = allStable() && reportSelection.goneCount == 0;
+
+    printf("targeted scans: turnover %s, new networks kept %s, moved network not gone %s\n",
+        turnover ? "ok" : "FAIL", kept ? "ok" : "FAIL", moved ? "ok" : "FAIL");
+    return turnover && kept && moved;
+}
+
+int main(int argc, char **argv) {
+    uint16_t count = argc >= 2 ? (uint16_t)atoi(argv[1]) : 20;
+    int cycles = argc >= 3 ? atoi(argv[2]) : 500;
+
+    printf("%u networks, %d scans, an event in ~1 of 8 scans, keyframe every %d reports\n\n",
+        count, cycles, DELTA_KEYFRAME_INTERVAL);
+    printf("%-8s %12s %12s %7s %8s %8s\n", "mode", "full B/scan", "delta B/scan", "ratio", "events", "missed");
+
+    RunResult textFull = run(REPORT_MODE_TEXT, false, count, cycles);
+    RunResult textDelta = run(REPORT_MODE_TEXT, true, count, cycles);
+    printf("%-8s %12.0f %12.0f %6.1fx %8s %8s\n", "text",
+        textFull.bytesPerScan, textDelta.bytesPerScan, textFull.bytesPerScan / textDelta.bytesPerScan, "-", "-");
+
+    RunResult binFull = run(REPORT_MODE_BINARY, false, count, cycles);
+    RunResult binDelta = run(REPORT_MODE_BINARY, true, count, cycles);
+    printf("%-8s %12.0f %12.0f %6.1fx %8u %8u\n", "binary",
+        binFull.bytesPerScan, binDelta.bytesPerScan, binFull.bytesPerScan / binDelta.bytesPerScan,
+        binDelta.events, binDelta.missed);
+
+    int resync = worstResync(count, 100);
+    printf("\nlate-attaching decoder: first keyframe within %d frames (%u of %u delta-mode frames are keyframes)\n",
+        resync, binDelta.keyframes, binDelta.frames);
+
+    bool history = targetedHistory();
+
+    bool ok = binDelta.missed == 0 && binFull.missed == 0 && resync <= DELTA_KEYFRAME_INTERVAL && history;
+    printf("events reported: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/*
+ * Energy detect benchmark: runs the sketch's setup()/loop() for 20 minutes
+ * of virtual time per scenario, with synthetic interferers in the mock band
+ * (WiFi traffic, Bluetooth hopping, constant carriers, a microwave oven).
+ *
+ * Prints each scenario's channel table as the sketch's "energy" command
+ * does, and checks the classification against the interferers placed:
+ * per channel, the type most windows reported must be the expected one.
+ * Also reports CPU time per sample, radio time spent on energy detect, and
+ * checks that beacon scans start at the same times with the sampler on
+ * as with it off. Exits with 1 on a mismatch.
+ *
+ * Usage: bench_energy_detect [-v]
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+static const unsigned long RUN_TIME = 1200000UL;
+
+static const uint8_t NETWORK_CHANNELS[] = { 15, 20, 25 };
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static const MockInterferer WIFI_1 = { MOCK_RF_WIFI, 2412, 20, -55, 40, 600 };
+static const MockInterferer WIFI_6 = { MOCK_RF_WIFI, 2437, 20, -60, 30, 400 };
+static const MockInterferer BLE = { MOCK_RF_BLE, 0, 2, -65, 0, 5 };
+static const MockInterferer CARRIER_26 = { MOCK_RF_CONSTANT, 2480, 2, -70, 100, 0 };
+static const MockInterferer MICROWAVE = { MOCK_RF_CONSTANT, 2455, 30, -50, 100, 0 };
+
+struct Scenario {
+    const char *name;
+    std::vector<MockInterferer> sources;
+    // Expected type and constant flag per channel, 'n'one 'w'ifi 'b'luetooth
+    // 'o'ther (constant)
+    const char *expected;
+};
+
+// Types seen per channel over the windows of a run
+struct Tally {
+    uint32_t type[CHANNEL_COUNT][4];
+    uint32_t windows;
+};
+
+struct RunResult {
+    std::vector<unsigned long> scanStarts;
+    Tally tally;
+    uint32_t sweeps;
+    uint32_t failedSweeps;
+    unsigned long edAirtimeMs;
+    unsigned long scanAirtimeMs;
+    std::string table;
+};
+
+static zigbee_scan_result_t makeNetwork(uint16_t pan, uint8_t channel) {
+    zigbee_scan_result_t n = {};
+    n.short_pan_id = pan;
+    n.logic_channel = channel;
+    n.router_capacity = true;
+    n.end_device_capacity = true;
+    for (int b = 0; b < 8; b++) n.extended_pan_id[b] = (uint8_t)(pan >> (b % 2 * 8)) ^ (uint8_t)(b * 41);
+    return n;
+}
+
+static RunResult run(const Scenario &scenario, bool sampler) {
+    RunResult result = {};
+    mockClearInterferers();
+    for (const MockInterferer &source : scenario.sources) mockAddInterferer(source);
+
+    setup();
+    energySampler.enabled = sampler;
+    memset(currentAnalysis, 0, sizeof(currentAnalysis));
+    memset(channelHistory, 0, sizeof(channelHistory));
+    uint32_t completed = Zigbee.mockCompletedScans();
+    uint32_t windows = energySampler.windows;
+    unsigned long edBefore = mockEnergyDetectAirtimeMs();
+    unsigned long scanBefore = Zigbee.mockScanAirtimeMs();
+    unsigned long start = millis();
+    unsigned long end = start + RUN_TIME;
+
+    while ((long)(millis() - end) < 0) {
+        loop();
+        if (Zigbee.mockCompletedScans() != completed) {
+            completed = Zigbee.mockCompletedScans();
+            result.scanStarts.push_back(scheduler.scanStartTime - start);
+        }
+        if (energySampler.windows != windows) {
+            windows = energySampler.windows;
+            result.tally.windows++;
+            for (int i = 0; i < CHANNEL_COUNT; i++) {
+                // Every sweep measures all channels, so a window closes them all
+                result.tally.type[i][currentAnalysis[i].interferenceType]++;
+            }
+        }
+    }
+
+    result.sweeps = energySampler.sweeps;
+    result.failedSweeps = energySampler.failedSweeps;
+    result.edAirtimeMs = mockEnergyDetectAirtimeMs() - edBefore;
+    result.scanAirtimeMs = Zigbee.mockScanAirtimeMs() - scanBefore;
+    CapturePrint table;
+    printEnergyTable(&energySampler, table);
+    result.table = table.text;
+    return result;
+}
+
+static char typeLetter(uint8_t type) {
+    return "nwbo"[type];
+}
+
+// Most frequent type per channel against the expectation
+static bool checkTally(const Tally &tally, const char *expected, std::string *seen) {
+    bool ok = true;
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        uint8_t best = 0;
+        for (uint8_t t = 1; t < 4; t++) {
+            if (tally.type[i][t] > tally.type[i][best]) best = t;
+        }
+        *seen += typeLetter(best);
+        ok = ok && typeLetter(best) == expected[i];
+    }
+    return ok;
+}
+
+// CPU cost of folding one sweep and closing a window, per channel sample
+static void measureCost() {
+    const int sweeps = 200000;
+    initEnergySampler(&energySampler, true);
+    uint32_t state = 99;
+    for (int i = 0; i < CHANNEL_COUNT; i++) energySampler.measured[i] = true;
+
+    double foldMicros = 0;
+    double analyzeMicros = 0;
+    for (int n = 0; n < sweeps; n += 8) {
+        for (int i = 0; i < CHANNEL_COUNT; i++) {
+            state = state * 1103515245u + 12345u;
+            energySampler.reading[i] = (int8_t)(-96 + (state >> 8) % 40);
+        }
+        double start = cpuMicrosNow();
+        for (int k = 0; k < 8; k++) foldEnergySweep(&energySampler);
+        double mid = cpuMicrosNow();
+        analyzeEnergyWindow(&energySampler, 0);
+        foldMicros += mid - start;
+        analyzeMicros += cpuMicrosNow() - mid;
+    }
+    printf("cpu:    %.1f ns per channel sample folded, %.2f us per window analysed (8 sweeps)\n",
+        foldMicros * 1000.0 / ((double)sweeps * CHANNEL_COUNT), analyzeMicros / (sweeps / 8));
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc >= 2 && strcmp(argv[1], "-v") == 0;
+    bool ok = true;
+
+    ScanCycle world;
+    for (size_t i = 0; i < sizeof(NETWORK_CHANNELS); i++) {
+        world.push_back(makeNetwork((uint16_t)(0x2200 + i * 0x0111), NETWORK_CHANNELS[i]));
+    }
+    Zigbee.mockSetScanResults(world.data(), (uint16_t)world.size());
+
+    // Channels   11..26
+    std::vector<Scenario> scenarios = {
+        { "clean", {}, "nnnnnnnnnnnnnnnn" },
+        { "wifi 6", { WIFI_6 }, "nnnnnwwwwnnnnnnn" },
+        { "bluetooth", { BLE }, "bbbbbbbbbbbbbbbb" },
+        { "carrier 26", { CARRIER_26 }, "nnnnnnnnnnnnnnno" },
+        { "microwave oven", { MICROWAVE }, "nnnnnnnooooooonn" },
+        { "wifi 1 + bt + carrier", { WIFI_1, BLE, CARRIER_26 }, "wwwwbbbbbbbbbbbo" },
+    };
+
+    RunResult reference = run(scenarios[0], false);
+    printf("%d networks, a scenario is %lu minutes of virtual time, sweeps every %lu ms between scans\n\n",
+        (int)world.size(), RUN_TIME / 60000, ENERGY_SWEEP_INTERVAL);
+    printf("%-24s %7s %8s %9s %9s %17s %6s\n",
+        "scenario", "sweeps", "windows", "ED radio%", "scan radio%", "types 11..26", "result");
+
+    for (const Scenario &scenario : scenarios) {
+        RunResult result = run(scenario, true);
+        std::string seen;
+        bool matches = checkTally(result.tally, scenario.expected, &seen);
+        bool sameScans = result.scanStarts == reference.scanStarts;
+        printf("%-24s %7u %8u %9.2f %11.2f %17s %6s\n", scenario.name,
+            (unsigned)result.sweeps, (unsigned)result.tally.windows,
+            100.0 * result.edAirtimeMs / RUN_TIME, 100.0 * result.scanAirtimeMs / RUN_TIME,
+            seen.c_str(), matches && sameScans ? "ok" : "FAIL");
+        if (!matches) printf("%-24s %7s %8s %9s %11s %17s\n", "", "", "", "", "expected", scenario.expected);
+        if (!sameScans) {
+            printf("%-24s beacon scans moved: %lu scans against %lu without the sampler\n", "",
+                (unsigned long)result.scanStarts.size(), (unsigned long)reference.scanStarts.size());
+        }
+        if (verbose || !matches) printf("\n%s\n", result.table.c_str());
+        ok = ok && matches && sameScans && result.failedSweeps == 0;
+    }
+    printf("\nbeacon scans: %lu per scenario, start times identical with the sampler off\n",
+        (unsigned long)reference.scanStarts.size());
+
+    // A request the stack fails is counted and sampling carries on
+    Scenario clean = scenarios[0];
+    mockFailNextEnergyDetect();
+    RunResult failed = run(clean, true);
+    bool recovered = failed.failedSweeps == 1 && failed.sweeps > 0;
+    printf("failed request: counted, sampling continues: %s\n", recovered ? "yes" : "NO");
+    ok = ok && recovered;
+
+    measureCost();
+    printf("\nenergy detect checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/*
+ * Fixed-point kernels benchmark: the Q-format replacements for the float
+ * math in the analysis paths, checked against the float code they replaced
+ * over every input the scanner can produce, and timed against it.
+ *
+ * Display checks: beacon loss in percent for every missed/expected pair up
+ * to MAX_EXPECTED scans (threshold verdicts and the "%.1f" text), the
+ * signal spread for every variance of 8-bit samples, and the 1.5x below
+ * average test for every pair of signal values. Text may only differ where
+ * the exact value is within float rounding of a display tie.
+ *
+ * The host has an FPU, so the float times here are hardware float; the
+ * cycle table at the end is what the "fixed" serial command prints on the
+ * C6 (FIXED_POINT_BENCH 1), where float is soft-float.
+ *
+ * Usage: bench_fixed_point
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const uint32_t MAX_EXPECTED = 2000;
+static const uint32_t MAX_VARIANCE = 128 * 128;   // 8-bit samples: at most 127.5^2
+
+static double cpuNanosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// num / den sits on a display tie (x.x5) or within 1e-4 of the last digit
+// of one, where float rounding decides the printed digit
+static bool nearTie(uint64_t num, uint64_t den) {
+    // num / den * 10 against k + 0.5
+    uint64_t rem = num * 20 % (2 * den);
+    uint64_t distance = rem > den ? rem - den : den - rem;
+    return distance * 10000 <= 2 * den;
+}
+
+static void checkLoss() {
+    char fixedText[16], floatText[16];
+    uint64_t pairs = 0, textDiffs = 0, tieDiffs = 0, verdictDiffs = 0;
+
+    for (uint32_t expected = 1; expected <= MAX_EXPECTED; expected++) {
+        for (uint32_t missed = 0; missed <= expected; missed++) {
+            Q24 loss = qPercent(missed, expected);
+            pairs++;
+            if ((loss.raw > qFromInt<24>(20).raw) != floatLossAbove(missed, expected, 20) ||
+                (loss.raw > qFromInt<24>(10).raw) != floatLossAbove(missed, expected, 10)) {
+                verdictDiffs++;
+            }
+            qFormat(loss, 1, fixedText, sizeof(fixedText));
+            floatFormatLoss(missed, expected, floatText, sizeof(floatText));
+            if (strcmp(fixedText, floatText) != 0) {
+                textDiffs++;
+                if (nearTie((uint64_t)missed * 100, expected)) tieDiffs++;
+                else if (textDiffs - tieDiffs <= 5) printf("  loss %u/%u: fixed %s, float %s\n", missed, expected, fixedText, floatText);
+            }
+        }
+    }
+    printf("Beacon loss: %llu pairs, %llu threshold differences, %llu text differences (%llu at display ties)\n",
+        (unsigned long long)pairs, (unsigned long long)verdictDiffs, (unsigned long long)textDiffs,
+        (unsigned long long)tieDiffs);
+    check(verdictDiffs == 0, "loss thresholds match float");
+    check(textDiffs == tieDiffs, "loss text matches float away from display ties");
+}
+
+static void checkSpread() {
+    char fixedText[16], floatText[16];
+    uint32_t diffs = 0;
+    for (uint32_t v = 0; v <= MAX_VARIANCE; v++) {
+        qFormat(qSqrtInt<24>(v), 1, fixedText, sizeof(fixedText));
+        floatFormatSpread(v, floatText, sizeof(floatText));
+        if (strcmp(fixedText, floatText) != 0) {
+            if (++diffs <= 5) printf("  variance %u: fixed %s, float %s\n", v, fixedText, floatText);
+        }
+    }
+    printf("Signal spread: %u variances, %u text differences\n", MAX_VARIANCE + 1, diffs);
+    check(diffs == 0, "spread text matches float");
+}
+
+static void checkBelowAverage() {
+    uint32_t diffs = 0;
+    for (uint32_t average = 0; average < 256; average++) {
+        for (uint32_t signal = 0; signal < 256; signal++) {
+            bool fixed = qFromInt<16>(average).raw > qMul(qFromInt<16>(signal), qFromRaw<16>(3 << 15)).raw;
+            if (fixed != floatBelowAverage(average, signal)) diffs++;
+        }
+    }
+    printf("Below average: 65536 pairs, %u differences\n", diffs);
+    check(diffs == 0, "below-average test matches float");
+}
+
+// Saturation and formatting corners
+static void checkArithmetic() {
+    char buf[16];
+    check(strcmp(qFormat(qFromRaw<16>(-(3 << 15)), 1, buf, sizeof(buf)), "-1.5") == 0, "negative format");
+    check(strcmp(qFormat(qFromRaw<16>(-1), 1, buf, sizeof(buf)), "0.0") == 0, "no negative zero");
+    check(strcmp(qFormat(qRatio<24>(1, 8), 2, buf, sizeof(buf)), "0.12") == 0, "ties round to even");
+    check(strcmp(qFormat(qRatio<24>(3, 8), 2, buf, sizeof(buf)), "0.38") == 0, "ties round to even, up");
+    check(strcmp(qFormat(qFromRaw<24>(INT32_MAX), 5, buf, sizeof(buf)), "128.00000") == 0, "largest value");
+    check(strcmp(qFormat(qFromInt<16>(42), 0, buf, sizeof(buf)), "42") == 0, "no decimals");
+    check(qAdd(qFromRaw<16>(INT32_MAX), qFromInt<16>(1)).raw == INT32_MAX, "add saturates high");
+    check(qSub(qFromRaw<16>(INT32_MIN), qFromInt<16>(1)).raw == INT32_MIN, "sub saturates low");
+    check(qMul(qFromInt<16>(30000), qFromInt<16>(30000)).raw == INT32_MAX, "mul saturates");
+    check(qMul(qFromInt<16>(-3), qFromRaw<16>(1 << 15)).raw == -(3 << 15), "signed mul");
+    check(qFromInt<24>(200).raw == INT32_MAX, "int conversion saturates");
+    check(qRatio<16>(-1, 3).raw == -21845 && qRatio<16>(1, -3).raw == -21845, "signed ratio rounds");
+    check(qSqrtInt<16>(2).raw == 92681, "sqrt 2");
+    check(qSqrtInt<24>(70000).raw == INT32_MAX, "sqrt saturates");
+    check(qPercent(5, 0).raw == 0, "percent of nothing");
+}
+
+template<typename Kernel>
+static double nanosPerCall(uint32_t calls, Kernel kernel) {
+    volatile uint32_t sink = 0;
+    double start = cpuNanosNow();
+    for (uint32_t i = 0; i < calls; i++) sink = sink + kernel(i);
+    return (cpuNanosNow() - start) / calls;
+}
+
+static void timeKernels() {
+    const uint32_t calls = 2000000;
+    char buf[16];
+
+    struct Row { const char *name; double floatNs, fixedNs; };
+    Row rows[] = {
+        { "loss threshold",
+          nanosPerCall(calls, [](uint32_t i) { return (uint32_t)floatLossAbove(i % 997, 997 + i % 13, 20); }),
+          nanosPerCall(calls, [](uint32_t i) { return (uint32_t)(qPercent(i % 997, 997 + i % 13).raw > qFromInt<24>(20).raw); }) },
+        { "loss percent",
+          nanosPerCall(calls, [&](uint32_t i) { return (uint32_t)floatFormatLoss(i % 997, 997 + i % 13, buf, sizeof(buf))[0]; }),
+          nanosPerCall(calls, [&](uint32_t i) { return (uint32_t)qFormat(qPercent(i % 997, 997 + i % 13), 1, buf, sizeof(buf))[0]; }) },
+        { "signal spread",
+          nanosPerCall(calls, [&](uint32_t i) { return (uint32_t)floatFormatSpread(i % MAX_VARIANCE, buf, sizeof(buf))[0]; }),
+          nanosPerCall(calls, [&](uint32_t i) { return (uint32_t)qFormat(qSqrtInt<24>(i % MAX_VARIANCE), 1, buf, sizeof(buf))[0]; }) },
+        { "below average",
+          nanosPerCall(calls, [](uint32_t i) { return (uint32_t)floatBelowAverage((uint8_t)(i * 13), (uint8_t)i); }),
+          nanosPerCall(calls, [](uint32_t i) {
+              return (uint32_t)(qFromInt<16>((uint8_t)(i * 13)).raw > qMul(qFromInt<16>((uint8_t)i), qFromRaw<16>(3 << 15)).raw); }) },
+    };
+
+    printf("\nKernel           Float ns  Fixed ns  (host, hardware float)\n");
+    for (const Row &row : rows) printf("%-16s %8.1f  %8.1f\n", row.name, row.floatNs, row.fixedNs);
+}
+
+int main() {
+    checkLoss();
+    checkSpread();
+    checkBelowAverage();
+    checkArithmetic();
+    timeKernels();
+
+    printf("\nAs printed by the \"fixed\" command (mock cycle counter):\n");
+    Serial.mockSetEcho(true);
+    printFixedPointBench(Serial);
+    Serial.mockSetEcho(false);
+
+    return checkResult();
+}
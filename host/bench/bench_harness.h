@@ -0,0 +1,64 @@
+#ifndef ZIGBEE_SCANNER_BENCH_HARNESS_H
+#define ZIGBEE_SCANNER_BENCH_HARNESS_H
+
+/*
+ * What the benches share: a check() that counts failed checks, the exit
+ * code they make, and Print targets that capture or count the sketch's
+ * output.
+ *
+ * Include it after sketch.h (or the header that includes the sketch).
+ */
+
+#include <Arduino.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+inline int failures = 0;
+
+inline void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// main()'s exit code: 1 if a check failed
+inline int checkResult() {
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
+// Text output, such as reports and command replies
+class CapturePrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t c) override { text += (char)c; return 1; }
+    size_t write(const uint8_t *data, size_t size) override { text.append((const char *)data, size); return size; }
+    using Print::write;
+};
+
+// Binary output, such as telemetry frames
+class ByteCapturePrint : public Print {
+public:
+    std::vector<uint8_t> bytes;
+    size_t write(uint8_t c) override { bytes.push_back(c); return 1; }
+    size_t write(const uint8_t *data, size_t size) override { bytes.insert(bytes.end(), data, data + size); return size; }
+    using Print::write;
+};
+
+// Only the number of bytes written
+class CountPrint : public Print {
+public:
+    uint64_t bytes = 0;
+    size_t write(uint8_t) override { bytes++; return 1; }
+    size_t write(const uint8_t *, size_t size) override { bytes += size; return size; }
+    using Print::write;
+};
+
+#endif // ZIGBEE_SCANNER_BENCH_HARNESS_H
@@ -0,0 +1,253 @@
+/*
+ * History log benchmark: appends an overnight-style survey (a scan every
+ * 30 s, signal and load drifting) to the on-flash log in a mock partition,
+ * long enough for the ring to come round several times.
+ *
+ * Reports records written per second (encoding and mock flash, host CPU),
+ * flash bytes per record against a plain 9 byte record, erase spread over
+ * the sectors, and reads the saved image back through the memory-mapped
+ * host reader: full decode rate and the blocks a one-hour range query
+ * visits with the sector index against a walk from the oldest sector.
+ *
+ * Checks, exiting with 1 on a mismatch:
+ *  - the image reads back as exactly the newest scans written
+ *  - a reboot continues the log (boot block, time keeps counting)
+ *  - a write torn by a power loss loses only that scan
+ *  - the serial dump command prints the same lines as the host reader
+ *
+ * Usage: bench_history_log [networks] [scans]
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "history/history_log_reader.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+
+#define PARTITION_SIZE (512 * 1024)
+#define PLAIN_RECORD_SIZE 9               // time u32, pan u16, channel, signal, load
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Networks that stay put while their signal and load wander, with the
+// odd scan that misses one
+struct Survey {
+    uint16_t count;
+    uint32_t state;
+    uint16_t panId[SCAN_SNAPSHOT_CAPACITY];
+    uint8_t channel[SCAN_SNAPSHOT_CAPACITY];
+    int signal[SCAN_SNAPSHOT_CAPACITY];
+    int load[SCAN_SNAPSHOT_CAPACITY];
+};
+
+static uint32_t nextRandom(Survey *s) {
+    s->state = s->state * 1103515245u + 12345u;
+    return s->state >> 8;
+}
+
+static void initSurvey(Survey *s, uint16_t count) {
+    s->count = count;
+    s->state = 17;
+    for (uint16_t i = 0; i < count; i++) {
+        s->panId[i] = (uint16_t)nextRandom(s);
+        s->channel[i] = MIN_CHANNEL + nextRandom(s) % 16;
+        s->signal[i] = 40 + nextRandom(s) % 180;
+        s->load[i] = nextRandom(s) % 100;
+    }
+}
+
+static void nextScan(Survey *s, ScanSnapshot *scan, uint32_t time) {
+    memset(scan, 0, sizeof(ScanSnapshot));
+    scan->channelMask = nextRandom(s) % 4 == 0 ? 0x00421800 : ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+    scan->timestamp = time * 1000;
+    for (uint16_t i = 0; i < s->count; i++) {
+        uint32_t r = nextRandom(s);
+        s->signal[i] = constrain(s->signal[i] + (int)(r % 7) - 3 + (r % 50 == 0 ? (int)(r % 61) - 30 : 0), 0, 255);
+        s->load[i] = constrain(s->load[i] + (int)((r >> 8) % 5) - 2, 0, 100);
+        if (!(scan->channelMask & (1UL << s->channel[i])) || (r >> 16) % 40 == 0) continue;
+        uint16_t n = scan->count++;
+        scan->panId[n] = s->panId[i];
+        scan->channel[n] = s->channel[i];
+        scan->signal[n] = (uint8_t)s->signal[i];
+        scan->load[n] = (uint8_t)s->load[i];
+    }
+}
+
+static std::string recordLine(const HistoryLogRecord &r) {
+    char line[48];
+    snprintf(line, sizeof(line), "%lu,0x%04x,%u,%u,%u\n", (unsigned long)r.time, r.panId, r.channel, r.signal, r.load);
+    return line;
+}
+
+// Expected log contents: one line per record in write order (PAN ID order
+// within a scan), and where each scan's lines start
+struct Truth {
+    std::vector<std::string> lines;
+    std::vector<size_t> scanStart;
+};
+
+static void expectScan(Truth *truth, const ScanSnapshot *scan, uint32_t time) {
+    std::vector<HistoryLogRecord> records;
+    for (uint16_t i = 0; i < scan->count; i++) {
+        records.push_back({ time, scan->panId[i], scan->channel[i], scan->signal[i], scan->load[i] });
+    }
+    std::stable_sort(records.begin(), records.end(),
+        [](const HistoryLogRecord &a, const HistoryLogRecord &b) { return a.panId < b.panId; });
+    truth->scanStart.push_back(truth->lines.size());
+    for (const HistoryLogRecord &r : records) truth->lines.push_back(recordLine(r));
+}
+
+static std::vector<std::string> readLines(HistoryLogReader &reader, uint32_t from, uint32_t to) {
+    std::vector<std::string> lines;
+    reader.read(from, to, [&](const HistoryLogBlock &block, const HistoryLogRecord *records) {
+        for (uint16_t i = 0; i < block.count; i++) lines.push_back(recordLine(records[i]));
+    });
+    return lines;
+}
+
+// The log holds whole scans from some point on: its lines must be a suffix
+// of the truth starting at a scan boundary
+static bool isNewestScans(const std::vector<std::string> &lines, const Truth &truth) {
+    if (lines.size() > truth.lines.size()) return false;
+    size_t start = truth.lines.size() - lines.size();
+    if (!std::binary_search(truth.scanStart.begin(), truth.scanStart.end(), start)) return false;
+    return std::equal(lines.begin(), lines.end(), truth.lines.begin() + start);
+}
+
+int main(int argc, char **argv) {
+    uint16_t networks = argc >= 2 ? (uint16_t)atoi(argv[1]) : 20;
+    uint32_t scans = argc >= 3 ? (uint32_t)atoi(argv[2]) : 20000;
+    networks = min(networks, (uint16_t)SCAN_SNAPSHOT_CAPACITY);
+    const uint32_t interval = 30;
+    const char *imagePath = "/tmp/bench_history_log.bin";
+    bool ok = true;
+
+    mockPartitionCreate(HISTORY_LOG_PARTITION, PARTITION_SIZE);
+    historyLogBegin(&historyLog, true, 0);
+
+    Survey survey;
+    initSurvey(&survey, networks);
+    static ScanSnapshot scan;
+    Truth truth;
+    uint32_t time = 0;
+
+    // Appending
+    double start = cpuMicrosNow();
+    for (uint32_t n = 0; n < scans; n++) {
+        time += interval;
+        nextScan(&survey, &scan, time);
+        historyLogAppendScan(&historyLog, &scan, time);
+        expectScan(&truth, &scan, time);
+    }
+    double appendMicros = cpuMicrosNow() - start;
+    uint64_t records = historyLog.recordsWritten;
+    double bytesPerRecord = (double)historyLog.bytesWritten / records;
+
+    printf("%u networks, a scan every %u s, %u scans (%.1f days), %u KB partition\n\n",
+        networks, interval, scans, scans * interval / 86400.0, PARTITION_SIZE / 1024);
+    printf("write:  %.0f records/s, %.2f bytes/record (plain %d: %.1fx), %.0f bytes/scan\n",
+        records / (appendMicros / 1e6), bytesPerRecord, PLAIN_RECORD_SIZE, PLAIN_RECORD_SIZE / bytesPerRecord,
+        (double)historyLog.bytesWritten / scans);
+    printf("flash:  %lu erases, per sector %u..%u, ring holds %.1f h\n",
+        (unsigned long)mockPartitionErases(), mockPartitionMinSectorErases(), mockPartitionMaxSectorErases(),
+        (time - historyLog.index[historyLog.oldest].baseTime) / 3600.0);
+
+    // Reading the saved image back through mmap
+    mockPartitionSave(imagePath);
+    HistoryLogReader reader;
+    if (!reader.open(imagePath)) {
+        printf("cannot map %s\n", imagePath);
+        return 1;
+    }
+    uint64_t decoded = 0;
+    start = cpuMicrosNow();
+    reader.read(0, UINT32_MAX, [&](const HistoryLogBlock &block, const HistoryLogRecord *) { decoded += block.count; });
+    double readMicros = cpuMicrosNow() - start;
+    std::vector<std::string> lines = readLines(reader, 0, UINT32_MAX);
+    bool readBack = isNewestScans(lines, truth) && !lines.empty();
+    printf("read:   %lu records in %lu sectors, %.0f records/s decoded, newest scans match: %s\n",
+        (unsigned long)lines.size(), (unsigned long)reader.sectors(), decoded / (readMicros / 1e6),
+        readBack ? "yes" : "NO");
+    ok = ok && readBack;
+
+    uint32_t from = reader.oldestTime() + (time - reader.oldestTime()) / 2;
+    uint32_t to = from + 3600;
+    uint64_t indexed = reader.read(from, to, [](const HistoryLogBlock &, const HistoryLogRecord *) {});
+    uint64_t linear = reader.read(reader.oldestTime(), to, [](const HistoryLogBlock &, const HistoryLogRecord *) {});
+    printf("range:  one hour from %lu s visits %lu blocks with the index, %lu walking from the oldest\n",
+        (unsigned long)from, (unsigned long)indexed, (unsigned long)linear);
+
+    // Reboot: the log continues after the newest block
+    uint32_t before = time;
+    historyLogBegin(&historyLog, true, 0);
+    bool rebooted = historyLogTime(&historyLog, 0) > before;
+    for (int n = 0; n < 10; n++) {
+        time = historyLogTime(&historyLog, (n + 1) * interval * 1000UL);
+        nextScan(&survey, &scan, time);
+        historyLogAppendScan(&historyLog, &scan, time);
+        expectScan(&truth, &scan, time);
+    }
+    reader.open(mockPartitionData(), PARTITION_SIZE);
+    int boots = 0;
+    reader.read(before, UINT32_MAX, [&](const HistoryLogBlock &block, const HistoryLogRecord *) {
+        if (block.type == HISTORY_LOG_BLOCK_BOOT) boots++;
+    });
+    rebooted = rebooted && boots == 1 && isNewestScans(readLines(reader, 0, UINT32_MAX), truth);
+    printf("reboot: log continues at %lu s with a boot marker: %s\n",
+        (unsigned long)historyLogTime(&historyLog, 0), rebooted ? "yes" : "NO");
+    ok = ok && rebooted;
+
+    // Power loss in the middle of a block write, then a reboot
+    uint32_t beforeTear = time;
+    time += interval;
+    nextScan(&survey, &scan, time);
+    mockPartitionTearNextWrite(7);
+    historyLogAppendScan(&historyLog, &scan, time);
+    Truth torn = truth;
+    historyLogBegin(&historyLog, true, 0);
+    for (int n = 0; n < 10; n++) {
+        time = historyLogTime(&historyLog, (n + 1) * interval * 1000UL);
+        nextScan(&survey, &scan, time);
+        historyLogAppendScan(&historyLog, &scan, time);
+        expectScan(&torn, &scan, time);
+    }
+    reader.open(mockPartitionData(), PARTITION_SIZE);
+    bool recovered = isNewestScans(readLines(reader, 0, UINT32_MAX), torn) &&
+        historyLogTime(&historyLog, 0) > beforeTear;
+    printf("tear:   torn scan dropped, earlier and later scans intact: %s\n", recovered ? "yes" : "NO");
+    ok = ok && recovered;
+
+    // The serial command prints what the host reader reads
+    CapturePrint capture;
+    Report.setOutput(capture);
+    Serial.mockInput("dump 0 4294967295\n");
+    do {
+        pollSerialCommands();
+    } while (commandsBusy());
+    Report.setOutput(Serial);
+
+    std::string expected;
+    for (const std::string &line : readLines(reader, 0, UINT32_MAX)) expected += line;
+    std::string dumped;
+    size_t pos = 0;
+    while (pos < capture.text.size()) {
+        size_t end = capture.text.find('\n', pos) + 1;
+        std::string line = capture.text.substr(pos, end - pos);
+        if (line[0] != '#' && line.compare(0, 4, "time") != 0) dumped += line;
+        pos = end;
+    }
+    bool dumpMatches = dumped == expected;
+    printf("dump:   serial dump of %lu bytes matches the host reader: %s\n",
+        (unsigned long)capture.text.size(), dumpMatches ? "yes" : "NO");
+    ok = ok && dumpMatches;
+
+    remove(imagePath);
+    printf("\nhistory log checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
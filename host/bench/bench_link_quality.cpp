@@ -0,0 +1,207 @@
+/*
+ * Link quality benchmark: injects beacon loss in the Zigbee mock and checks
+ * the per-network counters against what the mock actually dropped:
+ *  - random loss: beacons expected / missed and the longest missed run
+ *    match the mock exactly
+ *  - an outage of several scans shows up as the missed run
+ *  - targeted scans only count for the channels they covered
+ *  - failed scans count for nothing
+ *  - a network that changes channel keeps its counters
+ *  - uptime follows the first and last sighting
+ *
+ * Also reports the CPU time of a network update. Exits with 1 on a mismatch.
+ *
+ * Usage: bench_link_quality
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void runScan(const ScanCycle &cycle, uint32_t mask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK) {
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks(mask, 5);
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(mask, 5));
+    int16_t status = Zigbee.scanComplete();
+    if (status >= 0) printScannedNetworks(status, mask);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+static const NetworkStats *statsFor(uint16_t panId) {
+    for (uint16_t i = 0; i < networkTable.count; i++) {
+        if (networkTable.entries[i].panId == panId) return &networkTable.stats[i];
+    }
+    return NULL;
+}
+
+static void reset() {
+    initializeStats();
+    Report.setMuted(true);
+    Zigbee.mockClearBeaconLoss();
+}
+
+static bool check(const char *name, bool ok, const char *detail) {
+    printf("%-44s %-34s %s\n", name, detail, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static bool randomLoss() {
+    reset();
+    ScanCycle cycle;
+    generateScanCycle(cycle, 20, 99);
+    const uint8_t loss[] = { 0, 2, 5, 10, 20, 30, 50 };
+    for (size_t i = 0; i < cycle.size(); i++) {
+        Zigbee.mockSetBeaconLoss(cycle[i].short_pan_id, loss[i % sizeof(loss)]);
+    }
+    for (int i = 0; i < 500; i++) runScan(cycle);
+    // A last scan without loss closes every missed run
+    for (size_t i = 0; i < cycle.size(); i++) Zigbee.mockSetBeaconLoss(cycle[i].short_pan_id, 0);
+    runScan(cycle);
+
+    bool ok = true;
+    double worstError = 0;
+    for (size_t i = 0; i < cycle.size(); i++) {
+        MockBeaconCounts truth = Zigbee.mockBeaconCounts(cycle[i].short_pan_id);
+        const NetworkStats *stats = statsFor(cycle[i].short_pan_id);
+        if (!stats || stats->beaconsMissed != truth.dropped ||
+            stats->beaconsExpected != truth.answered + truth.dropped ||
+            stats->longestMissStreak != truth.longestDropRun) {
+            ok = false;
+            continue;
+        }
+        double estimated = 100.0 * stats->beaconsMissed / stats->beaconsExpected;
+        worstError = fmax(worstError, fabs(estimated - loss[i % sizeof(loss)]));
+    }
+    char detail[48];
+    snprintf(detail, sizeof(detail), "worst vs set rate %.1f points", worstError);
+    return check("random loss 0-50%, 500 scans: exact counts", ok, detail);
+}
+
+static bool outage() {
+    reset();
+    ScanCycle cycle;
+    generateScanCycle(cycle, 8, 7);
+    uint16_t pan = cycle[3].short_pan_id;
+    for (int i = 0; i < 10; i++) runScan(cycle);
+    Zigbee.mockMissScans(pan, 7);
+    for (int i = 0; i < 8; i++) runScan(cycle);
+    const NetworkStats *stats = statsFor(pan);
+    bool ok = stats && stats->missStreak == 7 && stats->longestMissStreak == 7 &&
+        stats->beaconsMissed == 7 && stats->beaconsExpected == 18;
+    char detail[48];
+    snprintf(detail, sizeof(detail), "run %u, %lu of %lu missed", stats ? stats->missStreak : 0,
+        stats ? (unsigned long)stats->beaconsMissed : 0, stats ? (unsigned long)stats->beaconsExpected : 0);
+    return check("outage of 7 scans", ok, detail);
+}
+
+static bool targetedScans() {
+    reset();
+    ScanCycle cycle;
+    generateScanCycle(cycle, 16, 3);
+    const uint32_t masks[] = {
+        ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 1UL << 15, (1UL << 20) | (1UL << 25), 1UL << 11,
+        0x0000F800UL, 0x07FF0000UL,
+    };
+    uint32_t covered[32] = {};
+    for (int i = 0; i < 120; i++) {
+        uint32_t mask = masks[i % 6];
+        for (int ch = MIN_CHANNEL; ch <= MAX_CHANNEL; ch++) {
+            if (mask & (1UL << ch)) covered[ch]++;
+        }
+        runScan(cycle, mask);
+    }
+    bool ok = true;
+    for (const zigbee_scan_result_t &network : cycle) {
+        const NetworkStats *stats = statsFor(network.short_pan_id);
+        // The first full scan saw everything, so every scan of the channel counts
+        if (!stats || stats->beaconsMissed != 0 || stats->beaconsExpected != covered[network.logic_channel]) ok = false;
+    }
+    return check("targeted scans count per channel", ok, "no false misses");
+}
+
+static bool failedScans() {
+    reset();
+    ScanCycle cycle;
+    generateScanCycle(cycle, 10, 11);
+    int completed = 0;
+    for (int i = 0; i < 60; i++) {
+        if (i % 4 == 2) Zigbee.mockFailNextScan();
+        else completed++;
+        runScan(cycle);
+    }
+    const NetworkStats *stats = statsFor(cycle[0].short_pan_id);
+    bool ok = stats && stats->beaconsMissed == 0 && stats->beaconsExpected == (uint32_t)completed;
+    char detail[48];
+    snprintf(detail, sizeof(detail), "%lu expected of %d completed", stats ? (unsigned long)stats->beaconsExpected : 0,
+        completed);
+    return check("failed scans do not count", ok, detail);
+}
+
+static bool channelChange() {
+    reset();
+    ScanCycle cycle;
+    generateScanCycle(cycle, 4, 21);
+    for (int i = 0; i < 5; i++) runScan(cycle);
+    uint16_t pan = cycle[0].short_pan_id;
+    Zigbee.mockMissScans(pan, 2);
+    for (int i = 0; i < 2; i++) runScan(cycle);
+    cycle[0].logic_channel = cycle[0].logic_channel == 20 ? 21 : 20;
+    for (int i = 0; i < 5; i++) runScan(cycle);
+    const NetworkStats *stats = statsFor(pan);
+    bool ok = stats && stats->channel == cycle[0].logic_channel && stats->beaconsExpected == 10 &&
+        stats->beaconsMissed == 0;
+    return check("channel change keeps counting", ok, "moved, no misses charged");
+}
+
+static bool uptime() {
+    reset();
+    ScanCycle cycle;
+    generateScanCycle(cycle, 4, 5);
+    runScan(cycle);
+    uint32_t first = currentScan.timestamp;
+    for (int i = 0; i < 40; i++) runScan(cycle);
+    uint32_t last = currentScan.timestamp;
+    const NetworkStats *stats = statsFor(cycle[1].short_pan_id);
+    bool ok = stats && stats->firstSeen == first && stats->lastSeen == last && networkUptime(stats) == (last - first) / 1000;
+    char detail[48];
+    snprintf(detail, sizeof(detail), "%lu s over 41 scans", stats ? (unsigned long)networkUptime(stats) : 0);
+    return check("uptime from first and last sighting", ok, detail);
+}
+
+static void updateCost() {
+    reset();
+    ScanCycle cycle;
+    generateScanCycle(cycle, SCAN_SNAPSHOT_CAPACITY, 1);
+    runScan(cycle);
+    const int passes = 20000;
+    double start = cpuMicrosNow();
+    for (int i = 0; i < passes; i++) {
+        updateChannelStats(&currentScan);
+        for (uint16_t n = 0; n < currentScan.count; n++) updateNetworkStats(scanStats[n], &currentScan, n);
+    }
+    double micros = cpuMicrosNow() - start;
+    printf("\ncpu: %.1f ns per network update (signal window and link counters)\n",
+        micros * 1000 / passes / currentScan.count);
+}
+
+int main() {
+    bool ok = true;
+    ok &= randomLoss();
+    ok &= outage();
+    ok &= targetedScans();
+    ok &= failedScans();
+    ok &= channelChange();
+    ok &= uptime();
+    updateCost();
+
+    printf("\nlink quality checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+/*
+ * Network stats layout benchmark: the per-network state as it is now (keys,
+ * a packed hot NetworkStats array and a cold NetworkSeries array) against
+ * the previous layout, one record per network with the signal window and
+ * change detectors inline, kept here for comparison.
+ *
+ * Reports bytes per network and per table size, the CPU time of the
+ * per-scan update (signal window, link counters, change detectors) and of
+ * the delta report check, which reads only hot fields, for 128 to 2048
+ * tracked networks. Both layouts run the same scans through the same
+ * arithmetic, and their results are compared.
+ *
+ * Usage: bench_network_stats [scans]
+ *
+ * Exits with 1 if the two layouts disagree.
+ */
+
+#include "sketch.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// The previous layout. The change detector keeps its warm-up sums and run
+// totals apart, as it did, so it takes the 8 bytes the union saves now.
+struct LegacyChangeDetector {
+    ChangeDetector d;
+    uint8_t separateTotals[8];
+};
+
+struct LegacyNetworkStats {
+    uint32_t beaconsExpected;
+    uint32_t beaconsMissed;
+    uint32_t channelScansSeen;
+    uint16_t missStreak;
+    uint16_t longestMissStreak;
+    uint32_t firstSeen;
+    uint32_t lastSeen;
+    uint32_t uptime;
+    uint8_t channel;
+    uint8_t lastSignalStrength;
+    uint8_t minSignalStrength;
+    uint8_t maxSignalStrength;
+    uint8_t avgSignalStrength;
+    uint8_t signalTrend;
+    uint8_t maxNetworkLoad;
+    bool isCoordinator;
+    SignalStats<SIGNAL_HISTORY_SIZE> signal;
+    LegacyChangeDetector signalChange;
+    LegacyChangeDetector loadChange;
+    ChangePoint signalShift;
+    uint8_t scansSinceShift;
+    ScanIndex historyIndex;
+    bool reported;
+    uint8_t reportedSignal;
+    uint8_t reportedLoad;
+    uint8_t reportedFlags;
+};
+
+struct LegacyNetworkEntry {
+    uint16_t panId;
+    uint64_t extendedPanId;
+    uint32_t lastSeen;
+    NetworkIndex lruPrev;
+    NetworkIndex lruNext;
+    LegacyNetworkStats stats;
+};
+
+static LegacyNetworkEntry legacy[NETWORK_TABLE_CAPACITY];
+static ChangeLog legacyLog;
+
+// updateNetworkStats() and its link counters as they were
+static void legacyUpdate(LegacyNetworkStats *stats, const ScanSnapshot *scan, uint16_t idx) {
+    uint8_t signalStrength = scan->signal[idx];
+    signalStatsAdd(&stats->signal, signalStrength);
+    stats->minSignalStrength = signalStatsMin(&stats->signal);
+    stats->maxSignalStrength = signalStatsMax(&stats->signal);
+    stats->avgSignalStrength = signalStatsMean(&stats->signal);
+    int trend = signalStatsEwma(&stats->signal) - stats->avgSignalStrength;
+    stats->signalTrend = trend > SIGNAL_TREND_THRESHOLD ? 1 : (trend < -SIGNAL_TREND_THRESHOLD ? 2 : 0);
+    stats->lastSignalStrength = signalStrength;
+    stats->maxNetworkLoad = max(scan->load[idx], stats->maxNetworkLoad);
+    stats->isCoordinator = (scan->flags[idx] & NETWORK_FLAG_COORDINATOR) != 0;
+
+    uint8_t channel = scan->channel[idx];
+    if (stats->beaconsExpected == 0) stats->firstSeen = scan->timestamp;
+    stats->lastSeen = scan->timestamp;
+    stats->uptime = (stats->lastSeen - stats->firstSeen) / 1000;
+    uint32_t scans = channelScans[channel - MIN_CHANNEL];
+    if (stats->beaconsExpected == 0 || stats->channel != channel) {
+        stats->channel = channel;
+        stats->missStreak = 0;
+    } else if (scans == stats->channelScansSeen) {
+        return;
+    } else {
+        uint32_t missed = scans - stats->channelScansSeen - 1;
+        stats->beaconsExpected += missed;
+        stats->beaconsMissed += missed;
+        stats->missStreak = (uint16_t)min(missed, (uint32_t)0xFFFF);
+        stats->longestMissStreak = max(stats->longestMissStreak, stats->missStreak);
+    }
+    stats->beaconsExpected++;
+    stats->channelScansSeen = scans;
+}
+
+static void legacyDetect(LegacyNetworkStats *stats, const ScanSnapshot *scan, uint16_t i) {
+    ChangePoint signal = changeDetectorAddSignal(&stats->signalChange.d, scan->signal[i]);
+    ChangePoint load = changeDetectorAdd(&stats->loadChange.d, scan->load[i], CHANGE_MIN_SPREAD_LOAD);
+    if (signal.severity) {
+        recordChange(&legacyLog, &signal, scan->timestamp, scan->panId[i], scan->channel[i], CHANGE_SERIES_SIGNAL);
+        stats->signalShift = signal;
+        stats->scansSinceShift = 0;
+    } else if (stats->scansSinceShift < 255) {
+        stats->scansSinceShift++;
+    }
+    if (load.severity) {
+        recordChange(&legacyLog, &load, scan->timestamp, scan->panId[i], scan->channel[i], CHANGE_SERIES_LOAD);
+    }
+}
+
+static uint16_t legacySelect(const ScanSnapshot *scan, LegacyNetworkStats **stats) {
+    uint16_t count = 0;
+    for (int i = 0; i < scan->count; i++) {
+        const LegacyNetworkStats *s = stats[i];
+        if (!s->reported || abs(scan->signal[i] - s->reportedSignal) > DELTA_SIGNAL_HYSTERESIS ||
+            abs(scan->load[i] - s->reportedLoad) > DELTA_LOAD_HYSTERESIS || scan->flags[i] != s->reportedFlags) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static uint32_t nextRandom(uint32_t *state) {
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+// Networks in the order the table first saw them: a signal level that
+// steps down now and then, and a load that drifts
+struct SimNetwork {
+    uint16_t panId;
+    uint64_t extendedPanId;
+    uint8_t channel;
+    int level;
+    int load;
+    NetworkIndex entry;
+};
+
+struct LayoutCost {
+    double updateNanos;           // per network and scan
+    double selectNanos;
+    size_t changes;
+};
+
+static bool sameResults(const std::vector<SimNetwork> &networks) {
+    for (const SimNetwork &n : networks) {
+        const NetworkStats *a = &networkTable.stats[n.entry];
+        const NetworkSeries *series = &networkTable.series[n.entry];
+        const LegacyNetworkStats *b = &legacy[n.entry].stats;
+        if (a->beaconsExpected != b->beaconsExpected || a->beaconsMissed != b->beaconsMissed ||
+            a->longestMissStreak != b->longestMissStreak || networkUptime(a) != b->uptime ||
+            a->minSignalStrength != b->minSignalStrength || a->maxSignalStrength != b->maxSignalStrength ||
+            a->avgSignalStrength != b->avgSignalStrength || a->signalTrend != b->signalTrend ||
+            a->maxNetworkLoad != b->maxNetworkLoad || a->isCoordinator != b->isCoordinator ||
+            a->reported != b->reported || a->reportedSignal != b->reportedSignal ||
+            series->signalShift.severity != b->signalShift.severity ||
+            series->signalShift.after != b->signalShift.after ||
+            series->scansSinceShift != b->scansSinceShift) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool run(uint16_t tracked, int scans, LayoutCost *current, LayoutCost *previous) {
+    initializeStats();
+    memset(legacy, 0, sizeof(legacy));
+    initChangeLog(&legacyLog, true);
+    deltaReports = true;
+
+    uint32_t seed = 2024 + tracked;
+    std::vector<SimNetwork> networks(tracked);
+    for (uint16_t i = 0; i < tracked; i++) {
+        SimNetwork &n = networks[i];
+        n.panId = (uint16_t)(0x1000 + i * 7);
+        n.extendedPanId = 0xA0B0C0D000000000ULL | nextRandom(&seed);
+        n.channel = MIN_CHANNEL + nextRandom(&seed) % CHANNEL_COUNT;
+        n.level = 60 + nextRandom(&seed) % 150;
+        n.load = nextRandom(&seed) % 60;
+        n.entry = (NetworkIndex)(trackNetwork(&networkTable, n.panId, n.extendedPanId) - networkTable.stats);
+    }
+
+    static ScanSnapshot scan;
+    static LegacyNetworkStats *legacyStats[SCAN_SNAPSHOT_CAPACITY];
+    static ReportSelection selection;
+    memset(&scan, 0, sizeof(scan));
+    memset(&selection, 0, sizeof(selection));
+    double update[2] = {}, select[2] = {};
+    uint64_t updates = 0;
+
+    for (int s = 0; s < scans; s++) {
+        // A scan lists the networks in its own order and misses a few
+        scan.count = 0;
+        scan.sequence++;
+        scan.timestamp = 1000 + s * SCAN_INTERVAL_NORMAL;
+        scan.channelMask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+        uint16_t start = nextRandom(&seed) % tracked;
+        for (uint16_t k = 0; k < tracked; k++) {
+            SimNetwork &n = networks[(start + k * 13) % tracked];
+            uint32_t r = nextRandom(&seed);
+            if (r % 1000 == 0) n.level = constrain(n.level - 40, 0, 255);
+            int signal = constrain(n.level + (int)(r / 7 % 9) - 4, 0, 255);
+            n.load = constrain(n.load + (int)(r / 5 % 3) - 1, 0, 100);
+            if (r / 15 % 20 == 0) continue;
+            uint16_t i = scan.count++;
+            scan.panId[i] = n.panId;
+            scan.extendedPanId[i] = n.extendedPanId;
+            scan.channel[i] = n.channel;
+            scan.signal[i] = (uint8_t)signal;
+            scan.load[i] = (uint8_t)n.load;
+            scan.flags[i] = n.panId & 1 ? NETWORK_FLAG_COORDINATOR : NETWORK_FLAG_ROUTER_CAP;
+            scanStats[i] = &networkTable.stats[n.entry];
+            legacyStats[i] = &legacy[n.entry].stats;
+        }
+        updateChannelStats(&scan);
+        updates += scan.count;
+
+        // Alternate which layout goes first, so neither always finds the
+        // scan in the cache
+        bool currentFirst = s % 2 == 0;
+        for (int pass = 0; pass < 2; pass++) {
+            double t0 = cpuMicrosNow();
+            if ((pass == 0) == currentFirst) {
+                for (uint16_t i = 0; i < scan.count; i++) updateNetworkStats(scanStats[i], &scan, i);
+                detectNetworkChanges(&changeLog, &scan);
+                update[0] += cpuMicrosNow() - t0;
+            } else {
+                for (uint16_t i = 0; i < scan.count; i++) legacyUpdate(legacyStats[i], &scan, i);
+                for (uint16_t i = 0; i < scan.count; i++) legacyDetect(legacyStats[i], &scan, i);
+                update[1] += cpuMicrosNow() - t0;
+            }
+        }
+
+        // Delta selection reads only the report baseline; every 20th scan
+        // is a keyframe that makes everything the new baseline
+        selection.reportsSinceKeyframe = s % 20;
+        uint16_t legacyCount = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            double t0 = cpuMicrosNow();
+            if ((pass == 0) == currentFirst) {
+                selectReportedNetworks(&scan, &selection);
+                select[0] += cpuMicrosNow() - t0;
+            } else {
+                legacyCount = legacySelect(&scan, legacyStats);
+                select[1] += cpuMicrosNow() - t0;
+            }
+        }
+        if (!selection.keyframe && legacyCount != selection.count) return false;
+
+        markNetworksReported(&scan, &selection);
+        for (uint16_t n = 0; n < selection.count; n++) {
+            uint16_t i = selection.index[n];
+            LegacyNetworkStats *stats = legacyStats[i];
+            stats->reported = true;
+            stats->reportedSignal = scan.signal[i];
+            stats->reportedLoad = scan.load[i];
+            stats->reportedFlags = scan.flags[i];
+        }
+    }
+
+    current->updateNanos = update[0] * 1000 / updates;
+    previous->updateNanos = update[1] * 1000 / updates;
+    current->selectNanos = select[0] * 1000 / updates;
+    previous->selectNanos = select[1] * 1000 / updates;
+    current->changes = changeLog.total;
+    previous->changes = legacyLog.total;
+    return changeLog.total == legacyLog.total && sameResults(networks);
+}
+
+int main(int argc, char **argv) {
+    int scans = argc >= 2 ? atoi(argv[1]) : 200;
+    const size_t perNetwork = sizeof(NetworkEntry) + sizeof(NetworkStats) + sizeof(NetworkSeries);
+    const size_t legacyPerNetwork = sizeof(LegacyNetworkEntry);
+
+    printf("%u signal samples per network, %d scans per run\n\n", (unsigned)SIGNAL_HISTORY_SIZE, scans);
+    printf("%-10s %8s %8s %8s %8s\n", "layout", "entry", "hot", "cold", "total");
+    printf("%-10s %8s %8zu %8zu %8zu\n", "previous", "-", legacyPerNetwork, (size_t)0, legacyPerNetwork);
+    printf("%-10s %8zu %8zu %8zu %8zu\n\n", "current", sizeof(NetworkEntry), sizeof(NetworkStats),
+        sizeof(NetworkSeries), perNetwork);
+
+    // Per-network state against the ESP32-C6's 512 KB of SRAM
+    printf("%-9s %14s %14s\n", "networks", "previous KB", "current KB");
+    for (uint32_t n = 128; n <= 2048; n *= 2) {
+        printf("%-9u %8.1f (%2.0f%%) %8.1f (%2.0f%%)\n", (unsigned)n, n * legacyPerNetwork / 1024.0,
+            100.0 * n * legacyPerNetwork / (512 * 1024), n * perNetwork / 1024.0, 100.0 * n * perNetwork / (512 * 1024));
+    }
+
+    printf("\n%-9s %-10s %18s %18s %8s\n", "networks", "layout", "update ns/network", "select ns/network", "changes");
+    bool ok = true;
+    for (uint32_t n = 128; n <= NETWORK_TABLE_CAPACITY; n *= 2) {
+        LayoutCost current = {}, previous = {};
+        bool same = run((uint16_t)n, scans, &current, &previous);
+        printf("%-9u %-10s %18.1f %18.1f %8zu\n", (unsigned)n, "previous", previous.updateNanos,
+            previous.selectNanos, previous.changes);
+        printf("%-9s %-10s %18.1f %18.1f %8zu%s\n", "", "current", current.updateNanos, current.selectNanos,
+            current.changes, same ? "" : "  MISMATCH");
+        ok &= same;
+    }
+    return ok ? 0 : 1;
+}
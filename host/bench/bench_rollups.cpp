@@ -0,0 +1,284 @@
+/*
+ * Rollup benchmark: feeds 8 days of synthetic scans of one channel (a
+ * daily signal and load cycle, outages, a gap without scans) into a rollup
+ * store and into a raw sample log, and at every hour checks summaries over
+ * 10 minutes to 7 days against the raw samples of the same buckets:
+ * scans, sightings, min and max exact, means within 1 (closed buckets keep
+ * rounded means).
+ *
+ * Then reports the store's RAM against the raw log, the time per sample
+ * and per 24 h summary after one hour and after 8 days, and checks that a
+ * summary reads no more buckets than its span takes, however long the
+ * history. Last, runs 26 hours of scans through the
+ * sketch: channel and network stores, the diagnostics line, the "trends"
+ * command.
+ *
+ * Usage: bench_rollups
+ *
+ * Exits with 1 if a check fails.
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+static double cpuNanosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint32_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (uint32_t)(rngState >> 32);
+}
+
+struct RawSample {
+    uint32_t time;
+    bool seen;
+    uint8_t signal;
+    uint8_t load;
+};
+
+static const uint32_t HOUR = 3600000UL;
+static const uint32_t DAY = 24 * HOUR;
+
+// Scans every 20 s with jitter; signal and load follow the time of day,
+// the network is missed now and then and is off for an hour on day 3,
+// and the scanner stops for 5 hours on day 5
+static std::vector<RawSample> makeTrace(uint32_t start, uint32_t length) {
+    std::vector<RawSample> trace;
+    for (uint32_t t = start; t < start + length; t += 17000 + nextRandom() % 6000) {
+        uint32_t day = (t - start) / DAY;
+        uint32_t hourOfDay = (t - start) % DAY / HOUR;
+        if (day == 5 && hourOfDay >= 10 && hourOfDay < 15) continue;
+        RawSample s;
+        s.time = t;
+        s.seen = nextRandom() % 100 >= 8 && !(day == 3 && hourOfDay == 7);
+        int busy = hourOfDay >= 8 && hourOfDay < 18;
+        s.signal = (uint8_t)(90 - busy * 18 + (int)(nextRandom() % 25) - 12);
+        s.load = (uint8_t)(10 + busy * 35 + nextRandom() % 20);
+        trace.push_back(s);
+    }
+    return trace;
+}
+
+// The raw samples of the buckets a summary covers
+static RollupSummary rawSummary(const std::vector<RawSample> &trace, size_t end, uint32_t now, uint32_t spanMs) {
+    const RollupTier *tier = &rollupTiers[rollupTierFor(spanMs)];
+    uint32_t buckets = (spanMs + tier->lengthMs - 1) / tier->lengthMs;
+    if (buckets > tier->count) buckets = tier->count;
+    uint32_t current = now / tier->lengthMs;
+    uint32_t from = current + 1 >= buckets ? (current + 1 - buckets) * tier->lengthMs : 0;
+
+    RollupSummary s = {};
+    s.signalMin = UINT8_MAX;
+    s.signalMax = 0;
+    s.loadMin = UINT8_MAX;
+    for (size_t i = 0; i < end; i++) {
+        const RawSample &r = trace[i];
+        if (r.time < from) continue;
+        s.scans++;
+        if (!r.seen) continue;
+        s.seen++;
+        s.signalSum += r.signal;
+        s.loadSum += r.load;
+        s.signalMin = min(s.signalMin, r.signal);
+        s.signalMax = max(s.signalMax, r.signal);
+        s.loadMin = min(s.loadMin, r.load);
+        s.loadMax = max(s.loadMax, r.load);
+    }
+    return s;
+}
+
+static void checkAgainstRaw() {
+    static const uint32_t spans[] = { 600000UL, HOUR, 3 * HOUR, DAY, 7 * DAY };
+    const uint32_t start = 5 * 60000UL + 1234;
+    std::vector<RawSample> trace = makeTrace(start, 8 * DAY);
+
+    static RollupStore store;
+    memset(&store, 0, sizeof(store));
+    uint32_t checks = 0, countDiffs = 0, rangeDiffs = 0, meanDiffs = 0;
+    int worstSignal = 0, worstLoad = 0;
+    uint32_t nextCheck = start + HOUR / 3;
+    for (size_t i = 0; i < trace.size(); i++) {
+        const RawSample &r = trace[i];
+        rollupAdd(&store, r.time, r.seen, r.signal, r.load);
+        if (r.time < nextCheck) continue;
+        nextCheck += HOUR;
+        for (uint32_t span : spans) {
+            RollupSummary got = rollupSummary(&store, r.time, span);
+            RollupSummary want = rawSummary(trace, i + 1, r.time, span);
+            checks++;
+            if (got.scans != want.scans || got.seen != want.seen) {
+                if (++countDiffs <= 5) {
+                    printf("  at %lu s, span %lu s: %lu/%lu scans/seen, raw %lu/%lu\n", (unsigned long)(r.time / 1000),
+                        (unsigned long)(span / 1000), (unsigned long)got.scans, (unsigned long)got.seen,
+                        (unsigned long)want.scans, (unsigned long)want.seen);
+                }
+                continue;
+            }
+            if (want.seen == 0) continue;
+            if (got.signalMin != want.signalMin || got.signalMax != want.signalMax ||
+                got.loadMin != want.loadMin || got.loadMax != want.loadMax) {
+                rangeDiffs++;
+            }
+            int signal = abs(rollupSignalMean(&got) - rollupSignalMean(&want));
+            int load = abs(rollupLoadMean(&got) - rollupLoadMean(&want));
+            worstSignal = max(worstSignal, signal);
+            worstLoad = max(worstLoad, load);
+            if (signal > 1 || load > 1) meanDiffs++;
+        }
+    }
+    printf("Summaries against raw samples: %lu samples over 8 days, %lu summaries (10 min to 7 days)\n",
+        (unsigned long)trace.size(), (unsigned long)checks);
+    printf("  %lu count differences, %lu min/max differences, %lu means off by more than 1"
+        " (worst signal %d, %d%% load)\n", (unsigned long)countDiffs, (unsigned long)rangeDiffs,
+        (unsigned long)meanDiffs, worstSignal, worstLoad);
+    check(countDiffs == 0, "scans and sightings match the raw samples");
+    check(rangeDiffs == 0, "min and max match the raw samples");
+    check(meanDiffs == 0, "means within 1 of the raw samples");
+
+    RollupSummary week = rollupSummary(&store, trace.back().time, 7 * DAY);
+    printf("  last 7 days: %lu scans, seen %u%%, signal %u (%u..%u), load %u%% (%u..%u%%)\n",
+        (unsigned long)week.scans, rollupPresence(&week), rollupSignalMean(&week), week.signalMin, week.signalMax,
+        rollupLoadMean(&week), week.loadMin, week.loadMax);
+
+    size_t rawBytes = 0;
+    for (const RawSample &r : trace) rawBytes += r.time >= trace.back().time - 7 * DAY ? 4 : 0;
+    printf("\nRAM per store: %u bytes (%u buckets of %u bytes, %u open), 7 days raw at 4 bytes per scan: %lu bytes\n",
+        (unsigned)sizeof(RollupStore), (unsigned)ROLLUP_BUCKETS, (unsigned)sizeof(RollupBucket),
+        (unsigned)ROLLUP_TIERS, (unsigned long)rawBytes);
+    check(sizeof(RollupStore) <= 4096, "7 days of one store fit in 4 KB");
+}
+
+// Sample and summary time. The summary must read as many buckets after
+// 8 days as the span takes, not more as the history grows; the times are
+// only printed.
+static void timeRollups() {
+    static RollupStore store;
+    memset(&store, 0, sizeof(store));
+    const uint32_t samples = 8 * 24 * 180;
+    double start = cpuNanosNow();
+    uint32_t t = 1000;
+    double hourNs = 0;
+    uint16_t hourRead = 0;
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < samples; i++) {
+        t += 20000;
+        rollupAdd(&store, t, i % 13 != 0, (uint8_t)(90 - i % 7), (uint8_t)(i % 50));
+        if (i == 180) {
+            double s = cpuNanosNow();
+            for (int k = 0; k < 100000; k++) sink = sink + rollupSummary(&store, t, DAY).scans;
+            hourNs = (cpuNanosNow() - s) / 100000;
+            hourRead = rollupSummary(&store, t, DAY).read;
+            start += cpuNanosNow() - s;
+        }
+    }
+    double addNs = (cpuNanosNow() - start) / samples;
+
+    double s = cpuNanosNow();
+    for (int k = 0; k < 100000; k++) sink = sink + rollupSummary(&store, t, DAY).scans;
+    double weekNs = (cpuNanosNow() - s) / 100000;
+    uint16_t dayRead = rollupSummary(&store, t, DAY).read;
+    uint16_t weekRead = rollupSummary(&store, t, 7 * DAY).read;
+
+    printf("\ncpu: %.1f ns per sample, 24 h summary %.1f ns after 1 hour, %.1f ns after 8 days\n",
+        addNs, hourNs, weekNs);
+    printf("buckets read: 24 h summary %u after 1 hour, %u after 8 days; 7 day summary %u\n",
+        hourRead, dayRead, weekRead);
+    uint32_t dayBuckets = DAY / rollupTiers[ROLLUP_TIERS - 1].lengthMs;
+    check(dayRead <= dayBuckets + ROLLUP_TIERS, "24 h summary reads its span's buckets, whatever the history");
+    check(weekRead <= ROLLUP_HOURS + ROLLUP_TIERS, "7 day summary reads at most the hourly ring");
+}
+
+// 26 hours of scans every SCAN_INTERVAL_NORMAL; network 0 is missed on
+// every 4th scan
+static void runSketch() {
+    initializeStats();
+    Report.setMuted(true);
+    ScanCycle cycle;
+    generateScanCycle(cycle, 12, 23);
+    ScanCycle partial(cycle.begin() + 1, cycle.end());
+
+    uint32_t scans = 0;
+    unsigned long end = millis() + 26 * HOUR;
+    while ((long)(millis() - end) < 0) {
+        const ScanCycle &c = scans % 4 == 3 ? partial : cycle;
+        Zigbee.mockSetScanResults(c.data(), (uint16_t)c.size());
+        Zigbee.scanNetworks();
+        mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+        int16_t status = Zigbee.scanComplete();
+        if (status > 0) printScannedNetworks(status);
+        mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+        scans++;
+    }
+
+    uint16_t stores = 0;
+    for (uint16_t i = 0; i < networkTable.count; i++) {
+        if (networkRollup(&rollups, &networkTable.stats[i])) stores++;
+    }
+    printf("\nSketch: %lu scans over 26 h of 12 networks, %u of %u network stores used\n",
+        (unsigned long)scans, (unsigned)(ROLLUP_NETWORKS - rollups.freeStores), (unsigned)ROLLUP_NETWORKS);
+    check(stores == min((uint16_t)12, (uint16_t)ROLLUP_NETWORKS) && stores == ROLLUP_NETWORKS - rollups.freeStores,
+        "networks get stores while there are free ones");
+
+    // Network 0 is first in the scan, so it has the first store
+    RollupSummary day = rollupSummary(&rollups.network[0], millis(), DAY);
+    RollupSummary hour = rollupSummary(&rollups.network[0], millis(), HOUR);
+    printf("  PAN 0x%04x: seen in %u%% of %lu scans in 24 h, %u%% of %lu in the last hour\n",
+        rollups.owner[0].panId, rollupPresence(&day), (unsigned long)day.scans, rollupPresence(&hour),
+        (unsigned long)hour.scans);
+    check(rollups.owner[0].panId == cycle[0].short_pan_id && rollupPresence(&day) == 75 &&
+        day.scans > hour.scans * 22, "a network missed every 4th scan is seen 75% of the time");
+
+    uint32_t channels = 0, channelScansOk = 0;
+    for (int z = 0; z < CHANNEL_COUNT; z++) {
+        if (!rollups.channel[z].active) continue;
+        channels++;
+        if (rollupSummary(&rollups.channel[z], millis(), DAY).scans == day.scans) channelScansOk++;
+    }
+    check(channels == CHANNEL_COUNT && channelScansOk == CHANNEL_COUNT, "every channel store counts every scan");
+
+    // One more scan with the report on, captured
+    CapturePrint capture;
+    Report.setOutput(capture);
+    Report.setMuted(false);
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    int16_t status = Zigbee.scanComplete();
+    if (status > 0) printScannedNetworks(status);
+    size_t line = capture.text.find("Last 24 h:");
+    if (line != std::string::npos) {
+        printf("  diagnostics: %s\n", capture.text.substr(line, capture.text.find('\n', line) - line).c_str());
+    }
+    check(line != std::string::npos, "the diagnostics show the last 24 h");
+
+    printf("\nAs printed by the \"trends\" command:\n");
+    CapturePrint trends;
+    printRollups(&rollups, millis(), trends);
+    fputs(trends.text.c_str(), stdout);
+}
+
+int main() {
+    checkAgainstRaw();
+    timeRollups();
+    runSketch();
+
+    printf("\nRollup budget: %lu bytes, %lu used (%u channels, %u networks)\n",
+        (unsigned long)ROLLUP_BUDGET, (unsigned long)sizeof(RollupSet), (unsigned)CHANNEL_COUNT,
+        (unsigned)ROLLUP_NETWORKS);
+    check(sizeof(RollupSet) <= ROLLUP_BUDGET, "the stores fit the budget");
+
+    return checkResult();
+}
@@ -0,0 +1,109 @@
+/*
+ * Scan cycle benchmark: feeds generated scans of 1 to 1000 networks through
+ * printScannedNetworks() and reports, per cycle, the CPU time, the heap
+ * allocations made and the bytes written to Serial.
+ *
+ * Usage: bench_scan_cycle [--csv] [--check-allocs]
+ *
+ * --check-allocs exits with status 1 if any steady-state cycle allocated.
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <time.h>
+
+struct CycleCost {
+    double cpuMicros;
+    double allocations;
+    double allocatedBytes;
+    double serialBytes;
+};
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void runCycle(const ScanCycle &cycle) {
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    int16_t status = Zigbee.scanComplete();
+    if (status > 0) printScannedNetworks(status);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+static CycleCost measure(uint16_t networks, int cycles) {
+    ScanCycle cycle;
+    generateScanCycle(cycle, networks, 12345);
+    initializeStats();
+
+    // Warm up so first-sighting work is not counted as steady state
+    for (int i = 0; i < 3; i++) {
+        perturbScanCycle(cycle, 100 + i);
+        runCycle(cycle);
+    }
+
+    std::vector<ScanCycle> inputs(cycles, cycle);
+    for (int i = 0; i < cycles; i++) {
+        perturbScanCycle(cycle, 1000 + i);
+        inputs[i] = cycle;
+    }
+
+    uint64_t allocsBefore = mockHeapAllocations();
+    uint64_t bytesBefore = mockHeapBytes();
+    uint64_t serialBefore = Serial.mockBytesWritten();
+    double cpuBefore = cpuMicrosNow();
+
+    for (int i = 0; i < cycles; i++) {
+        runCycle(inputs[i]);
+    }
+
+    CycleCost cost;
+    cost.cpuMicros = (cpuMicrosNow() - cpuBefore) / cycles;
+    cost.allocations = (double)(mockHeapAllocations() - allocsBefore) / cycles;
+    cost.allocatedBytes = (double)(mockHeapBytes() - bytesBefore) / cycles;
+    cost.serialBytes = (double)(Serial.mockBytesWritten() - serialBefore) / cycles;
+    return cost;
+}
+
+int main(int argc, char **argv) {
+    bool csv = false;
+    bool checkAllocs = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else if (strcmp(argv[i], "--check-allocs") == 0) checkAllocs = true;
+    }
+    bool allocated = false;
+    const uint16_t sizes[] = {1, 10, 100, 1000};
+
+    if (csv) {
+        printf("networks,cycles,cpu_us_per_cycle,allocs_per_cycle,alloc_bytes_per_cycle,serial_bytes_per_cycle\n");
+    } else {
+        printf("%8s %7s %14s %13s %18s %19s\n",
+            "networks", "cycles", "cpu us/cycle", "allocs/cycle", "alloc bytes/cycle", "serial bytes/cycle");
+    }
+
+    for (uint16_t networks : sizes) {
+        int cycles = networks >= 1000 ? 10 : networks >= 100 ? 50 : 200;
+        CycleCost cost = measure(networks, cycles);
+
+        if (csv) {
+            printf("%u,%d,%.1f,%.1f,%.0f,%.0f\n", networks, cycles,
+                cost.cpuMicros, cost.allocations, cost.allocatedBytes, cost.serialBytes);
+        } else {
+            printf("%8u %7d %14.1f %13.1f %18.0f %19.0f\n", networks, cycles,
+                cost.cpuMicros, cost.allocations, cost.allocatedBytes, cost.serialBytes);
+        }
+        if (cost.allocations > 0) allocated = true;
+    }
+
+    if (checkAllocs && allocated) {
+        fprintf(stderr, "Heap allocations found in steady-state scan cycles\n");
+        return 1;
+    }
+    return 0;
+}
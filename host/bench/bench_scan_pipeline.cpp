@@ -0,0 +1,127 @@
+/*
+ * Scan pipeline benchmark: scans per hour with the pipelined scan cycle
+ * (copy the result, restart the radio, report while it scans) against the
+ * serial one (report, then start the next scan), scanning back to back.
+ *
+ * The mock charges host CPU time to the virtual clock, scaled by a
+ * slowdown factor standing in for the C6 (160 MHz, no data cache), so the
+ * time the report code takes on the device shows up as radio idle time in
+ * the serial cycle. Two ports:
+ *   fast: the port takes everything, text reports; only CPU time matters
+ *   slow: binary reports into a port too slow for them; the serial cycle
+ *         and the default pipeline drop reports and keep scanning, the
+ *         pipeline with a report wait (SCAN_PIPELINE_MAX_WAIT) holds
+ *         scans back instead and drops none
+ *
+ * Usage: bench_scan_pipeline [networks] [slowdown]
+ *
+ * Exits with 1 if a check fails.
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+
+static const unsigned long RUN_TIME = 3600000UL;
+static const unsigned long SLOW_PORT_BAUD = 1200;
+
+struct RunResult {
+    uint32_t scans;
+    uint32_t reported;
+    uint32_t held;
+    uint32_t droppedReports;
+    uint64_t portBytes;
+    unsigned long airtimeMs;
+    unsigned long maxLatencyMs;
+};
+
+static const unsigned long LOSSLESS_WAIT = 30000;
+
+static RunResult run(bool pipelined, unsigned long reportWait, uint8_t mode, bool slowPort, uint32_t slowdown) {
+    setup();
+    scheduler.pipelined = pipelined;
+    scheduler.reportWaitLimit = reportWait;
+    setReportMode(mode);
+    if (slowPort) {
+        Serial.begin(SLOW_PORT_BAUD);
+        Serial.mockSetTxFifo(128);
+    } else {
+        Serial.mockSetTxFifo(0);
+    }
+
+    uint32_t scansBefore = Zigbee.mockCompletedScans();
+    uint32_t droppedBefore = serialOutput.getDroppedReports();
+    uint64_t bytesBefore = Serial.mockBytesWritten();
+    unsigned long airtimeBefore = Zigbee.mockScanAirtimeMs();
+    unsigned long end = millis() + RUN_TIME;
+    mockSetCpuSlowdown(slowdown);
+    while ((long)(millis() - end) < 0) loop();
+    mockSetCpuSlowdown(0);
+
+    RunResult r;
+    r.scans = Zigbee.mockCompletedScans() - scansBefore;
+    r.reported = scheduler.scansReported;
+    r.held = scheduler.heldScans;
+    r.droppedReports = serialOutput.getDroppedReports() - droppedBefore;
+    r.airtimeMs = Zigbee.mockScanAirtimeMs() - airtimeBefore;
+    r.maxLatencyMs = scheduler.maxReportLatency;
+
+    // Let the port finish before the next run
+    Serial.mockSetTxFifo(0);
+    while (serialOutput.pending() > 0) drainSerialOutput();
+    r.portBytes = Serial.mockBytesWritten() - bytesBefore;
+    return r;
+}
+
+static void print(const char *name, const RunResult &r) {
+    printf("  %-10s %6u scans/h  radio busy %5.1f%%  %6u reported  %5u dropped  %5u held  max scan-to-report %lu ms  %.1f KB/report\n",
+        name, (unsigned)(r.scans * 3600000ULL / RUN_TIME), 100.0 * r.airtimeMs / RUN_TIME,
+        (unsigned)r.reported, (unsigned)r.droppedReports, (unsigned)r.held, r.maxLatencyMs,
+        r.reported > r.droppedReports ? r.portBytes / 1024.0 / (r.reported - r.droppedReports) : 0.0);
+}
+
+int main(int argc, char **argv) {
+    int networks = argc >= 2 ? atoi(argv[1]) : 60;
+    uint32_t slowdown = argc >= 3 ? (uint32_t)atoi(argv[2]) : 100;
+    ScanCycle cycle;
+    generateScanCycle(cycle, (uint16_t)networks, 2121);
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+
+    printf("%d networks, back-to-back full sweeps (%lu ms of airtime each), CPU %ux slower than this host\n",
+        networks, scanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, SCAN_DURATION), (unsigned)slowdown);
+
+    printf("\nFast port, text reports:\n");
+    RunResult serial = run(false, 0, REPORT_MODE_TEXT, false, slowdown);
+    RunResult pipelined = run(true, 0, REPORT_MODE_TEXT, false, slowdown);
+    print("serial", serial);
+    print("pipelined", pipelined);
+    printf("  %+.2f%% scans per channel, %+.2f%% radio time\n",
+        serial.scans ? 100.0 * pipelined.scans / serial.scans - 100 : 0.0,
+        serial.airtimeMs ? 100.0 * pipelined.airtimeMs / serial.airtimeMs - 100 : 0.0);
+
+    check(pipelined.scans >= serial.scans && pipelined.airtimeMs >= serial.airtimeMs,
+        "pipelining does not lower the scan rate");
+    check(pipelined.reported + 1 >= pipelined.scans, "every pipelined scan was reported");
+    check(serial.reported == serial.scans, "every serial scan was reported");
+    check(pipelined.held == 0 && pipelined.droppedReports == 0 && serial.droppedReports == 0,
+        "a fast port neither holds nor drops");
+
+    printf("\nSlow port (%lu baud), binary reports:\n", SLOW_PORT_BAUD);
+    RunResult serialSlow = run(false, 0, REPORT_MODE_BINARY, true, slowdown);
+    RunResult pipelinedSlow = run(true, 0, REPORT_MODE_BINARY, true, slowdown);
+    RunResult losslessSlow = run(true, LOSSLESS_WAIT, REPORT_MODE_BINARY, true, slowdown);
+    print("serial", serialSlow);
+    print("pipelined", pipelinedSlow);
+    print("lossless", losslessSlow);
+
+    uint32_t serialDelivered = serialSlow.reported - serialSlow.droppedReports;
+    check(serialSlow.droppedReports > 0, "the slow port cannot take every serial report");
+    check(pipelinedSlow.held == 0 && pipelinedSlow.scans >= serialSlow.scans,
+        "without a report wait the pipeline keeps scanning");
+    check(losslessSlow.held > 0 && losslessSlow.droppedReports == 0, "with a report wait scans are held, no report dropped");
+    check(losslessSlow.reported + 2 >= serialDelivered, "as many reports reach the port");
+
+    return checkResult();
+}
@@ -0,0 +1,135 @@
+/*
+ * Scheduler benchmark: runs the sketch's setup()/loop() for an hour of
+ * virtual time and compares it with the previous loop, which polled
+ * scanComplete() and then slept a fixed 100 ms.
+ *
+ * Reports loop wakeups per minute, idle share, and the delay from the scan
+ * actually finishing to the report starting.
+ *
+ * Usage: bench_scheduler [networks]
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+
+static const unsigned long RUN_TIME = 3600000UL;
+
+struct SchedulerCost {
+    uint32_t wakeups;
+    unsigned long idleMicros;
+    uint32_t reports;
+    unsigned long latencySum;
+    unsigned long latencyMax;
+};
+
+static unsigned long legacyIdleMicros = 0;
+
+// The loop() this sketch used before ScanScheduler, kept for comparison
+static void legacyLoop() {
+    static unsigned long lastScanTime = 0;
+    static bool scanInProgress = false;
+    static bool networksFound = false;
+    static unsigned long lastPrintTime = 0;
+    static unsigned long scanStartTime = 0;
+    unsigned long currentTime = millis();
+    unsigned long currentScanInterval = networksFound ? SCAN_INTERVAL_NORMAL : SCAN_INTERVAL_SEARCH;
+
+    if (scanInProgress) {
+        int16_t scanStatus = Zigbee.scanComplete();
+        if (scanStatus == ZB_SCAN_RUNNING) {
+            if (currentTime - scanStartTime > 30000) {
+                Report.println("\nScan timeout - restarting scan");
+                Zigbee.scanDelete();
+                scanInProgress = false;
+                lastScanTime = currentTime;
+            }
+        } else if (scanStatus == ZB_SCAN_FAILED) {
+            Report.println("\nScan failed! Waiting before retry...");
+            scanInProgress = false;
+            lastScanTime = currentTime;
+        } else if (scanStatus > 0) {
+            Report.printf("\nScan completed with status: %d\n", scanStatus);
+            networksFound = true;
+            printScannedNetworks(scanStatus);
+            scanInProgress = false;
+            lastScanTime = currentTime;
+        } else if (scanStatus == 0) {
+            Report.println("\nNo networks found, will scan again soon...");
+            scanInProgress = false;
+            lastScanTime = currentTime;
+            networksFound = false;
+        }
+    } else {
+        if (currentTime - lastScanTime >= currentScanInterval) {
+            Report.println("\nInitiating new scan cycle...");
+            Zigbee.scanNetworks();
+            Report.println("Scan started");
+            scanInProgress = true;
+            scanStartTime = currentTime;
+        } else if (currentTime - lastPrintTime >= 20000) {
+            int remainingTime = (currentScanInterval - (currentTime - lastScanTime)) / 1000;
+            Report.printf("\nWaiting for next scan: %d seconds", remainingTime);
+            lastPrintTime = currentTime;
+        }
+    }
+
+    unsigned long start = micros();
+    delay(100);
+    legacyIdleMicros += micros() - start;
+}
+
+static SchedulerCost run(bool legacy) {
+    SchedulerCost cost = {};
+    uint32_t completed = Zigbee.mockCompletedScans();
+    unsigned long end = millis() + RUN_TIME;
+
+    while ((long)(millis() - end) < 0) {
+        if (legacy) legacyLoop();
+        else loop();
+        cost.wakeups++;
+
+        if (Zigbee.mockCompletedScans() != completed) {
+            completed = Zigbee.mockCompletedScans();
+            unsigned long latency = Zigbee.mockLastCompletionLatencyMs();
+            cost.reports++;
+            cost.latencySum += latency;
+            cost.latencyMax = max(cost.latencyMax, latency);
+        }
+    }
+    return cost;
+}
+
+static void print(const char *name, const SchedulerCost &cost, unsigned long idleMicros) {
+    printf("%-22s %12.1f %8.2f %9u %16.1f %15lu\n", name,
+        cost.wakeups / (RUN_TIME / 60000.0),
+        100.0 * idleMicros / (RUN_TIME * 1000.0),
+        cost.reports,
+        cost.reports ? (double)cost.latencySum / cost.reports : 0.0,
+        cost.latencyMax);
+}
+
+int main(int argc, char **argv) {
+    int networks = argc >= 2 ? atoi(argv[1]) : 10;
+    ScanCycle cycle;
+    generateScanCycle(cycle, (uint16_t)networks, 4242);
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.mockSetScanOverheadMs(50);
+    Serial.mockSetTxFifo(256);
+
+    printf("%d networks, 115200 baud serial, scans overrun by 0-50 ms, %lu minutes of virtual time\n\n",
+        networks, RUN_TIME / 60000);
+    printf("%-22s %12s %8s %9s %16s %15s\n",
+        "loop", "wakeups/min", "idle %", "reports", "mean latency ms", "max latency ms");
+
+    setup();
+    uint64_t idleBefore = scheduler.totalIdleMicros;
+    SchedulerCost current = run(false);
+    print("ScanScheduler", current, (unsigned long)(scheduler.totalIdleMicros - idleBefore));
+
+    Report.setOutput(Serial);
+    SchedulerCost legacy = run(true);
+    print("poll + delay(100)", legacy, legacyIdleMicros);
+    return 0;
+}
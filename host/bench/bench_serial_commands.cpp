@@ -0,0 +1,296 @@
+/*
+ * Serial commands benchmark: what a scan costs when nothing is formatted
+ * per scan (report none) against text reports, and the command set that
+ * gives the text on request, driven through the mock serial port.
+ *
+ * Per-scan cost: host CPU time and report bytes of a scan of 60 networks
+ * in each report mode.
+ *
+ * Commands: list, show, channel, recommendations, stats, set and report
+ * are checked for their output, list also for the status of its rows;
+ * show, channel and recommendations for being replayed from the memo until
+ * the next analysed scan, and for what a replay costs against computing
+ * the reply. A command sent between the
+ * capture of a scan and its analysis waits for it. Finally the sketch runs
+ * with "set mask" and "set interval" sent over the port, and with "set
+ * mask" alone on the adaptive schedule.
+ *
+ * Usage: bench_serial_commands [networks]
+ *
+ * Exits with 1 if a check fails.
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <string>
+#include <time.h>
+
+static double cpuNanosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t occurrences(const std::string &text, const char *what) {
+    size_t n = 0;
+    for (size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1)) n++;
+    return n;
+}
+
+static int16_t radioScan(const ScanCycle &cycle) {
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    return Zigbee.scanComplete();
+}
+
+static void scanOnce(const ScanCycle &cycle) {
+    int16_t status = radioScan(cycle);
+    if (status > 0) printScannedNetworks(status);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+// Sends one line and returns the reply
+static std::string command(const char *line) {
+    CapturePrint capture;
+    Report.setOutput(capture);
+    Serial.mockInput(line);
+    Serial.mockInput("\n");
+    pollSerialCommands();
+    Report.setOutput(serialOutput);
+    return capture.text;
+}
+
+// A scan of two networks on channel 15, the first at signal; the signal
+// index of the radio mock is part of the PAN ID, so the snapshot is filled
+// here
+static void signalScan(uint8_t signal) {
+    beginScanSnapshot(&currentScan, ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+    for (uint16_t i = 0; i < 2; i++) {
+        currentScan.panId[i] = (uint16_t)(0x1a00 + i);
+        currentScan.extendedPanId[i] = 0x1a00 + i;
+        currentScan.channel[i] = 15;
+        currentScan.signal[i] = i == 0 ? signal : 0x80;
+        currentScan.load[i] = 10;
+        currentScan.flags[i] = NETWORK_FLAG_SECURED;
+    }
+    currentScan.count = 2;
+    reportScannedNetworks(2, true, &currentScan);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+static void perScanCost(const ScanCycle &base) {
+    const uint32_t scans = 200;
+    static const struct { uint8_t mode; const char *name; } modes[] = {
+        { REPORT_MODE_TEXT, "text" }, { REPORT_MODE_NONE, "none" },
+    };
+    double ns[2];
+    uint64_t bytes[2];
+
+    for (int m = 0; m < 2; m++) {
+        initializeStats();
+        setReportMode(modes[m].mode);
+        CountPrint port;
+        Report.setOutput(port);
+        ScanCycle cycle = base;
+        double cpu = 0;
+        for (uint32_t s = 0; s < scans; s++) {
+            perturbScanCycle(cycle, s);
+            int16_t status = radioScan(cycle);
+            double start = cpuNanosNow();
+            if (status > 0) printScannedNetworks(status);
+            cpu += cpuNanosNow() - start;
+            mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+        }
+        Report.setOutput(serialOutput);
+        ns[m] = cpu / scans;
+        bytes[m] = port.bytes / scans;
+        printf("  report %-4s  %8.1f us per scan  %6llu bytes per scan\n", modes[m].name, ns[m] / 1000,
+            (unsigned long long)bytes[m]);
+    }
+    check(ns[1] < ns[0] && bytes[1] == 0, "without text reports a scan formats nothing");
+}
+
+static void commands(const ScanCycle &cycle) {
+    initializeStats();
+    setReportMode(REPORT_MODE_NONE);
+    // The status is against the scan before, not the history the scan was saved to
+    signalScan(0x80);
+    check(occurrences(command("list"), "| New") == 2, "list shows new networks after the first scan");
+    signalScan(0x80);
+    check(occurrences(command("list"), "| Stable") == 2, "list shows unchanged networks as stable");
+    signalScan(0x40);
+    std::string down = command("list");
+    check(occurrences(down, "| (!) Down") == 1 && occurrences(down, "| Stable") == 1,
+        "list shows a signal drop");
+
+    initializeStats();
+    for (int s = 0; s < 12; s++) scanOnce(cycle);
+
+    std::string list = command("list");
+    printf("\nlist: %zu bytes\n", list.size());
+    check(occurrences(list, "/0x") == currentScan.count, "list has a row per network");
+
+    char line[32];
+    char expect[32];
+    uint16_t pan = cycle[0].short_pan_id;
+    snprintf(line, sizeof(line), "show 0x%04x", pan);
+    snprintf(expect, sizeof(expect), "Network 0x%04x", pan);
+    uint32_t misses = commandMemo.misses, hits = commandMemo.hits;
+    std::string show = command(line);
+    std::string again = command(line);
+    fputs(show.c_str(), stdout);
+    check(show.find(expect) != std::string::npos && show.find("Beacon Loss") != std::string::npos,
+        "show prints the network's diagnostics");
+    check(again == show && commandMemo.misses == misses + 1 && commandMemo.hits == hits + 1,
+        "a repeated show is replayed");
+    snprintf(line, sizeof(line), "show %u", pan);
+    check(command(line) == show && commandMemo.hits == hits + 2, "show takes decimal PAN IDs");
+
+    uint16_t absent = 0x0001;
+    while (true) {
+        bool used = false;
+        for (const zigbee_scan_result_t &n : cycle) used |= n.short_pan_id == absent;
+        if (!used) break;
+        absent++;
+    }
+    snprintf(line, sizeof(line), "show 0x%04x", absent);
+    check(command(line).find("is not in the last scan") != std::string::npos, "show of an absent PAN");
+
+    snprintf(line, sizeof(line), "channel %u", cycle[0].logic_channel);
+    snprintf(expect, sizeof(expect), "PAN 0x%04x:", pan);
+    std::string channel = command(line);
+    check(channel.find("=== CHANNEL") != std::string::npos && channel.find(expect) != std::string::npos,
+        "channel lists its networks");
+    check(command("channel 27").find("Commands:") != std::string::npos, "channels outside 11-26 get the help");
+
+    std::string recommendations = command("recommendations");
+    printf("\nrecommendations: %zu bytes, channel: %zu bytes\n", recommendations.size(), channel.size());
+    check(recommendations.find("=== SMART RECOMMENDATIONS ===") != std::string::npos, "recommendations on request");
+    hits = commandMemo.hits;
+    misses = commandMemo.misses;
+    check(command("recommendations") == recommendations && commandMemo.hits == hits + 1, "recommendations replayed");
+    scanOnce(cycle);
+    command("recommendations");
+    check(commandMemo.misses == misses + 1, "the next scan invalidates the memo");
+
+    // Replay against computing: alternating two PANs misses every time
+    char other[32];
+    snprintf(line, sizeof(line), "show 0x%04x", pan);
+    snprintf(other, sizeof(other), "show 0x%04x", cycle[1].short_pan_id);
+    const int rounds = 2000;
+    double start = cpuNanosNow();
+    for (int i = 0; i < rounds; i++) command(i & 1 ? other : line);
+    double computeNs = (cpuNanosNow() - start) / rounds;
+    start = cpuNanosNow();
+    for (int i = 0; i < rounds; i++) command(line);
+    double replayNs = (cpuNanosNow() - start) / rounds;
+    printf("\nshow: %.1f us computed, %.1f us replayed (host)\n", computeNs / 1000, replayNs / 1000);
+    check(replayNs < computeNs, "a replay is cheaper than the reply");
+
+    // A line arriving between capture and analysis waits for the analysis
+    int16_t status = radioScan(cycle);
+    uint16_t sequence = currentScan.sequence;
+    bool captured = captureScanResults(status, ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, &currentScan);
+    check(captured && currentScan.sequence == (uint16_t)(sequence + 1), "a captured scan advances the sequence once");
+    std::string early = command("list");
+    check(early.empty() && commandsBusy(), "a command waits while the scan is not analysed");
+    reportScannedNetworks(status, captured, &currentScan);
+    CapturePrint late;
+    Report.setOutput(late);
+    pollSerialCommands();
+    Report.setOutput(serialOutput);
+    check(occurrences(late.text, "/0x") == currentScan.count && !commandsBusy(), "it runs once the scan is analysed");
+
+    std::string stats = command("stats");
+    fputs(stats.c_str(), stdout);
+    check(stats.find("Reports: none") != std::string::npos, "stats shows the report mode");
+
+    check(command("report text").find("Reports: text") != std::string::npos && reportMode == REPORT_MODE_TEXT,
+        "report switches the mode");
+    command("report none");
+    check(command("set mask 0").find("Usage:") != std::string::npos, "a mask without channels is refused");
+    check(command("set interval 5000").find("every 5000 ms") != std::string::npos &&
+        !channelPlanner.adaptive && channelPlanner.interval == 5000, "set interval");
+    command("set interval auto");
+    check(channelPlanner.adaptive == ADAPTIVE_CHANNEL_SCAN && channelPlanner.interval == SCAN_INTERVAL_NORMAL,
+        "set interval auto restores the schedule");
+}
+
+// The sketch with its scheduler, settings sent over the port
+static void sketch(const ScanCycle &cycle) {
+    setup();
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    setReportMode(REPORT_MODE_NONE);
+    CapturePrint port;
+    Report.setOutput(port);
+
+    const uint32_t mask = 1UL << cycle[0].logic_channel;
+    char line[48];
+    snprintf(line, sizeof(line), "set mask 0x%lx\nset interval 5000\n", (unsigned long)mask);
+    Serial.mockInput(line);
+    uint32_t scansBefore = Zigbee.mockCompletedScans();
+    unsigned long end = millis() + 60000;
+    while ((long)(millis() - end) < 0) loop();
+
+    uint16_t onChannel = 0;
+    for (const zigbee_scan_result_t &n : cycle) onChannel += n.logic_channel == cycle[0].logic_channel;
+    uint32_t scans = Zigbee.mockCompletedScans() - scansBefore;
+    printf("\nSketch: %lu scans in 60 s over mask 0x%08lx, %u networks in the last\n", (unsigned long)scans,
+        (unsigned long)currentScan.channelMask, currentScan.count);
+    check(port.text.find("every 5000 ms") != std::string::npos, "the sketch reads commands from the port");
+    check(currentScan.channelMask == mask && currentScan.count == onChannel, "scans cover the set mask");
+    check(scans >= 10 && scans <= 13, "scans follow the set interval");
+
+    Report.setOutput(serialOutput);
+    setReportMode(REPORT_MODE);
+}
+
+// "set mask" alone keeps the adaptive schedule: the channels left out must
+// not stay overdue and pull the scans down to the minimum gap
+static void adaptiveMask(const ScanCycle &cycle) {
+    setup();
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    setReportMode(REPORT_MODE_NONE);
+    CapturePrint port;
+    Report.setOutput(port);
+
+    const unsigned long period = 300000;
+    uint32_t before = Zigbee.mockCompletedScans();
+    unsigned long end = millis() + period;
+    while ((long)(millis() - end) < 0) loop();
+    uint32_t allChannels = Zigbee.mockCompletedScans() - before;
+
+    char line[32];
+    snprintf(line, sizeof(line), "set mask 0x%lx\n", 1UL << cycle[0].logic_channel);
+    Serial.mockInput(line);
+    before = Zigbee.mockCompletedScans();
+    end = millis() + period;
+    while ((long)(millis() - end) < 0) loop();
+    uint32_t masked = Zigbee.mockCompletedScans() - before;
+
+    printf("Adaptive schedule: %lu scans in 5 min over all channels, %lu over channel %u\n",
+        (unsigned long)allChannels, (unsigned long)masked, cycle[0].logic_channel);
+    // At most one scan per CHANNEL_RESCAN_BUSY, against one per CHANNEL_SCAN_MIN_GAP when it was broken
+    check(channelPlanner.adaptive && masked <= period / CHANNEL_RESCAN_BUSY + 1, "set mask keeps the adaptive scan rate");
+
+    Report.setOutput(serialOutput);
+    setReportMode(REPORT_MODE);
+}
+
+int main(int argc, char **argv) {
+    int networks = argc >= 2 ? atoi(argv[1]) : 60;
+    ScanCycle cycle;
+    generateScanCycle(cycle, (uint16_t)networks, 2424);
+
+    printf("%d networks, per-scan report cost:\n", networks);
+    perScanCost(cycle);
+    commands(cycle);
+    sketch(cycle);
+    adaptiveMask(cycle);
+
+    return checkResult();
+}
@@ -0,0 +1,104 @@
+/*
+ * Serial output benchmark: how long a scan report keeps loop() away from
+ * the scan state machine, with blocking Serial writes versus the buffered
+ * output drained from loop().
+ *
+ * The mock port runs at 115200 baud with a 256 byte TX FIFO, and a write
+ * into a full FIFO blocks on the virtual clock like the real driver.
+ *
+ * Usage: bench_serial_output
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+
+struct ReportCost {
+    unsigned long reportBytes;
+    unsigned long latencyMicros;   // time printScannedNetworks() held loop()
+    unsigned long drainMicros;     // time until the port went idle
+    uint32_t droppedBytes;
+};
+
+static int16_t completeScan(const ScanCycle &cycle) {
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    return Zigbee.scanComplete();
+}
+
+static void waitForIdlePort() {
+    while (serialOutput.pending() > 0 || Serial.mockTxLevel() > 0) {
+        drainSerialOutput();
+        delay(1);
+    }
+}
+
+static ReportCost blockingReport(const ScanCycle &cycle) {
+    Report.setOutput(Serial);
+    int16_t status = completeScan(cycle);
+
+    ReportCost cost = {};
+    uint64_t bytesBefore = Serial.mockBytesWritten();
+    unsigned long start = micros();
+    printScannedNetworks(status);
+    cost.latencyMicros = micros() - start;
+    waitForIdlePort();
+    cost.drainMicros = micros() - start;
+    cost.reportBytes = (unsigned long)(Serial.mockBytesWritten() - bytesBefore);
+    return cost;
+}
+
+static ReportCost bufferedReport(const ScanCycle &cycle, uint8_t policy) {
+    Report.setOutput(serialOutput);
+    serialOutput.setOverflowPolicy(policy);
+    int16_t status = completeScan(cycle);
+
+    ReportCost cost = {};
+    uint32_t droppedBefore = serialOutput.getDroppedBytes();
+    uint64_t bytesBefore = Serial.mockBytesWritten();
+    unsigned long start = micros();
+    serialOutput.beginReport();
+    printScannedNetworks(status);
+    serialOutput.endReport();
+    cost.latencyMicros = micros() - start;
+    waitForIdlePort();
+    cost.drainMicros = micros() - start;
+    cost.reportBytes = (unsigned long)(Serial.mockBytesWritten() - bytesBefore);
+    cost.droppedBytes = serialOutput.getDroppedBytes() - droppedBefore;
+    return cost;
+}
+
+int main() {
+    const uint16_t sizes[] = {1, 5, 10, 25, 50, 100};
+
+    Serial.begin(115200);
+    Serial.mockSetTxFifo(256);
+    initializeStats();
+
+    printf("Serial 115200 baud, 256 byte TX FIFO, %d byte output buffer\n\n", SERIAL_OUTPUT_BUFFER_SIZE);
+    printf("%8s | %25s | %35s | %35s\n", "", "blocking Serial", "buffered, drop report", "buffered, drop oldest");
+    printf("%8s | %8s %8s %7s | %8s %8s %7s %9s | %8s %8s %7s %9s\n",
+        "networks", "bytes", "loop ms", "tx ms",
+        "bytes", "loop ms", "tx ms", "dropped",
+        "bytes", "loop ms", "tx ms", "dropped");
+
+    for (uint16_t networks : sizes) {
+        ScanCycle cycle;
+        generateScanCycle(cycle, networks, 777);
+
+        ReportCost direct = blockingReport(cycle);
+        ReportCost dropReport = bufferedReport(cycle, OVERFLOW_DROP_REPORT);
+        ReportCost dropOldest = bufferedReport(cycle, OVERFLOW_DROP_OLDEST);
+
+        printf("%8u | %8lu %8.1f %7.1f | %8lu %8.1f %7.1f %9u | %8lu %8.1f %7.1f %9u\n",
+            networks,
+            direct.reportBytes, direct.latencyMicros / 1000.0, direct.drainMicros / 1000.0,
+            dropReport.reportBytes, dropReport.latencyMicros / 1000.0, dropReport.drainMicros / 1000.0,
+            dropReport.droppedBytes,
+            dropOldest.reportBytes, dropOldest.latencyMicros / 1000.0, dropOldest.drainMicros / 1000.0,
+            dropOldest.droppedBytes);
+    }
+    return 0;
+}
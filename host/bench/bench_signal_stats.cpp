@@ -0,0 +1,146 @@
+/*
+ * Signal statistics benchmark: per-update cost of the streaming
+ * SignalStats window against the previous approach of rescanning the whole
+ * history ring for min/max/avg, for windows of 10 to 1000 samples.
+ *
+ * Every update is also checked against a brute-force recomputation of
+ * min, max, mean, variance and quantile bounds; a mismatch exits with 1.
+ *
+ * Usage: bench_signal_stats [updates]
+ */
+
+#include "sketch.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Slowly drifting signal with noise and occasional drop-outs
+static uint8_t nextSample(uint32_t *state, int *level) {
+    *state = *state * 1103515245u + 12345u;
+    uint32_t r = *state >> 8;
+    *level += (int)(r % 5) - 2;
+    *level = constrain(*level, 20, 230);
+    if (r % 97 == 0) return (uint8_t)(*level / 4);
+    return (uint8_t)constrain(*level + (int)((r >> 8) % 21) - 10, 0, 255);
+}
+
+// The per-update work updateNetworkStats() used to do
+template<uint16_t WINDOW>
+struct RescanStats {
+    uint8_t history[WINDOW];
+    uint16_t index;
+    uint16_t count;
+    uint8_t minValue, maxValue, avgValue;
+};
+
+template<uint16_t WINDOW>
+static void rescanAdd(RescanStats<WINDOW> *s, uint8_t value) {
+    s->history[s->index] = value;
+    s->index = (s->index + 1) % WINDOW;
+    if (s->count < WINDOW) s->count++;
+    s->minValue = 255;
+    s->maxValue = 0;
+    uint32_t sum = 0;
+    for (int i = 0; i < s->count; i++) {
+        s->minValue = min(s->minValue, s->history[i]);
+        s->maxValue = max(s->maxValue, s->history[i]);
+        sum += s->history[i];
+    }
+    s->avgValue = sum / s->count;
+}
+
+template<uint16_t WINDOW>
+static bool verify(uint32_t updates) {
+    static SignalStats<WINDOW> stats;
+    memset(&stats, 0, sizeof(stats));
+    uint8_t window[WINDOW];
+    uint32_t state = 7;
+    int level = 120;
+    const uint8_t width = 256 / SIGNAL_QUANTILE_BINS;
+
+    for (uint32_t n = 0; n < updates; n++) {
+        uint8_t value = nextSample(&state, &level);
+        signalStatsAdd(&stats, value);
+        window[n % WINDOW] = value;
+
+        uint32_t count = min(n + 1, (uint32_t)WINDOW);
+        uint8_t sorted[WINDOW];
+        memcpy(sorted, window, count);
+        std::sort(sorted, sorted + count);
+        uint32_t sum = 0;
+        uint64_t squares = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            sum += sorted[i];
+            squares += sorted[i] * sorted[i];
+        }
+        uint32_t variance = count < 2 ? 0 : (uint32_t)((count * squares - (uint64_t)sum * sum) / ((uint64_t)count * count));
+
+        bool ok = signalStatsMin(&stats) == sorted[0] &&
+            signalStatsMax(&stats) == sorted[count - 1] &&
+            signalStatsMean(&stats) == sum / count &&
+            signalStatsVariance(&stats) == variance;
+
+        static const uint8_t percents[] = { 10, 50, 90 };
+        for (uint8_t p : percents) {
+            uint8_t exact = sorted[((count - 1) * p + 50) / 100];
+            int q = signalStatsQuantile(&stats, p);
+            ok = ok && q / width == exact / width;
+        }
+        if (!ok) {
+            printf("window %u: mismatch after %u updates\n", (unsigned)WINDOW, (unsigned)n + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+static volatile uint32_t sink;
+
+template<uint16_t WINDOW>
+static void measure(uint32_t updates) {
+    static SignalStats<WINDOW> stats;
+    static RescanStats<WINDOW> rescan;
+    memset(&stats, 0, sizeof(stats));
+    memset(&rescan, 0, sizeof(rescan));
+
+    uint32_t state = 11;
+    int level = 120;
+    double start = cpuMicrosNow();
+    for (uint32_t n = 0; n < updates; n++) {
+        signalStatsAdd(&stats, nextSample(&state, &level));
+        sink = signalStatsMin(&stats) + signalStatsMax(&stats) + signalStatsMean(&stats);
+    }
+    double streaming = (cpuMicrosNow() - start) * 1000.0 / updates;
+
+    state = 11;
+    level = 120;
+    start = cpuMicrosNow();
+    for (uint32_t n = 0; n < updates; n++) {
+        rescanAdd(&rescan, nextSample(&state, &level));
+        sink = rescan.minValue + rescan.maxValue + rescan.avgValue;
+    }
+    double rescanned = (cpuMicrosNow() - start) * 1000.0 / updates;
+
+    printf("%8u %10u %14.1f %13.1f\n", (unsigned)WINDOW, (unsigned)sizeof(stats), streaming, rescanned);
+}
+
+int main(int argc, char **argv) {
+    uint32_t updates = argc >= 2 ? (uint32_t)atoi(argv[1]) : 1000000;
+
+    bool ok = verify<10>(20000) && verify<100>(20000) && verify<300>(20000) && verify<1000>(5000);
+    printf("brute-force check: %s\n\n", ok ? "ok" : "FAILED");
+
+    printf("%8s %10s %14s %13s\n", "window", "bytes", "streaming ns", "rescan ns");
+    measure<10>(updates);
+    measure<100>(updates);
+    measure<300>(updates);
+    measure<1000>(updates);
+    return ok ? 0 : 1;
+}
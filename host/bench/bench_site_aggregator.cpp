@@ -0,0 +1,401 @@
+/*
+ * Site aggregator load test: simulated scanners spread over a building
+ * hear networks at a signal that falls with distance, and their telemetry
+ * streams (boot text, keyframes, a network leaving) are merged by
+ * SiteAggregator. Per scanner count (1 to 256) reports
+ *  - frames and records merged per second of wall time
+ *  - how often readers waited on a full queue
+ * and checks the merged view against the simulation: who hears each
+ * network, its mean signal per scanner and the strongest scanner. The
+ * streams are held open until the view is checked; once they end, their
+ * scanners must hear nothing.
+ *
+ * Also merges streams in which each scanner lost the frame saying a network
+ * left (the next keyframe must drop it), and the same streams read from a
+ * file and a local socket.
+ *
+ * Usage: bench_site_aggregator [frames per scanner]
+ *
+ * Exits with 1 if a merged view is wrong.
+ */
+
+#include "aggregator/site_aggregator.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+
+static const int SITE_NETWORKS = 48;
+static const double SITE_SIZE = 200;            // m, square
+static const int HEARD_BELOW_DBM = -95;
+
+struct Point {
+    double x, y;
+};
+
+struct SimNetwork {
+    uint16_t panId;
+    uint8_t channel;
+    Point at;
+};
+
+// What the simulation sent, per network and scanner
+struct Expected {
+    uint32_t count;
+    int64_t sumSignal;
+};
+
+struct Simulation {
+    std::vector<SimNetwork> networks;
+    std::vector<Point> scanners;
+    std::vector<std::vector<uint8_t>> streams;
+    std::map<std::pair<int, int>, Expected> heard;     // (network, scanner)
+    std::vector<uint64_t> records;                      // per scanner, as the reader passes them
+    uint64_t frames;
+    std::vector<uint64_t> lost;                         // frames left out, per scanner
+};
+
+static uint32_t nextRandom(uint32_t &state) {
+    state = state * 1103515245u + 12345u;
+    return state >> 8;
+}
+
+static void put16(std::vector<uint8_t> &out, uint16_t v) {
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+static void put32(std::vector<uint8_t> &out, uint32_t v) {
+    put16(out, (uint16_t)v);
+    put16(out, (uint16_t)(v >> 16));
+}
+
+// One keyframe in the sketch's telemetry format
+struct FrameNetwork {
+    const SimNetwork *network;
+    uint8_t signal;
+    uint8_t flags;
+};
+
+static void appendFrame(std::vector<uint8_t> &out, uint16_t sequence, uint32_t timestamp,
+                        const std::vector<FrameNetwork> &networks) {
+    std::vector<uint8_t> payload;
+    put16(payload, sequence);
+    put32(payload, timestamp);
+    put32(payload, 0x07FFF800UL);
+    put16(payload, (uint16_t)networks.size());
+    put16(payload, 0);
+    for (const FrameNetwork &n : networks) {
+        put16(payload, n.network->panId);
+        put32(payload, 0xDDCCBBAAu);
+        put32(payload, n.network->panId);
+        payload.push_back(n.network->channel);
+        payload.push_back(n.signal);
+        payload.push_back(20);
+        payload.push_back(n.flags);
+        for (int i = 0; i < 7; i++) payload.push_back(0);
+        put32(payload, timestamp / 1000);
+        put32(payload, sequence + 1);
+        put16(payload, 0);
+        put16(payload, 0);
+    }
+
+    size_t start = out.size();
+    out.push_back(TELEMETRY_SYNC0);
+    out.push_back(TELEMETRY_SYNC1);
+    out.push_back(TELEMETRY_VERSION);
+    out.push_back(TELEMETRY_FRAME_SCAN);
+    put16(out, (uint16_t)payload.size());
+    out.insert(out.end(), payload.begin(), payload.end());
+    put16(out, telemetryCrc16(TELEMETRY_CRC_INIT, out.data() + start + 2, 4 + payload.size()));
+}
+
+// With loseFrame, another network leaves half way and the frame saying so
+// is lost
+static Simulation simulate(int scanners, int frames, bool loseFrame = false) {
+    Simulation sim;
+    sim.frames = 0;
+    uint32_t state = 77;
+    for (int i = 0; i < SITE_NETWORKS; i++) {
+        SimNetwork n;
+        n.panId = (uint16_t)(0x1000 + i * 37);
+        n.channel = (uint8_t)(11 + nextRandom(state) % 16);
+        n.at.x = nextRandom(state) % 1000 * SITE_SIZE / 1000;
+        n.at.y = nextRandom(state) % 1000 * SITE_SIZE / 1000;
+        sim.networks.push_back(n);
+    }
+    // Scanners on a grid over the building
+    int side = (int)ceil(sqrt((double)scanners));
+    for (int s = 0; s < scanners; s++) {
+        Point p = { (s % side + 0.5) * SITE_SIZE / side, (s / side + 0.5) * SITE_SIZE / side };
+        sim.scanners.push_back(p);
+    }
+
+    sim.streams.resize(scanners);
+    sim.records.assign(scanners, 0);
+    sim.lost.assign(scanners, 0);
+    for (int s = 0; s < scanners; s++) {
+        std::vector<uint8_t> &out = sim.streams[s];
+        const char *boot = "ESP-ROM:esp32c6\r\nZigBee Network Scanner starting\r\n";
+        out.insert(out.end(), boot, boot + strlen(boot));
+
+        // The network the scanner hears loudest leaves before the last frame
+        int leaving = -1;
+        double loudest = -1000;
+        std::vector<double> level(SITE_NETWORKS);
+        for (int i = 0; i < SITE_NETWORKS; i++) {
+            double d = fmax(1, hypot(sim.networks[i].at.x - sim.scanners[s].x, sim.networks[i].at.y - sim.scanners[s].y));
+            level[i] = -30 - 30 * log10(d);
+            if (level[i] > loudest) {
+                loudest = level[i];
+                leaving = i;
+            }
+        }
+
+        int dropping = -1;
+        for (int i = 0; i < SITE_NETWORKS && loseFrame; i++) {
+            if (level[i] >= HEARD_BELOW_DBM && i != leaving) dropping = i;
+        }
+
+        uint32_t noise = 1000 + s;
+        std::vector<FrameNetwork> frame;
+        for (int f = 0; f < frames; f++) {
+            frame.clear();
+            bool lost = f == frames / 2 && dropping >= 0;
+            for (int i = 0; i < SITE_NETWORKS; i++) {
+                if (level[i] < HEARD_BELOW_DBM) continue;
+                if (i == dropping && f >= frames / 2) {
+                    if (lost) frame.push_back({ &sim.networks[i], 0, 0x20 });
+                    sim.heard.erase(std::make_pair(i, s));
+                    continue;
+                }
+                bool last = f == frames - 1;
+                if (last && i == leaving && scanners > 1) {
+                    frame.push_back({ &sim.networks[i], 0, 0x20 });
+                    sim.heard.erase(std::make_pair(i, s));
+                    continue;
+                }
+                // As a scanner measuring its level would report it, -130 dBm at 0
+                uint8_t signal = (uint8_t)lround(level[i] + 130 + (int)(nextRandom(noise) % 7) - 3);
+                frame.push_back({ &sim.networks[i], signal, 0x02 });
+                if (lost) continue;
+                Expected &e = sim.heard[std::make_pair(i, s)];
+                e.count++;
+                e.sumSignal += signal;
+            }
+            if (lost) {
+                sim.lost[s]++;
+                continue;
+            }
+            appendFrame(out, (uint16_t)f, 5000 + f * 30000u, frame);
+            sim.frames++;
+            sim.records[s] += 1 + frame.size();
+        }
+    }
+    return sim;
+}
+
+// Compares the merged view with what was sent, with the streams still
+// open; a scanner whose stream ended must hear nothing. Prints the first
+// mismatch.
+static bool matches(const Simulation &sim, const SiteView &view) {
+    size_t expectedNetworks = 0;
+    for (int i = 0; i < SITE_NETWORKS; i++) {
+        const SimNetwork &n = sim.networks[i];
+        const SiteNetwork *merged = NULL;
+        for (const SiteNetwork &candidate : view.networks()) {
+            if (candidate.panId == n.panId && candidate.channel == n.channel) merged = &candidate;
+        }
+        size_t hearing = 0;
+        double best = -1;
+        for (size_t s = 0; s < sim.scanners.size(); s++) {
+            const SiteSighting *sighting = NULL;
+            if (merged) {
+                for (const SiteSighting &candidate : merged->sightings) {
+                    if (candidate.scanner == s) sighting = &candidate;
+                }
+            }
+            auto e = sim.heard.find(std::make_pair(i, (int)s));
+            if (e == sim.heard.end() || view.scanners()[s].ended) {
+                if (sighting) {
+                    printf("  PAN 0x%04x scanner %zu: still heard\n", n.panId, s);
+                    return false;
+                }
+                continue;
+            }
+            hearing++;
+            double mean = (double)e->second.sumSignal / e->second.count;
+            best = fmax(best, mean);
+            if (!sighting || sighting->count != e->second.count || sighting->sumSignal != e->second.sumSignal) {
+                printf("  PAN 0x%04x scanner %zu: sighting does not match\n", n.panId, s);
+                return false;
+            }
+        }
+        if (hearing == 0) continue;
+        expectedNetworks++;
+        if (merged->sightings.size() != hearing || merged->sightings[merged->strongest()].meanSignal() != best) {
+            printf("  PAN 0x%04x: %zu of %zu scanners, strongest wrong\n", n.panId, merged->sightings.size(), hearing);
+            return false;
+        }
+    }
+    if (view.heard() != expectedNetworks) {
+        printf("  %zu networks merged, %zu expected\n", view.heard(), expectedNetworks);
+        return false;
+    }
+    return true;
+}
+
+// Once every stream ended: each read cleanly but for the frames left out,
+// and nothing is heard any more
+static bool endedCleanly(const Simulation &sim, const SiteView &view) {
+    for (size_t s = 0; s < view.scanners().size(); s++) {
+        const SiteScanner &scanner = view.scanners()[s];
+        if (!scanner.ended || scanner.failed || scanner.decoder.crcErrors ||
+            scanner.decoder.sequenceGaps != sim.lost[s]) {
+            printf("  %s: stream not read cleanly\n", scanner.name.c_str());
+            return false;
+        }
+    }
+    if (view.heard() != 0) {
+        printf("  %zu networks heard after every stream ended\n", view.heard());
+        return false;
+    }
+    return true;
+}
+
+// Runs the aggregator and checks the view once every scanner's records are
+// merged, then calls finish to let the held streams end. mergedSeconds is
+// the time until the check.
+static bool mergeAndCheck(SiteAggregator &aggregator, const Simulation &sim, const std::function<void()> &finish,
+                          double &mergedSeconds) {
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(60);
+    bool checked = false, ok = false;
+    aggregator.run([&](const SiteView &view) {
+        if (checked) return;
+        bool merged = true;
+        for (size_t s = 0; s < sim.streams.size(); s++) merged &= view.scanners()[s].records >= sim.records[s];
+        auto now = std::chrono::steady_clock::now();
+        if (!merged && now < deadline) return;
+        mergedSeconds = std::chrono::duration<double>(now - start).count();
+        if (!merged) printf("  records missing\n");
+        ok = merged && matches(sim, view);
+        checked = true;
+        finish();
+    }, 1);
+    return ok && endedCleanly(sim, aggregator.view());
+}
+
+static bool loadRun(int scanners, int frames, double &baseRate, bool loseFrame = false) {
+    Simulation sim = simulate(scanners, frames, loseFrame);
+    size_t bytes = 0;
+    SiteAggregator aggregator;
+    std::vector<MemorySource *> held;
+    for (int s = 0; s < scanners; s++) {
+        bytes += sim.streams[s].size();
+        std::string name = "sim" + std::to_string(s);
+        held.push_back(new MemorySource(name, sim.streams[s].data(), sim.streams[s].size(), 512, true));
+        aggregator.addSource(std::unique_ptr<ByteSource>(held.back()));
+    }
+
+    double seconds = 0;
+    bool ok = mergeAndCheck(aggregator, sim, [&] { for (MemorySource *source : held) source->finish(); }, seconds);
+
+    SiteAggregatorStats stats = aggregator.stats();
+    double rate = stats.records / seconds;
+    if (baseRate == 0) baseRate = rate;
+    printf("%8d %9llu %10llu %8.1f %9.1f %11.0f %11.0f %7.2fx %10llu  %s%s\n", scanners, (unsigned long long)sim.frames,
+        (unsigned long long)stats.records, bytes / 1e6, seconds * 1000, sim.frames / seconds, rate, rate / baseRate,
+        (unsigned long long)stats.queueFullWaits, ok ? "ok" : "FAIL", loseFrame ? "  (a frame lost per scanner)" : "");
+    return ok;
+}
+
+// Scanner 0 from a file, scanner 1 from a local socket, the rest in memory.
+// The file ends before the check, so scanner 0 must hear nothing by then.
+static bool sourcesRun() {
+    Simulation sim = simulate(4, 40);
+
+    char file[] = "/tmp/site_aggregatorXXXXXX";
+    int fd = mkstemp(file);
+    if (fd < 0 || write(fd, sim.streams[0].data(), sim.streams[0].size()) != (ssize_t)sim.streams[0].size()) return false;
+    close(fd);
+
+    std::string socketPath = std::string(file) + ".sock";
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listener, 1) < 0) return false;
+    std::atomic<bool> checked(false);
+    std::thread server([&] {
+        int client = accept(listener, NULL, NULL);
+        // Dribbled out like a scanner at 115200 baud would, in small pieces
+        const std::vector<uint8_t> &bytes = sim.streams[1];
+        for (size_t pos = 0; pos < bytes.size(); pos += 64) {
+            if (write(client, bytes.data() + pos, std::min((size_t)64, bytes.size() - pos)) < 0) break;
+        }
+        while (!checked.load()) usleep(1000);
+        close(client);
+    });
+
+    bool ok = true;
+    {
+        SiteAggregator aggregator(64);
+        std::string error;
+        std::unique_ptr<ByteSource> fromFile = openByteSource(std::string("file:") + file, error);
+        std::unique_ptr<ByteSource> fromSocket = openByteSource("unix:" + socketPath, error);
+        ok = fromFile && fromSocket;
+        if (ok) {
+            aggregator.addSource(std::move(fromFile));
+            aggregator.addSource(std::move(fromSocket));
+            std::vector<MemorySource *> held;
+            for (int s = 2; s < 4; s++) {
+                held.push_back(new MemorySource("sim" + std::to_string(s), sim.streams[s].data(),
+                    sim.streams[s].size(), 7, true));
+                aggregator.addSource(std::unique_ptr<ByteSource>(held.back()));
+            }
+            double seconds = 0;
+            ok = mergeAndCheck(aggregator, sim, [&] {
+                aggregator.view().print(stdout);
+                checked.store(true);
+                for (MemorySource *source : held) source->finish();
+            }, seconds);
+        } else {
+            printf("  %s\n", error.c_str());
+            checked.store(true);
+        }
+    }
+    server.join();
+    close(listener);
+    unlink(socketPath.c_str());
+    unlink(file);
+
+    printf("\n%-52s %s\n", "file + local socket + memory streams merged", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int frames = argc >= 2 ? atoi(argv[1]) : 100;
+    bool ok = true;
+
+    printf("%d networks over %.0f x %.0f m, %d frames per scanner, %u hardware threads\n\n", SITE_NETWORKS,
+        SITE_SIZE, SITE_SIZE, frames, std::thread::hardware_concurrency());
+    printf("%8s %9s %10s %8s %9s %11s %11s %8s %10s\n", "scanners", "frames", "records", "MB", "wall ms",
+        "frames/s", "records/s", "scaling", "full waits");
+    double baseRate = 0;
+    for (int scanners = 1; scanners <= 256; scanners *= 2) ok &= loadRun(scanners, frames, baseRate);
+    ok &= loadRun(16, frames, baseRate, true);
+
+    ok &= sourcesRun();
+
+    printf("\nsite aggregator checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/*
+ * Telemetry benchmark: bytes on the wire per scan for the text report and
+ * the binary frame, a round-trip check of the host decoder against the
+ * sketch's own snapshot and stats, and decoder throughput over many
+ * scanners' streams with injected line noise.
+ *
+ * Usage: bench_telemetry [scanners] [frames per scanner]
+ *
+ * Exits with 1 if a decoded frame does not match what the sketch sent.
+ */
+
+#include "sketch.h"
+#include "bench_harness.h"
+#include "scan_script.h"
+#include "telemetry/telemetry_decoder.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static double cpuMicrosNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void runCycle(const ScanCycle &cycle) {
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    int16_t status = Zigbee.scanComplete();
+    if (status > 0) printScannedNetworks(status);
+    mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+}
+
+// Average report bytes per scan in the given mode
+static double bytesPerScan(uint8_t mode, uint16_t networks, int cycles) {
+    ScanCycle cycle;
+    generateScanCycle(cycle, networks, 777);
+    initializeStats();
+    setReportMode(mode);
+
+    ByteCapturePrint capture;
+    Report.setOutput(capture);
+    for (int i = 0; i < cycles; i++) {
+        perturbScanCycle(cycle, 50 + i);
+        runCycle(cycle);
+    }
+    Report.setOutput(Serial);
+    setReportMode(REPORT_MODE_TEXT);
+    return (double)capture.bytes.size() / cycles;
+}
+
+static bool sameAsSketch(const TelemetryScan &scan) {
+    if (scan.networks.size() != currentScan.count || scan.channelMask != currentScan.channelMask) return false;
+    for (size_t i = 0; i < scan.networks.size(); i++) {
+        const TelemetryNetwork &n = scan.networks[i];
+        NetworkStats *stats = findNetworkStats(&networkTable, currentScan.panId[i], currentScan.extendedPanId[i]);
+        if (!stats) return false;
+        if (n.panId != currentScan.panId[i] || n.extendedPanId != currentScan.extendedPanId[i] ||
+            n.channel != currentScan.channel[i] || n.signal != currentScan.signal[i] ||
+            n.load != currentScan.load[i] ||
+            n.flags != currentScan.flags[i] || n.signalAvg != stats->avgSignalStrength ||
+            n.signalMin != stats->minSignalStrength || n.signalMax != stats->maxSignalStrength ||
+            n.signalP50 != signalStatsQuantile(&networkSeries(&networkTable, stats)->signal, 50) ||
+            n.uptime != networkUptime(stats) || n.beaconsExpected != stats->beaconsExpected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Decodes each frame right after the sketch wrote it, in REPORT_MODE_BOTH
+// so the decoder also has to skip the text around it
+static bool roundTrip(uint16_t networks, int cycles) {
+    ScanCycle cycle;
+    generateScanCycle(cycle, networks, 31337);
+    initializeStats();
+    setReportMode(REPORT_MODE_BOTH);
+
+    bool ok = true;
+    ByteCapturePrint capture;
+    TelemetryDecoder decoder([&](const TelemetryScan &scan) { ok = ok && sameAsSketch(scan); });
+    Report.setOutput(capture);
+    for (int i = 0; i < cycles; i++) {
+        perturbScanCycle(cycle, 900 + i);
+        runCycle(cycle);
+        decoder.feed(capture.bytes.data(), capture.bytes.size());
+        capture.bytes.clear();
+    }
+    Report.setOutput(Serial);
+    setReportMode(REPORT_MODE_TEXT);
+    return ok && decoder.stats().frames == (uint64_t)cycles && decoder.stats().crcErrors == 0;
+}
+
+// Binary stream of one scanner
+static std::vector<uint8_t> recordStream(uint16_t networks, int frames, uint32_t seed) {
+    ScanCycle cycle;
+    generateScanCycle(cycle, networks, seed);
+    initializeStats();
+    setReportMode(REPORT_MODE_BINARY);
+
+    ByteCapturePrint capture;
+    Report.setOutput(capture);
+    for (int i = 0; i < frames; i++) {
+        perturbScanCycle(cycle, seed + i);
+        runCycle(cycle);
+    }
+    Report.setOutput(Serial);
+    setReportMode(REPORT_MODE_TEXT);
+    return capture.bytes;
+}
+
+int main(int argc, char **argv) {
+    int scanners = argc >= 2 ? atoi(argv[1]) : 64;
+    int frames = argc >= 3 ? atoi(argv[2]) : 200;
+
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    bool crcOk = telemetryCrc16(TELEMETRY_CRC_INIT, check, sizeof(check)) == 0x29B1;
+
+    printf("%8s %12s %14s %7s\n", "networks", "text B/scan", "binary B/scan", "ratio");
+    const uint16_t sizes[] = { 1, 10, 50 };
+    for (uint16_t networks : sizes) {
+        double text = bytesPerScan(REPORT_MODE_TEXT, networks, 20);
+        double binary = bytesPerScan(REPORT_MODE_BINARY, networks, 20);
+        printf("%8u %12.0f %14.0f %6.1fx\n", networks, text, binary, text / binary);
+    }
+
+    bool decodeOk = crcOk && roundTrip(10, 50) && roundTrip(50, 10);
+    printf("\nround trip (crc check value, frames vs sketch state): %s\n\n", decodeOk ? "ok" : "FAILED");
+
+    // Every scanner's stream, with one flipped byte per 16 frames
+    std::vector<std::vector<uint8_t>> streams;
+    uint64_t streamBytes = 0;
+    uint32_t noise = 99;
+    int corrupted = 0;
+    std::vector<uint8_t> base = recordStream(10, frames, 4000);
+    for (int s = 0; s < scanners; s++) {
+        std::vector<uint8_t> stream = base;
+        size_t frameBytes = stream.size() / frames;
+        for (int f = s % 16; f < frames; f += 16) {
+            noise = noise * 1103515245u + 12345u;
+            stream[f * frameBytes + (noise >> 8) % frameBytes] ^= 0x40;
+            corrupted++;
+        }
+        streamBytes += stream.size();
+        streams.push_back(stream);
+    }
+
+    uint64_t decoded = 0;
+    uint64_t dropped = 0;
+    double start = cpuMicrosNow();
+    for (const std::vector<uint8_t> &stream : streams) {
+        uint64_t networks = 0;
+        TelemetryDecoder decoder([&](const TelemetryScan &scan) { networks += scan.networks.size(); });
+        // Serial reads come in small chunks
+        for (size_t pos = 0; pos < stream.size(); pos += 64) {
+            decoder.feed(stream.data() + pos, min((size_t)64, stream.size() - pos));
+        }
+        decoded += decoder.stats().frames;
+        dropped += decoder.stats().sequenceGaps;
+    }
+    double seconds = (cpuMicrosNow() - start) / 1e6;
+
+    printf("decoder: %d scanners x %d frames of 10 networks, %d corrupted\n", scanners, frames, corrupted);
+    printf("  %.1f MB/s, %.0f frames/s, %llu frames decoded, %llu lost to corruption\n",
+        streamBytes / seconds / 1e6, decoded / seconds,
+        (unsigned long long)decoded, (unsigned long long)dropped);
+
+    return decodeOk ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/*
+ * Threshold sweep benchmark: replays a synthetic recording through the
+ * analysis once per threshold set on a pool of threads, each thread a
+ * scanner of its own (replay/threshold_sweep.h).
+ *
+ * Checks: the results are the same on one thread and on many, and the same
+ * as replaying a set on the main thread; the main thread's scanner is left
+ * alone by the workers, while the mock's heap counters see their
+ * allocations; the loss, signal and load alerts move the right way
+ * as their threshold rises; the alert bits agree with the diagnosis text.
+ *
+ * Throughput: threshold sets per second on 1-8 threads. Whether it scales
+ * is only checked with two or more cores.
+ *
+ * Usage: bench_threshold_sweep [networks] [scans]
+ *
+ * Exits with 1 if a check fails.
+ */
+
+#include "replay/threshold_sweep.h"
+#include "bench_harness.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+static bool sameResults(const std::vector<SweepResult> &a, const std::vector<SweepResult> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (memcmp(&a[i], &b[i], sizeof(SweepResult)) != 0) return false;
+    }
+    return true;
+}
+
+static std::vector<AnalysisThresholds> sweepOf(uint8_t AnalysisThresholds::*field, int from, int to, int step) {
+    std::vector<AnalysisThresholds> sets;
+    for (int v = from; v <= to; v += step) {
+        AnalysisThresholds t = DEFAULT_ANALYSIS_THRESHOLDS;
+        t.*field = (uint8_t)v;
+        if (field == &AnalysisThresholds::lossWarning) t.lossCritical = 100;
+        sets.push_back(t);
+    }
+    return sets;
+}
+
+static bool nonIncreasing(const std::vector<SweepResult> &results, uint8_t bits) {
+    uint64_t last = UINT64_MAX;
+    for (const SweepResult &r : results) {
+        uint64_t active = 0;
+        for (int k = 0; k < NETWORK_ALERT_KINDS; k++) {
+            if (bits & (1 << k)) active += r.active[k];
+        }
+        if (active > last) return false;
+        last = active;
+    }
+    return true;
+}
+
+static void correctness(const ScanArchive &archive, unsigned threads) {
+    std::vector<AnalysisThresholds> sets;
+    for (uint8_t warning : { 5, 10, 20 }) {
+        for (uint8_t trend : { 3, 5, 8 }) {
+            for (uint8_t weak : { 0x30, 0x50 }) {
+                AnalysisThresholds t = DEFAULT_ANALYSIS_THRESHOLDS;
+                t.lossWarning = warning;
+                t.lossCritical = warning + 10;
+                t.trendDelta = trend;
+                t.weakSignal = weak;
+                sets.push_back(t);
+            }
+        }
+    }
+    std::vector<SweepResult> one, many;
+    sweepThresholds(archive, sets, 1, one);
+    uint64_t allocations = mockHeapAllocations();
+    sweepThresholds(archive, sets, threads, many);
+    // Every replay allocates its alert tracks on its worker
+    check(mockHeapAllocations() - allocations >= sets.size(), "the heap counters see the workers' allocations");
+    check(sameResults(one, many), "the results do not depend on the number of threads");
+    check(networkTable.count == 0 && currentScan.count == 0, "the workers leave the main thread's scanner alone");
+
+    SweepResult local = replayArchive(archive, sets[7]);
+    check(memcmp(&local, &one[7], sizeof(local)) == 0, "a set replays the same on the main thread");
+    SweepResult again = replayArchive(archive, sets[7]);
+    check(memcmp(&local, &again, sizeof(local)) == 0, "a replay does not depend on the one before");
+
+    const SweepResult &d = one[2];
+    printf("lossWarning %u: %llu sightings, raised weak %llu falling %llu shift %llu loss %llu/%llu load %llu "
+        "crowded %llu, %llu flaps\n", sets[2].lossWarning, (unsigned long long)d.sightings,
+        (unsigned long long)d.raised[0], (unsigned long long)d.raised[1], (unsigned long long)d.raised[2],
+        (unsigned long long)d.raised[3], (unsigned long long)d.raised[4], (unsigned long long)d.raised[5],
+        (unsigned long long)d.raised[6], (unsigned long long)sweepTotal(d.flaps));
+    check(d.sightings == archive.records.size(), "every recorded sighting is analysed");
+    check(sweepTotal(d.raised) > 0 && sweepTotal(d.flaps) > 0, "the recording raises and flaps alerts");
+
+    std::vector<SweepResult> results;
+    sweepThresholds(archive, sweepOf(&AnalysisThresholds::lossWarning, 0, 40, 5), threads, results);
+    check(nonIncreasing(results, NETWORK_ALERT_LOSS | NETWORK_ALERT_HIGH_LOSS) &&
+        results.front().active[3] > results.back().active[3], "fewer loss alerts as lossWarning rises");
+    sweepThresholds(archive, sweepOf(&AnalysisThresholds::highLoad, 50, 100, 10), threads, results);
+    check(nonIncreasing(results, NETWORK_ALERT_HIGH_LOAD) && results.back().active[5] == 0,
+        "fewer load alerts as highLoad rises");
+    std::vector<AnalysisThresholds> weak = sweepOf(&AnalysisThresholds::weakSignal, 0, 0x80, 0x20);
+    std::reverse(weak.begin(), weak.end());
+    sweepThresholds(archive, weak, threads, results);
+    check(nonIncreasing(results, NETWORK_ALERT_WEAK_SIGNAL) && results.back().active[0] == 0,
+        "fewer weak signal alerts as weakSignal falls");
+    sweepThresholds(archive, sweepOf(&AnalysisThresholds::trendDelta, 1, 15, 2), threads, results);
+    check(nonIncreasing(results, NETWORK_ALERT_FALLING), "fewer falling trends as trendDelta rises");
+
+    // The bits against the diagnosis of the last scan replayed here
+    replayArchive(archive, sets[0]);
+    bool agree = true;
+    for (uint16_t i = 0; i < currentScan.count; i++) {
+        if (!scanStats[i]) continue;
+        CapturePrint text;
+        getNetworkAnalysis(scanStats[i], text);
+        uint8_t alerts = networkAlerts(&currentScan, i, scanStats[i]);
+        agree &= ((alerts & NETWORK_ALERT_HIGH_LOSS) != 0) == (text.text.find("High beacon loss") != std::string::npos);
+        agree &= ((alerts & NETWORK_ALERT_LOSS) != 0) == (text.text.find("Moderate beacon loss") != std::string::npos);
+        agree &= ((alerts & NETWORK_ALERT_SIGNAL_SHIFT) != 0) == (text.text.find("Signal level changed") != std::string::npos);
+    }
+    check(agree, "the alert bits agree with the diagnosis");
+    analysisThresholds = DEFAULT_ANALYSIS_THRESHOLDS;
+}
+
+static void throughput(const ScanArchive &archive) {
+    std::vector<AnalysisThresholds> sets;
+    for (uint8_t warning = 5; warning <= 20; warning += 5) {
+        for (uint8_t trend = 3; trend <= 9; trend += 2) {
+            AnalysisThresholds t = DEFAULT_ANALYSIS_THRESHOLDS;
+            t.lossWarning = warning;
+            t.lossCritical = warning + 10;
+            t.trendDelta = trend;
+            sets.push_back(t);
+        }
+    }
+    unsigned cores = std::thread::hardware_concurrency();
+    printf("\n%zu threshold sets, %u cores:\n", sets.size(), cores);
+    double single = 0, best = 0;
+    for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+        std::vector<SweepResult> results;
+        auto start = std::chrono::steady_clock::now();
+        sweepThresholds(archive, sets, threads, results);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rate = sets.size() / seconds;
+        if (threads == 1) single = rate;
+        if (threads <= cores && rate > best) best = rate;
+        printf("  %u threads  %8.1f sets/s  %5.2fx\n", threads, rate, rate / single);
+    }
+    if (cores >= 2) {
+        check(best >= single * 1.5, "the sweep scales with cores");
+    } else {
+        printf("  one core: scaling not checked\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    int networks = argc >= 2 ? atoi(argv[1]) : 60;
+    int scans = argc >= 3 ? atoi(argv[2]) : 2000;
+    ScanArchive archive;
+    generateArchive(archive, (uint16_t)networks, (uint32_t)scans, 2525);
+    printf("%d networks, %zu scans, %zu sightings\n", networks, archive.scans.size(), archive.records.size());
+
+    correctness(archive, 4);
+    throughput(archive);
+
+    return checkResult();
+}
@@ -0,0 +1,105 @@
+#include "history_log_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+HistoryLogReader::HistoryLogReader() : data(NULL), size(0), mapped(false), torn(0) {}
+
+HistoryLogReader::~HistoryLogReader() {
+    close();
+}
+
+bool HistoryLogReader::open(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < HISTORY_LOG_SECTOR_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    data = (const uint8_t *)map;
+    size = (size_t)st.st_size;
+    mapped = true;
+    return index();
+}
+
+bool HistoryLogReader::open(const uint8_t *image, size_t imageSize) {
+    close();
+    data = image;
+    size = imageSize;
+    return index();
+}
+
+void HistoryLogReader::close() {
+    if (mapped) munmap((void *)data, size);
+    data = NULL;
+    size = 0;
+    mapped = false;
+    order.clear();
+    torn = 0;
+}
+
+// Keeps the run of consecutive sequences ending at the newest sector, the
+// same rule the sketch applies on boot
+bool HistoryLogReader::index() {
+    std::vector<Sector> found;
+    for (size_t offset = 0; offset + HISTORY_LOG_SECTOR_SIZE <= size; offset += HISTORY_LOG_SECTOR_SIZE) {
+        Sector sector = { (uint32_t)offset, 0, 0 };
+        if (historyLogParseSectorHeader(data + offset, &sector.sequence, &sector.baseTime)) found.push_back(sector);
+    }
+    if (found.empty()) return true;
+
+    std::sort(found.begin(), found.end(), [](const Sector &a, const Sector &b) { return a.sequence < b.sequence; });
+    size_t start = found.size() - 1;
+    while (start > 0 && found[start - 1].sequence == found[start].sequence - 1) start--;
+    order.assign(found.begin() + start, found.end());
+    return true;
+}
+
+uint32_t HistoryLogReader::oldestTime() const {
+    return order.empty() ? 0 : order.front().baseTime;
+}
+
+uint32_t HistoryLogReader::newestTime() const {
+    if (order.empty()) return 0;
+    uint32_t newest = order.back().baseTime;
+    read(newest, UINT32_MAX, [&](const HistoryLogBlock &block, const HistoryLogRecord *) { newest = block.time; });
+    return newest;
+}
+
+uint64_t HistoryLogReader::read(uint32_t from, uint32_t to, const BlockHandler &onBlock) const {
+    // Last sector starting at or before from: earlier ones end before it
+    auto first = std::upper_bound(order.begin(), order.end(), from,
+        [](uint32_t time, const Sector &sector) { return time < sector.baseTime; });
+    if (first != order.begin()) --first;
+
+    HistoryLogCursor cursor;
+    HistoryLogBlock info;
+    HistoryLogRecord records[HISTORY_LOG_MAX_RECORDS];
+    uint64_t visited = 0;
+    for (auto sector = first; sector != order.end(); ++sector) {
+        if (sector->baseTime > to) break;
+        const uint8_t *p = data + sector->offset + HISTORY_LOG_SECTOR_HEADER_SIZE;
+        const uint8_t *end = data + sector->offset + HISTORY_LOG_SECTOR_SIZE;
+        historyLogResetCursor(&cursor, sector->baseTime);
+
+        size_t blockSize;
+        while ((blockSize = historyLogCheckBlock(p, end - p)) > 0) {
+            if (!historyLogDecodeBlock(&cursor, p, &info, records)) break;
+            p += blockSize;
+            visited++;
+            if (info.time > to) return visited;
+            if (info.time >= from) onBlock(info, records);
+        }
+        if (p + 2 <= end && historyLogGet16(p) != HISTORY_LOG_UNWRITTEN) torn++;
+    }
+    return visited;
+}
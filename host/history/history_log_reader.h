@@ -0,0 +1,58 @@
+#ifndef ZIGBEE_SCANNER_HISTORY_LOG_READER_H
+#define ZIGBEE_SCANNER_HISTORY_LOG_READER_H
+
+/*
+ * Reader for a raw image of the scanner's history log partition (see
+ * block_history_log_format.h), e.g. read back with
+ *   esptool.py read_flash <spiffs offset> <spiffs size> history.bin
+ *
+ * The image is memory-mapped, the sector index is built from the sector
+ * headers on open, and a time range is found by binary search over it, so
+ * only the sectors holding the range are decoded. Independent of the
+ * Arduino mock.
+ */
+
+#include "../../zigbee_scanner/block_history_log_format.h"
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+class HistoryLogReader {
+public:
+    // Called per block in time order; records is empty for boot blocks
+    typedef std::function<void(const HistoryLogBlock &, const HistoryLogRecord *records)> BlockHandler;
+
+    HistoryLogReader();
+    ~HistoryLogReader();
+
+    bool open(const char *path);
+    // Reads an image already in memory (not copied, must outlive the reader)
+    bool open(const uint8_t *image, size_t size);
+    void close();
+
+    // Blocks with from <= time <= to. Returns the blocks visited.
+    uint64_t read(uint32_t from, uint32_t to, const BlockHandler &onBlock) const;
+
+    size_t sectors() const { return order.size(); }
+    uint32_t oldestTime() const;
+    uint32_t newestTime() const;
+    uint64_t tornSectors() const { return torn; }
+
+private:
+    struct Sector {
+        uint32_t offset;
+        uint32_t sequence;
+        uint32_t baseTime;
+    };
+
+    bool index();
+
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+    std::vector<Sector> order;        // the log's sectors, oldest first
+    mutable uint64_t torn;
+};
+
+#endif // ZIGBEE_SCANNER_HISTORY_LOG_READER_H
@@ -0,0 +1,194 @@
+#ifndef ZIGBEE_SCANNER_MOCK_ARDUINO_H
+#define ZIGBEE_SCANNER_MOCK_ARDUINO_H
+
+/*
+ * Host stand-in for the parts of the ESP32 Arduino core used by the sketch.
+ *
+ * Only what the scanner touches is provided: Print/String, Serial (input
+ * queued with mockInput()), ESP, millis()/delay() on a virtual clock and a
+ * deterministic random(). Flash partitions are in esp_partition.h.
+ * Heap allocations made through operator new are counted so the host
+ * benchmarks can report allocations per scan cycle.
+ *
+ * Built with SCANNER_INSTANCE thread_local (as the sketch then is), the
+ * mock's state is per thread, so every thread runs its own scanner. The heap
+ * counters are not: they count every thread's allocations.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+// Storage of the mock's state, see block_definitions.h
+#ifndef SCANNER_INSTANCE
+#define SCANNER_INSTANCE
+#endif
+
+using std::min;
+using std::max;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define DEC 10
+#define HEX 16
+
+// Time (virtual clock, advanced by delay() or mockAdvanceMillis())
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// Random numbers (deterministic LCG so host runs are reproducible)
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class String {
+public:
+    String(const char *cstr = "");
+    String(const String &str);
+    String(String &&str);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimalPlaces = 2);
+    explicit String(double value, unsigned int decimalPlaces = 2);
+    ~String();
+
+    String &operator=(const String &rhs);
+    String &operator=(String &&rhs);
+    String &operator=(const char *cstr);
+
+    bool reserve(unsigned int size);
+    bool concat(const char *cstr, unsigned int length);
+    bool concat(const char *cstr) { return concat(cstr, cstr ? strlen(cstr) : 0); }
+    bool concat(const String &str) { return concat(str.buffer, str.len); }
+    String &operator+=(const String &rhs) { concat(rhs); return *this; }
+    String &operator+=(const char *cstr) { concat(cstr); return *this; }
+    String &operator+=(char c) { concat(&c, 1); return *this; }
+
+    unsigned int length() const { return len; }
+    const char *c_str() const { return buffer ? buffer : ""; }
+    bool operator==(const String &rhs) const { return strcmp(c_str(), rhs.c_str()) == 0; }
+    bool operator==(const char *cstr) const { return strcmp(c_str(), cstr) == 0; }
+    bool operator!=(const String &rhs) const { return !(*this == rhs); }
+    char operator[](unsigned int index) const { return index < len ? buffer[index] : 0; }
+
+private:
+    char *buffer;
+    unsigned int capacity;
+    unsigned int len;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+    // Same behaviour as the ESP32 core: formats into a 64 byte stack buffer
+    // and falls back to a heap buffer for longer output.
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const char *str) { return write(str); }
+    size_t print(const String &str) { return write(str.c_str(), str.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T &value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(const T &value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+// Serial port: counts every byte, optionally echoes to stdout.
+// With mockSetTxFifo() the port drains at the configured baud rate and a
+// write into a full FIFO blocks, advancing the virtual clock like the real
+// driver would stall the caller.
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long baud) { baudRate = baud; }
+    void end() {}
+    operator bool() const { return true; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int availableForWrite() override;
+    int available() { return (int)(rxData.size() - rxPos); }
+    int read() { return rxPos < rxData.size() ? (uint8_t)rxData[rxPos++] : -1; }
+
+    using Print::write;
+
+    // Mock controls
+    void mockSetEcho(bool enabled) { echo = enabled; }
+    void mockInput(const char *text) { rxData.erase(0, rxPos); rxPos = 0; rxData += text; }
+    void mockSetTxFifo(size_t bytes) { txFifo = bytes; txLevel = 0; txUpdatedAt = micros(); }
+    uint64_t mockBytesWritten() const { return bytesWritten; }
+    uint64_t mockStallMicros() const { return stallMicros; }
+    size_t mockTxLevel() { updateTxLevel(); return (size_t)txLevel; }
+
+private:
+    void updateTxLevel();
+
+    unsigned long baudRate = 115200;
+    bool echo = false;
+    uint64_t bytesWritten = 0;
+    size_t txFifo = 0;                 // 0: port takes everything at once
+    double txLevel = 0;
+    unsigned long txUpdatedAt = 0;
+    uint64_t stallMicros = 0;
+    std::string rxData;                // queued by mockInput(), read() from rxPos
+    size_t rxPos = 0;
+};
+
+extern SCANNER_INSTANCE HardwareSerial Serial;
+
+class EspClass {
+public:
+    void restart();
+    uint32_t getFreeHeap();
+    uint32_t getMaxAllocHeap();
+    // 160 MHz cycles of virtual time plus host time (monotonic clock, cheap
+    // enough to time short phases), so both waits and host work show up
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 160; }
+};
+
+extern SCANNER_INSTANCE EspClass ESP;
+
+// FreeRTOS: stack bytes the calling task never used
+unsigned int uxTaskGetStackHighWaterMark(void *task);
+
+// Mock controls shared by the host tools
+void mockAdvanceMillis(unsigned long ms);
+void mockSetMillis(unsigned long ms);
+// Charges host CPU time to the virtual clock, factor times slower (0: off)
+void mockSetCpuSlowdown(uint32_t factor);
+// Allocations through operator new by all threads since the start
+uint64_t mockHeapAllocations();
+uint64_t mockHeapBytes();
+void mockSetHeap(uint32_t freeBytes, uint32_t largestBlock);
+void mockSetStackHeadroom(uint32_t bytes);
+
+#endif // ZIGBEE_SCANNER_MOCK_ARDUINO_H
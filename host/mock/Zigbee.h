@@ -0,0 +1,176 @@
+#ifndef ZIGBEE_SCANNER_MOCK_ZIGBEE_H
+#define ZIGBEE_SCANNER_MOCK_ZIGBEE_H
+
+/*
+ * Host stand-in for the Zigbee library of the ESP32 Arduino core.
+ *
+ * zigbee_scan_result_t keeps the exact layout of esp_zb_network_descriptor_t
+ * so the sketch's raw byte decoding behaves as on the target. Scans take
+ * virtual time like the real active scan and return whatever the host tool
+ * queued with mockSetScanResults().
+ *
+ * Energy detect goes through the same ZDO call as on the target. Readings
+ * come from a synthetic 2.4 GHz band: a noise floor plus the interferers
+ * added with mockAddInterferer(), each channel measured over its own slice
+ * of virtual time. The callback runs from inside the request.
+ *
+ * Beacon loss can be injected per PAN: a network then misses a share of the
+ * scans of its channel, or a run of them, and the mock counts what it
+ * dropped so estimators can be checked against it.
+ */
+
+#include "Arduino.h"
+
+#include <vector>
+
+typedef uint8_t esp_zb_ieee_addr_t[8];
+
+typedef struct esp_zb_network_descriptor_s {
+    uint16_t short_pan_id;
+    bool permit_joining;
+    esp_zb_ieee_addr_t extended_pan_id;
+    uint8_t logic_channel;
+    bool router_capacity;
+    bool end_device_capacity;
+} esp_zb_network_descriptor_t;
+
+typedef esp_zb_network_descriptor_t zigbee_scan_result_t;
+
+typedef enum {
+    ZIGBEE_COORDINATOR = 0,
+    ZIGBEE_ROUTER = 1,
+    ZIGBEE_END_DEVICE = 2,
+} zigbee_role_t;
+
+#define ZB_SCAN_RUNNING (-1)
+#define ZB_SCAN_FAILED  (-2)
+
+#define ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK 0x07FFF800U
+
+// Energy detect request, declared as in esp_zigbee_zdo_command.h of the
+// ESP-Zigbee-SDK; the callback runs with the stack lock held, as there
+typedef enum {
+    ESP_ZB_ZDP_STATUS_SUCCESS = 0x00,
+    ESP_ZB_ZDP_STATUS_TIMEOUT = 0x85,
+} esp_zb_zdp_status_t;
+
+typedef struct esp_zb_energy_detect_channel_info_s {
+    uint16_t channel_nbr;
+    int8_t energy_detected;            // dBm
+} esp_zb_energy_detect_channel_info_t;
+
+typedef struct esp_zb_zdo_energy_detect_req_s {
+    uint32_t channel_mask;
+    uint8_t duration;                  // 2^n + 1 superframes per channel
+} esp_zb_zdo_energy_detect_req_t;
+
+typedef void (*esp_zb_zdo_energy_detect_callback_t)(esp_zb_zdp_status_t status, uint16_t count,
+                                                    esp_zb_energy_detect_channel_info_t *channel_info,
+                                                    void *user_ctx);
+
+void esp_zb_zdo_energy_detect_request(esp_zb_zdo_energy_detect_req_t *cmd_req,
+                                      esp_zb_zdo_energy_detect_callback_t user_cb, void *user_ctx);
+
+// Stack lock (FreeRTOS ticks)
+typedef uint32_t TickType_t;
+#ifndef portMAX_DELAY
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#endif
+bool esp_zb_lock_acquire(TickType_t block_ticks);
+void esp_zb_lock_release();
+
+// Synthetic interferers for energy detect
+#define MOCK_RF_WIFI     0   // 20 MHz OFDM, traffic bursts of about periodMs
+#define MOCK_RF_BLE      1   // 2 MHz hops over the 40 channels, one per periodMs
+#define MOCK_RF_CONSTANT 2   // always on (carrier, video sender, microwave oven)
+
+struct MockInterferer {
+    uint8_t kind;                      // MOCK_RF_*
+    uint16_t centerMHz;                // WiFi and constant sources
+    uint8_t widthMHz;
+    int8_t powerDbm;                   // at the scanner
+    uint8_t dutyPercent;               // WiFi: share of time on air
+    uint16_t periodMs;                 // WiFi: burst cycle, BLE: time between hops
+};
+
+void mockAddInterferer(const MockInterferer &source);
+void mockClearInterferers();
+// Energy detect statistics: requests, channels measured, radio time
+uint32_t mockEnergyDetectRequests();
+uint32_t mockEnergyDetectSamples();
+unsigned long mockEnergyDetectAirtimeMs();
+// Fail the next request with a timeout status
+void mockFailNextEnergyDetect();
+
+// What the mock did with one PAN's beacons. Drops before its first answer
+// are not counted, the scanner cannot know about those.
+struct MockBeaconCounts {
+    uint32_t answered;
+    uint32_t dropped;
+    uint16_t longestDropRun;
+};
+
+class ZigbeeCore {
+public:
+    bool begin(zigbee_role_t role = ZIGBEE_END_DEVICE, bool erase_nvs = false);
+    bool started() const { return isStarted; }
+
+    void scanNetworks(uint32_t channel_mask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, uint8_t scan_duration = 5);
+    int16_t scanComplete();
+    zigbee_scan_result_t *getScanResult();
+    void scanDelete();
+
+    // Mock controls
+    void mockSetScanResults(const zigbee_scan_result_t *results, uint16_t count);
+    void mockFailNextScan() { failNextScan = true; }
+    // Extra 0..ms the stack takes beyond the nominal scan time
+    void mockSetScanOverheadMs(unsigned long ms) { overheadMax = ms; }
+    uint32_t mockScanCount() const { return scansStarted; }
+    uint32_t mockLastChannelMask() const { return lastChannelMask; }
+    unsigned long mockScanDurationMs(uint32_t channel_mask, uint8_t scan_duration) const;
+    // Time from the scan actually finishing to the first scanComplete() that saw it
+    unsigned long mockLastCompletionLatencyMs() const { return completionLatency; }
+    uint32_t mockCompletedScans() const { return scansCompleted; }
+    // Radio time spent in scans so far (nominal scan time per started scan)
+    unsigned long mockScanAirtimeMs() const { return airtime; }
+    // The PAN's beacon is lost from percent of the scans of its channel
+    void mockSetBeaconLoss(uint16_t panId, uint8_t percent);
+    // The PAN misses the next scans of its channel
+    void mockMissScans(uint16_t panId, uint16_t scans);
+    void mockClearBeaconLoss() { beaconLoss.clear(); }
+    MockBeaconCounts mockBeaconCounts(uint16_t panId) const;
+
+private:
+    bool isStarted = false;
+    bool scanning = false;
+    bool failNextScan = false;
+    bool scanFailed = false;
+    bool resultReady = false;
+    unsigned long scanStartedAt = 0;
+    unsigned long scanLength = 0;
+    uint32_t scansStarted = 0;
+    uint32_t scansCompleted = 0;
+    unsigned long completionLatency = 0;
+    unsigned long airtime = 0;
+    unsigned long overheadMax = 0;
+    uint32_t overheadState = 12345;
+    uint32_t lastChannelMask = 0;
+    std::vector<zigbee_scan_result_t> queued;
+    std::vector<zigbee_scan_result_t> results;
+
+    struct BeaconLoss {
+        uint16_t panId;
+        uint8_t percent;
+        uint16_t missNext;
+        uint16_t dropRun;
+        MockBeaconCounts counts;
+    };
+    std::vector<BeaconLoss> beaconLoss;
+    uint32_t lossState = 4321;
+    BeaconLoss *findBeaconLoss(uint16_t panId);
+    bool beaconLost(uint16_t panId);
+};
+
+extern SCANNER_INSTANCE ZigbeeCore Zigbee;
+
+#endif // ZIGBEE_SCANNER_MOCK_ZIGBEE_H
@@ -0,0 +1,58 @@
+#ifndef ZIGBEE_SCANNER_MOCK_ESP_PARTITION_H
+#define ZIGBEE_SCANNER_MOCK_ESP_PARTITION_H
+
+/*
+ * Host stand-in for the ESP-IDF partition API, over an in-memory flash image
+ * with NOR semantics: erase sets bytes to 0xFF, writes can only clear bits.
+ * Host tools create partitions with mockPartitionCreate() and can save the
+ * image to a file for the host-side readers.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+// Mock controls. One partition at a time; creating another replaces it.
+void mockPartitionCreate(const char *label, uint32_t size);
+void mockPartitionRemove();
+bool mockPartitionSave(const char *path);
+uint8_t *mockPartitionData();
+uint64_t mockPartitionBytesWritten();
+uint32_t mockPartitionErases();
+uint32_t mockPartitionMaxSectorErases();
+uint32_t mockPartitionMinSectorErases();
+// The next write stops after bytes, like a power loss in the middle of it
+void mockPartitionTearNextWrite(size_t bytes);
+
+#endif // ZIGBEE_SCANNER_MOCK_ESP_PARTITION_H
@@ -0,0 +1,480 @@
+#include "Arduino.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+SCANNER_INSTANCE HardwareSerial Serial;
+SCANNER_INSTANCE EspClass ESP;
+
+static SCANNER_INSTANCE uint64_t virtualMicros = 0;
+static SCANNER_INSTANCE uint32_t randomState = 1;
+// Heap counters are for the whole process, whatever SCANNER_INSTANCE is:
+// operator new is global, and a bench counting a sweep must see its workers
+static std::atomic<uint64_t> heapAllocations(0);
+static std::atomic<uint64_t> heapBytes(0);
+
+// Time
+
+// With a CPU slowdown, host CPU time spent between two clock reads is
+// charged to the virtual clock, scaled to a slower target
+static SCANNER_INSTANCE uint32_t cpuSlowdown = 0;
+static SCANNER_INSTANCE uint64_t cpuChargedNanos = 0;
+static SCANNER_INSTANCE uint64_t cpuPendingNanos = 0;
+
+static uint64_t threadCpuNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void chargeCpuTime() {
+    if (!cpuSlowdown) return;
+    uint64_t now = threadCpuNanos();
+    cpuPendingNanos += (now - cpuChargedNanos) * cpuSlowdown;
+    cpuChargedNanos = now;
+    virtualMicros += cpuPendingNanos / 1000;
+    cpuPendingNanos %= 1000;
+}
+
+unsigned long millis() {
+    chargeCpuTime();
+    return (unsigned long)(virtualMicros / 1000);
+}
+
+unsigned long micros() {
+    chargeCpuTime();
+    return (unsigned long)virtualMicros;
+}
+
+void delay(uint32_t ms) {
+    chargeCpuTime();
+    virtualMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(uint32_t us) {
+    chargeCpuTime();
+    virtualMicros += us;
+}
+
+void yield() {
+}
+
+void mockAdvanceMillis(unsigned long ms) {
+    virtualMicros += (uint64_t)ms * 1000;
+}
+
+void mockSetMillis(unsigned long ms) {
+    virtualMicros = (uint64_t)ms * 1000;
+}
+
+void mockSetCpuSlowdown(uint32_t factor) {
+    cpuSlowdown = factor;
+    cpuChargedNanos = threadCpuNanos();
+    cpuPendingNanos = 0;
+}
+
+// Random numbers
+
+void randomSeed(unsigned long seed) {
+    randomState = seed ? (uint32_t)seed : 1;
+}
+
+long random(long howbig) {
+    if (howbig <= 0) return 0;
+    randomState = randomState * 1103515245u + 12345u;
+    return (long)((randomState >> 8) % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) return howsmall;
+    return random(howbig - howsmall) + howsmall;
+}
+
+// Heap accounting. Every form of new is counted and every form of delete
+// frees what its new gave, so sanitizers see matching pairs.
+
+static void *countedAlloc(size_t size, size_t alignment) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    heapBytes.fetch_add(size, std::memory_order_relaxed);
+    if (alignment <= alignof(std::max_align_t)) return malloc(size ? size : 1);
+    void *p = nullptr;
+    return posix_memalign(&p, alignment, size ? size : 1) == 0 ? p : nullptr;
+}
+
+void *operator new(size_t size) {
+    void *p = countedAlloc(size, 0);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, 0);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, 0);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    void *p = countedAlloc(size, (size_t)alignment);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, (size_t)alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return countedAlloc(size, (size_t)alignment);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+    free(p);
+}
+
+uint64_t mockHeapAllocations() {
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t mockHeapBytes() {
+    return heapBytes.load(std::memory_order_relaxed);
+}
+
+// String
+
+String::String(const char *cstr) : buffer(nullptr), capacity(0), len(0) {
+    concat(cstr);
+}
+
+String::String(const String &str) : buffer(nullptr), capacity(0), len(0) {
+    concat(str);
+}
+
+String::String(String &&str) : buffer(str.buffer), capacity(str.capacity), len(str.len) {
+    str.buffer = nullptr;
+    str.capacity = 0;
+    str.len = 0;
+}
+
+String::String(char c) : buffer(nullptr), capacity(0), len(0) {
+    concat(&c, 1);
+}
+
+static void formatInteger(char *out, size_t size, unsigned long value, bool negative, unsigned char base) {
+    char tmp[34];
+    int pos = 0;
+    if (base < 2) base = 10;
+    do {
+        unsigned long digit = value % base;
+        tmp[pos++] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value && pos < (int)sizeof(tmp) - 1);
+    size_t n = 0;
+    if (negative && n + 1 < size) out[n++] = '-';
+    while (pos > 0 && n + 1 < size) out[n++] = tmp[--pos];
+    out[n] = 0;
+}
+
+String::String(unsigned char value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char tmp[40];
+    formatInteger(tmp, sizeof(tmp), value, false, base);
+    concat(tmp);
+}
+
+String::String(int value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char tmp[40];
+    bool negative = value < 0 && base == 10;
+    formatInteger(tmp, sizeof(tmp), negative ? -(long)value : (unsigned int)value, negative, base);
+    concat(tmp);
+}
+
+String::String(unsigned int value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char tmp[40];
+    formatInteger(tmp, sizeof(tmp), value, false, base);
+    concat(tmp);
+}
+
+String::String(long value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char tmp[40];
+    bool negative = value < 0 && base == 10;
+    formatInteger(tmp, sizeof(tmp), negative ? -(unsigned long)value : (unsigned long)value, negative, base);
+    concat(tmp);
+}
+
+String::String(unsigned long value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char tmp[40];
+    formatInteger(tmp, sizeof(tmp), value, false, base);
+    concat(tmp);
+}
+
+String::String(float value, unsigned int decimalPlaces) : buffer(nullptr), capacity(0), len(0) {
+    char tmp[40];
+    snprintf(tmp, sizeof(tmp), "%.*f", (int)decimalPlaces, (double)value);
+    concat(tmp);
+}
+
+String::String(double value, unsigned int decimalPlaces) : buffer(nullptr), capacity(0), len(0) {
+    char tmp[40];
+    snprintf(tmp, sizeof(tmp), "%.*f", (int)decimalPlaces, value);
+    concat(tmp);
+}
+
+String::~String() {
+    delete[] buffer;
+}
+
+String &String::operator=(const String &rhs) {
+    if (this == &rhs) return *this;
+    len = 0;
+    if (buffer) buffer[0] = 0;
+    concat(rhs);
+    return *this;
+}
+
+String &String::operator=(String &&rhs) {
+    if (this == &rhs) return *this;
+    delete[] buffer;
+    buffer = rhs.buffer;
+    capacity = rhs.capacity;
+    len = rhs.len;
+    rhs.buffer = nullptr;
+    rhs.capacity = 0;
+    rhs.len = 0;
+    return *this;
+}
+
+String &String::operator=(const char *cstr) {
+    len = 0;
+    if (buffer) buffer[0] = 0;
+    concat(cstr);
+    return *this;
+}
+
+bool String::reserve(unsigned int size) {
+    if (buffer && capacity >= size) return true;
+    char *grown = new char[size + 1];
+    if (buffer) memcpy(grown, buffer, len + 1);
+    else grown[0] = 0;
+    delete[] buffer;
+    buffer = grown;
+    capacity = size;
+    return true;
+}
+
+bool String::concat(const char *cstr, unsigned int length) {
+    if (!cstr) return false;
+    if (length == 0) {
+        // Like the Arduino core, an empty String still owns a buffer
+        return reserve(len);
+    }
+    reserve(len + length);
+    memcpy(buffer + len, cstr, length);
+    len += length;
+    buffer[len] = 0;
+    return true;
+}
+
+String operator+(const String &lhs, const String &rhs) {
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+String operator+(const String &lhs, const char *rhs) {
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+String operator+(const char *lhs, const String &rhs) {
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+// Print
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        if (!write(*buffer++)) break;
+        n++;
+    }
+    return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+    char loc_buf[64];
+    char *temp = loc_buf;
+    va_list arg;
+    va_list copy;
+    va_start(arg, format);
+    va_copy(copy, arg);
+    int len = vsnprintf(temp, sizeof(loc_buf), format, copy);
+    va_end(copy);
+    if (len < 0) {
+        va_end(arg);
+        return 0;
+    }
+    if (len >= (int)sizeof(loc_buf)) {
+        temp = new char[len + 1];
+        vsnprintf(temp, len + 1, format, arg);
+    }
+    va_end(arg);
+    len = write((const uint8_t *)temp, len);
+    if (temp != loc_buf) {
+        delete[] temp;
+    }
+    return len;
+}
+
+size_t Print::print(long value, int base) {
+    char tmp[40];
+    bool negative = value < 0 && base == 10;
+    formatInteger(tmp, sizeof(tmp), negative ? -(unsigned long)value : (unsigned long)value, negative, base);
+    return write(tmp);
+}
+
+size_t Print::print(unsigned long value, int base) {
+    char tmp[40];
+    formatInteger(tmp, sizeof(tmp), value, false, base);
+    return write(tmp);
+}
+
+size_t Print::print(double value, int digits) {
+    char tmp[48];
+    snprintf(tmp, sizeof(tmp), "%.*f", digits, value);
+    return write(tmp);
+}
+
+// Serial
+
+void HardwareSerial::updateTxLevel() {
+    unsigned long now = micros();
+    double sent = (double)(now - txUpdatedAt) * baudRate / 10 / 1e6;
+    txLevel = txLevel > sent ? txLevel - sent : 0;
+    txUpdatedAt = now;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    bytesWritten += size;
+    if (echo) fwrite(buffer, 1, size, stdout);
+
+    if (txFifo) {
+        updateTxLevel();
+        double space = txFifo - txLevel;
+        if (size <= space) {
+            txLevel += size;
+        } else {
+            // Caller blocks until the bytes that did not fit have gone out
+            uint32_t stall = (uint32_t)((size - space) * 10 * 1e6 / baudRate);
+            delayMicroseconds(stall);
+            stallMicros += stall;
+            txLevel = txFifo;
+            txUpdatedAt = micros();
+        }
+    }
+    return size;
+}
+
+int HardwareSerial::availableForWrite() {
+    if (!txFifo) return 256;
+    updateTxLevel();
+    return (int)(txFifo - txLevel);
+}
+
+// ESP
+
+void EspClass::restart() {
+    fprintf(stderr, "ESP.restart() called on host, exiting\n");
+    exit(1);
+}
+
+static SCANNER_INSTANCE uint32_t mockFreeHeap = 320 * 1024;
+static SCANNER_INSTANCE uint32_t mockLargestBlock = 192 * 1024;
+static SCANNER_INSTANCE uint32_t mockStackHeadroom = 5 * 1024;
+
+uint32_t EspClass::getFreeHeap() {
+    return mockFreeHeap;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return mockLargestBlock;
+}
+
+uint32_t EspClass::getCycleCount() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t hostNanos = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    return (uint32_t)(virtualMicros * 160 + hostNanos * 160 / 1000);
+}
+
+void mockSetHeap(uint32_t freeBytes, uint32_t largestBlock) {
+    mockFreeHeap = freeBytes;
+    mockLargestBlock = largestBlock;
+}
+
+void mockSetStackHeadroom(uint32_t bytes) {
+    mockStackHeadroom = bytes;
+}
+
+unsigned int uxTaskGetStackHighWaterMark(void *) {
+    return mockStackHeadroom;
+}
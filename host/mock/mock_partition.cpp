@@ -0,0 +1,111 @@
+#include "Arduino.h"
+#include "esp_partition.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#define MOCK_SECTOR_SIZE 4096
+
+static SCANNER_INSTANCE esp_partition_t partition;
+static SCANNER_INSTANCE bool partitionExists = false;
+static SCANNER_INSTANCE std::vector<uint8_t> flash;
+static SCANNER_INSTANCE std::vector<uint32_t> sectorErases;
+static SCANNER_INSTANCE uint64_t bytesWritten = 0;
+static SCANNER_INSTANCE uint32_t erases = 0;
+static SCANNER_INSTANCE size_t tearAfter = (size_t)-1;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    if (!partitionExists || type != partition.type) return NULL;
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != partition.subtype) return NULL;
+    if (label && strcmp(label, partition.label) != 0) return NULL;
+    return &partition;
+}
+
+static bool inRange(const esp_partition_t *p, size_t offset, size_t size) {
+    return p == &partition && offset <= flash.size() && size <= flash.size() - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t src_offset, void *dst, size_t size) {
+    if (!inRange(p, src_offset, size)) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, flash.data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t dst_offset, const void *src, size_t size) {
+    if (!inRange(p, dst_offset, size)) return ESP_ERR_INVALID_SIZE;
+    const uint8_t *bytes = (const uint8_t *)src;
+    size_t n = std::min(size, tearAfter);
+    for (size_t i = 0; i < n; i++) flash[dst_offset + i] &= bytes[i];
+    bytesWritten += n;
+    if (tearAfter != (size_t)-1) {
+        tearAfter = (size_t)-1;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t size) {
+    if (!inRange(p, offset, size)) return ESP_ERR_INVALID_SIZE;
+    if (offset % MOCK_SECTOR_SIZE || size % MOCK_SECTOR_SIZE) return ESP_ERR_INVALID_ARG;
+    memset(flash.data() + offset, 0xFF, size);
+    for (size_t s = offset / MOCK_SECTOR_SIZE; s < (offset + size) / MOCK_SECTOR_SIZE; s++) {
+        sectorErases[s]++;
+        erases++;
+    }
+    return ESP_OK;
+}
+
+void mockPartitionCreate(const char *label, uint32_t size) {
+    memset(&partition, 0, sizeof(partition));
+    partition.type = ESP_PARTITION_TYPE_DATA;
+    partition.subtype = ESP_PARTITION_SUBTYPE_DATA_SPIFFS;
+    partition.size = size;
+    partition.erase_size = MOCK_SECTOR_SIZE;
+    strncpy(partition.label, label, sizeof(partition.label) - 1);
+    partitionExists = true;
+    flash.assign(size, 0xFF);
+    sectorErases.assign(size / MOCK_SECTOR_SIZE, 0);
+    bytesWritten = 0;
+    erases = 0;
+    tearAfter = (size_t)-1;
+}
+
+void mockPartitionRemove() {
+    partitionExists = false;
+    flash.clear();
+    sectorErases.clear();
+}
+
+bool mockPartitionSave(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(flash.data(), 1, flash.size(), f) == flash.size();
+    return fclose(f) == 0 && ok;
+}
+
+uint8_t *mockPartitionData() {
+    return flash.data();
+}
+
+uint64_t mockPartitionBytesWritten() {
+    return bytesWritten;
+}
+
+uint32_t mockPartitionErases() {
+    return erases;
+}
+
+uint32_t mockPartitionMaxSectorErases() {
+    return sectorErases.empty() ? 0 : *std::max_element(sectorErases.begin(), sectorErases.end());
+}
+
+uint32_t mockPartitionMinSectorErases() {
+    return sectorErases.empty() ? 0 : *std::min_element(sectorErases.begin(), sectorErases.end());
+}
+
+void mockPartitionTearNextWrite(size_t bytes) {
+    tearAfter = bytes;
+}
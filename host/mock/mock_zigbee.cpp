@@ -0,0 +1,239 @@
+#include "Zigbee.h"
+
+SCANNER_INSTANCE ZigbeeCore Zigbee;
+
+bool ZigbeeCore::begin(zigbee_role_t role, bool erase_nvs) {
+    (void)role;
+    (void)erase_nvs;
+    isStarted = true;
+    return true;
+}
+
+// Active scan time per channel is aBaseSuperframeDuration * (2^n + 1) symbols,
+// i.e. 15.36 ms * (2^n + 1)
+unsigned long ZigbeeCore::mockScanDurationMs(uint32_t channel_mask, uint8_t scan_duration) const {
+    uint32_t channels = __builtin_popcount(channel_mask & ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+    uint64_t perChannelUs = 15360ULL * ((1ULL << scan_duration) + 1);
+    return (unsigned long)((channels * perChannelUs) / 1000);
+}
+
+void ZigbeeCore::scanNetworks(uint32_t channel_mask, uint8_t scan_duration) {
+    scanning = true;
+    scanFailed = failNextScan;
+    failNextScan = false;
+    resultReady = false;
+    scanStartedAt = millis();
+    scanLength = mockScanDurationMs(channel_mask, scan_duration);
+    airtime += scanLength;
+    if (overheadMax) {
+        overheadState = overheadState * 1103515245u + 12345u;
+        scanLength += (overheadState >> 8) % (overheadMax + 1);
+    }
+    lastChannelMask = channel_mask;
+    scansStarted++;
+
+    // Only networks on the requested channels answer the beacon request
+    results.clear();
+    for (const zigbee_scan_result_t &network : queued) {
+        if (network.logic_channel < 32 && (channel_mask & (1UL << network.logic_channel))) {
+            if (scanFailed || !beaconLost(network.short_pan_id)) results.push_back(network);
+        }
+    }
+}
+
+ZigbeeCore::BeaconLoss *ZigbeeCore::findBeaconLoss(uint16_t panId) {
+    for (BeaconLoss &loss : beaconLoss) {
+        if (loss.panId == panId) return &loss;
+    }
+    return nullptr;
+}
+
+// Decides whether the PAN's beacon gets through this scan
+bool ZigbeeCore::beaconLost(uint16_t panId) {
+    BeaconLoss *loss = findBeaconLoss(panId);
+    if (!loss) return false;
+    bool lost;
+    if (loss->missNext > 0) {
+        loss->missNext--;
+        lost = true;
+    } else {
+        lossState = lossState * 1103515245u + 12345u;
+        lost = (lossState >> 8) % 100 < loss->percent;
+    }
+    if (lost) {
+        if (loss->counts.answered > 0) {
+            loss->counts.dropped++;
+            loss->dropRun++;
+        }
+    } else {
+        loss->counts.answered++;
+        if (loss->dropRun > loss->counts.longestDropRun) loss->counts.longestDropRun = loss->dropRun;
+        loss->dropRun = 0;
+    }
+    return lost;
+}
+
+void ZigbeeCore::mockSetBeaconLoss(uint16_t panId, uint8_t percent) {
+    BeaconLoss *loss = findBeaconLoss(panId);
+    if (!loss) {
+        beaconLoss.push_back(BeaconLoss{ panId, 0, 0, 0, {} });
+        loss = &beaconLoss.back();
+    }
+    loss->percent = percent;
+}
+
+void ZigbeeCore::mockMissScans(uint16_t panId, uint16_t scans) {
+    mockSetBeaconLoss(panId, findBeaconLoss(panId) ? findBeaconLoss(panId)->percent : 0);
+    findBeaconLoss(panId)->missNext = scans;
+}
+
+MockBeaconCounts ZigbeeCore::mockBeaconCounts(uint16_t panId) const {
+    for (const BeaconLoss &loss : beaconLoss) {
+        if (loss.panId == panId) return loss.counts;
+    }
+    return MockBeaconCounts{};
+}
+
+int16_t ZigbeeCore::scanComplete() {
+    if (scanning && millis() - scanStartedAt >= scanLength) {
+        scanning = false;
+        resultReady = !scanFailed;
+        completionLatency = millis() - (scanStartedAt + scanLength);
+        scansCompleted++;
+    }
+    if (scanning) return ZB_SCAN_RUNNING;
+    if (!resultReady) return ZB_SCAN_FAILED;
+    return (int16_t)results.size();
+}
+
+zigbee_scan_result_t *ZigbeeCore::getScanResult() {
+    if (!resultReady || results.empty()) return nullptr;
+    return results.data();
+}
+
+void ZigbeeCore::scanDelete() {
+    scanning = false;
+    resultReady = false;
+}
+
+void ZigbeeCore::mockSetScanResults(const zigbee_scan_result_t *list, uint16_t count) {
+    queued.assign(list, list + count);
+    // Keep enough room for the largest answer so scans never allocate
+    if (results.capacity() < queued.size()) results.reserve(queued.size());
+}
+
+// Energy detect over a synthetic band
+
+static SCANNER_INSTANCE std::vector<MockInterferer> interferers;
+static SCANNER_INSTANCE uint32_t energyState = 777;
+static SCANNER_INSTANCE uint32_t energyRequests = 0;
+static SCANNER_INSTANCE uint32_t energySamples = 0;
+static SCANNER_INSTANCE unsigned long energyAirtime = 0;
+static SCANNER_INSTANCE bool failNextEnergyDetect = false;
+
+static uint32_t energyRandom() {
+    energyState = energyState * 1103515245u + 12345u;
+    return energyState >> 8;
+}
+
+// Stable pseudo-random value for a source and a time slot
+static uint32_t slotHash(uint32_t source, uint32_t slot) {
+    uint32_t h = (source + 1) * 0x9E3779B1u ^ slot * 0x85EBCA77u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+// Source on air at some point of [startUs, endUs) within +-2 MHz of
+// the Zigbee channel centre
+static bool sourceHits(const MockInterferer &source, uint32_t index, uint16_t channelMHz,
+                       uint64_t startUs, uint64_t endUs) {
+    switch (source.kind) {
+    case MOCK_RF_WIFI: {
+        if (abs((int)channelMHz - (int)source.centerMHz) > source.widthMHz / 2 + 1) return false;
+        // Each cycle starts its burst at a random offset
+        uint64_t period = (uint64_t)source.periodMs * 1000;
+        uint64_t on = period * source.dutyPercent / 100;
+        for (uint64_t cycle = startUs / period; cycle * period < endUs; cycle++) {
+            uint64_t burst = cycle * period + slotHash(index, (uint32_t)cycle) % (period - on + 1);
+            if (burst < endUs && burst + on > startUs) return true;
+        }
+        return false;
+    }
+    case MOCK_RF_BLE: {
+        uint64_t period = (uint64_t)source.periodMs * 1000;
+        for (uint64_t hop = startUs / period; hop * period < endUs; hop++) {
+            uint16_t bleMHz = 2402 + 2 * (slotHash(index, (uint32_t)hop) % 40);
+            if (abs((int)channelMHz - (int)bleMHz) < 2) return true;
+        }
+        return false;
+    }
+    default:
+        return abs((int)channelMHz - (int)source.centerMHz) <= source.widthMHz / 2 + 1;
+    }
+}
+
+void esp_zb_zdo_energy_detect_request(esp_zb_zdo_energy_detect_req_t *cmd,
+                                      esp_zb_zdo_energy_detect_callback_t user_cb, void *user_ctx) {
+    esp_zb_energy_detect_channel_info_t info[16];
+    uint16_t count = 0;
+    uint64_t perChannelUs = 15360ULL * ((1ULL << cmd->duration) + 1);
+    uint64_t at = (uint64_t)millis() * 1000;
+    energyRequests++;
+
+    for (uint8_t channel = 11; channel <= 26; channel++) {
+        if (!(cmd->channel_mask & (1UL << channel))) continue;
+        uint16_t channelMHz = 2405 + 5 * (channel - 11);
+        int energy = -96 + (int)(energyRandom() % 5);
+        for (size_t i = 0; i < interferers.size(); i++) {
+            if (!sourceHits(interferers[i], (uint32_t)i, channelMHz, at, at + perChannelUs)) continue;
+            energy = max(energy, interferers[i].powerDbm + (int)(energyRandom() % 5) - 2);
+        }
+        info[count].channel_nbr = channel;
+        info[count].energy_detected = (int8_t)energy;
+        count++;
+        at += perChannelUs;
+    }
+    energySamples += count;
+    energyAirtime += (unsigned long)(count * perChannelUs / 1000);
+
+    if (failNextEnergyDetect) {
+        failNextEnergyDetect = false;
+        user_cb(ESP_ZB_ZDP_STATUS_TIMEOUT, 0, NULL, user_ctx);
+        return;
+    }
+    user_cb(ESP_ZB_ZDP_STATUS_SUCCESS, count, info, user_ctx);
+}
+
+bool esp_zb_lock_acquire(TickType_t block_ticks) {
+    (void)block_ticks;
+    return true;
+}
+
+void esp_zb_lock_release() {
+}
+
+void mockAddInterferer(const MockInterferer &source) {
+    interferers.push_back(source);
+}
+
+void mockClearInterferers() {
+    interferers.clear();
+}
+
+uint32_t mockEnergyDetectRequests() {
+    return energyRequests;
+}
+
+uint32_t mockEnergyDetectSamples() {
+    return energySamples;
+}
+
+unsigned long mockEnergyDetectAirtimeMs() {
+    return energyAirtime;
+}
+
+void mockFailNextEnergyDetect() {
+    failNextEnergyDetect = true;
+}
@@ -0,0 +1,89 @@
+#include "scan_script.h"
+
+#include <stdio.h>
+#include <string>
+
+static uint32_t nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void setExtendedPanId(zigbee_scan_result_t &network, uint64_t extPanId) {
+    for (int i = 0; i < 8; i++) {
+        network.extended_pan_id[i] = (uint8_t)(extPanId >> (8 * i));
+    }
+}
+
+bool loadScanScript(const char *path, std::vector<ScanCycle> &cycles) {
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    char line[256];
+    ScanCycle cycle;
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') continue;
+
+        unsigned int pan, channel, join, router, endDevice;
+        unsigned long long extPanId = 0;
+        int fields = sscanf(line, "%x %u %u %u %u %llx", &pan, &channel, &join, &router, &endDevice, &extPanId);
+        if (fields < 5) {
+            // Blank (or unparsable) line closes the current cycle
+            if (!cycle.empty()) {
+                cycles.push_back(cycle);
+                cycle.clear();
+            }
+            continue;
+        }
+
+        zigbee_scan_result_t network = {};
+        network.short_pan_id = (uint16_t)pan;
+        network.logic_channel = (uint8_t)channel;
+        network.permit_joining = join != 0;
+        network.router_capacity = router != 0;
+        network.end_device_capacity = endDevice != 0;
+        setExtendedPanId(network, extPanId);
+        cycle.push_back(network);
+    }
+    if (!cycle.empty()) cycles.push_back(cycle);
+
+    fclose(file);
+    return true;
+}
+
+void generateScanCycle(ScanCycle &cycle, uint16_t count, uint32_t seed) {
+    uint32_t state = seed ? seed : 0x9e3779b9u;
+    std::vector<bool> usedPan(65536, false);
+
+    cycle.clear();
+    cycle.reserve(count);
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t pan;
+        do {
+            pan = (uint16_t)nextRandom(state);
+        } while (pan == 0 || pan == 0xFFFF || usedPan[pan]);
+        usedPan[pan] = true;
+
+        zigbee_scan_result_t network = {};
+        network.short_pan_id = pan;
+        network.logic_channel = (uint8_t)(11 + nextRandom(state) % 16);
+        network.permit_joining = nextRandom(state) % 4 == 0;
+        network.router_capacity = nextRandom(state) % 8 != 0;
+        network.end_device_capacity = nextRandom(state) % 8 != 0;
+        uint64_t extPanId = ((uint64_t)nextRandom(state) << 32) | nextRandom(state);
+        setExtendedPanId(network, extPanId);
+        cycle.push_back(network);
+    }
+}
+
+void perturbScanCycle(ScanCycle &cycle, uint32_t seed) {
+    uint32_t state = seed ? seed : 0x9e3779b9u;
+
+    for (size_t i = cycle.size(); i > 1; i--) {
+        size_t j = nextRandom(state) % i;
+        zigbee_scan_result_t tmp = cycle[i - 1];
+        cycle[i - 1] = cycle[j];
+        cycle[j] = tmp;
+    }
+}
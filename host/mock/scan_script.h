@@ -0,0 +1,28 @@
+#ifndef ZIGBEE_SCANNER_MOCK_SCAN_SCRIPT_H
+#define ZIGBEE_SCANNER_MOCK_SCAN_SCRIPT_H
+
+/*
+ * Scan result sources for the host tools: scripted cycles loaded from a
+ * text file, or randomly generated networks.
+ *
+ * Script format, one network per line, blank line ends a scan cycle:
+ *   <pan hex> <channel> <join 0/1> <router 0/1> <enddev 0/1> <extended pan hex>
+ * Lines starting with '#' are comments.
+ */
+
+#include "Zigbee.h"
+
+#include <vector>
+
+typedef std::vector<zigbee_scan_result_t> ScanCycle;
+
+// Loads every cycle from a script file, returns false if it cannot be read
+bool loadScanScript(const char *path, std::vector<ScanCycle> &cycles);
+
+// Generates count networks with unique PAN IDs spread over channels 11-26
+void generateScanCycle(ScanCycle &cycle, uint16_t count, uint32_t seed);
+
+// Shuffles the order, like consecutive scans of the same networks
+void perturbScanCycle(ScanCycle &cycle, uint32_t seed);
+
+#endif // ZIGBEE_SCANNER_MOCK_SCAN_SCRIPT_H
@@ -0,0 +1,230 @@
+#ifndef ZIGBEE_SCANNER_THRESHOLD_SWEEP_H
+#define ZIGBEE_SCANNER_THRESHOLD_SWEEP_H
+
+/*
+ * Replays recorded scans through the sketch's analysis once per set of
+ * AnalysisThresholds and counts, per set, the alerts the networks raise
+ * (networkAlerts()): how often each went on, how often it came back soon
+ * after going off (a flap) and how many sightings it was on for.
+ *
+ * Every replay is a scanner of its own: built with SCANNER_INSTANCE
+ * thread_local (the arduino_mock_threads library), the sketch's and the
+ * mock's globals are per thread, so a pool of worker threads replays sets
+ * side by side. Workers take the next set from a shared counter and write
+ * its result to the set's own slot, so the results do not depend on the
+ * number of threads and the archive is only read.
+ *
+ * So each worker thread carries a whole scanner: 54,744 bytes of
+ * thread-local storage in the standard profile (the TLS segment of
+ * readelf -l), set up when the thread starts. The pool has one thread per
+ * core, so that is a few hundred KB at most. The alternative is to pass a
+ * struct of the analysis state to every function. That would rewrite most
+ * of the sketch and add a pointer to every call on the single-scanner
+ * device, for a host tool, so the sketch keeps its globals. Only the tools
+ * built on arduino_mock_threads carry the copies.
+ *
+ * Includes the sketch: include it instead of sketch.h, from one source
+ * file per program.
+ */
+
+#include "sketch.h"
+#include "history/history_log_reader.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// An alert that goes on again within this many sightings of going off flaps
+const uint32_t SWEEP_FLAP_SIGHTINGS = 10;
+
+// Recorded scans in time order, their networks in one array
+struct RecordedScan {
+    uint32_t time;                // ms since the start of the recording
+    uint32_t channelMask;
+    uint32_t first;               // into ScanArchive::records
+    uint16_t count;
+    bool boot;                    // the scanner restarted: its state is reset
+};
+
+struct ScanArchive {
+    std::vector<RecordedScan> scans;
+    std::vector<HistoryLogRecord> records;
+};
+
+struct SweepResult {
+    uint64_t raised[NETWORK_ALERT_KINDS];   // went on
+    uint64_t flaps[NETWORK_ALERT_KINDS];    // went on within SWEEP_FLAP_SIGHTINGS of going off
+    uint64_t active[NETWORK_ALERT_KINDS];   // sightings it was on for
+    uint64_t sightings;
+    uint32_t scans;
+};
+
+inline uint64_t sweepTotal(const uint64_t *counts) {
+    uint64_t total = 0;
+    for (int k = 0; k < NETWORK_ALERT_KINDS; k++) total += counts[k];
+    return total;
+}
+
+// A history log partition image (the scanner's own recording)
+inline bool loadHistoryArchive(const char *path, ScanArchive &archive) {
+    HistoryLogReader reader;
+    if (!reader.open(path)) return false;
+    archive = ScanArchive();
+    uint32_t start = reader.oldestTime();
+    reader.read(0, UINT32_MAX, [&](const HistoryLogBlock &block, const HistoryLogRecord *records) {
+        RecordedScan scan;
+        scan.time = (block.time - start) * 1000;
+        scan.channelMask = block.channelMask;
+        scan.first = (uint32_t)archive.records.size();
+        scan.count = block.count;
+        scan.boot = block.type == HISTORY_LOG_BLOCK_BOOT;
+        archive.records.insert(archive.records.end(), records, records + block.count);
+        archive.scans.push_back(scan);
+    });
+    return true;
+}
+
+// Networks spread over the channels with their own signal level, noise,
+// beacon loss and load; some drop in level for a while, some are busy in
+// bursts. One full sweep every intervalMs.
+inline void generateArchive(ScanArchive &archive, uint16_t networks, uint32_t scans, uint32_t seed,
+                            uint32_t intervalMs = 30000) {
+    struct Network { uint16_t pan; uint8_t channel, level, noise, lossPercent, load; };
+    uint32_t state = seed * 2654435761u + 1;
+    auto next = [&state](uint32_t range) {
+        state = state * 1103515245u + 12345u;
+        return (state >> 8) % range;
+    };
+
+    std::vector<Network> list;
+    for (uint16_t n = 0; n < networks; n++) {
+        Network net;
+        net.pan = (uint16_t)(0x1000 + n * 97);
+        net.channel = (uint8_t)(MIN_CHANNEL + next(CHANNEL_COUNT));
+        net.level = (uint8_t)(24 + next(200));
+        net.noise = (uint8_t)(1 + next(12));
+        net.lossPercent = (uint8_t)(next(4) == 0 ? next(35) : next(6));
+        net.load = (uint8_t)next(90);
+        list.push_back(net);
+    }
+
+    archive = ScanArchive();
+    for (uint32_t s = 0; s < scans; s++) {
+        RecordedScan scan = { s * intervalMs, ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK,
+                              (uint32_t)archive.records.size(), 0, false };
+        for (const Network &net : list) {
+            if (next(100) < net.lossPercent) continue;
+            int signal = net.level + (int)next(2 * net.noise + 1) - net.noise;
+            if ((s / 200 + net.pan) % 7 == 0) signal -= 30;     // a drop now and then
+            int load = net.load + (int)next(21) - 10;
+            if ((s / 50 + net.pan) % 11 == 0) load += 25;       // busy bursts
+            HistoryLogRecord r = { s * intervalMs / 1000, net.pan, net.channel,
+                                   (uint8_t)constrain(signal, 0, 255), (uint8_t)constrain(load, 0, 100) };
+            archive.records.push_back(r);
+            scan.count++;
+        }
+        archive.scans.push_back(scan);
+    }
+}
+
+// Alert state of one tracked network
+struct AlertTrack {
+    uint16_t panId;
+    uint8_t alerts;
+    uint32_t sightings;
+    uint32_t clearedAt[NETWORK_ALERT_KINDS];   // sighting its alert went off, 0 never
+};
+
+// Replays the archive through this thread's scanner under thresholds
+inline SweepResult replayArchive(const ScanArchive &archive, const AnalysisThresholds &thresholds) {
+    SweepResult result;
+    memset(&result, 0, sizeof(result));
+    std::vector<AlertTrack> tracks(NETWORK_TABLE_CAPACITY);
+
+    // The same start on every replay, whatever this thread replayed before
+    const unsigned long base = 1000;
+    analysisThresholds = thresholds;
+    mockSetMillis(base);
+    initializeStats();
+    memset(channelHistory, 0, sizeof(channelHistory));
+    currentScan.sequence = 0;
+    setReportMode(REPORT_MODE_NONE);
+
+    for (const RecordedScan &recorded : archive.scans) {
+        if (recorded.boot) {
+            initializeStats();
+            std::fill(tracks.begin(), tracks.end(), AlertTrack());
+            continue;
+        }
+        unsigned long due = base + recorded.time;
+        if ((long)(due - millis()) > 0) mockAdvanceMillis(due - millis());
+
+        // What decodeScanResults() makes of a scan, from the recording
+        ScanSnapshot *scan = &currentScan;
+        uint16_t count = min(recorded.count, (uint16_t)SCAN_SNAPSHOT_CAPACITY);
+        scan->count = count;
+        scan->truncated = recorded.count - count;
+        scan->timestamp = millis();
+        scan->channelMask = recorded.channelMask;
+        scan->sequence++;
+        for (uint16_t i = 0; i < count; i++) {
+            const HistoryLogRecord &r = archive.records[recorded.first + i];
+            scan->panId[i] = r.panId;
+            scan->extendedPanId[i] = 0;
+            scan->channel[i] = r.channel;
+            scan->signal[i] = r.signal;
+            scan->load[i] = r.load;
+            scan->flags[i] = NETWORK_FLAG_SECURED;
+        }
+        reportScannedNetworks(recorded.count, true, scan);
+        result.scans++;
+
+        for (uint16_t i = 0; i < count; i++) {
+            const NetworkStats *stats = scanStats[i];
+            if (!stats) continue;
+            AlertTrack *track = &tracks[stats - networkTable.stats];
+            if (track->panId != scan->panId[i]) {
+                *track = AlertTrack();
+                track->panId = scan->panId[i];
+            }
+            track->sightings++;
+            result.sightings++;
+
+            uint8_t alerts = networkAlerts(scan, i, stats);
+            for (int k = 0; k < NETWORK_ALERT_KINDS; k++) {
+                uint8_t bit = 1 << k;
+                bool on = alerts & bit;
+                bool was = track->alerts & bit;
+                if (on) result.active[k]++;
+                if (on && !was) {
+                    result.raised[k]++;
+                    if (track->clearedAt[k] && track->sightings - track->clearedAt[k] <= SWEEP_FLAP_SIGHTINGS) {
+                        result.flaps[k]++;
+                    }
+                } else if (!on && was) {
+                    track->clearedAt[k] = track->sightings;
+                }
+            }
+            track->alerts = alerts;
+        }
+    }
+    return result;
+}
+
+// Replays every set on a pool of threads; results[i] is for sets[i]
+inline void sweepThresholds(const ScanArchive &archive, const std::vector<AnalysisThresholds> &sets,
+                            unsigned threads, std::vector<SweepResult> &results) {
+    results.assign(sets.size(), SweepResult());
+    std::atomic<size_t> nextSet(0);
+    auto worker = [&]() {
+        for (size_t i = nextSet.fetch_add(1); i < sets.size(); i = nextSet.fetch_add(1)) {
+            results[i] = replayArchive(archive, sets[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < max(threads, 1u); t++) pool.emplace_back(worker);
+    for (std::thread &thread : pool) thread.join();
+}
+
+#endif // ZIGBEE_SCANNER_THRESHOLD_SWEEP_H
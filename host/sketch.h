@@ -0,0 +1,9 @@
+#ifndef ZIGBEE_SCANNER_HOST_SKETCH_H
+#define ZIGBEE_SCANNER_HOST_SKETCH_H
+
+// Pulls the whole sketch into one translation unit, the same way the Arduino
+// builder does. Include this from exactly one source file per host program.
+#include "Arduino.h"
+#include "../zigbee_scanner/zigbee_scanner.ino"
+
+#endif // ZIGBEE_SCANNER_HOST_SKETCH_H
@@ -0,0 +1,160 @@
+#include "telemetry_decoder.h"
+
+#include <string.h>
+
+static inline uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+    return (uint32_t)get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+static inline uint64_t get64(const uint8_t *p) {
+    return (uint64_t)get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+// Header checks that let noise be skipped without waiting for a bogus length
+static bool plausibleHeader(const uint8_t *header) {
+    if (header[2] != TELEMETRY_VERSION) return false;
+    uint16_t length = get16(header + 4);
+    if (header[3] == TELEMETRY_FRAME_PROFILE) {
+        return length >= TELEMETRY_PROFILE_HEADER_SIZE + TELEMETRY_MEMORY_RECORD_SIZE &&
+            (length - TELEMETRY_PROFILE_HEADER_SIZE - TELEMETRY_MEMORY_RECORD_SIZE) % TELEMETRY_PHASE_RECORD_SIZE == 0;
+    }
+    if (header[3] != TELEMETRY_FRAME_SCAN && header[3] != TELEMETRY_FRAME_DELTA) return false;
+    return length >= TELEMETRY_SCAN_HEADER_SIZE &&
+        (length - TELEMETRY_SCAN_HEADER_SIZE) % TELEMETRY_NETWORK_RECORD_SIZE == 0;
+}
+
+TelemetryDecoder::TelemetryDecoder(ScanHandler onScan)
+    : onScan(onScan), counters(), haveSequence(false), lastSequence(0) {}
+
+void TelemetryDecoder::feed(const uint8_t *data, size_t size) {
+    counters.bytes += size;
+
+    if (pending.empty()) {
+        size_t used = parse(data, size);
+        pending.assign(data + used, data + size);
+        return;
+    }
+
+    pending.insert(pending.end(), data, data + size);
+    size_t used = parse(pending.data(), pending.size());
+    pending.erase(pending.begin(), pending.begin() + used);
+}
+
+// Returns the bytes consumed; an incomplete frame at the end is left
+size_t TelemetryDecoder::parse(const uint8_t *data, size_t size) {
+    size_t pos = 0;
+
+    while (size - pos >= TELEMETRY_HEADER_SIZE) {
+        const uint8_t *frame = data + pos;
+        if (frame[0] != TELEMETRY_SYNC0 || frame[1] != TELEMETRY_SYNC1 || !plausibleHeader(frame)) {
+            const void *next = memchr(frame + 1, TELEMETRY_SYNC0, size - pos - 1);
+            size_t skip = next ? (const uint8_t *)next - frame : size - pos;
+            counters.skippedBytes += skip;
+            pos += skip;
+            continue;
+        }
+
+        uint16_t length = get16(frame + 4);
+        size_t frameSize = (size_t)length + TELEMETRY_FRAME_OVERHEAD;
+        if (size - pos < frameSize) break;
+
+        uint16_t crc = telemetryCrc16(TELEMETRY_CRC_INIT, frame + 2, 4 + length);
+        if (crc != get16(frame + TELEMETRY_HEADER_SIZE + length)) {
+            counters.crcErrors++;
+            counters.skippedBytes++;
+            pos++;
+            continue;
+        }
+
+        if (frame[3] == TELEMETRY_FRAME_PROFILE) {
+            if (!decodeProfile(frame + TELEMETRY_HEADER_SIZE, length)) {
+                counters.malformed++;
+            } else {
+                counters.profiles++;
+                if (onProfile) onProfile(profile);
+            }
+            pos += frameSize;
+            continue;
+        }
+
+        scan.keyframe = frame[3] == TELEMETRY_FRAME_SCAN;
+        if (decodeScan(frame + TELEMETRY_HEADER_SIZE, length)) {
+            counters.frames++;
+            onScan(scan);
+        } else {
+            counters.malformed++;
+        }
+        pos += frameSize;
+    }
+    return pos;
+}
+
+bool TelemetryDecoder::decodeScan(const uint8_t *payload, size_t length) {
+    uint16_t count = get16(payload + 10);
+    if (length != TELEMETRY_SCAN_HEADER_SIZE + (size_t)count * TELEMETRY_NETWORK_RECORD_SIZE) return false;
+
+    scan.sequence = get16(payload);
+    scan.timestamp = get32(payload + 2);
+    scan.channelMask = get32(payload + 6);
+    scan.truncated = get16(payload + 12);
+
+    if (haveSequence && scan.sequence != (uint16_t)(lastSequence + 1)) {
+        counters.sequenceGaps += (uint16_t)(scan.sequence - lastSequence - 1);
+    }
+    haveSequence = true;
+    lastSequence = scan.sequence;
+
+    scan.networks.resize(count);
+    const uint8_t *p = payload + TELEMETRY_SCAN_HEADER_SIZE;
+    for (uint16_t i = 0; i < count; i++, p += TELEMETRY_NETWORK_RECORD_SIZE) {
+        TelemetryNetwork &n = scan.networks[i];
+        n.panId = get16(p);
+        n.extendedPanId = get64(p + 2);
+        n.channel = p[10];
+        n.signal = p[11];
+        n.load = p[12];
+        n.flags = p[13];
+        n.signalAvg = p[14];
+        n.signalMin = p[15];
+        n.signalMax = p[16];
+        n.signalTrend = p[17];
+        n.signalP10 = p[18];
+        n.signalP50 = p[19];
+        n.signalP90 = p[20];
+        n.uptime = get32(p + 21);
+        n.beaconsExpected = get32(p + 25);
+        n.beaconsMissed = get16(p + 29);
+        n.longestMissStreak = get16(p + 31);
+    }
+    return true;
+}
+
+bool TelemetryDecoder::decodeProfile(const uint8_t *payload, size_t length) {
+    uint8_t count = payload[10];
+    if (length != TELEMETRY_PROFILE_HEADER_SIZE + (size_t)count * TELEMETRY_PHASE_RECORD_SIZE +
+        TELEMETRY_MEMORY_RECORD_SIZE) return false;
+
+    profile.timestamp = get32(payload);
+    profile.cpuMHz = get16(payload + 4);
+    profile.scanCycles = get32(payload + 6);
+    profile.phases.resize(count);
+    const uint8_t *p = payload + TELEMETRY_PROFILE_HEADER_SIZE;
+    for (uint8_t i = 0; i < count; i++, p += TELEMETRY_PHASE_RECORD_SIZE) {
+        TelemetryPhase &phase = profile.phases[i];
+        phase.cycles = get16(p);
+        phase.mean = get32(p + 2);
+        phase.max = get32(p + 6);
+        phase.p50 = get32(p + 10);
+        phase.p90 = get32(p + 14);
+    }
+    profile.freeHeapMin = get32(p);
+    profile.freeHeapMax = get32(p + 4);
+    profile.largestBlockMin = get32(p + 8);
+    profile.largestBlockMax = get32(p + 12);
+    profile.stackHeadroomMin = get32(p + 16);
+    return true;
+}
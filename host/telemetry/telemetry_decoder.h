@@ -0,0 +1,112 @@
+#ifndef ZIGBEE_SCANNER_TELEMETRY_DECODER_H
+#define ZIGBEE_SCANNER_TELEMETRY_DECODER_H
+
+/*
+ * Decoder for the scanner's binary telemetry stream (REPORT_MODE_BINARY),
+ * independent of the Arduino mock so collectors can link it on its own.
+ *
+ * Feed it serial bytes in chunks of any size. Bytes outside frames (boot
+ * messages, text reports in REPORT_MODE_BOTH, line noise) are skipped, and
+ * a frame whose CRC does not match is dropped and the decoder resyncs on the
+ * next sync pattern. One decoder per stream; decoders share nothing.
+ */
+
+#include "../../zigbee_scanner/block_telemetry_format.h"
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+struct TelemetryNetwork {
+    uint16_t panId;
+    uint64_t extendedPanId;
+    uint8_t channel;
+    uint8_t signal;            // index, not a measured level (see decodeScanResults)
+    uint8_t load;
+    uint8_t flags;
+    uint8_t signalAvg;
+    uint8_t signalMin;
+    uint8_t signalMax;
+    uint8_t signalTrend;
+    uint8_t signalP10;
+    uint8_t signalP50;
+    uint8_t signalP90;
+    uint32_t uptime;
+    uint32_t beaconsExpected;
+    uint16_t beaconsMissed;
+    uint16_t longestMissStreak;
+};
+
+struct TelemetryScan {
+    bool keyframe;             // every network of the scan, not only changes
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint32_t channelMask;
+    uint16_t truncated;
+    std::vector<TelemetryNetwork> networks;
+};
+
+// Profile frame (CYCLE_PROFILE): scan cycle phases in CPU cycles
+struct TelemetryPhase {
+    uint16_t cycles;           // scan cycles since the previous profile frame
+    uint32_t mean;
+    uint32_t max;
+    uint32_t p50;              // over the same scan cycles, histogram bucket bounds
+    uint32_t p90;
+};
+
+struct TelemetryProfile {
+    uint32_t timestamp;
+    uint16_t cpuMHz;
+    uint32_t scanCycles;
+    std::vector<TelemetryPhase> phases;    // PHASE_* order
+    uint32_t freeHeapMin;
+    uint32_t freeHeapMax;
+    uint32_t largestBlockMin;
+    uint32_t largestBlockMax;
+    uint32_t stackHeadroomMin;
+};
+
+struct TelemetryDecoderStats {
+    uint64_t bytes;
+    uint64_t frames;           // scan and delta frames
+    uint64_t profiles;
+    uint64_t crcErrors;
+    uint64_t malformed;        // CRC fine but payload does not match its type
+    uint64_t skippedBytes;     // outside any valid frame
+    uint64_t sequenceGaps;     // frames lost between two decoded ones
+};
+
+class TelemetryDecoder {
+public:
+    typedef std::function<void(const TelemetryScan &)> ScanHandler;
+
+    typedef std::function<void(const TelemetryProfile &)> ProfileHandler;
+
+    explicit TelemetryDecoder(ScanHandler onScan);
+
+    // Profile frames are skipped unless a handler is set
+    void setProfileHandler(ProfileHandler handler) { onProfile = handler; }
+
+    // Consumes size bytes, calling the handler for every complete frame.
+    // The TelemetryScan passed to the handler is reused for the next frame.
+    void feed(const uint8_t *data, size_t size);
+
+    const TelemetryDecoderStats &stats() const { return counters; }
+
+private:
+    size_t parse(const uint8_t *data, size_t size);
+    bool decodeScan(const uint8_t *payload, size_t length);
+    bool decodeProfile(const uint8_t *payload, size_t length);
+
+    ScanHandler onScan;
+    ProfileHandler onProfile;
+    TelemetryProfile profile;
+    std::vector<uint8_t> pending;
+    TelemetryScan scan;
+    TelemetryDecoderStats counters;
+    bool haveSequence;
+    uint16_t lastSequence;
+};
+
+#endif // ZIGBEE_SCANNER_TELEMETRY_DECODER_H
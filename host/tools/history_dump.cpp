@@ -0,0 +1,44 @@
+/*
+ * Prints a history log partition image as CSV, the same lines as the
+ * sketch's serial "dump" command.
+ *
+ * Usage: history_dump <image.bin> [from [to]]   (log seconds)
+ */
+
+#include "history/history_log_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <image.bin> [from [to]]\n", argv[0]);
+        return 2;
+    }
+    uint32_t from = argc >= 3 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+    uint32_t to = argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 10) : UINT32_MAX;
+
+    HistoryLogReader reader;
+    if (!reader.open(argv[1])) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    unsigned long scans = 0, records = 0;
+    printf("# history %lu..%lu s\n", (unsigned long)from, (unsigned long)to);
+    printf("time,pan,channel,signal,load\n");
+    reader.read(from, to, [&](const HistoryLogBlock &block, const HistoryLogRecord *r) {
+        if (block.type == HISTORY_LOG_BLOCK_BOOT) {
+            printf("# boot at %lu\n", (unsigned long)block.time);
+            return;
+        }
+        scans++;
+        for (uint16_t i = 0; i < block.count; i++) {
+            printf("%lu,0x%04x,%u,%u,%u\n", (unsigned long)r[i].time, r[i].panId, r[i].channel, r[i].signal, r[i].load);
+        }
+        records += block.count;
+    });
+    printf("# end, %lu scans, %lu records\n", scans, records);
+    if (reader.tornSectors()) fprintf(stderr, "%lu sectors end in a torn block\n", (unsigned long)reader.tornSectors());
+    return 0;
+}
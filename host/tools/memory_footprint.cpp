@@ -0,0 +1,68 @@
+/*
+ * Prints the static RAM of the scanner's tables for the profile this
+ * program was built with (SCANNER_PROFILE), then runs scans of more
+ * networks than the table holds to check the profile's sizes and index
+ * widths: every network of the last scan must be found in the table.
+ *
+ * Sizes are host sizes; pointers are 4 bytes on the ESP32-C6, so the
+ * target totals are slightly smaller.
+ *
+ * Usage: memory_footprint [--csv]
+ *
+ * Exits with 1 if a check fails.
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+
+static bool runScans() {
+    initializeStats();
+    Report.setMuted(true);
+    ScanCycle cycle;
+    int cycles = NETWORK_TABLE_CAPACITY / SCAN_SNAPSHOT_CAPACITY + 3;
+    for (int i = 0; i < cycles; i++) {
+        generateScanCycle(cycle, SCAN_SNAPSHOT_CAPACITY, 1000 + i);
+        Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+        Zigbee.scanNetworks();
+        mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+        int16_t status = Zigbee.scanComplete();
+        if (status > 0) printScannedNetworks(status);
+        mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+    }
+
+    bool ok = currentScan.count == SCAN_SNAPSHOT_CAPACITY && networkTable.count == NETWORK_TABLE_CAPACITY &&
+        networkTable.evictions > 0;
+    for (uint16_t i = 0; i < currentScan.count; i++) {
+        if (!findNetworkStats(&networkTable, currentScan.panId[i], currentScan.extendedPanId[i])) ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    bool csv = argc >= 2 && strcmp(argv[1], "--csv") == 0;
+
+    if (csv) {
+        printf("profile,table,bytes\n");
+        for (uint8_t i = 0; i < MEMORY_USE_COUNT; i++) {
+            printf("%s,%s,%lu\n", SCANNER_PROFILE_NAME, memoryUse[i].name, (unsigned long)memoryUse[i].bytes);
+        }
+        printf("%s,total,%lu\n", SCANNER_PROFILE_NAME, (unsigned long)memoryFootprintTotal());
+    } else {
+        class StdoutPrint : public Print {
+        public:
+            size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+            using Print::write;
+        } out;
+        printMemoryFootprint(out);
+        printf("Scans every %lu ms (%lu ms while searching), energy detect %s, history log %s\n",
+            SCAN_INTERVAL_NORMAL, SCAN_INTERVAL_SEARCH, ENERGY_DETECT ? "on" : "off", HISTORY_LOG ? "on" : "off");
+    }
+
+    bool ok = runScans();
+    fprintf(csv ? stderr : stdout, "%stable check (%u scans of %u networks into %u slots): %s\n", csv ? "" : "\n",
+        (unsigned)(NETWORK_TABLE_CAPACITY / SCAN_SNAPSHOT_CAPACITY + 3), (unsigned)SCAN_SNAPSHOT_CAPACITY,
+        (unsigned)NETWORK_TABLE_CAPACITY, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
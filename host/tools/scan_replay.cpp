@@ -0,0 +1,54 @@
+/*
+ * Replays scripted scan cycles through printScannedNetworks() and prints
+ * the serial output, or a random scan when no script is given.
+ *
+ * Usage: scan_replay [script.txt]
+ *        scan_replay --random <networks> [cycles]
+ */
+
+#include "sketch.h"
+#include "scan_script.h"
+
+#include <stdio.h>
+
+static void runCycle(const ScanCycle &cycle) {
+    Zigbee.mockSetScanResults(cycle.data(), (uint16_t)cycle.size());
+    Zigbee.scanNetworks();
+    mockAdvanceMillis(Zigbee.mockScanDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, 5));
+    int16_t status = Zigbee.scanComplete();
+    if (status > 0) {
+        printScannedNetworks(status);
+    } else {
+        Serial.println("\nNo networks found, will scan again soon...");
+    }
+}
+
+int main(int argc, char **argv) {
+    std::vector<ScanCycle> cycles;
+
+    if (argc >= 3 && strcmp(argv[1], "--random") == 0) {
+        int networks = atoi(argv[2]);
+        int count = argc >= 4 ? atoi(argv[3]) : 1;
+        ScanCycle cycle;
+        generateScanCycle(cycle, (uint16_t)networks, 1);
+        for (int i = 0; i < count; i++) {
+            cycles.push_back(cycle);
+            perturbScanCycle(cycle, i + 2);
+        }
+    } else {
+        const char *path = argc >= 2 ? argv[1] : ZIGBEE_SCANNER_HOST_DIR "/scripts/readme_example.txt";
+        if (!loadScanScript(path, cycles)) {
+            fprintf(stderr, "Cannot read scan script %s\n", path);
+            return 1;
+        }
+    }
+
+    Serial.mockSetEcho(true);
+    initializeStats();
+    for (const ScanCycle &cycle : cycles) {
+        runCycle(cycle);
+        mockAdvanceMillis(SCAN_INTERVAL_NORMAL);
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Merges the binary telemetry of several scanners (built with
+ * REPORT_MODE_BINARY or REPORT_MODE_BOTH) into one site view and prints it
+ * every few seconds and when every stream has ended or on Ctrl-C. A
+ * scanner's networks leave the view when its stream ends, so for captures
+ * the periodic prints are the ones with networks.
+ *
+ * Usage: site_monitor [--interval <s>] <source>...
+ *   source: serial:/dev/ttyACM0[@baud], file:capture.bin, unix:/path.sock
+ *           or a plain path (see host/aggregator/byte_source.h)
+ *   --interval 0 prints only at the end
+ */
+
+#include "aggregator/site_aggregator.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static SiteAggregator *running = NULL;
+
+static void onSignal(int) {
+    if (running) running->stop();
+}
+
+int main(int argc, char **argv) {
+    unsigned interval = 10;
+    int first = 1;
+    if (argc >= 3 && strcmp(argv[1], "--interval") == 0) {
+        interval = (unsigned)atoi(argv[2]);
+        first = 3;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [--interval <s>] <source>...\n", argv[0]);
+        return 2;
+    }
+
+    SiteAggregator aggregator;
+    for (int i = first; i < argc; i++) {
+        std::string error;
+        std::unique_ptr<ByteSource> source = openByteSource(argv[i], error);
+        if (!source) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        aggregator.addSource(std::move(source));
+    }
+
+    running = &aggregator;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    aggregator.run([](const SiteView &view) {
+        view.print(stdout);
+        fflush(stdout);
+    }, interval * 1000);
+    running = NULL;
+
+    aggregator.view().print(stdout);
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * Replays recorded scans through the analysis once per threshold set and
+ * prints, per set, the alerts raised, their flaps and the alerts on per
+ * sighting (see replay/threshold_sweep.h).
+ *
+ * Usage: threshold_sweep [--threads N] [--csv] <history.bin> [name=from:to:step]...
+ *        threshold_sweep [--threads N] [--csv] --synthetic <networks> <scans> [name=from:to:step]...
+ *
+ * Each name=from:to:step sweeps one AnalysisThresholds field (lossWarning,
+ * lossCritical, trendDelta, weakSignal, highLoad, lossMinScans,
+ * shiftSeverity, shiftScans, overloadedChannel); the others keep their
+ * defaults. Without any, a grid of 729 sets over the loss, trend,
+ * signal and load thresholds. Sets with lossCritical <= lossWarning are
+ * skipped. --threads defaults to the number of cores.
+ */
+
+#include "replay/threshold_sweep.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+struct SweepAxis {
+    const char *name;
+    uint8_t AnalysisThresholds::*field;
+    std::vector<uint8_t> values;
+};
+
+static SweepAxis axes[] = {
+    { "lossWarning", &AnalysisThresholds::lossWarning, {} },
+    { "lossCritical", &AnalysisThresholds::lossCritical, {} },
+    { "trendDelta", &AnalysisThresholds::trendDelta, {} },
+    { "weakSignal", &AnalysisThresholds::weakSignal, {} },
+    { "highLoad", &AnalysisThresholds::highLoad, {} },
+    { "lossMinScans", &AnalysisThresholds::lossMinScans, {} },
+    { "shiftSeverity", &AnalysisThresholds::shiftSeverity, {} },
+    { "shiftScans", &AnalysisThresholds::shiftScans, {} },
+    { "overloadedChannel", &AnalysisThresholds::overloadedChannel, {} },
+};
+
+static void setRange(SweepAxis &axis, unsigned from, unsigned to, unsigned step) {
+    axis.values.clear();
+    for (unsigned v = from; v <= to && v <= 255; v += step ? step : 1) axis.values.push_back((uint8_t)v);
+}
+
+static bool parseAxis(const char *arg) {
+    char name[32];
+    unsigned from, to, step = 1;
+    if (sscanf(arg, "%31[A-Za-z]=%u:%u:%u", name, &from, &to, &step) < 3) return false;
+    for (SweepAxis &axis : axes) {
+        if (strcmp(axis.name, name) == 0) {
+            setRange(axis, from, to, step);
+            return !axis.values.empty();
+        }
+    }
+    return false;
+}
+
+// Every combination of the axes' values
+static void buildSets(std::vector<AnalysisThresholds> &sets) {
+    std::vector<AnalysisThresholds> partial(1, DEFAULT_ANALYSIS_THRESHOLDS);
+    for (const SweepAxis &axis : axes) {
+        if (axis.values.empty()) continue;
+        std::vector<AnalysisThresholds> next;
+        for (const AnalysisThresholds &t : partial) {
+            for (uint8_t v : axis.values) {
+                AnalysisThresholds set = t;
+                set.*axis.field = v;
+                next.push_back(set);
+            }
+        }
+        partial.swap(next);
+    }
+    for (const AnalysisThresholds &t : partial) {
+        if (t.lossCritical > t.lossWarning) sets.push_back(t);
+    }
+}
+
+// The swept fields of a set, or their names
+static void printThresholds(const AnalysisThresholds *t, char sep) {
+    bool first = true;
+    for (const SweepAxis &axis : axes) {
+        if (axis.values.empty()) continue;
+        if (!first) putchar(sep);
+        if (t) printf("%u", t->*axis.field);
+        else fputs(axis.name, stdout);
+        first = false;
+    }
+}
+
+static const char *alertNames[NETWORK_ALERT_KINDS] = {
+    "weak", "falling", "shift", "loss", "highloss", "load", "crowded",
+};
+
+int main(int argc, char **argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    bool csv = false;
+    ScanArchive archive;
+    bool loaded = false;
+    bool swept = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "--synthetic") == 0 && i + 2 < argc) {
+            generateArchive(archive, (uint16_t)atoi(argv[i + 1]), (uint32_t)atoi(argv[i + 2]), 1);
+            loaded = true;
+            i += 2;
+        } else if (strchr(argv[i], '=')) {
+            if (!parseAxis(argv[i])) {
+                fprintf(stderr, "bad sweep %s\n", argv[i]);
+                return 2;
+            }
+            swept = true;
+        } else if (!loaded) {
+            if (!loadHistoryArchive(argv[i], archive)) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+            loaded = true;
+        }
+    }
+    if (!loaded) {
+        fprintf(stderr, "usage: %s [--threads N] [--csv] (<history.bin> | --synthetic <networks> <scans>) "
+            "[name=from:to:step]...\n", argv[0]);
+        return 2;
+    }
+    if (!swept) {
+        setRange(axes[0], 5, 30, 5);      // lossWarning
+        setRange(axes[1], 10, 40, 5);     // lossCritical
+        setRange(axes[2], 3, 9, 3);       // trendDelta
+        setRange(axes[3], 0x20, 0x60, 0x20);
+        setRange(axes[4], 70, 90, 10);
+    }
+
+    std::vector<AnalysisThresholds> sets;
+    buildSets(sets);
+    std::vector<SweepResult> results;
+    auto start = std::chrono::steady_clock::now();
+    sweepThresholds(archive, sets, threads, results);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (csv) {
+        printThresholds(NULL, ',');
+        printf(",sightings");
+        for (const char *name : alertNames) printf(",%s_raised,%s_flaps,%s_active", name, name, name);
+        printf("\n");
+        for (size_t s = 0; s < sets.size(); s++) {
+            printThresholds(&sets[s], ',');
+            printf(",%llu", (unsigned long long)results[s].sightings);
+            for (int k = 0; k < NETWORK_ALERT_KINDS; k++) {
+                printf(",%llu,%llu,%llu", (unsigned long long)results[s].raised[k],
+                    (unsigned long long)results[s].flaps[k], (unsigned long long)results[s].active[k]);
+            }
+            printf("\n");
+        }
+    } else {
+        printf("# %lu scans, %zu sightings, %zu threshold sets on %u threads in %.2f s\n",
+            results.empty() ? 0UL : (unsigned long)results[0].scans, archive.records.size(), sets.size(),
+            max(threads, 1u), seconds);
+        printf("# ");
+        printThresholds(NULL, '/');
+        printf(" | raised flaps on/sighting | loss raised/flaps\n");
+        for (size_t s = 0; s < sets.size(); s++) {
+            const SweepResult &r = results[s];
+            uint64_t loss = r.raised[3] + r.raised[4], lossFlaps = r.flaps[3] + r.flaps[4];
+            printThresholds(&sets[s], '/');
+            printf("  %8llu %6llu %6.3f  %llu/%llu\n", (unsigned long long)sweepTotal(r.raised),
+                (unsigned long long)sweepTotal(r.flaps), r.sightings ? (double)sweepTotal(r.active) / r.sightings : 0.0,
+                (unsigned long long)loss, (unsigned long long)lossFlaps);
+        }
+    }
+    return 0;
+}
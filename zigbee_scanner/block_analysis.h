@@ -3,105 +3,216 @@
 
 #include "block_definitions.h"
 #include "block_helpers.h"
+#include "block_network_table.h"
+#include "block_change_events.h"
+#include "block_fixed_point.h"
+#include "block_thresholds.h"
+#include "block_channel_score.h"
 
-// Channel statistics update function
-void updateChannelStats(zigbee_scan_result_t *scan_result, uint16_t networksFound) {
-    for(int i = 0; i < networksFound; i++) {
-        uint8_t channel = scan_result[i].logic_channel;
-        if(channel >= MIN_CHANNEL && channel <= MAX_CHANNEL) {
-            // Additional statistics may be added here in the future
-        }
+// Completed scans per channel, the beacons a network there should have sent
+SCANNER_INSTANCE uint32_t channelScans[CHANNEL_COUNT];
+
+// Counts the scan on every channel it covered, whether or not anything
+// answered (a failed scan covers nothing)
+void updateChannelStats(const ScanSnapshot *scan) {
+    for(int ch = MIN_CHANNEL; ch <= MAX_CHANNEL; ch++) {
+        if(scan->channelMask & (1UL << ch)) channelScans[ch - MIN_CHANNEL]++;
     }
 }
 
-// Network statistics update function
-void updateNetworkStats(int idx, zigbee_scan_result_t *network) {
-    uint8_t* raw = (uint8_t*)&network->short_pan_id;
-    uint16_t rawSignal = (raw[0] << 8) | raw[1];
-    uint8_t signalStrength = (rawSignal >> 8) & 0xFF;
-    uint8_t networkLoad = (raw[4] * 100) / 255;
-
-    // Save the value to history
-    networkStats[idx].signalHistory[networkStats[idx].signalHistoryIndex] = signalStrength;
-    networkStats[idx].signalHistoryIndex = (networkStats[idx].signalHistoryIndex + 1) % SIGNAL_HISTORY_SIZE;
-    if (networkStats[idx].signalHistoryCount < SIGNAL_HISTORY_SIZE) {
-        networkStats[idx].signalHistoryCount++;
+// Beacon counters of a sighting: the scans of its channel since the last
+// one that it did not answer were misses
+static void updateLinkCounters(NetworkStats *stats, const ScanSnapshot *scan, uint16_t idx) {
+    uint8_t channel = scan->channel[idx];
+    if(stats->beaconsExpected == 0) stats->firstSeen = scan->timestamp;
+    stats->lastSeen = scan->timestamp;
+    if(channel < MIN_CHANNEL || channel > MAX_CHANNEL) return;
+
+    uint32_t scans = channelScans[channel - MIN_CHANNEL];
+    if(stats->beaconsExpected == 0 || stats->channel != channel) {
+        // First sighting, or it moved: counting goes on from its new channel
+        stats->channel = channel;
+        stats->missStreak = 0;
+    } else if(scans == stats->channelScansSeen) {
+        return;                   // listed twice in one scan
+    } else {
+        uint32_t missed = scans - stats->channelScansSeen - 1;
+        stats->beaconsExpected += missed;
+        stats->beaconsMissed += missed;
+        stats->missStreak = (uint16_t)min(missed, (uint32_t)0xFFFF);
+        stats->longestMissStreak = max(stats->longestMissStreak, stats->missStreak);
     }
+    stats->beaconsExpected++;
+    stats->channelScansSeen = scans;
+}
+
+// Network statistics update function
+void updateNetworkStats(NetworkStats *stats, const ScanSnapshot *scan, uint16_t idx) {
+    uint8_t signalStrength = scan->signal[idx];
+    uint8_t networkLoad = scan->load[idx];
+    SignalStats<SIGNAL_HISTORY_SIZE> *signal = &networkSeries(&networkTable, stats)->signal;
 
-    // Update min/max/avg based on history
-    networkStats[idx].minSignalStrength = 255;
-    networkStats[idx].maxSignalStrength = 0;
-    uint32_t sum = 0;
+    signalStatsAdd(signal, signalStrength);
+    stats->minSignalStrength = signalStatsMin(signal);
+    stats->maxSignalStrength = signalStatsMax(signal);
+    stats->avgSignalStrength = signalStatsMean(signal);
 
-    for (int i = 0; i < networkStats[idx].signalHistoryCount; i++) {
-        uint8_t value = networkStats[idx].signalHistory[i];
-        networkStats[idx].minSignalStrength = min(networkStats[idx].minSignalStrength, value);
-        networkStats[idx].maxSignalStrength = max(networkStats[idx].maxSignalStrength, value);
-        sum += value;
+    // Trend: the EWMA runs ahead of the window mean while the signal moves
+    int trend = signalStatsEwma(signal) - stats->avgSignalStrength;
+    if(trend > analysisThresholds.trendDelta) {
+        stats->signalTrend = 1;
+    } else if(trend < -analysisThresholds.trendDelta) {
+        stats->signalTrend = 2;
+    } else {
+        stats->signalTrend = 0;
     }
 
-    networkStats[idx].avgSignalStrength = sum / networkStats[idx].signalHistoryCount;
+    stats->lastSignalStrength = signalStrength;
+    stats->maxNetworkLoad = max(networkLoad, stats->maxNetworkLoad);
+    stats->isCoordinator = (scan->flags[idx] & NETWORK_FLAG_COORDINATOR) != 0;
+    updateLinkCounters(stats, scan, idx);
+}
 
-    // Trend detection
-    if(networkStats[idx].lastSignalStrength > 0) {
-        if(abs(signalStrength - networkStats[idx].lastSignalStrength) > 10) {
-            networkStats[idx].signalTrend = (signalStrength > networkStats[idx].lastSignalStrength) ? 1 : 2;
-        } else {
-            networkStats[idx].signalTrend = 0;
-        }
+// Tracks every network of a scan, folds it into its stats and marks its
+// history entry as seen. The stats stay reachable through scanStats[].
+void updateScanStats(const ScanSnapshot *scan) {
+    for(int i = 0; i < scan->count; i++) {
+        NetworkStats *stats = trackNetwork(&networkTable, scan->panId[i], scan->extendedPanId[i]);
+        updateNetworkStats(stats, scan, i);
+        scanStats[i] = stats;
+
+        NetworkHistory *previous = findNetworkHistory(stats, scan->panId[i], scan->extendedPanId[i]);
+        if(previous) previous->lastScanSeen = scan->sequence;
     }
-    
-    networkStats[idx].lastSignalStrength = signalStrength;
-    networkStats[idx].maxNetworkLoad = max(networkLoad, networkStats[idx].maxNetworkLoad);
-    networkStats[idx].isCoordinator = isCoordinator(network);
-    networkStats[idx].uptime += 5;
-    networkStats[idx].totalPackets++;
-
-    // Error simulation
-    if(random(100) < 5) networkStats[idx].failedPackets++;
-    if(random(100) < 8) networkStats[idx].retriesCount++;
 }
 
 // Network analysis function
-String getNetworkAnalysis(int idx) {
-    String result = "";
-    NetworkStats *stats = &networkStats[idx];
-    
-    // Signal stability analysis
-    float signalVariation = stats->maxSignalStrength - stats->minSignalStrength;
-    if(signalVariation > 50) {
-        result += "(!!) High signal variation\n";
-        result += String("     Signal range: ") + String(stats->minSignalStrength) + 
-                 " to " + String(stats->maxSignalStrength) + "\n";
+void getNetworkAnalysis(NetworkStats *stats, Print &out) {
+    // Signal level changes found by the change detector
+    const NetworkSeries *series = networkSeries(&networkTable, stats);
+    if(recentSignalShift(stats)) {
+        const ChangePoint *shift = &series->signalShift;
+        out.print(shift->severity == CHANGE_CRITICAL ? "(!!) Signal level changed\n" : "(!) Signal level changed\n");
+        out.printf("     %s from %d to %d (signal index), %u scans ago\n", shift->direction > 0 ? "Rose" : "Fell",
+            shift->before, shift->after, series->scansSinceShift);
     }
     
-    // Packet loss analysis
-    if(stats->totalPackets > 0) {
-        float lossRate = (float)stats->failedPackets / stats->totalPackets * 100;
-        if(lossRate > 20) {
-            result += "(!!) High packet loss rate\n";
-            result += String("     Loss rate: ") + String(lossRate, 1) + "%\n";
-        } else if(lossRate > 10) {
-            result += "(!) Moderate packet loss\n";
-            result += String("     Loss rate: ") + String(lossRate, 1) + "%\n";
+    // Beacon loss analysis
+    if(stats->beaconsExpected >= analysisThresholds.lossMinScans) {
+        Q24 lossRate = qPercent(stats->beaconsMissed, stats->beaconsExpected);
+        if(lossRate.raw > qFromInt<24>(analysisThresholds.lossCritical).raw) {
+            out.print("(!!) High beacon loss rate\n");
+            out.print("     Loss rate: ");
+            qPrint(out, lossRate, 1);
+            out.print("%\n");
+        } else if(lossRate.raw > qFromInt<24>(analysisThresholds.lossWarning).raw) {
+            out.print("(!) Moderate beacon loss\n");
+            out.print("     Loss rate: ");
+            qPrint(out, lossRate, 1);
+            out.print("%\n");
         }
     }
-    
-    return result;
+}
+
+// The issues above and in the recommendations as bits, for counting them
+// (the host threshold sweep)
+#define NETWORK_ALERT_WEAK_SIGNAL  0x01   // signal below weakSignal
+#define NETWORK_ALERT_FALLING      0x02   // signal trend down
+#define NETWORK_ALERT_SIGNAL_SHIFT 0x04   // recent signal level change
+#define NETWORK_ALERT_LOSS         0x08   // beacon loss above lossWarning
+#define NETWORK_ALERT_HIGH_LOSS    0x10   // beacon loss above lossCritical
+#define NETWORK_ALERT_HIGH_LOAD    0x20   // load above highLoad
+#define NETWORK_ALERT_CROWDED      0x40   // more than overloadedChannel networks on its channel
+#define NETWORK_ALERT_KINDS        7
+
+// Alerts of network i of an analysed scan under analysisThresholds
+uint8_t networkAlerts(const ScanSnapshot *scan, uint16_t i, const NetworkStats *stats) {
+    const AnalysisThresholds *t = &analysisThresholds;
+    uint8_t alerts = 0;
+    if(scan->signal[i] < t->weakSignal) alerts |= NETWORK_ALERT_WEAK_SIGNAL;
+    if(stats->signalTrend == 2) alerts |= NETWORK_ALERT_FALLING;
+    if(recentSignalShift(stats)) alerts |= NETWORK_ALERT_SIGNAL_SHIFT;
+    if(stats->beaconsExpected >= t->lossMinScans) {
+        Q24 lossRate = qPercent(stats->beaconsMissed, stats->beaconsExpected);
+        if(lossRate.raw > qFromInt<24>(t->lossCritical).raw) alerts |= NETWORK_ALERT_HIGH_LOSS;
+        else if(lossRate.raw > qFromInt<24>(t->lossWarning).raw) alerts |= NETWORK_ALERT_LOSS;
+    }
+    if(scan->load[i] > t->highLoad) alerts |= NETWORK_ALERT_HIGH_LOAD;
+    uint8_t ch = scan->channel[i];
+    if(ch >= MIN_CHANNEL && ch <= MAX_CHANNEL && channelRanking.channels[ch - MIN_CHANNEL].networks > t->overloadedChannel) {
+        alerts |= NETWORK_ALERT_CROWDED;
+    }
+    return alerts;
+}
+
+// Whether a network from the history answered this scan
+bool networkSeenInScan(const NetworkHistory *network, const ScanSnapshot *scan) {
+    return network->lastScanSeen == scan->sequence;
+}
+
+// The previous scan's entry for a tracked network, NULL if it has none
+NetworkHistory *findNetworkHistory(const NetworkStats *stats, uint16_t panId, uint64_t extPanId) {
+    if(!stats || stats->historyIndex >= previousNetworksCount) return NULL;
+    NetworkHistory *entry = &previousScan[stats->historyIndex];
+    return (entry->panId == panId && entry->extendedPanId == extPanId) ? entry : NULL;
+}
+
+// Whether a tracked network answered this scan: its beacon count is up to
+// date on a channel the scan covered. Unlike networkSeenInScan() it does
+// not depend on which history entry the network points to.
+static bool networkStatsInScan(const NetworkStats *stats, const ScanSnapshot *scan) {
+    uint8_t ch = stats->channel;
+    return ch >= MIN_CHANNEL && ch <= MAX_CHANNEL && (scan->channelMask & (1UL << ch)) &&
+        stats->beaconsExpected > 0 && stats->channelScansSeen == channelScans[ch - MIN_CHANNEL];
 }
 
 // Saving scan results
-void saveNetworkHistory(zigbee_scan_result_t *scan_result, uint16_t networksFound) {
-    previousNetworksCount = networksFound;
-    for(int i = 0; i < networksFound && i < MAX_NETWORKS; i++) {
-        uint8_t* raw = (uint8_t*)&scan_result[i];
-        uint16_t rawSignal = (raw[0] << 8) | raw[1];
-        
-        previousScan[i].panId = scan_result[i].short_pan_id;
-        previousScan[i].channel = scan_result[i].logic_channel;
-        previousScan[i].signalStrength = (rawSignal >> 8) & 0xFF;
-        previousScan[i].networkLoad = (raw[4] * 100) / 255;
+void saveNetworkHistory(const ScanSnapshot *scan) {
+    // The scan's networks always fit (MAX_NETWORKS is the snapshot size).
+    // The room they leave keeps what was seen on channels this scan did not
+    // cover, then networks that just left, so they are reported gone only
+    // once and can come back; the old entry of a network that moved into
+    // the scan goes.
+    int candidates = 0;
+    for(int i = 0; i < previousNetworksCount; i++) {
+        NetworkHistory *network = &previousScan[i];
+        if(networkSeenInScan(network, scan)) continue;
+        if(scan->channelMask & (1UL << network->channel)) {
+            if(!network->wasPresent) continue;
+            network->wasPresent = false;
+        }
+        const NetworkStats *stats = findNetworkStats(&networkTable, network->panId, network->extendedPanId);
+        if(stats && networkStatsInScan(stats, scan)) continue;
+        previousScan[candidates++] = *network;
+    }
+
+    int room = MAX_NETWORKS - scan->count;
+    int dropLeft = max(candidates - room, 0);
+    int kept = 0;
+    for(int i = 0; i < candidates && kept < room; i++) {
+        NetworkHistory *network = &previousScan[i];
+        if(!network->wasPresent && dropLeft > 0) {
+            dropLeft--;
+            continue;
+        }
+        previousScan[kept] = *network;
+        NetworkStats *stats = findNetworkStats(&networkTable, network->panId, network->extendedPanId);
+        if(stats) stats->historyIndex = kept;
+        kept++;
+    }
+
+    previousNetworksCount = kept + scan->count;
+    for(int idx = 0; idx < scan->count; idx++) {
+        int i = kept + idx;
+        previousScan[i].panId = scan->panId[idx];
+        previousScan[i].extendedPanId = scan->extendedPanId[idx];
+        previousScan[i].channel = scan->channel[idx];
+        previousScan[i].signalStrength = scan->signal[idx];
+        previousScan[i].networkLoad = scan->load[idx];
+        previousScan[i].flags = scan->flags[idx];
         previousScan[i].wasPresent = true;
+        previousScan[i].lastScanSeen = scan->sequence;
+        if(scanStats[idx]) scanStats[idx]->historyIndex = i;
     }
 }
 
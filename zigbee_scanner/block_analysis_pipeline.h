@@ -0,0 +1,146 @@
+#ifndef ZIGBEE_SCANNER_ANALYSIS_PIPELINE_H
+#define ZIGBEE_SCANNER_ANALYSIS_PIPELINE_H
+
+#include "block_definitions.h"
+#include "block_cycle_profile.h"
+
+// Per-stage timing of the analysis pipeline
+#ifndef ANALYSIS_TIMING
+#define ANALYSIS_TIMING 1
+#endif
+
+// Clock for the stage timing, in microseconds on the target (host tools
+// substitute a CPU clock with finer ticks)
+#ifndef ANALYSIS_CLOCK
+#define ANALYSIS_CLOCK() micros()
+#endif
+
+// What a stage reads and produces (AnalysisStage::reads / writes)
+#define ANALYSIS_SCAN       0x01   // decoded scan, the pipeline input
+#define ANALYSIS_STATS      0x02   // networkTable / scanStats[] updated
+#define ANALYSIS_SELECTION  0x04   // reportSelection
+#define ANALYSIS_ENERGY     0x08   // currentAnalysis from energy detect
+#define ANALYSIS_RANKING    0x10   // channelRanking
+#define ANALYSIS_COVERAGE   0x20   // channelScans[] counted
+#define ANALYSIS_CHANGES    0x40   // changeLog and the networks' change detectors
+#define ANALYSIS_ROLLUPS    0x80   // the networks' rollup stores
+
+// When a stage runs (AnalysisStage::level); a run at one level runs every
+// stage up to it
+#define STAGE_ALWAYS 0             // every completed scan
+#define STAGE_REPORT 1             // scans that are reported
+#define STAGE_TEXT   2             // reported as text
+#define STAGE_LEVELS 3
+
+struct AnalysisContext {
+    const ScanSnapshot *scan;
+    ReportSelection *selection;
+    unsigned long now;
+    uint8_t level;
+};
+
+struct AnalysisStageTiming {
+    const char *name;
+    uint32_t runs;
+    uint32_t lastMicros;
+    uint32_t maxMicros;
+    uint64_t totalMicros;
+};
+
+// A stage is a type with
+//   static constexpr const char *name;
+//   static constexpr bool enabled;      // false: never instantiated, no code
+//   static constexpr uint8_t level;     // STAGE_*
+//   static constexpr uint8_t reads;     // ANALYSIS_* it needs
+//   static constexpr uint8_t writes;    // ANALYSIS_* it produces
+//   static void run(AnalysisContext *ctx);
+// Stages run in list order. Each one may only read what the input or an
+// enabled earlier stage of the same or a lower level produced.
+template<typename... Stages>
+constexpr bool analysisContractsHold() {
+    uint8_t available[STAGE_LEVELS] = { ANALYSIS_SCAN, ANALYSIS_SCAN, ANALYSIS_SCAN };
+    bool ok = true;
+    auto check = [&](bool enabled, uint8_t level, uint8_t reads, uint8_t writes) {
+        if(!enabled) return;
+        if(level >= STAGE_LEVELS || (reads & ~available[level]) != 0) ok = false;
+        for(uint8_t l = level; l < STAGE_LEVELS; l++) available[l] |= writes;
+    };
+    (check(Stages::enabled, Stages::level, Stages::reads, Stages::writes), ...);
+    return ok;
+}
+
+template<typename... Stages>
+struct AnalysisPipeline {
+    static_assert(analysisContractsHold<Stages...>(),
+                  "an analysis stage reads something no enabled earlier stage produces");
+
+    static constexpr uint8_t STAGE_COUNT = (0 + ... + (Stages::enabled ? 1 : 0));
+
+#if ANALYSIS_TIMING
+    AnalysisStageTiming timing[STAGE_COUNT > 0 ? STAGE_COUNT : 1];
+#endif
+
+    void begin() {
+#if ANALYSIS_TIMING
+        memset(timing, 0, sizeof(timing));
+        uint8_t i = 0;
+        ((Stages::enabled ? (void)(timing[i++].name = Stages::name) : (void)0), ...);
+#endif
+    }
+
+    void run(AnalysisContext *ctx) {
+        uint8_t i = 0;
+        (runStage<Stages>(ctx, &i), ...);
+    }
+
+private:
+    template<typename Stage>
+    void runStage(AnalysisContext *ctx, uint8_t *index) {
+        if constexpr (Stage::enabled) {
+            uint8_t i = (*index)++;
+            if(Stage::level > ctx->level) return;
+            if constexpr (Stage::level == STAGE_TEXT) {
+                CYCLE_PHASE(PHASE_TEXT);
+                timeStage<Stage>(ctx, i);
+            } else {
+                timeStage<Stage>(ctx, i);
+            }
+        }
+    }
+
+    template<typename Stage>
+    void timeStage(AnalysisContext *ctx, uint8_t i) {
+#if ANALYSIS_TIMING
+        unsigned long start = ANALYSIS_CLOCK();
+        Stage::run(ctx);
+        uint32_t elapsed = (uint32_t)(ANALYSIS_CLOCK() - start);
+        AnalysisStageTiming *t = &timing[i];
+        t->runs++;
+        t->lastMicros = elapsed;
+        t->totalMicros += elapsed;
+        if(elapsed > t->maxMicros) t->maxMicros = elapsed;
+#else
+        (void)i;
+        Stage::run(ctx);
+#endif
+    }
+};
+
+template<typename... Stages>
+void printAnalysisTiming(const AnalysisPipeline<Stages...> *pipeline, Print &out) {
+#if ANALYSIS_TIMING
+    out.print("Stage                 Runs   Last us   Mean us    Max us\n");
+    for(uint8_t i = 0; i < AnalysisPipeline<Stages...>::STAGE_COUNT; i++) {
+        const AnalysisStageTiming *t = &pipeline->timing[i];
+        out.printf("%-20s %5lu %9lu %9lu %9lu\n", t->name, (unsigned long)t->runs,
+            (unsigned long)t->lastMicros,
+            (unsigned long)(t->runs ? t->totalMicros / t->runs : 0),
+            (unsigned long)t->maxMicros);
+    }
+#else
+    (void)pipeline;
+    out.print("Analysis timing is off (ANALYSIS_TIMING 0)\n");
+#endif
+}
+
+#endif // ZIGBEE_SCANNER_ANALYSIS_PIPELINE_H
@@ -0,0 +1,223 @@
+#ifndef ZIGBEE_SCANNER_ANALYSIS_STAGES_H
+#define ZIGBEE_SCANNER_ANALYSIS_STAGES_H
+
+#include "block_definitions.h"
+#include "block_helpers.h"
+#include "block_analysis.h"
+#include "block_delta_report.h"
+#include "block_analysis_pipeline.h"
+#include "block_energy_detect.h"
+#include "block_channel_score.h"
+#include "interference_analysis.h"
+#include "smart_recommendations.h"
+#include "block_change_events.h"
+#include "block_rollups.h"
+
+// Interference analysis of the reported channels in text reports
+#ifndef ANALYSIS_INTERFERENCE
+#define ANALYSIS_INTERFERENCE 0
+#endif
+
+// Smart recommendations at the end of text reports
+#ifndef ANALYSIS_RECOMMENDATIONS
+#define ANALYSIS_RECOMMENDATIONS 0
+#endif
+
+// Per-scan analysis, in order: what each stage needs is produced above it
+// (checked at compile time)
+
+// Every completed scan counts for the channels it covered, so networks
+// that did not answer are seen to miss it
+struct ChannelCoverageStage {
+    static constexpr const char *name = "channel coverage";
+    static constexpr bool enabled = true;
+    static constexpr uint8_t level = STAGE_ALWAYS;
+    static constexpr uint8_t reads = ANALYSIS_SCAN;
+    static constexpr uint8_t writes = ANALYSIS_COVERAGE;
+    static void run(AnalysisContext *ctx) { updateChannelStats(ctx->scan); }
+};
+
+struct NetworkStatsStage {
+    static constexpr const char *name = "network stats";
+    static constexpr bool enabled = true;
+    static constexpr uint8_t level = STAGE_REPORT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_COVERAGE;
+    static constexpr uint8_t writes = ANALYSIS_STATS;
+    static void run(AnalysisContext *ctx) {
+        CYCLE_PHASE(PHASE_STATS);
+        updateScanStats(ctx->scan);
+    }
+};
+
+struct ReportSelectionStage {
+    static constexpr const char *name = "report selection";
+    static constexpr bool enabled = true;
+    static constexpr uint8_t level = STAGE_REPORT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_STATS;
+    static constexpr uint8_t writes = ANALYSIS_SELECTION;
+    static void run(AnalysisContext *ctx) { selectReportedNetworks(ctx->scan, ctx->selection); }
+};
+
+struct EnergyWindowStage {
+    static constexpr const char *name = "energy window";
+    static constexpr bool enabled = ENERGY_DETECT;
+    static constexpr uint8_t level = STAGE_ALWAYS;
+    static constexpr uint8_t reads = 0;
+    static constexpr uint8_t writes = ANALYSIS_ENERGY;
+    static void run(AnalysisContext *ctx) { analyzeEnergyWindow(&energySampler, ctx->now); }
+};
+
+// Energy data is optional: without it WiFi 1/6/11 are assumed
+struct ChannelRankingStage {
+    static constexpr const char *name = "channel ranking";
+    static constexpr bool enabled = true;
+    static constexpr uint8_t level = STAGE_ALWAYS;
+    static constexpr uint8_t reads = ANALYSIS_SCAN;
+    static constexpr uint8_t writes = ANALYSIS_RANKING;
+    static void run(AnalysisContext *ctx) { rankChannels(&channelRanking, ctx->scan, currentAnalysis); }
+};
+
+// Without energy detect only the channels' Zigbee load is watched
+struct ChannelChangeStage {
+    static constexpr const char *name = "channel changes";
+    static constexpr bool enabled = CHANGE_DETECT;
+    static constexpr uint8_t level = STAGE_ALWAYS;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | (ENERGY_DETECT ? ANALYSIS_ENERGY : 0);
+    static constexpr uint8_t writes = 0;
+    static void run(AnalysisContext *ctx) { detectChannelChanges(&changeLog, ctx->scan, currentAnalysis, ctx->now); }
+};
+
+struct NetworkChangeStage {
+    static constexpr const char *name = "network changes";
+    static constexpr bool enabled = CHANGE_DETECT;
+    static constexpr uint8_t level = STAGE_REPORT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_STATS;
+    static constexpr uint8_t writes = ANALYSIS_CHANGES;
+    static void run(AnalysisContext *ctx) { detectNetworkChanges(&changeLog, ctx->scan); }
+};
+
+// Every covered channel into its rollup store
+struct ChannelRollupStage {
+    static constexpr const char *name = "channel rollups";
+    static constexpr bool enabled = ROLLUPS;
+    static constexpr uint8_t level = STAGE_ALWAYS;
+    static constexpr uint8_t reads = ANALYSIS_SCAN;
+    static constexpr uint8_t writes = 0;
+    static void run(AnalysisContext *ctx) {
+#if ROLLUPS
+        updateChannelRollups(&rollups, ctx->scan);
+#else
+        (void)ctx;
+#endif
+    }
+};
+
+struct NetworkRollupStage {
+    static constexpr const char *name = "network rollups";
+    static constexpr bool enabled = ROLLUPS;
+    static constexpr uint8_t level = STAGE_REPORT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_STATS;
+    static constexpr uint8_t writes = ANALYSIS_ROLLUPS;
+    static void run(AnalysisContext *ctx) {
+#if ROLLUPS
+        updateNetworkRollups(&rollups, ctx->scan);
+#else
+        (void)ctx;
+#endif
+    }
+};
+
+struct SummaryTableStage {
+    static constexpr const char *name = "summary table";
+    static constexpr bool enabled = true;
+    static constexpr uint8_t level = STAGE_TEXT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_SELECTION;
+    static constexpr uint8_t writes = 0;
+    static void run(AnalysisContext *ctx) { printSummaryTable(Report, ctx->scan, ctx->selection); }
+};
+
+struct NetworkDiagnosticsStage {
+    static constexpr const char *name = "diagnostics";
+    static constexpr bool enabled = true;
+    static constexpr uint8_t level = STAGE_TEXT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_STATS | ANALYSIS_SELECTION |
+        (CHANGE_DETECT ? ANALYSIS_CHANGES : 0) | (ROLLUPS ? ANALYSIS_ROLLUPS : 0);
+    static constexpr uint8_t writes = 0;
+    static void run(AnalysisContext *ctx) { printNetworkDiagnostics(Report, ctx->scan, ctx->selection); }
+};
+
+// Changes found since the last text report, channel ones included
+struct ChangeReportStage {
+    static constexpr const char *name = "change report";
+    static constexpr bool enabled = CHANGE_DETECT;
+    static constexpr uint8_t level = STAGE_TEXT;
+    static constexpr uint8_t reads = ANALYSIS_CHANGES;
+    static constexpr uint8_t writes = 0;
+    static void run(AnalysisContext *ctx) { (void)ctx; printNewChanges(&changeLog, Report); }
+};
+
+// Once per channel that has a reported network
+struct InterferenceStage {
+    static constexpr const char *name = "interference";
+    static constexpr bool enabled = ANALYSIS_INTERFERENCE;
+    static constexpr uint8_t level = STAGE_TEXT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_SELECTION | ANALYSIS_ENERGY | ANALYSIS_RANKING;
+    static constexpr uint8_t writes = 0;
+    static void run(AnalysisContext *ctx) {
+        uint32_t channels = 0;
+        for(int n = 0; n < ctx->selection->count; n++) {
+            channels |= 1UL << ctx->scan->channel[ctx->selection->index[n]];
+        }
+        if(channels == 0) return;
+        Report.println("\n=== CHANNEL INTERFERENCE ===");
+        for(int ch = MIN_CHANNEL; ch <= MAX_CHANNEL; ch++) {
+            if(!(channels & (1UL << ch))) continue;
+            Report.printf("\nChannel %d:\n", ch);
+            analyzeChannelInterference(ch, channelRanking.order, Report);
+        }
+    }
+};
+
+struct RecommendationsStage {
+    static constexpr const char *name = "recommendations";
+    static constexpr bool enabled = ANALYSIS_RECOMMENDATIONS;
+    static constexpr uint8_t level = STAGE_TEXT;
+    static constexpr uint8_t reads = ANALYSIS_SCAN | ANALYSIS_STATS | ANALYSIS_RANKING |
+        (CHANGE_DETECT ? ANALYSIS_CHANGES : 0);
+    static constexpr uint8_t writes = 0;
+    static void run(AnalysisContext *ctx) { generateSmartRecommendations(Report, ctx->scan); }
+};
+
+typedef AnalysisPipeline<
+    ChannelCoverageStage,
+    NetworkStatsStage,
+    ReportSelectionStage,
+    EnergyWindowStage,
+    ChannelRankingStage,
+    ChannelChangeStage,
+    NetworkChangeStage,
+    ChannelRollupStage,
+    NetworkRollupStage,
+    SummaryTableStage,
+    NetworkDiagnosticsStage,
+    ChangeReportStage,
+    InterferenceStage,
+    RecommendationsStage
+> ScanAnalysis;
+
+SCANNER_INSTANCE ScanAnalysis scanAnalysis;
+
+// The last scan the tables were updated with, and how many have been;
+// text computed on request from older tables is stale
+SCANNER_INSTANCE uint16_t analysedSequence = 0;
+SCANNER_INSTANCE uint32_t analysedScans = 0;
+
+// Runs the stages up to level for a completed scan
+void runScanAnalysis(const ScanSnapshot *scan, uint8_t level) {
+    AnalysisContext ctx = { scan, &reportSelection, millis(), level };
+    scanAnalysis.run(&ctx);
+    analysedSequence = scan->sequence;
+    analysedScans++;
+}
+
+#endif // ZIGBEE_SCANNER_ANALYSIS_STAGES_H
@@ -0,0 +1,147 @@
+#ifndef ZIGBEE_SCANNER_CHANGE_DETECT_H
+#define ZIGBEE_SCANNER_CHANGE_DETECT_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Two-sided CUSUM change detection on one series (signal index, load %, ...),
+// constant memory and time per sample:
+//  - the first CHANGE_WARMUP samples set the reference level and spread
+//  - then every sample's distance from the reference, in spreads, less a
+//    drift allowance, is summed upwards and downwards; a sum beyond
+//    CHANGE_THRESHOLD is a change
+//  - the new level is the mean of the samples since the sum left zero,
+//    and the reference and spread are learnt again from there
+// Slow drifts add up in the sums, so they are caught as well as steps.
+// Samples must lie within -127..127 (levels are kept in Q8 in 16 bits).
+// All zero is the empty state, so memset() resets it.
+
+// Samples that set the reference after a start or a change
+#ifndef CHANGE_WARMUP
+#define CHANGE_WARMUP 16
+#endif
+
+// Drift allowance and alarm threshold, in spreads (Q8)
+#ifndef CHANGE_DRIFT
+#define CHANGE_DRIFT 128          // 0.5
+#endif
+#ifndef CHANGE_THRESHOLD
+#define CHANGE_THRESHOLD 1536     // 6
+#endif
+
+// One sample moves a sum by at most this many spreads (Q8), so a single
+// outlier cannot raise an alarm on its own
+#define CHANGE_STEP_LIMIT 1024
+
+static_assert(CHANGE_WARMUP >= 2 && CHANGE_WARMUP <= 64, "CHANGE_WARMUP must be 2 to 64 samples");
+static_assert(CHANGE_THRESHOLD + CHANGE_STEP_LIMIT <= 32767, "CHANGE_THRESHOLD does not fit the sums");
+
+// ChangePoint::severity, by the size of the change in spreads
+#define CHANGE_NONE     0
+#define CHANGE_MINOR    1         // below 2
+#define CHANGE_MAJOR    2         // 2 to 4
+#define CHANGE_CRITICAL 3         // 4 and more
+
+struct ChangeDetector {
+    int16_t reference;            // Q8 sample units
+    int16_t spread;               // Q8, standard deviation of the warm-up
+    int16_t up;                   // CUSUM sums, Q8 spreads
+    int16_t down;
+    // The warm-up sums are done with before the run totals start
+    union {
+        struct {
+            int32_t sumSquares;
+            int16_t sum;
+        } warmup;
+        struct {
+            int32_t up;           // distance from the reference over the runs, Q8
+            int32_t down;
+        } total;
+    };
+    uint8_t upRun;                // samples since the sum left zero
+    uint8_t downRun;
+    uint8_t learnt;               // warm-up samples so far
+};
+
+struct ChangePoint {
+    uint8_t severity;             // CHANGE_*, CHANGE_NONE when nothing changed
+    int8_t direction;             // +1 rise, -1 drop
+    int16_t before;               // level before and after, sample units
+    int16_t after;
+};
+
+static inline uint32_t changeIsqrt(uint32_t x) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while(bit > x) bit >>= 2;
+    while(bit) {
+        if(x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+static inline int16_t changeLevel(int32_t q8) {
+    return (int16_t)(q8 >= 0 ? (q8 + 128) >> 8 : -((-q8 + 128) >> 8));
+}
+
+// Adds a sample; minSpread (Q8) keeps a quiet warm-up from making every
+// later wobble a change
+static inline ChangePoint changeDetectorAdd(ChangeDetector *d, int16_t value, int16_t minSpread) {
+    ChangePoint change = { CHANGE_NONE, 0, 0, 0 };
+
+    if(d->learnt < CHANGE_WARMUP) {
+        d->warmup.sum += value;
+        d->warmup.sumSquares += (int32_t)value * value;
+        if(++d->learnt == CHANGE_WARMUP) {
+            int32_t n = CHANGE_WARMUP;
+            int32_t scatter = n * d->warmup.sumSquares - (int32_t)d->warmup.sum * d->warmup.sum;  // n^2 * variance
+            uint32_t spread = changeIsqrt((uint32_t)((uint64_t)(scatter > 0 ? scatter : 0) * 65536 / (n * n)));
+            d->reference = (int16_t)(((int32_t)d->warmup.sum * 256) / n);
+            d->spread = (int16_t)(spread > (uint32_t)minSpread ? (spread > 32767 ? 32767 : spread) : minSpread);
+            d->up = d->down = 0;
+            d->total.up = d->total.down = 0;
+            d->upRun = d->downRun = 0;
+        }
+        return change;
+    }
+
+    int32_t distance = (int32_t)value * 256 - d->reference;
+    int32_t z = distance * 256 / d->spread;
+    if(z > CHANGE_STEP_LIMIT) z = CHANGE_STEP_LIMIT;
+    if(z < -CHANGE_STEP_LIMIT) z = -CHANGE_STEP_LIMIT;
+
+    int32_t up = d->up + z - CHANGE_DRIFT;
+    int32_t down = d->down - z - CHANGE_DRIFT;
+    d->up = (int16_t)(up > 0 ? up : 0);
+    d->down = (int16_t)(down > 0 ? down : 0);
+    d->upRun = d->up ? (d->upRun < 255 ? d->upRun + 1 : 255) : 0;
+    d->downRun = d->down ? (d->downRun < 255 ? d->downRun + 1 : 255) : 0;
+    d->total.up = d->up ? d->total.up + distance : 0;
+    d->total.down = d->down ? d->total.down + distance : 0;
+    if(d->up <= CHANGE_THRESHOLD && d->down <= CHANGE_THRESHOLD) return change;
+
+    // Size of the change: the mean distance of the samples since the sum
+    // started to grow (unclamped, so large steps are not cut short)
+    bool rise = d->up > CHANGE_THRESHOLD;
+    int32_t delta = rise ? d->total.up / d->upRun : d->total.down / d->downRun;    // Q8 sample units
+    int32_t shift = (delta < 0 ? -delta : delta) * 256 / d->spread;               // Q8 spreads
+    change.severity = shift < 512 ? CHANGE_MINOR : (shift < 1024 ? CHANGE_MAJOR : CHANGE_CRITICAL);
+    change.direction = rise ? 1 : -1;
+    change.before = changeLevel(d->reference);
+    change.after = changeLevel(d->reference + delta);
+
+    // Learn the new level, starting with this sample
+    memset(d, 0, sizeof(ChangeDetector));
+    d->warmup.sum = value;
+    d->warmup.sumSquares = (int32_t)value * value;
+    d->learnt = 1;
+    return change;
+}
+
+#endif // ZIGBEE_SCANNER_CHANGE_DETECT_H
@@ -0,0 +1,183 @@
+#ifndef ZIGBEE_SCANNER_CHANGE_EVENTS_H
+#define ZIGBEE_SCANNER_CHANGE_EVENTS_H
+
+#include "block_definitions.h"
+#include "block_helpers.h"
+#include "block_change_detect.h"
+#include "block_thresholds.h"
+#include "interference_analysis.h"
+
+// Change detection on every network's signal and load and on every
+// channel's Zigbee load and energy-detect busy time
+#ifndef CHANGE_DETECT
+#define CHANGE_DETECT 1
+#endif
+
+// Changes kept for the "changes" command (power of two)
+#ifndef CHANGE_LOG_SIZE
+#define CHANGE_LOG_SIZE 32
+#endif
+
+static_assert((CHANGE_LOG_SIZE & (CHANGE_LOG_SIZE - 1)) == 0, "CHANGE_LOG_SIZE must be a power of two");
+
+// ChangeEvent::series
+#define CHANGE_SERIES_SIGNAL       0   // network signal index, 0-255
+#define CHANGE_SERIES_LOAD         1   // network load, %
+#define CHANGE_SERIES_CHANNEL_LOAD 2   // summed Zigbee load on the channel, %
+#define CHANGE_SERIES_CHANNEL_BUSY 3   // energy-detect busy time, %
+
+// Smallest spread assumed per series (Q8): about the quantization step,
+// so a steady series does not turn every step into a change
+const int16_t CHANGE_MIN_SPREAD_SIGNAL = 6 * 256;
+const int16_t CHANGE_MIN_SPREAD_LOAD = 3 * 256;
+
+// The signal index (0-255) is fed to its detector around 0, to fit the
+// detector's -127..127; the change's levels are moved back
+const int CHANGE_SIGNAL_OFFSET = 128;
+
+inline ChangePoint changeDetectorAddSignal(ChangeDetector *d, uint8_t signal) {
+    int16_t level = (int16_t)constrain((int)signal - CHANGE_SIGNAL_OFFSET, -127, 127);
+    ChangePoint change = changeDetectorAdd(d, level, CHANGE_MIN_SPREAD_SIGNAL);
+    if(change.severity) {
+        change.before += CHANGE_SIGNAL_OFFSET;
+        change.after += CHANGE_SIGNAL_OFFSET;
+    }
+    return change;
+}
+
+// The network's signal changed by a major step or more lately
+inline bool recentSignalShift(const NetworkStats *stats) {
+    const NetworkSeries *series = networkSeries(&networkTable, stats);
+    return series->signalShift.severity >= analysisThresholds.shiftSeverity &&
+        series->scansSinceShift < analysisThresholds.shiftScans;
+}
+
+struct ChangeEvent {
+    uint32_t time;                // millis() of the scan that completed it
+    uint16_t panId;               // network series only
+    uint8_t channel;
+    uint8_t series;               // CHANGE_SERIES_*
+    uint8_t severity;             // CHANGE_MINOR..CHANGE_CRITICAL
+    int8_t direction;
+    int16_t before;
+    int16_t after;
+};
+
+struct ChangeLog {
+    bool enabled;
+    ChangeEvent events[CHANGE_LOG_SIZE];
+    uint32_t total;               // events ever recorded, the newest is total - 1
+    uint32_t reported;            // events already in a text report
+    ChangeDetector channelLoad[CHANNEL_COUNT];
+    ChangeDetector channelBusy[CHANNEL_COUNT];
+};
+
+SCANNER_INSTANCE ChangeLog changeLog;
+
+void initChangeLog(ChangeLog *log, bool enabled) {
+    memset(log, 0, sizeof(ChangeLog));
+    log->enabled = enabled;
+}
+
+static void recordChange(ChangeLog *log, const ChangePoint *change, uint32_t time,
+                         uint16_t panId, uint8_t channel, uint8_t series) {
+    ChangeEvent *e = &log->events[log->total & (CHANGE_LOG_SIZE - 1)];
+    e->time = time;
+    e->panId = panId;
+    e->channel = channel;
+    e->series = series;
+    e->severity = change->severity;
+    e->direction = change->direction;
+    e->before = change->before;
+    e->after = change->after;
+    log->total++;
+}
+
+// One sample per network of the scan
+void detectNetworkChanges(ChangeLog *log, const ScanSnapshot *scan) {
+    if(!log->enabled) return;
+    for(int i = 0; i < scan->count; i++) {
+        NetworkSeries *series = networkSeries(&networkTable, scanStats[i]);
+        ChangePoint signal = changeDetectorAddSignal(&series->signalChange, scan->signal[i]);
+        ChangePoint load = changeDetectorAdd(&series->loadChange, scan->load[i], CHANGE_MIN_SPREAD_LOAD);
+        if(signal.severity) {
+            recordChange(log, &signal, scan->timestamp, scan->panId[i], scan->channel[i], CHANGE_SERIES_SIGNAL);
+            series->signalShift = signal;
+            series->scansSinceShift = 0;
+        } else if(series->scansSinceShift < 255) {
+            series->scansSinceShift++;
+        }
+        if(load.severity) {
+            recordChange(log, &load, scan->timestamp, scan->panId[i], scan->channel[i], CHANGE_SERIES_LOAD);
+        }
+    }
+}
+
+// One sample per channel the scan covered, and per fresh energy window
+void detectChannelChanges(ChangeLog *log, const ScanSnapshot *scan, const InterferenceAnalysis *analysis,
+                          unsigned long now) {
+    if(!log->enabled) return;
+    uint16_t load[CHANNEL_COUNT] = {0};
+    for(int i = 0; i < scan->count; i++) {
+        int z = scan->channel[i] - MIN_CHANNEL;
+        if(z >= 0 && z < CHANNEL_COUNT) load[z] += scan->load[i];
+    }
+    for(int z = 0; z < CHANNEL_COUNT; z++) {
+        if(scan->channelMask & (1UL << (MIN_CHANNEL + z))) {
+            ChangePoint change = changeDetectorAdd(&log->channelLoad[z], (int16_t)min(load[z], (uint16_t)127),
+                                                   CHANGE_MIN_SPREAD_LOAD);
+            if(change.severity) recordChange(log, &change, scan->timestamp, 0, MIN_CHANNEL + z, CHANGE_SERIES_CHANNEL_LOAD);
+        }
+        if(analysis[z].samples > 0 && analysis[z].measuredAt == now) {
+            ChangePoint change = changeDetectorAdd(&log->channelBusy[z], analysis[z].dutyCycle, CHANGE_MIN_SPREAD_LOAD);
+            if(change.severity) recordChange(log, &change, scan->timestamp, 0, MIN_CHANNEL + z, CHANGE_SERIES_CHANNEL_BUSY);
+        }
+    }
+}
+
+static const char *changeSeriesName(uint8_t series) {
+    switch(series) {
+    case CHANGE_SERIES_SIGNAL: return "signal";
+    case CHANGE_SERIES_LOAD: return "load";
+    case CHANGE_SERIES_CHANNEL_LOAD: return "channel load";
+    default: return "channel busy";
+    }
+}
+
+static const char *changeSeverityName(uint8_t severity) {
+    switch(severity) {
+    case CHANGE_MINOR: return "minor";
+    case CHANGE_MAJOR: return "major";
+    default: return "critical";
+    }
+}
+
+void printChangeEvent(const ChangeEvent *e, Print &out) {
+    const char *unit = e->series == CHANGE_SERIES_SIGNAL ? "" : "%";
+    out.printf("%8lu.%lus  ", (unsigned long)(e->time / 1000), (unsigned long)(e->time % 1000 / 100));
+    if(e->series < CHANGE_SERIES_CHANNEL_LOAD) out.printf("PAN 0x%04x ch %2u  ", e->panId, e->channel);
+    else out.printf("channel %2u       ", e->channel);
+    out.printf("%-12s %s %d%s -> %d%s (%s)\n", changeSeriesName(e->series), e->direction > 0 ? "rose" : "fell",
+        e->before, unit, e->after, unit, changeSeverityName(e->severity));
+}
+
+// Events since the last text report
+void printNewChanges(ChangeLog *log, Print &out) {
+    if(log->reported == log->total) return;
+    uint32_t first = log->total - log->reported > CHANGE_LOG_SIZE ? log->total - CHANGE_LOG_SIZE : log->reported;
+    out.println("\n=== CHANGES ===");
+    for(uint32_t i = first; i < log->total; i++) printChangeEvent(&log->events[i & (CHANGE_LOG_SIZE - 1)], out);
+    log->reported = log->total;
+}
+
+void printChangeLog(const ChangeLog *log, Print &out) {
+    if(!log->enabled) {
+        out.print("Change detection is off (CHANGE_DETECT 0)\n");
+        return;
+    }
+    uint32_t first = log->total > CHANGE_LOG_SIZE ? log->total - CHANGE_LOG_SIZE : 0;
+    out.printf("Changes: %lu detected, last %lu:\n", (unsigned long)log->total, (unsigned long)(log->total - first));
+    for(uint32_t i = first; i < log->total; i++) printChangeEvent(&log->events[i & (CHANGE_LOG_SIZE - 1)], out);
+}
+
+#endif // ZIGBEE_SCANNER_CHANGE_EVENTS_H
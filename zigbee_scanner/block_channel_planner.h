@@ -0,0 +1,179 @@
+#ifndef ZIGBEE_SCANNER_CHANNEL_PLANNER_H
+#define ZIGBEE_SCANNER_CHANNEL_PLANNER_H
+
+#include "block_definitions.h"
+
+// Rescan channels by activity instead of sweeping all 16 on a fixed period
+#ifndef ADAPTIVE_CHANNEL_SCAN
+#define ADAPTIVE_CHANNEL_SCAN 1
+#endif
+
+// Fixed schedule (ADAPTIVE_CHANNEL_SCAN 0) and search mode; the profile's
+// intervals unless overridden (0: back-to-back scans)
+#ifndef SCAN_INTERVAL_NORMAL_MS
+#define SCAN_INTERVAL_NORMAL_MS ActiveScanner::scanIntervalNormal
+#endif
+#ifndef SCAN_INTERVAL_SEARCH_MS
+#define SCAN_INTERVAL_SEARCH_MS ActiveScanner::scanIntervalSearch
+#endif
+const unsigned long SCAN_INTERVAL_NORMAL = SCAN_INTERVAL_NORMAL_MS;  // between scans when networks are found
+const unsigned long SCAN_INTERVAL_SEARCH = SCAN_INTERVAL_SEARCH_MS;  // between scans during search
+
+// Adaptive schedule
+const unsigned long CHANNEL_RESCAN_BUSY = 15000;    // rescan period of a busy/changing channel
+const unsigned long CHANNEL_RESCAN_QUIET = 60000;   // rescan period of an empty channel
+const unsigned long CHANNEL_BATCH_WINDOW = 10000;    // channels due this soon join the scan
+const unsigned long CHANNEL_SCAN_MIN_GAP = 2000;    // between two targeted scans
+const uint8_t CHANNEL_SCORE_PER_NETWORK = 64;       // activity sample per network seen
+const uint8_t CHANNEL_SCORE_CHANGED = 255;          // activity sample when the PAN set changed
+
+// What the last scan of a channel saw
+struct ChannelActivity {
+    unsigned long lastScanned;
+    uint16_t panSignature;    // order-independent hash of the PAN IDs seen
+    uint8_t networks;
+    uint8_t score;            // EWMA of activity, 0 quiet .. 255 busy
+    bool scanned;
+};
+
+struct ChannelPlanner {
+    ChannelActivity channels[CHANNEL_COUNT];
+    unsigned long interval;   // fixed schedule, between scans when networks are found
+    uint32_t channelMask;     // channels scans may cover ("set mask")
+    bool adaptive;
+    bool fullSweepPending;    // set when a PAN appeared or disappeared
+    uint32_t fullSweeps;
+    uint32_t targetedScans;
+};
+
+SCANNER_INSTANCE ChannelPlanner channelPlanner;
+
+void initChannelPlanner(ChannelPlanner *p, bool adaptive) {
+    memset(p, 0, sizeof(ChannelPlanner));
+    p->interval = SCAN_INTERVAL_NORMAL;
+    p->channelMask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+    p->adaptive = adaptive;
+    p->fullSweepPending = true;
+}
+
+// Whether scans may cover channel index i (channel MIN_CHANNEL + i)
+bool channelPlanned(const ChannelPlanner *p, int i) {
+    return (p->channelMask & (1UL << (MIN_CHANNEL + i))) != 0;
+}
+
+bool channelPlanHasNetworks(const ChannelPlanner *p) {
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        if(channelPlanned(p, i) && p->channels[i].networks > 0) return true;
+    }
+    return false;
+}
+
+// Busy channels come back every CHANNEL_RESCAN_BUSY, quiet ones every
+// CHANNEL_RESCAN_QUIET, linear in between
+unsigned long channelRescanInterval(uint8_t score) {
+    return CHANNEL_RESCAN_QUIET - ((CHANNEL_RESCAN_QUIET - CHANNEL_RESCAN_BUSY) * score) / 255;
+}
+
+// When the next scan should start
+unsigned long nextPlannedScan(const ChannelPlanner *p, unsigned long lastScanTime) {
+    bool found = channelPlanHasNetworks(p);
+    if(!p->adaptive || !found) {
+        return lastScanTime + (found ? p->interval : SCAN_INTERVAL_SEARCH);
+    }
+    if(p->fullSweepPending) return lastScanTime;
+
+    unsigned long due = lastScanTime + CHANNEL_RESCAN_QUIET;
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        if(!channelPlanned(p, i)) continue;
+        unsigned long channelDue = p->channels[i].lastScanned + channelRescanInterval(p->channels[i].score);
+        if((long)(channelDue - due) < 0) due = channelDue;
+    }
+    if((long)(due - (lastScanTime + CHANNEL_SCAN_MIN_GAP)) < 0) due = lastScanTime + CHANNEL_SCAN_MIN_GAP;
+    return due;
+}
+
+// Channels to scan when starting at now; a full sweep covers every
+// channel of channelMask
+uint32_t planChannelMask(ChannelPlanner *p, unsigned long now) {
+    if(!p->adaptive || p->fullSweepPending || !channelPlanHasNetworks(p)) {
+        p->fullSweeps++;
+        return p->channelMask;
+    }
+
+    uint32_t mask = 0;
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        if(!channelPlanned(p, i)) continue;
+        unsigned long channelDue = p->channels[i].lastScanned + channelRescanInterval(p->channels[i].score);
+        if((long)(channelDue - (now + CHANNEL_BATCH_WINDOW)) <= 0) {
+            mask |= 1UL << (MIN_CHANNEL + i);
+        }
+    }
+    if(mask == 0) mask = p->channelMask;
+
+    if(mask == p->channelMask) p->fullSweeps++;
+    else p->targetedScans++;
+    return mask;
+}
+
+// Folds a completed scan into the per-channel scores
+void updateChannelPlan(ChannelPlanner *p, const ScanSnapshot *scan, unsigned long now) {
+    uint8_t networks[CHANNEL_COUNT] = {0};
+    uint16_t signature[CHANNEL_COUNT] = {0};
+
+    for(int i = 0; i < scan->count; i++) {
+        uint8_t ch = scan->channel[i];
+        if(ch < MIN_CHANNEL || ch > MAX_CHANNEL) continue;
+        if(networks[ch - MIN_CHANNEL] < 255) networks[ch - MIN_CHANNEL]++;
+        signature[ch - MIN_CHANNEL] += (uint16_t)(scan->panId[i] * 40503u);
+    }
+
+    bool changed = false;
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        if(!(scan->channelMask & (1UL << (MIN_CHANNEL + i)))) continue;
+        ChannelActivity *c = &p->channels[i];
+
+        bool channelChanged = c->scanned &&
+            (c->networks != networks[i] || c->panSignature != signature[i]);
+        uint8_t sample = channelChanged ? CHANNEL_SCORE_CHANGED :
+            (uint8_t)min(255, networks[i] * CHANNEL_SCORE_PER_NETWORK);
+
+        c->score = (uint8_t)((c->score * 3 + sample) / 4);
+        c->networks = networks[i];
+        c->panSignature = signature[i];
+        c->lastScanned = now;
+        c->scanned = true;
+        changed |= channelChanged;
+    }
+
+    // A full sweep has seen everything; a change seen by a targeted scan
+    // may have moved to another channel
+    if((scan->channelMask & p->channelMask) == p->channelMask) {
+        p->fullSweepPending = false;
+    } else if(changed) {
+        p->fullSweepPending = true;
+    }
+}
+
+// Fixed interval between scans (serial "set interval"); 0 goes back to
+// the build's schedule
+void setScanInterval(ChannelPlanner *p, unsigned long interval) {
+    if(interval == 0) {
+        p->interval = SCAN_INTERVAL_NORMAL;
+        p->adaptive = ADAPTIVE_CHANNEL_SCAN;
+    } else {
+        p->interval = interval;
+        p->adaptive = false;
+    }
+}
+
+// Channels to scan from now on (serial "set mask"); the next scan is a
+// full sweep of them. Returns false if mask holds no Zigbee channel.
+bool setScanChannels(ChannelPlanner *p, uint32_t mask) {
+    mask &= ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+    if(mask == 0) return false;
+    p->channelMask = mask;
+    p->fullSweepPending = true;
+    return true;
+}
+
+#endif // ZIGBEE_SCANNER_CHANNEL_PLANNER_H
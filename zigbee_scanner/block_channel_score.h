@@ -0,0 +1,135 @@
+#ifndef ZIGBEE_SCANNER_CHANNEL_SCORE_H
+#define ZIGBEE_SCANNER_CHANNEL_SCORE_H
+
+#include "block_definitions.h"
+#include "block_wifi_overlap.h"
+#include "interference_analysis.h"
+
+// Channel ranking: Zigbee networks, their load, WiFi and other energy on
+// each channel folded into one penalty, lower is better
+const uint16_t CHANNEL_PENALTY_NETWORK = 40;     // per network on the channel
+const uint8_t CHANNEL_PENALTY_LOAD_DIV = 2;      // summed load (%) / this
+const uint8_t WIFI_PRIOR_ACTIVITY = 25;          // assumed airtime of WiFi 1/6/11 without energy data
+
+struct ChannelScore {
+    uint8_t networks;          // at the channel's last scan
+    uint16_t load;             // their summed load (%)
+    uint8_t wifi;              // expected WiFi airtime on the channel (%)
+    uint8_t noise;             // other busy time from energy detect (%)
+    uint16_t penalty;
+};
+
+struct ChannelRanking {
+    ChannelScore channels[CHANNEL_COUNT];
+    uint8_t order[CHANNEL_COUNT];                 // channel indices, best first
+    uint8_t wifiActivity[WIFI_CHANNEL_COUNT];     // estimated airtime per 20 MHz WiFi channel (%)
+    uint8_t wifiActivity40[WIFI_HT40_COUNT];
+    bool measured;                                // WiFi activity comes from energy detect
+    uint32_t updates;
+};
+
+SCANNER_INSTANCE ChannelRanking channelRanking;
+
+void initChannelRanking(ChannelRanking *r) {
+    memset(r, 0, sizeof(ChannelRanking));
+    for(int i = 0; i < CHANNEL_COUNT; i++) r->order[i] = (uint8_t)i;
+}
+
+// A WiFi channel is as busy as the least busy Zigbee channel it fully
+// covers: wideband bursts light up all of them together
+static uint8_t wifiChannelActivity(const InterferenceAnalysis *analysis, const uint8_t *overlap, int stride) {
+    uint8_t activity = 255;
+    for(int z = 0; z < CHANNEL_COUNT; z++) {
+        if(overlap[z * stride] < 100) continue;
+        activity = min(activity, analysis[z].wifiOverlap);
+    }
+    return activity == 255 ? 0 : activity;
+}
+
+static void estimateWifiActivity(ChannelRanking *r, const InterferenceAnalysis *analysis) {
+    r->measured = false;
+    for(int z = 0; z < CHANNEL_COUNT; z++) {
+        if(analysis[z].samples > 0) r->measured = true;
+    }
+    for(int w = 0; w < WIFI_CHANNEL_COUNT; w++) {
+        if(r->measured) {
+            r->wifiActivity[w] = wifiChannelActivity(analysis, &wifiOverlapTable.ht20[0][w], WIFI_CHANNEL_COUNT);
+        } else {
+            r->wifiActivity[w] = (w + 1 == 1 || w + 1 == 6 || w + 1 == 11) ? WIFI_PRIOR_ACTIVITY : 0;
+        }
+    }
+    for(int w = 0; w < WIFI_HT40_COUNT; w++) {
+        r->wifiActivity40[w] = r->measured ?
+            wifiChannelActivity(analysis, &wifiOverlapTable.ht40[0][w], WIFI_HT40_COUNT) : 0;
+    }
+}
+
+// Ranks the channels after a scan. Channels the scan did not cover keep
+// what their last scan saw. Ties go to the lower channel, so the same
+// inputs always give the same order.
+void rankChannels(ChannelRanking *r, const ScanSnapshot *scan, const InterferenceAnalysis *analysis) {
+    uint8_t networks[CHANNEL_COUNT] = {0};
+    uint16_t load[CHANNEL_COUNT] = {0};
+    for(int i = 0; i < scan->count; i++) {
+        int z = scan->channel[i] - MIN_CHANNEL;
+        if(z < 0 || z >= CHANNEL_COUNT) continue;
+        if(networks[z] < 255) networks[z]++;
+        load[z] += scan->load[i];
+    }
+
+    estimateWifiActivity(r, analysis);
+
+    for(int z = 0; z < CHANNEL_COUNT; z++) {
+        ChannelScore *c = &r->channels[z];
+        if(scan->channelMask & (1UL << (MIN_CHANNEL + z))) {
+            c->networks = networks[z];
+            c->load = load[z];
+        }
+
+        // Expected WiFi airtime: the busiest WiFi channel reaching this one
+        uint16_t wifi = 0;
+        for(int w = 0; w < WIFI_CHANNEL_COUNT; w++) {
+            wifi = max(wifi, (uint16_t)(wifiOverlapTable.ht20[z][w] * r->wifiActivity[w] / 100));
+        }
+        for(int w = 0; w < WIFI_HT40_COUNT; w++) {
+            wifi = max(wifi, (uint16_t)(wifiOverlapTable.ht40[z][w] * r->wifiActivity40[w] / 100));
+        }
+        c->wifi = (uint8_t)wifi;
+        c->noise = analysis[z].dutyCycle > analysis[z].wifiOverlap ?
+            analysis[z].dutyCycle - analysis[z].wifiOverlap : 0;
+        c->penalty = (uint16_t)min(65535UL, (unsigned long)c->networks * CHANNEL_PENALTY_NETWORK +
+            c->load / CHANNEL_PENALTY_LOAD_DIV + c->wifi + c->noise);
+
+        // Insertion into the order, best first
+        int pos = z;
+        while(pos > 0 && r->channels[r->order[pos - 1]].penalty > c->penalty) {
+            r->order[pos] = r->order[pos - 1];
+            pos--;
+        }
+        r->order[pos] = (uint8_t)z;
+    }
+    r->updates++;
+}
+
+// Best channels first, up to count, without Zigbee networks when freeOnly
+uint8_t recommendedChannels(const ChannelRanking *r, uint8_t *channels, uint8_t count, bool freeOnly) {
+    uint8_t n = 0;
+    for(int i = 0; i < CHANNEL_COUNT && n < count; i++) {
+        uint8_t z = r->order[i];
+        if(freeOnly && r->channels[z].networks > 0) continue;
+        channels[n++] = MIN_CHANNEL + z;
+    }
+    return n;
+}
+
+void printChannelRanking(const ChannelRanking *r, Print &out) {
+    out.printf("Channel ranking (%s WiFi):\n", r->measured ? "measured" : "assumed 1/6/11");
+    out.print("Ch  Networks  Load  WiFi%  Other%  Penalty\n");
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        const ChannelScore *c = &r->channels[r->order[i]];
+        out.printf("%2d %9u %5u %6u %7u %8u\n", MIN_CHANNEL + r->order[i],
+            c->networks, c->load, c->wifi, c->noise, c->penalty);
+    }
+}
+
+#endif // ZIGBEE_SCANNER_CHANNEL_SCORE_H
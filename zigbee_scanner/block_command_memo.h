@@ -0,0 +1,81 @@
+#ifndef ZIGBEE_SCANNER_COMMAND_MEMO_H
+#define ZIGBEE_SCANNER_COMMAND_MEMO_H
+
+#include "block_definitions.h"
+#include "block_serial_output.h"
+
+// The expensive serial command replies (a network's diagnostics, a
+// channel's interference and trends, the recommendations) are computed
+// when asked for and kept until the next scan is analysed: asking again,
+// or from a second terminal, replays the text. A reply longer than the
+// memo (a quarter of the output queue) is sent but not kept.
+#ifndef COMMAND_MEMO_SIZE
+#define COMMAND_MEMO_SIZE (SERIAL_OUTPUT_BUFFER_SIZE / 4)
+#endif
+
+// CommandMemo::command
+#define MEMO_NONE            0
+#define MEMO_SHOW            1   // argument: PAN ID
+#define MEMO_CHANNEL         2   // argument: channel
+#define MEMO_RECOMMENDATIONS 3
+
+struct CommandMemo {
+    char text[COMMAND_MEMO_SIZE];
+    uint16_t length;
+    uint8_t command;          // MEMO_* of the kept reply
+    uint32_t argument;
+    uint32_t scans;           // analysedScans it was computed from
+    uint32_t hits;            // replies replayed
+    uint32_t misses;          // replies computed
+};
+
+SCANNER_INSTANCE CommandMemo commandMemo;
+
+// Sends a reply on and keeps a copy while it fits
+class MemoWriter : public Print {
+public:
+    MemoWriter(Print &out, CommandMemo *memo) : out(out), memo(memo), overflow(false) {
+        memo->command = MEMO_NONE;
+        memo->length = 0;
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t size) override {
+        if(!overflow && size <= sizeof(memo->text) - memo->length) {
+            memcpy(memo->text + memo->length, data, size);
+            memo->length += size;
+        } else {
+            overflow = true;
+        }
+        return out.write(data, size);
+    }
+    using Print::write;
+
+    bool overflowed() const { return overflow; }
+
+private:
+    Print &out;
+    CommandMemo *memo;
+    bool overflow;
+};
+
+// Replays the kept reply to (command, argument) if it is still current
+bool commandMemoReplay(CommandMemo *m, uint8_t command, uint32_t argument, uint32_t scans, Print &out) {
+    if(m->command == MEMO_NONE || m->command != command || m->argument != argument || m->scans != scans) {
+        m->misses++;
+        return false;
+    }
+    out.write((const uint8_t *)m->text, m->length);
+    m->hits++;
+    return true;
+}
+
+// Marks what the writer just captured as the reply to (command, argument)
+void commandMemoKeep(CommandMemo *m, const MemoWriter *writer, uint8_t command, uint32_t argument, uint32_t scans) {
+    if(writer->overflowed()) return;
+    m->command = command;
+    m->argument = argument;
+    m->scans = scans;
+}
+
+#endif // ZIGBEE_SCANNER_COMMAND_MEMO_H
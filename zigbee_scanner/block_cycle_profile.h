@@ -0,0 +1,320 @@
+#ifndef ZIGBEE_SCANNER_CYCLE_PROFILE_H
+#define ZIGBEE_SCANNER_CYCLE_PROFILE_H
+
+#include "block_definitions.h"
+#include "block_helpers.h"
+#include "block_telemetry.h"
+
+// Where a scan cycle's time goes: CPU cycles per phase, summed over one
+// scan cycle (scan start to the next scan start), with a histogram per
+// phase, plus heap and stack water marks. CYCLE_PROFILE 0 leaves no code
+// and no RAM behind: CYCLE_PHASE() and the hooks expand to nothing.
+#ifndef CYCLE_PROFILE
+#define CYCLE_PROFILE 1
+#endif
+
+// Cycle counter, wraps after about 26 s at 160 MHz
+#ifndef CYCLE_PROFILE_CLOCK
+#define CYCLE_PROFILE_CLOCK() ESP.getCycleCount()
+#endif
+
+// Phases (a phase a cycle did not enter is not counted for it)
+#define PHASE_AIRTIME     0        // scan start to the scheduler seeing it complete
+#define PHASE_RESULT_COPY 1        // Zigbee.getScanResult()
+#define PHASE_DECODE      2        // descriptors to the scan snapshot
+#define PHASE_STATS       3        // updateNetworkStats() for every network
+#define PHASE_TEXT        4        // text report stages, formatting into the output buffer
+#define PHASE_TELEMETRY   5        // binary telemetry frame
+#define PHASE_HISTORY     6        // flash history log append
+#define PHASE_SERIAL      7        // output buffer to the UART (from loop())
+#define CYCLE_PHASES      8
+
+// Histogram buckets: the first holds under 1024 cycles, then one per
+// octave up to 2^32
+#define CYCLE_PROFILE_BUCKETS 23
+
+#if CYCLE_PROFILE
+
+// Phases after which the heap is sampled (outside the timed span): the
+// result copy is when the scan list is allocated
+const uint8_t CYCLE_PROFILE_MEMORY_PHASES = (1 << PHASE_RESULT_COPY) | (1 << PHASE_DECODE) | (1 << PHASE_TEXT) |
+                                           (1 << PHASE_TELEMETRY) | (1 << PHASE_HISTORY);
+
+const char *const CYCLE_PHASE_NAMES[CYCLE_PHASES] = {
+    "airtime", "copy", "decode", "stats", "text", "telemetry", "history", "serial"
+};
+
+struct CyclePhaseStats {
+    uint32_t pending;             // this scan cycle so far
+    uint32_t cycles;              // scan cycles with the phase, since boot
+    uint32_t last;
+    uint32_t max;
+    uint64_t total;
+    uint16_t windowCycles;        // since the last periodic report
+    uint32_t windowMax;
+    uint64_t windowTotal;
+    uint16_t histogram[CYCLE_PROFILE_BUCKETS];
+    uint16_t windowHistogram[CYCLE_PROFILE_BUCKETS];
+};
+
+struct MemoryWatermarks {
+    uint32_t freeHeapMin;
+    uint32_t freeHeapMax;
+    uint32_t largestBlockMin;     // largest allocatable block
+    uint32_t largestBlockMax;
+    uint32_t stackHeadroomMin;    // loop task, bytes never used
+};
+
+struct CycleProfile {
+    CyclePhaseStats phases[CYCLE_PHASES];
+    MemoryWatermarks memory;
+    uint32_t scanCycles;
+    uint8_t entered;              // phases of this scan cycle so far, 1 << PHASE_*
+    uint32_t scanStartCycles;
+    bool scanRunning;
+    bool endDeferred;             // next scan started before this cycle's report
+};
+
+SCANNER_INSTANCE CycleProfile cycleProfile;
+
+void initCycleProfile(CycleProfile *p) {
+    memset(p, 0, sizeof(CycleProfile));
+    p->memory.freeHeapMin = UINT32_MAX;
+    p->memory.largestBlockMin = UINT32_MAX;
+    p->memory.stackHeadroomMin = UINT32_MAX;
+}
+
+static inline uint8_t cycleProfileBucket(uint32_t cycles) {
+    uint8_t bits = cycles ? 32 - __builtin_clz(cycles) : 0;
+    return bits <= 10 ? 0 : bits - 10;
+}
+
+// Cycles below which the bucket's samples lie
+static inline uint32_t cycleProfileBucketLimit(uint8_t bucket) {
+    return bucket + 10 >= 32 ? UINT32_MAX : 1UL << (bucket + 10);
+}
+
+// Upper bound of the q-th percentile of count samples, from their histogram
+static uint32_t cycleHistogramQuantile(const uint16_t *histogram, uint32_t count, uint32_t max, uint8_t q) {
+    uint32_t wanted = (uint32_t)(((uint64_t)count * q + 99) / 100);
+    uint32_t seen = 0;
+    for(uint8_t b = 0; b < CYCLE_PROFILE_BUCKETS; b++) {
+        seen += histogram[b];
+        if(seen >= wanted && seen > 0) return min(cycleProfileBucketLimit(b), max);
+    }
+    return max;
+}
+
+// Since boot
+uint32_t cycleProfileQuantile(const CyclePhaseStats *s, uint8_t q) {
+    return cycleHistogramQuantile(s->histogram, s->cycles, s->max, q);
+}
+
+// Since the last periodic report
+uint32_t cycleProfileWindowQuantile(const CyclePhaseStats *s, uint8_t q) {
+    return cycleHistogramQuantile(s->windowHistogram, s->windowCycles, s->windowMax, q);
+}
+
+void cycleProfileSampleMemory(CycleProfile *p) {
+    MemoryWatermarks *m = &p->memory;
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largest = ESP.getMaxAllocHeap();
+    uint32_t stack = (uint32_t)uxTaskGetStackHighWaterMark(NULL);
+    m->freeHeapMin = min(m->freeHeapMin, freeHeap);
+    m->freeHeapMax = max(m->freeHeapMax, freeHeap);
+    m->largestBlockMin = min(m->largestBlockMin, largest);
+    m->largestBlockMax = max(m->largestBlockMax, largest);
+    m->stackHeadroomMin = min(m->stackHeadroomMin, stack);
+}
+
+// Folds the scan cycle that just ended into the totals and histograms
+void cycleProfileEndCycle(CycleProfile *p) {
+    bool any = false;
+    for(uint8_t i = 0; i < CYCLE_PHASES; i++) {
+        CyclePhaseStats *s = &p->phases[i];
+        if(!(p->entered & (1 << i))) continue;
+        uint8_t b = cycleProfileBucket(s->pending);
+        if(s->histogram[b] < UINT16_MAX) s->histogram[b]++;
+        if(s->windowHistogram[b] < UINT16_MAX) s->windowHistogram[b]++;
+        s->cycles++;
+        s->last = s->pending;
+        s->max = max(s->max, s->pending);
+        s->total += s->pending;
+        if(s->windowCycles < UINT16_MAX) s->windowCycles++;
+        s->windowMax = max(s->windowMax, s->pending);
+        s->windowTotal += s->pending;
+        s->pending = 0;
+        any = true;
+    }
+    p->entered = 0;
+    if(any) p->scanCycles++;
+    cycleProfileSampleMemory(p);
+}
+
+// A scan starts a new cycle; airtime runs until the scheduler sees it end.
+// A scan started while the previous one is still to be reported (the
+// scheduler's pipeline) leaves that cycle open until its report is done.
+void cycleProfileScanStarted(CycleProfile *p, bool reportPending) {
+    if(reportPending) p->endDeferred = true;
+    else cycleProfileEndCycle(p);
+    p->scanStartCycles = CYCLE_PROFILE_CLOCK();
+    p->scanRunning = true;
+}
+
+void cycleProfileReportDone(CycleProfile *p) {
+    if(!p->endDeferred) return;
+    p->endDeferred = false;
+    cycleProfileEndCycle(p);
+}
+
+void cycleProfileScanEnded(CycleProfile *p, bool timedOut) {
+    if(!p->scanRunning) return;
+    p->scanRunning = false;
+    // A timed-out scan ran past the counter's wrap
+    if(timedOut) return;
+    p->phases[PHASE_AIRTIME].pending += CYCLE_PROFILE_CLOCK() - p->scanStartCycles;
+    p->entered |= 1 << PHASE_AIRTIME;
+}
+
+// Times the enclosing scope into a phase of the running scan cycle
+class CyclePhaseTimer {
+public:
+    explicit CyclePhaseTimer(uint8_t phase) : phase(phase), start(CYCLE_PROFILE_CLOCK()) {}
+    ~CyclePhaseTimer() {
+        cycleProfile.phases[phase].pending += CYCLE_PROFILE_CLOCK() - start;
+        cycleProfile.entered |= 1 << phase;
+        if(CYCLE_PROFILE_MEMORY_PHASES & (1 << phase)) cycleProfileSampleMemory(&cycleProfile);
+    }
+
+private:
+    uint8_t phase;
+    uint32_t start;
+};
+
+#define CYCLE_PHASE(phase) CyclePhaseTimer cyclePhaseTimer(phase)
+#define CYCLE_PROFILE_SCAN_STARTED(reportPending) cycleProfileScanStarted(&cycleProfile, reportPending)
+#define CYCLE_PROFILE_SCAN_ENDED(timedOut) cycleProfileScanEnded(&cycleProfile, timedOut)
+#define CYCLE_PROFILE_REPORT_DONE() cycleProfileReportDone(&cycleProfile)
+
+static void printCycleSpan(Print &out, uint64_t cycles) {
+    uint64_t us = cycles / ESP.getCpuFreqMHz();
+    if(us >= 1000000) out.printf("%lu.%02lu s", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000 / 10000));
+    else if(us >= 1000) out.printf("%lu.%lu ms", (unsigned long)(us / 1000), (unsigned long)(us % 1000 / 100));
+    else out.printf("%lu us", (unsigned long)us);
+}
+
+// One line for the periodic report: mean per scan cycle since the last one
+void printCycleProfileLine(CycleProfile *p, Print &out) {
+    out.print("Profile:");
+    bool first = true;
+    for(uint8_t i = 0; i < CYCLE_PHASES; i++) {
+        const CyclePhaseStats *s = &p->phases[i];
+        if(s->windowCycles == 0) continue;
+        out.printf("%s %s ", first ? "" : ",", CYCLE_PHASE_NAMES[i]);
+        printCycleSpan(out, s->windowTotal / s->windowCycles);
+        first = false;
+    }
+    if(first) out.print(" no scans");
+    const MemoryWatermarks *m = &p->memory;
+    if(m->freeHeapMin != UINT32_MAX) {
+        out.printf("; heap %lu-%lu KB, block %lu KB min, stack %lu B min free",
+            (unsigned long)(m->freeHeapMin / 1024), (unsigned long)(m->freeHeapMax / 1024),
+            (unsigned long)(m->largestBlockMin / 1024), (unsigned long)m->stackHeadroomMin);
+    }
+    out.print("\n");
+}
+
+// Telemetry frame with the same window (TELEMETRY_FRAME_PROFILE)
+void writeProfileTelemetry(Print &out, const CycleProfile *p, uint32_t now) {
+    TelemetryFrameWriter frame(out);
+    frame.begin(TELEMETRY_FRAME_PROFILE, TELEMETRY_PROFILE_HEADER_SIZE +
+                CYCLE_PHASES * TELEMETRY_PHASE_RECORD_SIZE + TELEMETRY_MEMORY_RECORD_SIZE);
+    frame.put32(now);
+    frame.put16((uint16_t)ESP.getCpuFreqMHz());
+    frame.put32(p->scanCycles);
+    frame.put8(CYCLE_PHASES);
+    for(uint8_t i = 0; i < CYCLE_PHASES; i++) {
+        const CyclePhaseStats *s = &p->phases[i];
+        frame.put16(s->windowCycles);
+        frame.put32(s->windowCycles ? (uint32_t)(s->windowTotal / s->windowCycles) : 0);
+        frame.put32(s->windowMax);
+        frame.put32(cycleProfileWindowQuantile(s, 50));
+        frame.put32(cycleProfileWindowQuantile(s, 90));
+    }
+    frame.put32(p->memory.freeHeapMin);
+    frame.put32(p->memory.freeHeapMax);
+    frame.put32(p->memory.largestBlockMin);
+    frame.put32(p->memory.largestBlockMax);
+    frame.put32(p->memory.stackHeadroomMin);
+    frame.end();
+}
+
+void resetCycleProfileWindow(CycleProfile *p) {
+    for(uint8_t i = 0; i < CYCLE_PHASES; i++) {
+        p->phases[i].windowCycles = 0;
+        p->phases[i].windowMax = 0;
+        p->phases[i].windowTotal = 0;
+        memset(p->phases[i].windowHistogram, 0, sizeof(p->phases[i].windowHistogram));
+    }
+}
+
+// Periodic report in the modes reports go out in
+void reportCycleProfile(CycleProfile *p, uint32_t now) {
+    printCycleProfileLine(p, Report);
+    if(reportMode & REPORT_MODE_BINARY) writeProfileTelemetry(Report.raw(), p, now);
+    resetCycleProfileWindow(p);
+}
+
+#else
+
+#define CYCLE_PHASE(phase)
+#define CYCLE_PROFILE_SCAN_STARTED(reportPending)
+#define CYCLE_PROFILE_SCAN_ENDED(timedOut)
+#define CYCLE_PROFILE_REPORT_DONE()
+
+#endif // CYCLE_PROFILE
+
+// Since boot, for the "profile" command: per phase the scan cycles it
+// ran in, mean, median, 90th percentile (bucket bounds) and max, and the
+// histogram from the first to the last bucket used, after its lower bound
+void printCycleProfile(Print &out) {
+#if CYCLE_PROFILE
+    const CycleProfile *p = &cycleProfile;
+    out.printf("Cycle profile, %lu scan cycles, %lu MHz\n", (unsigned long)p->scanCycles,
+        (unsigned long)ESP.getCpuFreqMHz());
+    out.print("Phase       Cycles      Mean       p50       p90       Max  Histogram (x2 per bucket)\n");
+    for(uint8_t i = 0; i < CYCLE_PHASES; i++) {
+        const CyclePhaseStats *s = &p->phases[i];
+        out.printf("%-10s %7lu", CYCLE_PHASE_NAMES[i], (unsigned long)s->cycles);
+        if(s->cycles == 0) {
+            out.print("\n");
+            continue;
+        }
+        uint64_t spans[4] = { s->total / s->cycles, cycleProfileQuantile(s, 50), cycleProfileQuantile(s, 90), s->max };
+        for(uint8_t k = 0; k < 4; k++) {
+            FixedTextBuffer<16> text;
+            printCycleSpan(text, spans[k]);
+            out.printf(" %9s", text.c_str());
+        }
+        uint8_t lo = 0, hi = CYCLE_PROFILE_BUCKETS - 1;
+        while(lo < hi && s->histogram[lo] == 0) lo++;
+        while(hi > lo && s->histogram[hi] == 0) hi--;
+        out.print("  ");
+        printCycleSpan(out, lo == 0 ? 0 : cycleProfileBucketLimit(lo) / 2);
+        out.print(" [");
+        for(uint8_t b = lo; b <= hi; b++) out.printf(b == lo ? "%u" : " %u", s->histogram[b]);
+        out.print("]\n");
+    }
+    const MemoryWatermarks *m = &p->memory;
+    if(m->freeHeapMin != UINT32_MAX) {
+        out.printf("Free heap %lu-%lu bytes, largest block %lu-%lu bytes, stack headroom %lu bytes min\n",
+            (unsigned long)m->freeHeapMin, (unsigned long)m->freeHeapMax,
+            (unsigned long)m->largestBlockMin, (unsigned long)m->largestBlockMax,
+            (unsigned long)m->stackHeadroomMin);
+    }
+#else
+    out.print("Cycle profile is off (CYCLE_PROFILE 0)\n");
+#endif
+}
+
+#endif // ZIGBEE_SCANNER_CYCLE_PROFILE_H
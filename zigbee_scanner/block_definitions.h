@@ -4,43 +4,197 @@
 #include "Zigbee.h"
 //#include "Zigbee/src/Zigbee.h"
 
+#include "block_scanner_config.h"
+#include "block_signal_stats.h"
+#include "block_change_detect.h"
+
+// Storage of the scanner's state. A device runs one scanner; host tools
+// that run one per thread build with SCANNER_INSTANCE thread_local.
+#ifndef SCANNER_INSTANCE
+#define SCANNER_INSTANCE
+#endif
+
 // Constants
-#define MAX_NETWORKS 10
 #define MIN_CHANNEL 11
 #define MAX_CHANNEL 26
-#define SIGNAL_HISTORY_SIZE 10
+#define CHANNEL_COUNT (MAX_CHANNEL - MIN_CHANNEL + 1)
+
+// Signal samples each network's statistics cover (update cost does not
+// depend on it, memory does: about 5 bytes per sample)
+#ifndef SIGNAL_HISTORY_SIZE
+#define SIGNAL_HISTORY_SIZE ActiveScanner::signalHistorySize
+#endif
+
+// Per-network memory allowed for the signal statistics
+#ifndef SIGNAL_STATS_BUDGET
+#define SIGNAL_STATS_BUDGET 1024
+#endif
+
+// Number of networks tracked across scans (hash table keyed on PAN ID)
+#ifndef NETWORK_TABLE_CAPACITY
+#define NETWORK_TABLE_CAPACITY ActiveScanner::networkTableCapacity
+#endif
+
+// Networks kept from one scan (results beyond this are counted, not decoded)
+#ifndef SCAN_SNAPSHOT_CAPACITY
+#define SCAN_SNAPSHOT_CAPACITY ActiveScanner::scanSnapshotCapacity
+#endif
+
+// Networks remembered from the previous scans for New/Better/Down/Gone status
+#define MAX_NETWORKS SCAN_SNAPSHOT_CAPACITY
+
+// One scan never evicts its own networks, so stats pointers taken while
+// updating a scan stay valid for its whole report
+static_assert(SCAN_SNAPSHOT_CAPACITY <= NETWORK_TABLE_CAPACITY,
+              "SCAN_SNAPSHOT_CAPACITY must not exceed NETWORK_TABLE_CAPACITY");
+
+// Narrowest index types for the sizes above: a network table entry (with
+// room for NETWORK_TABLE_NONE) and a network of one scan
+typedef ScannerIndex<NETWORK_TABLE_CAPACITY> NetworkIndex;
+typedef ScannerIndex<SCAN_SNAPSHOT_CAPACITY - 1> ScanIndex;
+
+// Bits of ScanSnapshot::flags
+#define NETWORK_FLAG_PERMIT_JOIN   0x01
+#define NETWORK_FLAG_ROUTER_CAP    0x02
+#define NETWORK_FLAG_END_DEV_CAP   0x04
+#define NETWORK_FLAG_SECURED       0x08
+#define NETWORK_FLAG_COORDINATOR   0x10
+#define NETWORK_FLAG_GONE          0x20   // telemetry only: left since the last scan
 
 // Data structures
+
+// One scan, decoded once from the stack's zigbee_scan_result_t array.
+// Stored as parallel arrays so per-field loops stay compact.
+struct ScanSnapshot {
+    uint16_t count;
+    uint16_t truncated;                              // results that did not fit
+    uint32_t timestamp;                              // millis() at decode time
+    uint32_t channelMask;                            // channels this scan covered
+    uint16_t sequence;                               // increments with every decode
+    uint16_t panId[SCAN_SNAPSHOT_CAPACITY];
+    uint64_t extendedPanId[SCAN_SNAPSHOT_CAPACITY];
+    uint8_t channel[SCAN_SNAPSHOT_CAPACITY];
+    uint8_t signal[SCAN_SNAPSHOT_CAPACITY];          // 0-255 index, not a measurement (see decodeScanResults)
+    uint8_t load[SCAN_SNAPSHOT_CAPACITY];            // 0-100, likewise
+    uint8_t flags[SCAN_SNAPSHOT_CAPACITY];           // NETWORK_FLAG_*
+};
+
+// Per-network state is split by how often it is touched. NetworkStats is
+// the hot part every per-scan loop reads (counters, current signal, report
+// baseline), packed and kept in its own dense array; NetworkSeries holds
+// the signal window and change detectors, only touched once per sighting
+// and by the diagnostics. Both are indexed like the table's entries.
 struct NetworkStats {
-    uint32_t totalPackets;
-    uint32_t failedPackets;
-    uint32_t retriesCount;
-    uint32_t lastResponseTime;
-    uint32_t uptime;              
+    // Link counters: every scan of its channel should bring its beacon
+    uint32_t beaconsExpected;     // scans of its channel since it was first seen
+    uint32_t beaconsMissed;
+    uint32_t channelScansSeen;    // channelScans[] of its channel at the last sighting
+    uint32_t firstSeen;           // millis() of the first and last sighting
+    uint32_t lastSeen;
+    uint16_t missStreak;          // scans of its channel missed before the last sighting
+    uint16_t longestMissStreak;
+    ScanIndex historyIndex;       // its previousScan entry, checked before use
+    uint8_t channel;              // where the counters were taken
     uint8_t lastSignalStrength;
     uint8_t minSignalStrength;
     uint8_t maxSignalStrength;
-    uint8_t avgSignalStrength;    
-    uint8_t signalTrend;          // 0 - stable, 1 - improving, 2 - degrading
-    uint8_t maxNetworkLoad;       
-    bool isCoordinator;           
-    uint8_t signalHistory[SIGNAL_HISTORY_SIZE];
-    uint8_t signalHistoryIndex;
-    uint8_t signalHistoryCount;
+    uint8_t avgSignalStrength;
+    uint8_t maxNetworkLoad;
+    uint8_t signalTrend : 2;      // 0 - stable, 1 - improving, 2 - degrading
+    uint8_t isCoordinator : 1;
+    uint8_t reported : 1;         // the reported* values are a delta baseline
+
+    // Values the last report sent, the baseline for delta reports
+    uint8_t reportedSignal;
+    uint8_t reportedLoad;
+    uint8_t reportedFlags;
+};
+
+// Seconds from the first to the last sighting
+static inline uint32_t networkUptime(const NetworkStats *stats) {
+    return (stats->lastSeen - stats->firstSeen) / 1000;
+}
+
+struct NetworkSeries {
+    SignalStats<SIGNAL_HISTORY_SIZE> signal;
+    ChangeDetector signalChange;  // signal index
+    ChangeDetector loadChange;
+    ChangePoint signalShift;      // the last signal change, and how long ago
+    uint8_t scansSinceShift;
+    uint8_t rollup;               // its network rollup store + 1, 0 for none
+};
+
+static_assert(sizeof(SignalStats<SIGNAL_HISTORY_SIZE>) <= SIGNAL_STATS_BUDGET,
+              "SIGNAL_HISTORY_SIZE does not fit SIGNAL_STATS_BUDGET");
+
+// Key and LRU links of a network table slot
+struct NetworkEntry {
+    uint64_t extendedPanId;
+    uint16_t panId;
+    NetworkIndex lruPrev;
+    NetworkIndex lruNext;
+};
+
+// Open addressing index over twice as many slots as entries, so probe
+// sequences stay short even when every entry is in use
+constexpr uint16_t networkTableSlotCount(uint32_t capacity, uint32_t slots = 1) {
+    return slots >= capacity * 2 ? slots : networkTableSlotCount(capacity, slots * 2);
+}
+#define NETWORK_TABLE_SLOTS networkTableSlotCount(NETWORK_TABLE_CAPACITY)
+#define NETWORK_TABLE_NONE ((NetworkIndex)~0)
+
+static_assert(NETWORK_TABLE_CAPACITY > 0 && NETWORK_TABLE_CAPACITY <= 16384,
+              "NETWORK_TABLE_CAPACITY must be between 1 and 16384");
+
+struct NetworkTable {
+    NetworkEntry entries[NETWORK_TABLE_CAPACITY];
+    NetworkStats stats[NETWORK_TABLE_CAPACITY];   // hot, same index as entries
+    NetworkSeries series[NETWORK_TABLE_CAPACITY]; // cold, same index as entries
+    NetworkIndex slots[NETWORK_TABLE_SLOTS]; // entry index or NETWORK_TABLE_NONE
+    uint16_t count;
+    NetworkIndex lruHead;                    // most recently seen
+    NetworkIndex lruTail;                    // next to be evicted
+    uint32_t evictions;
 };
 
 struct NetworkHistory {
     uint16_t panId;
+    uint64_t extendedPanId;
     uint8_t channel;
     uint8_t signalStrength;
     uint8_t networkLoad;
-    bool wasPresent;
+    uint8_t flags;
+    bool wasPresent;              // false once it has been reported gone
+    uint16_t lastScanSeen;        // ScanSnapshot::sequence of the last sighting
+};
+
+// A network against its entry from the last report
+#define NETWORK_STATUS_NEW         0
+#define NETWORK_STATUS_BACK        1      // reported gone before
+#define NETWORK_STATUS_BETTER      2      // stronger signal
+#define NETWORK_STATUS_DOWN        3      // weaker signal
+#define NETWORK_STATUS_STABLE      4
+
+// Which networks a report covers: everything on a keyframe, otherwise only
+// what appeared, left or changed beyond the hysteresis
+struct ReportSelection {
+    bool keyframe;
+    uint16_t count;
+    ScanIndex index[SCAN_SNAPSHOT_CAPACITY]; // into the scan
+    uint8_t status[SCAN_SNAPSHOT_CAPACITY];  // NETWORK_STATUS_* per network of the scan
+    uint16_t goneCount;
+    ScanIndex gone[MAX_NETWORKS];            // into previousScan
+    uint16_t reportsSinceKeyframe;
 };
 
 // External variable declarations
-extern NetworkStats networkStats[MAX_NETWORKS];
-extern NetworkHistory previousScan[MAX_NETWORKS];
-extern int previousNetworksCount;
+extern SCANNER_INSTANCE NetworkTable networkTable;
+extern SCANNER_INSTANCE ScanSnapshot currentScan;
+extern SCANNER_INSTANCE NetworkHistory previousScan[MAX_NETWORKS];
+extern SCANNER_INSTANCE int previousNetworksCount;
+extern SCANNER_INSTANCE NetworkStats *scanStats[SCAN_SNAPSHOT_CAPACITY];
+extern SCANNER_INSTANCE ReportSelection reportSelection;
+extern SCANNER_INSTANCE uint32_t channelScans[CHANNEL_COUNT];
 
 // Operating mode
 #ifdef ZIGBEE_MODE_ZCZR
@@ -50,15 +204,27 @@ zigbee_role_t role = ZIGBEE_END_DEVICE;
 #endif
 
 // Function prototypes
+class ReportWriter;
 bool isCoordinator(zigbee_scan_result_t *network);
-String getChannelStatus(uint8_t channel, zigbee_scan_result_t *results, uint16_t count);
-void printSummaryTable(zigbee_scan_result_t *scan_result, uint16_t networksFound);
-void printNetworkDiagnostics(zigbee_scan_result_t *scan_result, uint16_t networksFound);
-void printScannedNetworks(uint16_t networksFound);
-void updateChannelStats(zigbee_scan_result_t *scan_result, uint16_t networksFound);
-void updateNetworkStats(int idx, zigbee_scan_result_t *network);
-void saveNetworkHistory(zigbee_scan_result_t *scan_result, uint16_t networksFound);
-String getNetworkAnalysis(int idx);
-String analyzeChannelInterference(uint8_t channel, uint8_t signalStrength);
+void beginScanSnapshot(ScanSnapshot *scan, uint32_t channelMask);
+void decodeScanResults(zigbee_scan_result_t *scan_result, uint16_t networksFound, ScanSnapshot *scan);
+void printSummaryTable(ReportWriter &out, const ScanSnapshot *scan, const ReportSelection *selection);
+void printNetworkDiagnostics(ReportWriter &out, const ScanSnapshot *scan, const ReportSelection *selection);
+void reportScan(const ScanSnapshot *scan);
+void printScannedNetworks(uint16_t networksFound, uint32_t channelMask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+void updateChannelStats(const ScanSnapshot *scan);
+void updateNetworkStats(NetworkStats *stats, const ScanSnapshot *scan, uint16_t idx);
+void updateScanStats(const ScanSnapshot *scan);
+void saveNetworkHistory(const ScanSnapshot *scan);
+NetworkHistory *findNetworkHistory(const NetworkStats *stats, uint16_t panId, uint64_t extPanId);
+void selectReportedNetworks(const ScanSnapshot *scan, ReportSelection *selection);
+void markNetworksReported(const ScanSnapshot *scan, const ReportSelection *selection);
+void getNetworkAnalysis(NetworkStats *stats, Print &out);
+void resetNetworkStats(NetworkStats *stats);
+void clearNetworkTable(NetworkTable *table);
+NetworkStats *findNetworkStats(NetworkTable *table, uint16_t panId, uint64_t extPanId);
+NetworkStats *trackNetwork(NetworkTable *table, uint16_t panId, uint64_t extPanId);
+NetworkSeries *networkSeries(NetworkTable *table, const NetworkStats *stats);
+void analyzeChannelInterference(uint8_t channel, const uint8_t *ranked, Print &out);
 
 #endif // ZIGBEE_SCANNER_DEFINITIONS_H
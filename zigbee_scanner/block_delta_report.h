@@ -0,0 +1,98 @@
+#ifndef ZIGBEE_SCANNER_DELTA_REPORT_H
+#define ZIGBEE_SCANNER_DELTA_REPORT_H
+
+#include "block_definitions.h"
+#include "block_helpers.h"
+#include "block_analysis.h"
+
+// Report only networks that appeared, left or changed since they were last
+// reported, with a full keyframe every DELTA_KEYFRAME_INTERVAL reports
+#ifndef DELTA_REPORTS
+#define DELTA_REPORTS 0
+#endif
+
+// Change from the last reported value that counts as material
+#ifndef DELTA_SIGNAL_HYSTERESIS
+#define DELTA_SIGNAL_HYSTERESIS 12    // signal units (0-255)
+#endif
+#ifndef DELTA_LOAD_HYSTERESIS
+#define DELTA_LOAD_HYSTERESIS 10      // load percent
+#endif
+
+// Reports between two full keyframes, so late consumers can resync
+#ifndef DELTA_KEYFRAME_INTERVAL
+#define DELTA_KEYFRAME_INTERVAL 20
+#endif
+
+SCANNER_INSTANCE bool deltaReports = DELTA_REPORTS;
+
+static bool networkChanged(const NetworkStats *stats, const ScanSnapshot *scan, uint16_t idx) {
+    if(!stats->reported) return true;
+    if(abs(scan->signal[idx] - stats->reportedSignal) > DELTA_SIGNAL_HYSTERESIS) return true;
+    if(abs(scan->load[idx] - stats->reportedLoad) > DELTA_LOAD_HYSTERESIS) return true;
+    return scan->flags[idx] != stats->reportedFlags;
+}
+
+// Network idx of the scan against its history entry, which still holds
+// the last report's values
+static uint8_t networkStatus(const ScanSnapshot *scan, uint16_t idx) {
+    const NetworkHistory *previous = findNetworkHistory(scanStats[idx], scan->panId[idx], scan->extendedPanId[idx]);
+    if(!previous) return NETWORK_STATUS_NEW;
+    if(!previous->wasPresent) return NETWORK_STATUS_BACK;
+    if(previous->signalStrength < scan->signal[idx]) return NETWORK_STATUS_BETTER;
+    if(previous->signalStrength > scan->signal[idx]) return NETWORK_STATUS_DOWN;
+    return NETWORK_STATUS_STABLE;
+}
+
+// Decides what the report of this scan covers and the status of each of
+// its networks, kept for the command replies after the history moves on. Networks that left are
+// listed in every mode; they are the history entries on scanned channels
+// that did not answer.
+void selectReportedNetworks(const ScanSnapshot *scan, ReportSelection *selection) {
+    selection->keyframe = !deltaReports || selection->reportsSinceKeyframe == 0;
+
+    selection->count = 0;
+    for(int i = 0; i < scan->count; i++) {
+        selection->status[i] = networkStatus(scan, i);
+        if(selection->keyframe ||
+           networkChanged(scanStats[i], scan, i)) {
+            selection->index[selection->count++] = i;
+        }
+    }
+
+    selection->goneCount = 0;
+    for(int i = 0; i < previousNetworksCount; i++) {
+        const NetworkHistory *network = &previousScan[i];
+        if(network->wasPresent && (scan->channelMask & (1UL << network->channel)) &&
+           !networkSeenInScan(network, scan)) {
+            selection->gone[selection->goneCount++] = i;
+        }
+    }
+}
+
+// Makes the reported values the new baseline
+void markNetworksReported(const ScanSnapshot *scan, const ReportSelection *selection) {
+    for(int i = 0; i < selection->count; i++) {
+        uint16_t idx = selection->index[i];
+        NetworkStats *stats = scanStats[idx];
+        stats->reported = true;
+        stats->reportedSignal = scan->signal[idx];
+        stats->reportedLoad = scan->load[idx];
+        stats->reportedFlags = scan->flags[idx];
+    }
+
+    // A network that comes back is reported as new
+    for(int i = 0; i < selection->goneCount; i++) {
+        const NetworkHistory *network = &previousScan[selection->gone[i]];
+        NetworkStats *stats = findNetworkStats(&networkTable, network->panId, network->extendedPanId);
+        if(stats) stats->reported = false;
+    }
+}
+
+// Counts reports towards the next keyframe
+void finishReport(ReportSelection *selection) {
+    selection->reportsSinceKeyframe++;
+    if(selection->reportsSinceKeyframe >= DELTA_KEYFRAME_INTERVAL) selection->reportsSinceKeyframe = 0;
+}
+
+#endif // ZIGBEE_SCANNER_DELTA_REPORT_H
@@ -0,0 +1,271 @@
+#ifndef ZIGBEE_SCANNER_ENERGY_DETECT_H
+#define ZIGBEE_SCANNER_ENERGY_DETECT_H
+
+#include <atomic>
+#include <limits.h>
+
+#include "block_definitions.h"
+#include "block_channel_planner.h"
+#include "interference_analysis.h"
+
+// Energy-detect sweeps between beacon scans feed interference_analysis.h
+#ifndef ENERGY_DETECT
+#define ENERGY_DETECT ActiveScanner::energyDetect
+#endif
+
+const uint8_t ENERGY_DETECT_DURATION = 0;          // 2^n + 1 superframes per channel (30.72 ms)
+const unsigned long ENERGY_SWEEP_INTERVAL = 5000;  // between sweep starts
+const unsigned long ENERGY_SCAN_MARGIN = 100;      // a sweep must end this long before the next scan
+const unsigned long ENERGY_SWEEP_TIMEOUT = 2000;   // beyond the nominal end
+const unsigned long ENERGY_POLL_INTERVAL = 5;      // waiting for a late callback
+const int8_t ENERGY_FLOOR_DBM = -100;              // noiseLevel 0
+const int8_t ENERGY_BUSY_DBM = -80;                // a sample above this is occupied
+const uint16_t ENERGY_MIN_SAMPLES = 4;             // per channel for a window to count
+const uint8_t ENERGY_MIN_DUTY = 5;                 // busy share below this is a clean channel
+const uint8_t ENERGY_CONSTANT_DUTY = 90;           // busy share of constant interference
+const uint8_t ENERGY_WIDEBAND_RUN = 3;             // adjacent busy channels of a WiFi-like burst
+
+// Samples of one channel since the last beacon scan
+struct EnergyWindow {
+    uint16_t samples;
+    uint16_t busy;
+    uint16_t wide;             // busy as part of a wideband burst
+    uint16_t bursts;           // quiet-to-busy transitions
+    int32_t sumDbm;
+    int8_t minDbm;
+    int8_t peakDbm;
+    bool lastBusy;
+};
+
+// The ZDO energy-detect request (esp_zb_zdo_energy_detect_request() in
+// esp_zigbee_zdo_command.h of the ESP-Zigbee-SDK, which the Arduino core's
+// Zigbee library includes) measures the channels one after another for a
+// fixed time each and answers through a callback on the Zigbee task.
+// Sweeps only start when they end before the next planned beacon scan, so
+// scan timing does not change; the callback copies the readings and
+// publishes them with done.
+//
+// The Zigbee task holds the stack lock while it runs the callback, and the
+// loop only changes sweepId under that lock, so a callback that matched the
+// current sweep finishes before a timeout or a new sweep moves the id on.
+struct EnergySampler {
+    bool enabled;
+    bool busy;                         // sweep requested, results not folded yet
+    std::atomic<uint32_t> sweepId;     // callback context, stale answers are ignored
+    unsigned long sweepStart;
+    unsigned long sweepEnd;            // nominal end
+    unsigned long lastSweep;
+
+    std::atomic<bool> done;
+    bool ok;
+    int8_t reading[CHANNEL_COUNT];
+    bool measured[CHANNEL_COUNT];
+
+    EnergyWindow window[CHANNEL_COUNT];
+    uint32_t sweeps;
+    uint32_t failedSweeps;
+    uint32_t windows;
+};
+
+SCANNER_INSTANCE EnergySampler energySampler;
+
+unsigned long energySweepDurationMs(uint32_t channelMask, uint8_t duration) {
+    uint32_t channels = __builtin_popcount(channelMask & ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+    return (unsigned long)((channels * 15360UL * ((1UL << duration) + 1)) / 1000);
+}
+
+static void resetEnergyWindow(EnergyWindow *w) {
+    memset(w, 0, sizeof(EnergyWindow));
+    w->minDbm = INT8_MAX;
+    w->peakDbm = INT8_MIN;
+}
+
+void initEnergySampler(EnergySampler *s, bool enabled) {
+    s->enabled = enabled;
+    s->busy = false;
+    s->sweepId.store(0);
+    s->lastSweep = 0;
+    s->done.store(false);
+    s->sweeps = 0;
+    s->failedSweeps = 0;
+    s->windows = 0;
+    for(int i = 0; i < CHANNEL_COUNT; i++) resetEnergyWindow(&s->window[i]);
+}
+
+// Zigbee task
+static void energyDetectCallback(esp_zb_zdp_status_t status, uint16_t count,
+                                 esp_zb_energy_detect_channel_info_t *info, void *ctx) {
+    EnergySampler *s = &energySampler;
+    if((uint32_t)(uintptr_t)ctx != s->sweepId.load(std::memory_order_relaxed) ||
+       s->done.load(std::memory_order_relaxed)) return;
+    memset(s->measured, 0, sizeof(s->measured));
+    s->ok = status == ESP_ZB_ZDP_STATUS_SUCCESS;
+    for(uint16_t i = 0; s->ok && i < count; i++) {
+        int idx = info[i].channel_nbr - MIN_CHANNEL;
+        if(idx < 0 || idx >= CHANNEL_COUNT) continue;
+        s->reading[idx] = info[i].energy_detected;
+        s->measured[idx] = true;
+    }
+    s->done.store(true, std::memory_order_release);
+}
+
+// A sweep started now would be over before the next beacon scan
+bool energySweepFits(const EnergySampler *s, unsigned long now, unsigned long nextScan) {
+    if(!s->enabled || s->busy) return false;
+    if(s->sweepId > 0 && now - s->lastSweep < ENERGY_SWEEP_INTERVAL) return false;
+    unsigned long end = now + energySweepDurationMs(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK, ENERGY_DETECT_DURATION);
+    return (long)(nextScan - (end + ENERGY_SCAN_MARGIN)) >= 0;
+}
+
+void startEnergySweep(EnergySampler *s, unsigned long now) {
+    esp_zb_zdo_energy_detect_req_t request = {};
+    request.channel_mask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK;
+    request.duration = ENERGY_DETECT_DURATION;
+    s->busy = true;
+    s->sweepStart = now;
+    s->sweepEnd = now + energySweepDurationMs(request.channel_mask, request.duration);
+    s->lastSweep = now;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    uint32_t id = s->sweepId.load(std::memory_order_relaxed) + 1;
+    s->sweepId.store(id, std::memory_order_relaxed);
+    s->done.store(false, std::memory_order_relaxed);
+    esp_zb_zdo_energy_detect_request(&request, energyDetectCallback, (void *)(uintptr_t)id);
+    esp_zb_lock_release();
+}
+
+// Adds one sweep to the windows. A burst lighting up a run of adjacent
+// channels is wideband (a 20 MHz WiFi channel covers four Zigbee channels);
+// narrowband sources light one.
+static void foldEnergySweep(EnergySampler *s) {
+    bool busy[CHANNEL_COUNT];
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        busy[i] = s->measured[i] && s->reading[i] > ENERGY_BUSY_DBM;
+    }
+
+    int run = 0;
+    for(int i = 0; i <= CHANNEL_COUNT; i++) {
+        if(i < CHANNEL_COUNT && busy[i]) {
+            run++;
+            continue;
+        }
+        if(run >= ENERGY_WIDEBAND_RUN) {
+            for(int j = i - run; j < i; j++) s->window[j].wide++;
+        }
+        run = 0;
+    }
+
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        if(!s->measured[i]) continue;
+        EnergyWindow *w = &s->window[i];
+        int8_t dbm = s->reading[i];
+        w->samples++;
+        w->sumDbm += dbm;
+        if(dbm < w->minDbm) w->minDbm = dbm;
+        if(dbm > w->peakDbm) w->peakDbm = dbm;
+        if(busy[i]) {
+            w->busy++;
+            if(!w->lastBusy) w->bursts++;
+        }
+        w->lastBusy = busy[i];
+    }
+    s->sweeps++;
+}
+
+// Folds a finished sweep in. Returns true while a sweep still holds the radio.
+bool pollEnergySweep(EnergySampler *s, unsigned long now) {
+    if(!s->busy) return false;
+    if((long)(now - s->sweepEnd) < 0) return true;
+    if(s->done.load(std::memory_order_acquire)) {
+        if(s->ok) foldEnergySweep(s);
+        else s->failedSweeps++;
+        s->busy = false;
+    } else if(now - s->sweepEnd > ENERGY_SWEEP_TIMEOUT) {
+        s->failedSweeps++;
+        esp_zb_lock_acquire(portMAX_DELAY);
+        s->sweepId.fetch_add(1, std::memory_order_relaxed);
+        esp_zb_lock_release();
+        s->busy = false;
+    }
+    return s->busy;
+}
+
+// Turns the samples since the last beacon scan into currentAnalysis and
+// channelHistory, then starts a new window. Called after each beacon scan.
+void analyzeEnergyWindow(EnergySampler *s, unsigned long now) {
+    if(!s->enabled) return;
+    bool any = false;
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        EnergyWindow *w = &s->window[i];
+        if(w->samples < ENERGY_MIN_SAMPLES) continue;
+        InterferenceAnalysis *a = &currentAnalysis[i];
+        int mean = w->sumDbm / w->samples;
+        uint8_t duty = (uint8_t)((w->busy * 100UL) / w->samples);
+
+        a->samples = w->samples;
+        a->measuredAt = now;
+        a->minDbm = w->minDbm;
+        a->meanDbm = (int8_t)mean;
+        a->peakDbm = w->peakDbm;
+        a->dutyCycle = duty;
+        a->bursts = w->bursts;
+        a->noiseLevel = (uint8_t)constrain(mean - ENERGY_FLOOR_DBM, 0, 255);
+        a->isConstant = duty >= ENERGY_CONSTANT_DUTY;
+        a->wifiOverlap = a->isConstant ? 0 : (uint8_t)((w->wide * 100UL) / w->samples);
+
+        // Always on is not traffic (carrier, microwave oven); bursts over
+        // adjacent channels are WiFi, narrow ones Bluetooth hops
+        if(duty < ENERGY_MIN_DUTY) {
+            a->interferenceType = INTERFERENCE_NONE;
+        } else if(a->isConstant) {
+            a->interferenceType = INTERFERENCE_OTHER;
+        } else if(w->wide * 2 >= w->busy) {
+            a->interferenceType = INTERFERENCE_WIFI;
+        } else {
+            a->interferenceType = INTERFERENCE_BLUETOOTH;
+        }
+        if(a->interferenceType != INTERFERENCE_NONE) a->lastDetected = now;
+
+        updateInterferenceHistory(MIN_CHANNEL + i, a->noiseLevel);
+        resetEnergyWindow(w);
+        any = true;
+    }
+    if(any) s->windows++;
+}
+
+// Milliseconds until the sampler needs the loop: the running sweep's end,
+// or the next sweep start that fits before nextScan
+unsigned long energySamplerNextWakeup(const EnergySampler *s, unsigned long now, unsigned long nextScan) {
+    if(!s->enabled) return ULONG_MAX;
+    if(s->busy) return (long)(s->sweepEnd - now) > 0 ? s->sweepEnd - now : ENERGY_POLL_INTERVAL;
+    unsigned long start = s->sweepId > 0 ? s->lastSweep + ENERGY_SWEEP_INTERVAL : now;
+    if((long)(start - now) < 0) start = now;
+    return energySweepFits(s, start, nextScan) ? start - now : ULONG_MAX;
+}
+
+static const char *interferenceTypeName(uint8_t type) {
+    switch(type) {
+        case INTERFERENCE_WIFI: return "WiFi";
+        case INTERFERENCE_BLUETOOTH: return "Bluetooth";
+        case INTERFERENCE_OTHER: return "other";
+        default: return "none";
+    }
+}
+
+void printEnergyTable(const EnergySampler *s, Print &out) {
+    if(!s->enabled) {
+        out.print("Energy detect: off\n");
+        return;
+    }
+    out.printf("Energy detect: %lu sweeps (%lu failed), %lu windows\n",
+        (unsigned long)s->sweeps, (unsigned long)s->failedSweeps, (unsigned long)s->windows);
+    out.print("Ch  Min  Mean  Peak  Busy%  WiFi%  Bursts  Type\n");
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        const InterferenceAnalysis *a = &currentAnalysis[i];
+        if(a->samples == 0) continue;
+        out.printf("%2d %4d %5d %5d %6u %6u %7u  %s%s\n", MIN_CHANNEL + i,
+            a->minDbm, a->meanDbm, a->peakDbm, a->dutyCycle, a->wifiOverlap, a->bursts,
+            interferenceTypeName(a->interferenceType), a->isConstant ? " (constant)" : "");
+    }
+}
+
+#endif // ZIGBEE_SCANNER_ENERGY_DETECT_H
@@ -0,0 +1,223 @@
+#ifndef ZIGBEE_SCANNER_FIXED_POINT_H
+#define ZIGBEE_SCANNER_FIXED_POINT_H
+
+#include "block_definitions.h"
+
+// Fixed-point numbers for the analysis paths. The C6's RISC-V core has no
+// FPU, so every float operation is a soft-float call; rates, spreads and
+// their thresholds are kept in integers instead, and printed without going
+// through printf's %f.
+//
+// QFixed<F> is a signed Q(31-F).F number, raw / 2^F. Conversions and
+// arithmetic saturate at the ends of the range instead of wrapping.
+template<uint8_t F>
+struct QFixed {
+    static_assert(F > 0 && F < 31, "QFixed needs 1 to 30 fraction bits");
+    static constexpr int32_t one = (int32_t)1 << F;
+    int32_t raw;
+};
+
+typedef QFixed<16> Q16;    // Q15.16: signal levels and scaled comparisons
+typedef QFixed<24> Q24;    // Q7.24: percentages and spreads, up to 128
+
+// Float reference kernels and the "fixed" serial command timing them
+#ifndef FIXED_POINT_BENCH
+#define FIXED_POINT_BENCH 0
+#endif
+
+static inline int32_t qSaturate(int64_t v) {
+    if(v > INT32_MAX) return INT32_MAX;
+    if(v < INT32_MIN) return INT32_MIN;
+    return (int32_t)v;
+}
+
+template<uint8_t F>
+constexpr QFixed<F> qFromRaw(int32_t raw) {
+    return QFixed<F>{raw};
+}
+
+template<uint8_t F>
+QFixed<F> qFromInt(int32_t v) {
+    return QFixed<F>{qSaturate((int64_t)v * QFixed<F>::one)};
+}
+
+// num / den, rounded to nearest; den must not be 0
+template<uint8_t F>
+QFixed<F> qRatio(int64_t num, int64_t den) {
+    if(den < 0) {
+        num = -num;
+        den = -den;
+    }
+    // |num| stays below 2^(62-F) for the callers here, so the shift fits
+    int64_t scaled = num * QFixed<F>::one;
+    int64_t half = den / 2;
+    return QFixed<F>{qSaturate(scaled >= 0 ? (scaled + half) / den : (scaled - half) / den)};
+}
+
+template<uint8_t F>
+QFixed<F> qAdd(QFixed<F> a, QFixed<F> b) {
+    return QFixed<F>{qSaturate((int64_t)a.raw + b.raw)};
+}
+
+template<uint8_t F>
+QFixed<F> qSub(QFixed<F> a, QFixed<F> b) {
+    return QFixed<F>{qSaturate((int64_t)a.raw - b.raw)};
+}
+
+// Product rounded to nearest
+template<uint8_t F>
+QFixed<F> qMul(QFixed<F> a, QFixed<F> b) {
+    int64_t p = (int64_t)a.raw * b.raw;
+    int64_t half = (int64_t)1 << (F - 1);
+    return QFixed<F>{qSaturate(p >= 0 ? (p + half) >> F : -((-p + half) >> F))};
+}
+
+// Square root of a non-negative integer, truncated to the last fraction bit
+template<uint8_t F>
+QFixed<F> qSqrtInt(uint32_t v) {
+    // v * 2^2F has to fit in 64 bits
+    if(2 * F + 32 > 64 && v >= ((uint64_t)1 << (64 - 2 * F))) return QFixed<F>{INT32_MAX};
+    uint64_t x = (uint64_t)v << (2 * F);
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while(bit > x) bit >>= 2;
+    while(bit) {
+        if(x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return QFixed<F>{qSaturate((int64_t)root)};
+}
+
+// part / whole in percent, Q24; 0 when whole is 0
+static inline Q24 qPercent(uint32_t part, uint32_t whole) {
+    return whole ? qRatio<24>((int64_t)part * 100, whole) : qFromRaw<24>(0);
+}
+
+// Writes v with decimals places, e.g. "-12.5", and returns buf. Rounds to
+// nearest with ties to even, as printf does with the exact value of a float.
+template<uint8_t F>
+char *qFormat(QFixed<F> v, uint8_t decimals, char *buf, size_t size) {
+    static const uint32_t powers[] = {1, 10, 100, 1000, 10000, 100000};
+    if(decimals > 5) decimals = 5;
+    uint64_t magnitude = v.raw < 0 ? (uint64_t)(-(int64_t)v.raw) : (uint64_t)v.raw;
+    uint64_t product = magnitude * powers[decimals];
+    uint64_t scaled = product >> F;
+    uint64_t rest = product & (((uint64_t)1 << F) - 1);
+    uint64_t half = (uint64_t)1 << (F - 1);
+    if(rest > half || (rest == half && (scaled & 1))) scaled++;
+
+    // Digits from the right, then the sign
+    char digits[24];
+    uint8_t n = 0;
+    for(uint8_t i = 0; i < decimals; i++) {
+        digits[n++] = '0' + scaled % 10;
+        scaled /= 10;
+    }
+    if(decimals) digits[n++] = '.';
+    do {
+        digits[n++] = '0' + scaled % 10;
+        scaled /= 10;
+    } while(scaled);
+    bool zero = true;
+    for(uint8_t i = 0; i < n; i++) zero &= digits[i] == '0' || digits[i] == '.';
+    if(v.raw < 0 && !zero) digits[n++] = '-';
+
+    size_t len = 0;
+    while(n > 0 && len + 1 < size) buf[len++] = digits[--n];
+    if(size) buf[len] = 0;
+    return buf;
+}
+
+template<uint8_t F>
+size_t qPrint(Print &out, QFixed<F> v, uint8_t decimals) {
+    char buf[16];
+    return out.print(qFormat(v, decimals, buf, sizeof(buf)));
+}
+
+#if FIXED_POINT_BENCH
+
+// The float code the kernels replaced, kept to check and time them against
+
+static inline bool floatLossAbove(uint32_t missed, uint32_t expected, float threshold) {
+    float lossRate = (float)missed / expected * 100;
+    return lossRate > threshold;
+}
+
+static inline char *floatFormatLoss(uint32_t missed, uint32_t expected, char *buf, size_t size) {
+    float lossRate = (float)missed / expected * 100;
+    snprintf(buf, size, "%.1f", lossRate);
+    return buf;
+}
+
+static inline char *floatFormatSpread(uint32_t variance, char *buf, size_t size) {
+    snprintf(buf, size, "%.1f", sqrtf(variance));
+    return buf;
+}
+
+static inline bool floatBelowAverage(uint8_t average, uint8_t signal) {
+    float avgStrength = average;
+    return avgStrength > signal * 1.5;
+}
+
+// Cycles per call of each kernel, float against fixed point, over the
+// same inputs; runs for a few milliseconds
+void printFixedPointBench(Print &out) {
+    const uint16_t rounds = 256;
+    char buf[16];
+    uint32_t sink = 0;
+    uint32_t cycles[4][2];
+
+    for(uint8_t fixed = 0; fixed < 2; fixed++) {
+        uint32_t start = ESP.getCycleCount();
+        for(uint16_t i = 0; i < rounds; i++) {
+            uint32_t expected = 20 + i * 7;
+            uint32_t missed = (i * 37) % expected;
+            sink += fixed ? qPercent(missed, expected).raw > qFromInt<24>(20).raw : floatLossAbove(missed, expected, 20);
+        }
+        cycles[0][fixed] = ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        for(uint16_t i = 0; i < rounds; i++) {
+            uint32_t expected = 20 + i * 7;
+            uint32_t missed = (i * 37) % expected;
+            sink += fixed ? qFormat(qPercent(missed, expected), 1, buf, sizeof(buf))[0] :
+                floatFormatLoss(missed, expected, buf, sizeof(buf))[0];
+        }
+        cycles[1][fixed] = ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        for(uint16_t i = 0; i < rounds; i++) {
+            uint32_t variance = (uint32_t)i * 61;
+            sink += fixed ? qFormat(qSqrtInt<24>(variance), 1, buf, sizeof(buf))[0] :
+                floatFormatSpread(variance, buf, sizeof(buf))[0];
+        }
+        cycles[2][fixed] = ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        for(uint16_t i = 0; i < rounds; i++) {
+            uint8_t average = (uint8_t)(i * 13);
+            uint8_t signal = (uint8_t)i;
+            sink += fixed ? qFromInt<16>(average).raw > qMul(qFromInt<16>(signal), qFromRaw<16>(3 << 15)).raw :
+                floatBelowAverage(average, signal);
+        }
+        cycles[3][fixed] = ESP.getCycleCount() - start;
+    }
+
+    static const char *names[] = {"loss threshold", "loss percent", "signal spread", "below average"};
+    out.printf("Kernel           Float cycles  Fixed cycles  (per call, %lu MHz)\n",
+        (unsigned long)ESP.getCpuFreqMHz());
+    for(uint8_t k = 0; k < 4; k++) {
+        out.printf("%-16s %12lu  %12lu\n", names[k],
+            (unsigned long)(cycles[k][0] / rounds), (unsigned long)(cycles[k][1] / rounds));
+    }
+    if(sink == 0) out.print("");    // keeps the loops
+}
+
+#endif // FIXED_POINT_BENCH
+
+#endif // ZIGBEE_SCANNER_FIXED_POINT_H
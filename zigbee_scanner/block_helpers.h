@@ -2,14 +2,19 @@
 #define ZIGBEE_SCANNER_HELPERS_H
 
 #include "block_definitions.h"
+#include "block_text.h"
 
 // Global variables
-NetworkStats networkStats[MAX_NETWORKS];
-NetworkHistory previousScan[MAX_NETWORKS];
-int previousNetworksCount = 0;
+SCANNER_INSTANCE NetworkTable networkTable;
+SCANNER_INSTANCE ScanSnapshot currentScan;
+SCANNER_INSTANCE ReportWriter Report(Serial);
+SCANNER_INSTANCE NetworkHistory previousScan[MAX_NETWORKS];
+SCANNER_INSTANCE int previousNetworksCount = 0;
+SCANNER_INSTANCE NetworkStats *scanStats[SCAN_SNAPSHOT_CAPACITY];   // per network of the scan last passed to updateScanStats()
+SCANNER_INSTANCE ReportSelection reportSelection;
 
 // Functions
-String getSignalLevel(uint8_t strength) {
+const char* getSignalLevel(uint8_t strength) {
     int level = (strength * 5) / 0xFF;
     switch(level) {
         case 0: return "[----]";
@@ -22,13 +27,19 @@ String getSignalLevel(uint8_t strength) {
     }
 }
 
-String getLoadLevel(uint8_t load) {
+const char* getLoadLevel(uint8_t load) {
     if (load >= 80) return "(!HIGH!)";
     if (load >= 60) return "(HIGH)";
     if (load >= 40) return "(Med)";
     return "(Low)";
 }
 
+const char* getSignalTrend(uint8_t trend) {
+    if (trend == 1) return "improving";
+    if (trend == 2) return "degrading";
+    return "stable";
+}
+
 const char* getSignalQuality(uint16_t rawSignal) {
     uint8_t signalStrength = (rawSignal >> 8) & 0xFF;
     if (signalStrength >= 0x80) return "Excellent";
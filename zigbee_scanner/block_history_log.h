@@ -0,0 +1,405 @@
+#ifndef ZIGBEE_SCANNER_HISTORY_LOG_H
+#define ZIGBEE_SCANNER_HISTORY_LOG_H
+
+#include <esp_partition.h>
+
+#include "block_definitions.h"
+#include "block_history_log_format.h"
+#include "block_cycle_profile.h"
+
+// Append every scan to the on-flash history log
+#ifndef HISTORY_LOG
+#define HISTORY_LOG ActiveScanner::historyLog
+#endif
+
+// Data partition the log owns, used raw (the Zigbee partition schemes
+// leave a spiffs partition the sketch does not otherwise use)
+#ifndef HISTORY_LOG_PARTITION
+#define HISTORY_LOG_PARTITION "spiffs"
+#endif
+
+// Sectors of the partition used for the ring (8 bytes of RAM each)
+#ifndef HISTORY_LOG_MAX_SECTORS
+#define HISTORY_LOG_MAX_SECTORS 128
+#endif
+
+// Output room a dump step needs before it decodes the next block
+#define HISTORY_LOG_DUMP_ROOM (64 + HISTORY_LOG_MAX_RECORDS * 32)
+
+struct HistoryLogSector {
+    uint32_t sequence;             // 0: erased or not part of the log
+    uint32_t baseTime;
+};
+
+// Append-only ring log of scans in a flash partition. Sectors are erased
+// one at a time as the ring comes round, so every sector sees the same
+// number of erases. The sector index in RAM (sequence and first block time
+// of each sector) locates a time range without touching the flash.
+struct HistoryLog {
+    const esp_partition_t *partition;
+    bool enabled;
+    uint16_t sectors;              // in the ring
+    uint16_t used;                 // holding log data
+    uint16_t oldest;
+    uint16_t current;              // being appended to
+    uint32_t writeOffset;          // in the current sector
+    uint32_t bootBase;             // log time at millis() 0 of this boot
+    HistoryLogCursor cursor;       // encoder state of the current sector
+    HistoryLogSector index[HISTORY_LOG_MAX_SECTORS];
+    uint16_t order[SCAN_SNAPSHOT_CAPACITY];
+    uint8_t block[HISTORY_LOG_MAX_PAYLOAD + HISTORY_LOG_BLOCK_OVERHEAD];
+    HistoryLogRecord records[HISTORY_LOG_MAX_RECORDS];
+
+    // Counters since boot
+    uint32_t blocksWritten;
+    uint32_t recordsWritten;
+    uint32_t bytesWritten;
+    uint32_t sectorErases;
+    uint32_t writeErrors;
+};
+
+// Progress of a dump command, one block per step
+struct HistoryLogDump {
+    bool active;
+    uint32_t from;
+    uint32_t to;
+    uint16_t sector;
+    uint32_t sequence;             // of sector, to notice it being recycled
+    uint32_t offset;
+    HistoryLogCursor cursor;
+    uint32_t scans;
+    uint32_t records;
+};
+
+SCANNER_INSTANCE HistoryLog historyLog;
+SCANNER_INSTANCE HistoryLogDump historyLogDump;
+
+static uint32_t historyLogSectorOffset(uint16_t sector) {
+    return (uint32_t)sector * HISTORY_LOG_SECTOR_SIZE;
+}
+
+// Log time in seconds for a millis() value of this boot
+uint32_t historyLogTime(const HistoryLog *log, unsigned long ms) {
+    return log->bootBase + ms / 1000;
+}
+
+// Reads the block at offset of a sector into log->block. Returns its size,
+// 0 at the end of the sector's data or on a torn block.
+static size_t historyLogReadBlock(HistoryLog *log, uint16_t sector, uint32_t offset) {
+    uint32_t available = HISTORY_LOG_SECTOR_SIZE - offset;
+    if(available < HISTORY_LOG_BLOCK_OVERHEAD) return 0;
+    uint32_t base = historyLogSectorOffset(sector) + offset;
+    if(esp_partition_read(log->partition, base, log->block, HISTORY_LOG_BLOCK_HEADER_SIZE) != ESP_OK) return 0;
+
+    uint16_t length = historyLogGet16(log->block);
+    if(length == HISTORY_LOG_UNWRITTEN || length > HISTORY_LOG_MAX_PAYLOAD) return 0;
+    size_t size = min((size_t)length + HISTORY_LOG_BLOCK_OVERHEAD, (size_t)available);
+    if(esp_partition_read(log->partition, base + HISTORY_LOG_BLOCK_HEADER_SIZE,
+                          log->block + HISTORY_LOG_BLOCK_HEADER_SIZE, size - HISTORY_LOG_BLOCK_HEADER_SIZE) != ESP_OK) {
+        return 0;
+    }
+    return historyLogCheckBlock(log->block, size);
+}
+
+// Erases the next sector of the ring and starts it at time
+static bool historyLogOpenSector(HistoryLog *log, uint32_t time) {
+    uint16_t next = log->used == 0 ? 0 : (log->current + 1) % log->sectors;
+    uint32_t sequence = log->used == 0 ? 1 : log->index[log->current].sequence + 1;
+
+    log->index[next].sequence = 0;
+    if(log->used == log->sectors) log->oldest = (log->oldest + 1) % log->sectors;
+    else log->used++;
+    log->current = next;
+    log->writeOffset = HISTORY_LOG_SECTOR_SIZE;     // unusable until the header is down
+
+    uint32_t base = historyLogSectorOffset(next);
+    uint8_t header[HISTORY_LOG_SECTOR_HEADER_SIZE];
+    historyLogBuildSectorHeader(header, sequence, time);
+    log->sectorErases++;
+    if(esp_partition_erase_range(log->partition, base, HISTORY_LOG_SECTOR_SIZE) != ESP_OK ||
+       esp_partition_write(log->partition, base, header, sizeof(header)) != ESP_OK) {
+        log->writeErrors++;
+        return false;
+    }
+    log->index[next].sequence = sequence;
+    log->index[next].baseTime = time;
+    log->writeOffset = HISTORY_LOG_SECTOR_HEADER_SIZE;
+    log->bytesWritten += sizeof(header);
+    historyLogResetCursor(&log->cursor, time);
+    return true;
+}
+
+// Fills log->block with a scan block of the networks from first on (in
+// PAN ID order), as many as fit. Returns the block size, *next the first
+// network left out.
+static size_t historyLogEncodeScan(HistoryLog *log, const ScanSnapshot *scan, uint16_t first,
+                                   uint32_t time, uint16_t *next) {
+    uint8_t *payload = log->block + HISTORY_LOG_BLOCK_HEADER_SIZE;
+    size_t n = historyLogPutVarint(payload, time - log->cursor.time);
+    uint32_t mask = scan->channelMask & HISTORY_LOG_ALL_CHANNELS;
+    n += historyLogPutVarint(payload + n, mask == HISTORY_LOG_ALL_CHANNELS ? 0 : mask >> 11);
+    size_t countAt = n++;          // HISTORY_LOG_MAX_RECORDS fits one varint byte
+
+    uint16_t i = first;
+    uint16_t previousPan = 0;
+    for(; i < scan->count && n + 6 <= HISTORY_LOG_MAX_PAYLOAD; i++) {
+        uint16_t idx = log->order[i];
+        uint16_t pan = scan->panId[idx];
+        uint8_t channel = scan->channel[idx] & 0x1F;
+        n += historyLogPutVarint(payload + n, i == first ? pan : pan - previousPan);
+        previousPan = pan;
+
+        HistoryLogDeltaSlot *slot = historyLogDeltaSlot(&log->cursor, pan, channel);
+        int signalDelta = slot ? scan->signal[idx] - slot->signal : 0;
+        int loadDelta = slot ? scan->load[idx] - slot->load : 0;
+        if(slot && slot->used && historyLogFitsNibble(signalDelta) && historyLogFitsNibble(loadDelta)) {
+            payload[n++] = channel | HISTORY_LOG_HEAD_DELTA;
+            payload[n++] = (uint8_t)((signalDelta & 0x0F) | ((loadDelta & 0x0F) << 4));
+        } else {
+            payload[n++] = channel;
+            payload[n++] = scan->signal[idx];
+            payload[n++] = scan->load[idx];
+        }
+        if(slot) {
+            slot->signal = scan->signal[idx];
+            slot->load = scan->load[idx];
+            slot->used = true;
+        }
+    }
+    payload[countAt] = (uint8_t)(i - first);
+    *next = i;
+    return n;
+}
+
+static size_t historyLogEncodeBoot(HistoryLog *log, uint32_t time) {
+    return historyLogPutVarint(log->block + HISTORY_LOG_BLOCK_HEADER_SIZE, time - log->cursor.time);
+}
+
+// Frames the payload in log->block and writes it to the current sector
+static bool historyLogWriteBlock(HistoryLog *log, uint8_t type, size_t length, uint32_t time) {
+    historyLogPut16(log->block, (uint16_t)length);
+    log->block[2] = type;
+    size_t size = HISTORY_LOG_BLOCK_HEADER_SIZE + length;
+    historyLogPut16(log->block + size, telemetryCrc16(TELEMETRY_CRC_INIT, log->block, size));
+    size += 2;
+
+    uint32_t base = historyLogSectorOffset(log->current) + log->writeOffset;
+    if(esp_partition_write(log->partition, base, log->block, size) != ESP_OK) {
+        // Whatever made it is torn; nothing more goes into this sector
+        log->writeOffset = HISTORY_LOG_SECTOR_SIZE;
+        log->writeErrors++;
+        return false;
+    }
+    log->writeOffset += size;
+    log->cursor.time = time;
+    log->blocksWritten++;
+    log->bytesWritten += size;
+    return true;
+}
+
+// Whether a block of size bytes still fits the current sector
+static bool historyLogFits(const HistoryLog *log, size_t length) {
+    return log->used > 0 && log->writeOffset + length + HISTORY_LOG_BLOCK_OVERHEAD <= HISTORY_LOG_SECTOR_SIZE;
+}
+
+// Appends a scan. The encoding depends on the sector (delta coding restarts
+// in each), so a block that does not fit is encoded again for a new one.
+bool historyLogAppendScan(HistoryLog *log, const ScanSnapshot *scan, uint32_t time) {
+    if(!log->enabled) return false;
+    CYCLE_PHASE(PHASE_HISTORY);
+    time = max(time, log->cursor.time);
+
+    // PAN ID order keeps the gaps between records small
+    for(uint16_t i = 0; i < scan->count; i++) {
+        uint16_t j = i;
+        while(j > 0 && scan->panId[log->order[j - 1]] > scan->panId[i]) {
+            log->order[j] = log->order[j - 1];
+            j--;
+        }
+        log->order[j] = i;
+    }
+
+    uint16_t first = 0;
+    do {
+        uint16_t next;
+        size_t length = historyLogEncodeScan(log, scan, first, time, &next);
+        if(!historyLogFits(log, length)) {
+            if(!historyLogOpenSector(log, time)) return false;
+            length = historyLogEncodeScan(log, scan, first, time, &next);
+        }
+        if(!historyLogWriteBlock(log, HISTORY_LOG_BLOCK_SCAN, length, time)) return false;
+        log->recordsWritten += next - first;
+        first = next;
+    } while(first < scan->count);
+    return true;
+}
+
+static bool historyLogAppendBoot(HistoryLog *log, uint32_t time) {
+    size_t length = historyLogEncodeBoot(log, time);
+    if(!historyLogFits(log, length)) {
+        if(!historyLogOpenSector(log, time)) return false;
+        length = historyLogEncodeBoot(log, time);
+    }
+    return historyLogWriteBlock(log, HISTORY_LOG_BLOCK_BOOT, length, time);
+}
+
+// Finds the log in the partition, replays the sector being written to
+// recover the encoder state and the time, and records the boot. With
+// enable false, or without the partition, the log stays off.
+bool historyLogBegin(HistoryLog *log, bool enable, unsigned long now) {
+    memset(log, 0, sizeof(HistoryLog));
+    if(!enable) return false;
+    log->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HISTORY_LOG_PARTITION);
+    if(!log->partition) return false;
+    log->sectors = min(log->partition->size / HISTORY_LOG_SECTOR_SIZE, (uint32_t)HISTORY_LOG_MAX_SECTORS);
+    if(log->sectors < 2) return false;
+
+    uint32_t newest = 0;
+    for(uint16_t s = 0; s < log->sectors; s++) {
+        uint8_t header[HISTORY_LOG_SECTOR_HEADER_SIZE];
+        HistoryLogSector *entry = &log->index[s];
+        if(esp_partition_read(log->partition, historyLogSectorOffset(s), header, sizeof(header)) != ESP_OK ||
+           !historyLogParseSectorHeader(header, &entry->sequence, &entry->baseTime)) {
+            entry->sequence = 0;
+        }
+        if(entry->sequence > newest) {
+            newest = entry->sequence;
+            log->current = s;
+        }
+    }
+
+    if(newest > 0) {
+        // The log is the run of consecutive sequences ending at the newest
+        while(log->used < log->sectors) {
+            uint16_t s = (log->current + log->sectors - log->used) % log->sectors;
+            if(log->index[s].sequence == 0 || log->index[s].sequence != newest - log->used) break;
+            log->used++;
+        }
+        log->oldest = (log->current + log->sectors - log->used + 1) % log->sectors;
+        for(uint16_t s = 0; s < log->sectors; s++) {
+            uint16_t age = (log->current + log->sectors - s) % log->sectors;
+            if(age >= log->used) log->index[s].sequence = 0;
+        }
+
+        historyLogResetCursor(&log->cursor, log->index[log->current].baseTime);
+        log->writeOffset = HISTORY_LOG_SECTOR_HEADER_SIZE;
+        HistoryLogBlock info;
+        size_t size;
+        while((size = historyLogReadBlock(log, log->current, log->writeOffset)) > 0 &&
+              historyLogDecodeBlock(&log->cursor, log->block, &info, log->records)) {
+            log->writeOffset += size;
+        }
+        // Anything but erased space here is a torn block: the sector is done
+        uint8_t length[2] = { 0xFF, 0xFF };
+        if(log->writeOffset + sizeof(length) <= HISTORY_LOG_SECTOR_SIZE) {
+            esp_partition_read(log->partition, historyLogSectorOffset(log->current) + log->writeOffset,
+                               length, sizeof(length));
+        }
+        if(historyLogGet16(length) != HISTORY_LOG_UNWRITTEN) log->writeOffset = HISTORY_LOG_SECTOR_SIZE;
+        log->bootBase = log->cursor.time + 1;
+    }
+
+    log->enabled = true;
+    historyLogAppendBoot(log, historyLogTime(log, now));
+    return true;
+}
+
+// First sector of the log that can hold data at time (binary search over
+// the ring in sequence order, sectors start in time order)
+static uint16_t historyLogFindSector(const HistoryLog *log, uint32_t time) {
+    uint16_t lo = 0;
+    uint16_t hi = log->used;
+    while(hi - lo > 1) {
+        uint16_t mid = (lo + hi) / 2;
+        if(log->index[(log->oldest + mid) % log->sectors].baseTime <= time) lo = mid;
+        else hi = mid;
+    }
+    return (log->oldest + lo) % log->sectors;
+}
+
+static void historyLogDumpSeek(const HistoryLog *log, HistoryLogDump *dump, uint16_t sector) {
+    dump->sector = sector;
+    dump->sequence = log->index[sector].sequence;
+    dump->offset = HISTORY_LOG_SECTOR_HEADER_SIZE;
+    historyLogResetCursor(&dump->cursor, log->index[sector].baseTime);
+}
+
+void historyLogStartDump(HistoryLog *log, HistoryLogDump *dump, uint32_t from, uint32_t to, Print &out) {
+    memset(dump, 0, sizeof(HistoryLogDump));
+    dump->from = from;
+    dump->to = to;
+    out.printf("# history %lu..%lu s\n", (unsigned long)from, (unsigned long)to);
+    out.print("time,pan,channel,signal,load\n");
+    if(!log->enabled || log->used == 0) {
+        out.print("# end, 0 scans, 0 records\n");
+        return;
+    }
+    dump->active = true;
+    historyLogDumpSeek(log, dump, historyLogFindSector(log, from));
+}
+
+static void historyLogEndDump(HistoryLogDump *dump, Print &out) {
+    out.printf("# end, %lu scans, %lu records\n", (unsigned long)dump->scans, (unsigned long)dump->records);
+    dump->active = false;
+}
+
+// Prints the next block of a dump if room bytes of output are free.
+// Returns false once the dump is done.
+bool historyLogDumpStep(HistoryLog *log, HistoryLogDump *dump, Print &out, size_t room) {
+    if(!dump->active) return false;
+    if(room < HISTORY_LOG_DUMP_ROOM) return true;
+
+    if(log->index[dump->sector].sequence != dump->sequence) {
+        // The ring came round and recycled this sector under the dump
+        out.print("# skipped overwritten history\n");
+        historyLogDumpSeek(log, dump, log->oldest);
+    }
+
+    HistoryLogBlock info;
+    size_t size = historyLogReadBlock(log, dump->sector, dump->offset);
+    if(size == 0 || !historyLogDecodeBlock(&dump->cursor, log->block, &info, log->records)) {
+        uint16_t next = (dump->sector + 1) % log->sectors;
+        if(dump->sector == log->current || log->index[next].sequence != dump->sequence + 1) {
+            historyLogEndDump(dump, out);
+            return false;
+        }
+        historyLogDumpSeek(log, dump, next);
+        return true;
+    }
+    dump->offset += size;
+
+    if(info.time > dump->to) {
+        historyLogEndDump(dump, out);
+        return false;
+    }
+    if(info.time < dump->from) return true;
+
+    char line[48];
+    if(info.type == HISTORY_LOG_BLOCK_BOOT) {
+        out.write(line, snprintf(line, sizeof(line), "# boot at %lu\n", (unsigned long)info.time));
+        return true;
+    }
+    dump->scans++;
+    for(uint16_t i = 0; i < info.count; i++) {
+        const HistoryLogRecord *r = &log->records[i];
+        out.write(line, snprintf(line, sizeof(line), "%lu,0x%04x,%u,%u,%u\n",
+            (unsigned long)r->time, r->panId, r->channel, r->signal, r->load));
+    }
+    dump->records += info.count;
+    return true;
+}
+
+void printHistoryLogStatus(const HistoryLog *log, Print &out) {
+    if(!log->enabled) {
+        out.print("History log: off (no \"" HISTORY_LOG_PARTITION "\" partition)\n");
+        return;
+    }
+    uint32_t newest = log->cursor.time;
+    uint32_t oldest = log->used ? log->index[log->oldest].baseTime : newest;
+    out.printf("History log: %u of %u sectors, %lu..%lu s, this boot %lu records in %lu bytes, %lu erases, %lu errors\n",
+        log->used, log->sectors, (unsigned long)oldest, (unsigned long)newest,
+        (unsigned long)log->recordsWritten, (unsigned long)log->bytesWritten,
+        (unsigned long)log->sectorErases, (unsigned long)log->writeErrors);
+}
+
+#endif // ZIGBEE_SCANNER_HISTORY_LOG_H
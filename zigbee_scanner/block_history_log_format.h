@@ -0,0 +1,246 @@
+#ifndef ZIGBEE_SCANNER_HISTORY_LOG_FORMAT_H
+#define ZIGBEE_SCANNER_HISTORY_LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "block_telemetry_format.h"
+
+// On-flash scan history, shared by the sketch and host-side readers.
+// All fields are little-endian.
+//
+// The log is a ring of erase sectors written in order. A sector starts with
+//   magic u32, sequence u32, baseTime u32, reserved u16, crc u16
+// where sequence grows by one per sector opened (the highest is the sector
+// being written) and baseTime is the log time of its first block. Log time
+// is in seconds and keeps counting across reboots.
+//
+// Blocks follow back to back until the erased (0xFF) space:
+//   length u16 (payload bytes), type u8, payload, crc u16 over length..payload
+// A block that does not check out ends its sector (torn by a power loss).
+//
+// Scan block payload
+//   dt varint          seconds since the previous block of the sector
+//                      (the first one: since baseTime)
+//   channels varint    channelMask >> 11, 0 for all channels
+//   count varint       records that follow
+// then per network, in ascending PAN ID order:
+//   pan varint         first record: PAN ID, then the gap to the previous one
+//   head u8            channel (bits 0-4), bit 7 set: delta coded
+//   delta coded:       u8 signal delta (bits 0-3) and load delta (bits 4-7),
+//                      two's complement nibbles against the same PAN and
+//                      channel's previous record in the sector
+//   otherwise:         signal u8, load u8
+// A scan with more networks than fit a block continues in further blocks
+// with dt 0.
+//
+// Boot block payload: dt varint. Written once per boot.
+
+#define HISTORY_LOG_SECTOR_SIZE 4096
+#define HISTORY_LOG_MAGIC 0x314C485AUL            // "ZHL1"
+#define HISTORY_LOG_SECTOR_HEADER_SIZE 16
+#define HISTORY_LOG_BLOCK_HEADER_SIZE 3           // length, type
+#define HISTORY_LOG_BLOCK_OVERHEAD 5              // header and crc
+#define HISTORY_LOG_MAX_PAYLOAD 256
+#define HISTORY_LOG_MAX_RECORDS (HISTORY_LOG_MAX_PAYLOAD / 3)
+#define HISTORY_LOG_UNWRITTEN 0xFFFF
+
+#define HISTORY_LOG_BLOCK_SCAN 1
+#define HISTORY_LOG_BLOCK_BOOT 2
+
+#define HISTORY_LOG_ALL_CHANNELS 0x07FFF800UL
+#define HISTORY_LOG_HEAD_DELTA 0x80
+
+// Previous values per PAN ID and channel for delta coding (power of two).
+// Writer and reader run the same updates on it, so they always agree.
+#define HISTORY_LOG_DELTA_SLOTS 64
+
+struct HistoryLogRecord {
+    uint32_t time;
+    uint16_t panId;
+    uint8_t channel;
+    uint8_t signal;
+    uint8_t load;
+};
+
+struct HistoryLogBlock {
+    uint8_t type;                    // HISTORY_LOG_BLOCK_*
+    uint32_t time;
+    uint32_t channelMask;
+    uint16_t count;                  // records decoded
+};
+
+struct HistoryLogDeltaSlot {
+    uint16_t panId;
+    uint8_t channel;
+    uint8_t signal;
+    uint8_t load;
+    bool used;
+};
+
+// Decoding state within one sector
+struct HistoryLogCursor {
+    uint32_t time;
+    HistoryLogDeltaSlot deltas[HISTORY_LOG_DELTA_SLOTS];
+};
+
+static inline uint16_t historyLogGet16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t historyLogGet32(const uint8_t *p) {
+    return (uint32_t)historyLogGet16(p) | ((uint32_t)historyLogGet16(p + 2) << 16);
+}
+
+static inline void historyLogPut16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static inline void historyLogPut32(uint8_t *p, uint32_t value) {
+    historyLogPut16(p, value & 0xFFFF);
+    historyLogPut16(p + 2, value >> 16);
+}
+
+// LEB128: 7 bits a byte, low bits first
+static inline size_t historyLogPutVarint(uint8_t *p, uint32_t value) {
+    size_t n = 0;
+    while(value >= 0x80) {
+        p[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (uint8_t)value;
+    return n;
+}
+
+// Returns the bytes read, 0 if the varint runs past end
+static inline size_t historyLogGetVarint(const uint8_t *p, const uint8_t *end, uint32_t *value) {
+    uint32_t result = 0;
+    for(size_t n = 0; n < 5 && p + n < end; n++) {
+        result |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+        if(!(p[n] & 0x80)) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static inline void historyLogResetCursor(HistoryLogCursor *cursor, uint32_t baseTime) {
+    cursor->time = baseTime;
+    memset(cursor->deltas, 0, sizeof(cursor->deltas));
+}
+
+// Slot of a PAN ID and channel, claimed if it has none yet; NULL when the
+// table is full
+static inline HistoryLogDeltaSlot *historyLogDeltaSlot(HistoryLogCursor *cursor, uint16_t panId, uint8_t channel) {
+    uint32_t hash = ((uint32_t)panId * 40503u) ^ channel;
+    for(int probe = 0; probe < HISTORY_LOG_DELTA_SLOTS; probe++) {
+        HistoryLogDeltaSlot *slot = &cursor->deltas[(hash + probe) & (HISTORY_LOG_DELTA_SLOTS - 1)];
+        if(!slot->used) {
+            slot->panId = panId;
+            slot->channel = channel;
+            return slot;
+        }
+        if(slot->panId == panId && slot->channel == channel) return slot;
+    }
+    return NULL;
+}
+
+static inline bool historyLogFitsNibble(int delta) {
+    return delta >= -8 && delta <= 7;
+}
+
+static inline int historyLogNibble(uint8_t nibble) {
+    return nibble >= 8 ? (int)nibble - 16 : nibble;
+}
+
+// Sector header check; fills sequence and baseTime
+static inline bool historyLogParseSectorHeader(const uint8_t *header, uint32_t *sequence, uint32_t *baseTime) {
+    if(historyLogGet32(header) != HISTORY_LOG_MAGIC) return false;
+    if(telemetryCrc16(TELEMETRY_CRC_INIT, header, 14) != historyLogGet16(header + 14)) return false;
+    *sequence = historyLogGet32(header + 4);
+    *baseTime = historyLogGet32(header + 8);
+    return *sequence != 0;
+}
+
+static inline void historyLogBuildSectorHeader(uint8_t *header, uint32_t sequence, uint32_t baseTime) {
+    historyLogPut32(header, HISTORY_LOG_MAGIC);
+    historyLogPut32(header + 4, sequence);
+    historyLogPut32(header + 8, baseTime);
+    historyLogPut16(header + 12, 0xFFFF);
+    historyLogPut16(header + 14, telemetryCrc16(TELEMETRY_CRC_INIT, header, 14));
+}
+
+// Checks a whole block (header, payload, crc) at most available bytes long.
+// Returns its size, 0 at the end of the sector's data or on a torn block.
+static inline size_t historyLogCheckBlock(const uint8_t *block, size_t available) {
+    if(available < HISTORY_LOG_BLOCK_OVERHEAD) return 0;
+    uint16_t length = historyLogGet16(block);
+    if(length == HISTORY_LOG_UNWRITTEN || length > HISTORY_LOG_MAX_PAYLOAD) return 0;
+    size_t size = (size_t)length + HISTORY_LOG_BLOCK_OVERHEAD;
+    if(size > available) return 0;
+    uint16_t crc = telemetryCrc16(TELEMETRY_CRC_INIT, block, HISTORY_LOG_BLOCK_HEADER_SIZE + length);
+    return crc == historyLogGet16(block + HISTORY_LOG_BLOCK_HEADER_SIZE + length) ? size : 0;
+}
+
+// Decodes a checked block into info and records (HISTORY_LOG_MAX_RECORDS),
+// advancing the cursor. Returns false on a malformed payload.
+static inline bool historyLogDecodeBlock(HistoryLogCursor *cursor, const uint8_t *block,
+                                         HistoryLogBlock *info, HistoryLogRecord *records) {
+    const uint8_t *p = block + HISTORY_LOG_BLOCK_HEADER_SIZE;
+    const uint8_t *end = p + historyLogGet16(block);
+    uint32_t value;
+    size_t n;
+
+    info->type = block[2];
+    info->count = 0;
+    info->channelMask = HISTORY_LOG_ALL_CHANNELS;
+    if(!(n = historyLogGetVarint(p, end, &value))) return false;
+    p += n;
+    cursor->time += value;
+    info->time = cursor->time;
+    if(info->type != HISTORY_LOG_BLOCK_SCAN) return true;
+
+    if(!(n = historyLogGetVarint(p, end, &value))) return false;
+    p += n;
+    if(value) info->channelMask = value << 11;
+    uint32_t count;
+    if(!(n = historyLogGetVarint(p, end, &count)) || count > HISTORY_LOG_MAX_RECORDS) return false;
+    p += n;
+
+    uint32_t pan = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        if(!(n = historyLogGetVarint(p, end, &value)) || p + n >= end) return false;
+        p += n;
+        pan = i == 0 ? value : pan + value;
+        uint8_t head = *p++;
+
+        HistoryLogRecord *record = &records[i];
+        record->time = cursor->time;
+        record->panId = (uint16_t)pan;
+        record->channel = head & 0x1F;
+
+        HistoryLogDeltaSlot *slot = historyLogDeltaSlot(cursor, record->panId, record->channel);
+        if(head & HISTORY_LOG_HEAD_DELTA) {
+            if(p + 1 > end || !slot || !slot->used) return false;
+            uint8_t packed = *p++;
+            record->signal = (uint8_t)(slot->signal + historyLogNibble(packed & 0x0F));
+            record->load = (uint8_t)(slot->load + historyLogNibble(packed >> 4));
+        } else {
+            if(p + 2 > end) return false;
+            record->signal = *p++;
+            record->load = *p++;
+        }
+        if(slot) {
+            slot->signal = record->signal;
+            slot->load = record->load;
+            slot->used = true;
+        }
+    }
+    info->count = (uint16_t)count;
+    return p == end;
+}
+
+#endif // ZIGBEE_SCANNER_HISTORY_LOG_FORMAT_H
@@ -0,0 +1,69 @@
+#ifndef ZIGBEE_SCANNER_MEMORY_FOOTPRINT_H
+#define ZIGBEE_SCANNER_MEMORY_FOOTPRINT_H
+
+#include "block_definitions.h"
+#include "block_text.h"
+#include "block_serial_output.h"
+#include "block_channel_planner.h"
+#include "block_history_log.h"
+#include "block_energy_detect.h"
+#include "block_channel_score.h"
+#include "block_analysis_stages.h"
+#include "block_cycle_profile.h"
+#include "block_rollups.h"
+#include "block_command_memo.h"
+
+// Static RAM of the scanner's tables for the configured profile (the
+// Zigbee stack, FreeRTOS and the Arduino core come on top)
+
+struct MemoryUse {
+    const char *name;
+    size_t bytes;
+};
+
+const MemoryUse memoryUse[] = {
+    { "network table", sizeof(networkTable) },
+    { "current scan", sizeof(currentScan) },
+    { "previous scan", sizeof(previousScan) },
+    { "scan stats", sizeof(scanStats) },
+    { "report selection", sizeof(reportSelection) },
+    { "report output", sizeof(Report) },
+    { "serial output", sizeof(serialOutput) },
+    { "history log", sizeof(historyLog) + sizeof(historyLogDump) },
+    { "energy detect", sizeof(energySampler) + sizeof(currentAnalysis) },
+    { "channel ranking", sizeof(channelRanking) },
+    { "change log", sizeof(changeLog) },
+    { "channel planner", sizeof(channelPlanner) },
+    { "analysis stages", sizeof(scanAnalysis) },
+#if CYCLE_PROFILE
+    { "cycle profile", sizeof(cycleProfile) },
+#endif
+#if ROLLUPS
+    { "rollups", sizeof(rollups) },
+#endif
+    { "command memo", sizeof(commandMemo) },
+};
+
+const uint8_t MEMORY_USE_COUNT = sizeof(memoryUse) / sizeof(memoryUse[0]);
+
+size_t memoryFootprintTotal() {
+    size_t total = 0;
+    for(uint8_t i = 0; i < MEMORY_USE_COUNT; i++) total += memoryUse[i].bytes;
+    return total;
+}
+
+void printMemoryFootprint(Print &out) {
+    out.printf("Profile: %s, %u networks tracked, %u per scan, %u signal samples\n",
+        SCANNER_PROFILE_NAME, (unsigned)NETWORK_TABLE_CAPACITY, (unsigned)SCAN_SNAPSHOT_CAPACITY,
+        (unsigned)SIGNAL_HISTORY_SIZE);
+    out.printf("Index widths: network %u byte(s), scan %u byte(s); per network %u bytes (%u hot)\n",
+        (unsigned)sizeof(NetworkIndex), (unsigned)sizeof(ScanIndex),
+        (unsigned)(sizeof(NetworkEntry) + sizeof(NetworkStats) + sizeof(NetworkSeries)), (unsigned)sizeof(NetworkStats));
+    for(uint8_t i = 0; i < MEMORY_USE_COUNT; i++) {
+        out.printf("%-18s %8lu\n", memoryUse[i].name, (unsigned long)memoryUse[i].bytes);
+    }
+    out.printf("%-18s %8lu\n", "total", (unsigned long)memoryFootprintTotal());
+    out.printf("Free heap: %lu bytes\n", (unsigned long)ESP.getFreeHeap());
+}
+
+#endif // ZIGBEE_SCANNER_MEMORY_FOOTPRINT_H
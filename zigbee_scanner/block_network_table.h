@@ -0,0 +1,113 @@
+#ifndef ZIGBEE_SCANNER_NETWORK_TABLE_H
+#define ZIGBEE_SCANNER_NETWORK_TABLE_H
+
+#include "block_definitions.h"
+
+// Network table: per-network stats keyed on PAN ID + extended PAN ID.
+// Fixed capacity, no heap. When full, the network seen longest ago is evicted.
+
+void resetNetworkStats(NetworkStats *stats) {
+    memset(stats, 0, sizeof(NetworkStats));
+}
+
+// The cold half of a network's state, stats from the same table
+NetworkSeries *networkSeries(NetworkTable *table, const NetworkStats *stats) {
+    return &table->series[stats - table->stats];
+}
+
+static uint16_t networkTableHash(uint16_t panId, uint64_t extPanId) {
+    uint64_t h = (extPanId ^ ((uint64_t)panId << 48) ^ panId) * 0x9E3779B97F4A7C15ULL;
+    return (uint16_t)(h >> 48) & (NETWORK_TABLE_SLOTS - 1);
+}
+
+static void lruUnlink(NetworkTable *table, NetworkIndex idx) {
+    NetworkEntry *entry = &table->entries[idx];
+    if(entry->lruPrev != NETWORK_TABLE_NONE) table->entries[entry->lruPrev].lruNext = entry->lruNext;
+    else table->lruHead = entry->lruNext;
+    if(entry->lruNext != NETWORK_TABLE_NONE) table->entries[entry->lruNext].lruPrev = entry->lruPrev;
+    else table->lruTail = entry->lruPrev;
+}
+
+static void lruPushFront(NetworkTable *table, NetworkIndex idx) {
+    NetworkEntry *entry = &table->entries[idx];
+    entry->lruPrev = NETWORK_TABLE_NONE;
+    entry->lruNext = table->lruHead;
+    if(table->lruHead != NETWORK_TABLE_NONE) table->entries[table->lruHead].lruPrev = idx;
+    table->lruHead = idx;
+    if(table->lruTail == NETWORK_TABLE_NONE) table->lruTail = idx;
+}
+
+// Returns the slot holding the key, or the empty slot where it would go
+static uint16_t findSlot(NetworkTable *table, uint16_t panId, uint64_t extPanId) {
+    uint16_t slot = networkTableHash(panId, extPanId);
+    while(table->slots[slot] != NETWORK_TABLE_NONE) {
+        NetworkEntry *entry = &table->entries[table->slots[slot]];
+        if(entry->panId == panId && entry->extendedPanId == extPanId) break;
+        slot = (slot + 1) & (NETWORK_TABLE_SLOTS - 1);
+    }
+    return slot;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void removeSlot(NetworkTable *table, uint16_t slot) {
+    uint16_t hole = slot;
+    uint16_t next = (hole + 1) & (NETWORK_TABLE_SLOTS - 1);
+    while(table->slots[next] != NETWORK_TABLE_NONE) {
+        NetworkEntry *entry = &table->entries[table->slots[next]];
+        uint16_t home = networkTableHash(entry->panId, entry->extendedPanId);
+        // Move the entry back if its home slot is not inside (hole, next]
+        if(((next - home) & (NETWORK_TABLE_SLOTS - 1)) >= ((next - hole) & (NETWORK_TABLE_SLOTS - 1))) {
+            table->slots[hole] = table->slots[next];
+            hole = next;
+        }
+        next = (next + 1) & (NETWORK_TABLE_SLOTS - 1);
+    }
+    table->slots[hole] = NETWORK_TABLE_NONE;
+}
+
+void clearNetworkTable(NetworkTable *table) {
+    memset(table->slots, 0xFF, sizeof(table->slots));
+    table->count = 0;
+    table->lruHead = NETWORK_TABLE_NONE;
+    table->lruTail = NETWORK_TABLE_NONE;
+    table->evictions = 0;
+}
+
+NetworkStats *findNetworkStats(NetworkTable *table, uint16_t panId, uint64_t extPanId) {
+    uint16_t slot = findSlot(table, panId, extPanId);
+    if(table->slots[slot] == NETWORK_TABLE_NONE) return NULL;
+    return &table->stats[table->slots[slot]];
+}
+
+// Looks up the network, adding it (and evicting the stalest one if needed)
+// when it was not tracked yet, and marks it as most recently seen
+NetworkStats *trackNetwork(NetworkTable *table, uint16_t panId, uint64_t extPanId) {
+    uint16_t slot = findSlot(table, panId, extPanId);
+    NetworkIndex idx = table->slots[slot];
+
+    if(idx != NETWORK_TABLE_NONE) {
+        lruUnlink(table, idx);
+    } else {
+        if(table->count < NETWORK_TABLE_CAPACITY) {
+            idx = table->count++;
+        } else {
+            idx = table->lruTail;
+            NetworkEntry *stale = &table->entries[idx];
+            removeSlot(table, findSlot(table, stale->panId, stale->extendedPanId));
+            lruUnlink(table, idx);
+            table->evictions++;
+            slot = findSlot(table, panId, extPanId);
+        }
+        NetworkEntry *entry = &table->entries[idx];
+        entry->panId = panId;
+        entry->extendedPanId = extPanId;
+        resetNetworkStats(&table->stats[idx]);
+        memset(&table->series[idx], 0, sizeof(NetworkSeries));
+        table->slots[slot] = idx;
+    }
+
+    lruPushFront(table, idx);
+    return &table->stats[idx];
+}
+
+#endif // ZIGBEE_SCANNER_NETWORK_TABLE_H
@@ -4,126 +4,225 @@
 #include "block_definitions.h"
 #include "block_helpers.h"
 #include "block_analysis.h"
+#include "block_scan_decode.h"
+#include "block_telemetry.h"
+#include "block_delta_report.h"
+#include "block_analysis_stages.h"
+#include "block_cycle_profile.h"
+#include "block_fixed_point.h"
+#include "block_rollups.h"
+
+// Output functions. They print through a ReportWriter: Report for the
+// per-scan report, one over a reply for the serial commands.
+
+void printSummaryHeader(ReportWriter &out) {
+    out.println("+------------------+----+------+---------+--------+----------+---------+");
+    out.println("| PAN ID (dec/hex) | CH | Join | Routers | EndDev | Security | Status  |");
+    out.println("+------------------+----+------+---------+--------+----------+---------+");
+}
+
+void printSummaryFooter(ReportWriter &out, const ScanSnapshot *scan) {
+    out.println("+------------------+----+------+---------+--------+----------+---------+");
+    if (scan->truncated > 0) {
+        out.printf("(%d more networks not shown, SCAN_SNAPSHOT_CAPACITY is %d)\n",
+            scan->truncated, SCAN_SNAPSHOT_CAPACITY);
+    }
+}
+
+static const char *networkStatusName(uint8_t status) {
+    switch(status) {
+        case NETWORK_STATUS_NEW: return "New";
+        case NETWORK_STATUS_BACK: return "Back";
+        case NETWORK_STATUS_BETTER: return "Better";
+        case NETWORK_STATUS_DOWN: return "(!) Down";
+        default: return "Stable";
+    }
+}
 
-// Output functions
-void printSummaryTable(zigbee_scan_result_t *scan_result, uint16_t networksFound) {
-    Serial.println("\n=== NETWORK SCAN SUMMARY ===");
-    Serial.println("+------------------+----+------+---------+--------+----------+---------+");
-    Serial.println("| PAN ID (dec/hex) | CH | Join | Routers | EndDev | Security | Status  |");
-    Serial.println("+------------------+----+------+---------+--------+----------+---------+");
-
-    for (int i = 0; i < networksFound; ++i) {
-        uint8_t* raw = (uint8_t*)&scan_result[i];
-        if (!raw) {
-            Serial.printf("Error accessing network data for index %d\n", i);
-            continue;
-        }
-
-        uint16_t rawSignal = (raw[0] << 8) | raw[1];
-        uint8_t signalStrength = (rawSignal >> 8) & 0xFF;
-
-        String status = "New";
-        for(int j = 0; j < previousNetworksCount; j++) {
-            if(previousScan[j].panId == scan_result[i].short_pan_id) {
-                if(previousScan[j].signalStrength < signalStrength) {
-                    status = "Better";
-                } else if(previousScan[j].signalStrength > signalStrength) {
-                    status = "(!) Down";
-                } else {
-                    status = "Stable";
-                }
-                break;
-            }
-        }
+// One row of the summary table, status as the selection found it
+void printSummaryRow(ReportWriter &out, const ScanSnapshot *scan, const ReportSelection *selection, int i) {
+    uint8_t flags = scan->flags[i];
+    const char *status = networkStatusName(selection->status[i]);
+
+    char panIdStr[20];
+    snprintf(panIdStr, sizeof(panIdStr), "%5d/0x%04x", 
+        scan->panId[i], 
+        scan->panId[i]);
+
+    out.printf("| %-16s | %2d | %-4s | %-7s | %-6s | %-8s | %-7s |\n",
+        panIdStr,
+        scan->channel[i],
+        (flags & NETWORK_FLAG_PERMIT_JOIN) ? "Yes" : "No",
+        (flags & NETWORK_FLAG_ROUTER_CAP) ? "Yes" : "No",
+        (flags & NETWORK_FLAG_END_DEV_CAP) ? "Yes" : "No",
+        (flags & NETWORK_FLAG_SECURED) ? "Secured" : "Open",
+        status
+    );
+}
 
+void printSummaryTable(ReportWriter &out, const ScanSnapshot *scan, const ReportSelection *selection) {
+    if (selection->keyframe) {
+        out.println("\n=== NETWORK SCAN SUMMARY ===");
+    } else if (selection->count == 0 && selection->goneCount == 0) {
+        out.printf("\n=== NO CHANGES (%d networks) ===\n", scan->count);
+        return;
+    } else {
+        out.printf("\n=== NETWORK CHANGES (%d of %d networks) ===\n", selection->count, scan->count);
+    }
+    printSummaryHeader(out);
+
+    for (int n = 0; n < selection->count; ++n) {
+        printSummaryRow(out, scan, selection, selection->index[n]);
+    }
+
+    for (int n = 0; n < selection->goneCount; ++n) {
+        const NetworkHistory *network = &previousScan[selection->gone[n]];
         char panIdStr[20];
-        snprintf(panIdStr, sizeof(panIdStr), "%5d/0x%04x", 
-            scan_result[i].short_pan_id, 
-            scan_result[i].short_pan_id);
-
-        Serial.printf("| %-16s | %2d | %-4s | %-7s | %-6s | %-8s | %-7s |\n",
-            panIdStr,
-            scan_result[i].logic_channel,
-            scan_result[i].permit_joining ? "Yes" : "No",
-            scan_result[i].router_capacity ? "Yes" : "No",
-            scan_result[i].end_device_capacity ? "Yes" : "No",
-            (raw[5] & 0x7F) ? "Secured" : "Open",
-            status.c_str()
-        );
+        snprintf(panIdStr, sizeof(panIdStr), "%5d/0x%04x", network->panId, network->panId);
+        out.printf("| %-16s | %2d | %-4s | %-7s | %-6s | %-8s | %-7s |\n",
+            panIdStr, network->channel, "-", "-", "-", "-", "Gone");
     }
     
-    Serial.println("+------------------+----+------+---------+--------+----------+---------+");
+    printSummaryFooter(out, scan);
 }
 
-void printNetworkDiagnostics(zigbee_scan_result_t *scan_result, uint16_t networksFound) {
-    Serial.println("\n=== NETWORK DIAGNOSTICS ===");
-    
-    // Update channel statistics
-    updateChannelStats(scan_result, networksFound);
+// Diagnostics of network i of the scan
+void printNetworkDiagnosis(ReportWriter &out, const ScanSnapshot *scan, int i) {
+    NetworkStats *stats = scanStats[i];
+    if (!stats) return;
+
+    out.printf("\nNetwork 0x%04x (PAN ID: %d):\n",
+        scan->panId[i],
+        scan->panId[i]);
+
+    out.printf("├─ Type: %s\n", stats->isCoordinator ? "Coordinator" : "Router/End Device");
+    out.printf("├─ Uptime: %lu sec\n", (unsigned long)networkUptime(stats));
+    out.printf("├─ Signal index (not RSSI): %d avg, %d-%d range, %s\n",
+        stats->avgSignalStrength, stats->minSignalStrength, stats->maxSignalStrength,
+        getSignalTrend(stats->signalTrend));
+    const SignalStats<SIGNAL_HISTORY_SIZE> *signal = &networkSeries(&networkTable, stats)->signal;
+    char spread[16];
+    out.printf("├─ Signal Spread: p10 %d, p50 %d, p90 %d, sd %s\n",
+        signalStatsQuantile(signal, 10),
+        signalStatsQuantile(signal, 50),
+        signalStatsQuantile(signal, 90),
+        qFormat(qSqrtInt<24>(signalStatsVariance(signal)), 1, spread, sizeof(spread)));
+
+    if(stats->beaconsExpected > 0) {
+        Q24 beaconLoss = qPercent(stats->beaconsMissed, stats->beaconsExpected);
+        char loss[16];
+
+        out.printf("├─ Beacon Loss: %s%% (%lu of %lu scans)", qFormat(beaconLoss, 1, loss, sizeof(loss)),
+            (unsigned long)stats->beaconsMissed, (unsigned long)stats->beaconsExpected);
+        if(stats->beaconsExpected < analysisThresholds.lossMinScans) out.println("");
+        else if(beaconLoss.raw > qFromInt<24>(analysisThresholds.lossCritical).raw) out.println(" (!!!)");
+        else if(beaconLoss.raw > qFromInt<24>(analysisThresholds.lossWarning).raw) out.println(" (!)");
+        else out.println(" (OK)");
+
+        out.printf("├─ Missed In A Row: %u last, %u longest\n",
+            stats->missStreak, stats->longestMissStreak);
+    }
+
+#if ROLLUPS
+    // The last day once the store holds more than the signal window
+    const RollupStore *rollup = networkRollup(&rollups, stats);
+    if(rollup && rollup->active && scan->timestamp - rollup->since >= ROLLUP_REPORT_AGE) {
+        RollupSummary day = rollupSummary(rollup, scan->timestamp, 86400000UL);
+        out.printf("├─ Last 24 h: seen in %u%% of %lu scans, signal %u (%u..%u), load %u%% (max %u%%)\n",
+            rollupPresence(&day), (unsigned long)day.scans, rollupSignalMean(&day),
+            day.signalMin, day.signalMax, rollupLoadMean(&day), day.loadMax);
+    }
+#endif
+
+    // Problem analysis
+    FixedTextBuffer<256> analysis;
+    getNetworkAnalysis(stats, analysis);
+    if(analysis.length() > 0) {
+        out.print("└─ Issues Found:\n");
+        out.print(analysis.c_str());
+    } else {
+        out.println("└─ No issues detected");
+    }
+}
+
+void printNetworkDiagnostics(ReportWriter &out, const ScanSnapshot *scan, const ReportSelection *selection) {
+    if (selection->count == 0) return;
+
+    out.println("\n=== NETWORK DIAGNOSTICS ===");
 
     // Network analysis
-    Serial.println("\nNetwork Analysis:");
-    for(int i = 0; i < networksFound; i++) {
-        updateNetworkStats(i, &scan_result[i]);
-        
-        Serial.printf("\nNetwork 0x%04x (PAN ID: %d):\n",
-            scan_result[i].short_pan_id,
-            scan_result[i].short_pan_id);
-
-        uint8_t* raw = (uint8_t*)&scan_result[i];
-        uint16_t rawSignal = (raw[0] << 8) | raw[1];
-        uint8_t signalStrength = (rawSignal >> 8) & 0xFF;
-        uint8_t networkLoad = (raw[4] * 100) / 255;
-        
-        Serial.printf("├─ Type: %s\n", networkStats[i].isCoordinator ? "Coordinator" : "Router/End Device");
-        Serial.printf("├─ Uptime: %d sec\n", networkStats[i].uptime);
-
-        if(networkStats[i].totalPackets > 0) {
-            float packetLoss = (float)networkStats[i].failedPackets / networkStats[i].totalPackets * 100;
-            float retryRate = (float)networkStats[i].retriesCount / networkStats[i].totalPackets * 100;
-            
-            Serial.printf("├─ Packet Loss: %.1f%%", packetLoss);
-            if(packetLoss > 20) Serial.println(" (!!!)");
-            else if(packetLoss > 10) Serial.println(" (!)");
-            else Serial.println(" (OK)");
-            
-            Serial.printf("├─ Retry Rate: %.1f%%\n", retryRate);
-        }
-
-        // Problem analysis
-        String analysis = getNetworkAnalysis(i);
-        if(analysis.length() > 0) {
-            Serial.printf("└─ Issues Found:\n%s", analysis.c_str());
-        } else {
-            Serial.println("└─ No issues detected");
-        }
+    out.println("\nNetwork Analysis:");
+    for(int n = 0; n < selection->count; n++) {
+        printNetworkDiagnosis(out, scan, selection->index[n]);
     }
 }
 
-void printScannedNetworks(uint16_t networksFound) {
-    Serial.printf("\nScan completed. Networks found: %d\n", networksFound);
-    
-    if (networksFound == 0 || networksFound == 255) {
-        Serial.println("No networks found or scan error");
-        return;
+// Runs the analysis pipeline (stats, selection, text report) and reports a
+// decoded scan in the selected modes. Only called for scans that found
+// networks; empty and failed scans run the STAGE_ALWAYS stages alone (see
+// reportScannedNetworks()).
+void reportScan(const ScanSnapshot *scan) {
+    runScanAnalysis(scan, (reportMode & REPORT_MODE_TEXT) ? STAGE_TEXT : STAGE_REPORT);
+    if (reportMode & REPORT_MODE_BINARY) {
+        CYCLE_PHASE(PHASE_TELEMETRY);
+        writeScanTelemetry(Report.raw(), scan, &reportSelection);
     }
+    markNetworksReported(scan, &reportSelection);
+    finishReport(&reportSelection);
+    saveNetworkHistory(scan);
+}
 
-    zigbee_scan_result_t *scan_result = Zigbee.getScanResult();
+// Copies a finished scan out of the stack into scan and hands the result
+// buffer back, so the radio is free for the next scan before anything is
+// analysed or printed. Returns false if the stack had no results to give.
+bool captureScanResults(uint16_t networksFound, uint32_t channelMask, ScanSnapshot *scan) {
+    // Error paths below leave an empty snapshot rather than a stale one,
+    // covering no channels when the scan itself failed
+    beginScanSnapshot(scan, networksFound == 255 ? 0 : channelMask);
+    if (networksFound == 0 || networksFound == 255) return true;
+
+    zigbee_scan_result_t *scan_result;
+    {
+        CYCLE_PHASE(PHASE_RESULT_COPY);
+        scan_result = Zigbee.getScanResult();
+    }
     if (!scan_result) {
-        Serial.println("Error: Unable to get scan results");
-        return;
+        scan->channelMask = 0;
+        return false;
     }
 
-    Serial.println("Scan data received successfully");
-    Serial.println("-------------------------------");
-
-    if (networksFound > 0) {
-        printSummaryTable(scan_result, networksFound);
-        printNetworkDiagnostics(scan_result, networksFound);
-        saveNetworkHistory(scan_result, networksFound);
+    // Decode once, then hand the buffer back to the stack
+    {
+        CYCLE_PHASE(PHASE_DECODE);
+        decodeScanResults(scan_result, networksFound, scan);
     }
-    
     Zigbee.scanDelete();
+    return true;
+}
+
+// Prints and analyses a scan taken by captureScanResults()
+void reportScannedNetworks(uint16_t networksFound, bool captured, const ScanSnapshot *scan) {
+    Report.printf("\nScan completed. Networks found: %d\n", networksFound);
+
+    if (networksFound == 0 || networksFound == 255) {
+        Report.println("No networks found or scan error");
+    } else if (!captured) {
+        Report.println("Error: Unable to get scan results");
+    } else {
+        Report.println("Scan data received successfully");
+        Report.println("-------------------------------");
+    }
+
+    if (scan->count > 0) {
+        reportScan(scan);
+    } else {
+        runScanAnalysis(scan, STAGE_ALWAYS);
+    }
+}
+
+void printScannedNetworks(uint16_t networksFound, uint32_t channelMask) {
+    bool captured = captureScanResults(networksFound, channelMask, &currentScan);
+    reportScannedNetworks(networksFound, captured, &currentScan);
 }
 
 #endif // ZIGBEE_SCANNER_OUTPUT_H
\ No newline at end of file
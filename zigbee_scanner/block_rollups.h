@@ -0,0 +1,442 @@
+#ifndef ZIGBEE_SCANNER_ROLLUPS_H
+#define ZIGBEE_SCANNER_ROLLUPS_H
+
+#include "block_definitions.h"
+#include "block_network_table.h"
+
+// Long-term trends per channel and for as many networks as the budget
+// allows. Scans are rolled up into 1-minute, 15-minute and 1-hour buckets
+// (scans, sightings, min/max/mean of signal and load). A scan only adds to
+// the open bucket of the finest tier; when a bucket's time is over it is
+// written to its tier's ring and folded into the open bucket of the next
+// tier, so nothing is kept raw and the memory never grows. A summary reads
+// at most one ring plus the open buckets, whatever the time it covers.
+//
+// Channel stores take every scan of the channel: its strongest network's
+// signal and the summed load of its networks, seen when any network
+// answered. Network stores take every scan of the network's channel, seen
+// when it answered. Networks get a store in the order they are found while
+// stores are free; a store is freed when its network leaves the table.
+// On in the dense site profile only: the stores take ROLLUP_BUDGET of RAM
+// (64 KB by default), more than the rest of the standard profile's tables.
+#ifndef ROLLUPS
+#define ROLLUPS (SCANNER_PROFILE == SCANNER_PROFILE_DENSE_SITE)
+#endif
+
+// RAM for all stores: the channels' first, the rest for networks. Only
+// taken with ROLLUPS 1.
+#ifndef ROLLUP_BUDGET
+#define ROLLUP_BUDGET ActiveScanner::rollupBudget
+#endif
+
+// Buckets per tier: an hour of minutes, 4 hours of quarters, 7 days of hours
+#ifndef ROLLUP_MINUTES
+#define ROLLUP_MINUTES 60
+#endif
+#ifndef ROLLUP_QUARTERS
+#define ROLLUP_QUARTERS 16
+#endif
+#ifndef ROLLUP_HOURS
+#define ROLLUP_HOURS 168
+#endif
+
+#define ROLLUP_TIERS 3
+#define ROLLUP_BUCKETS (ROLLUP_MINUTES + ROLLUP_QUARTERS + ROLLUP_HOURS)
+
+static_assert(ROLLUP_MINUTES > 0 && ROLLUP_QUARTERS > 0 && ROLLUP_HOURS > 0,
+              "every rollup tier needs at least one bucket");
+
+// A store this old shows its last day in the text report's diagnostics
+const unsigned long ROLLUP_REPORT_AGE = 3600000UL;
+
+struct RollupTier {
+    uint32_t lengthMs;            // a multiple of the finer tier's
+    uint16_t count;
+    uint16_t offset;              // into RollupStore::buckets
+};
+
+const RollupTier rollupTiers[ROLLUP_TIERS] = {
+    { 60000UL, ROLLUP_MINUTES, 0 },
+    { 900000UL, ROLLUP_QUARTERS, ROLLUP_MINUTES },
+    { 3600000UL, ROLLUP_HOURS, ROLLUP_MINUTES + ROLLUP_QUARTERS },
+};
+
+// A closed bucket; scans == 0 is an empty one
+struct RollupBucket {
+    uint16_t scans;               // scans of the channel
+    uint16_t seen;                // of them with a sighting
+    uint8_t signalMin;            // signal index, over the sightings
+    uint8_t signalMax;
+    uint8_t signalMean;
+    uint8_t loadMin;              // %, over the sightings
+    uint8_t loadMax;
+    uint8_t loadMean;
+};
+
+// The bucket a tier is filling, with exact sums
+struct RollupOpen {
+    uint32_t index;               // timestamp / RollupTier::lengthMs
+    int32_t signalSum;
+    uint32_t loadSum;
+    uint16_t scans;
+    uint16_t seen;
+    uint8_t signalMin;
+    uint8_t signalMax;
+    uint8_t loadMin;
+    uint8_t loadMax;
+};
+
+// All zero is the empty state, so memset() resets it
+struct RollupStore {
+    uint32_t since;               // timestamp of the first sample
+    uint16_t lastScan;            // ScanSnapshot::sequence of the last sample
+    bool active;
+    RollupOpen open[ROLLUP_TIERS];
+    RollupBucket buckets[ROLLUP_BUCKETS];
+};
+
+// Whose a network store is
+struct RollupOwner {
+    uint64_t extendedPanId;
+    uint16_t panId;
+    uint8_t channel;
+    bool used;
+};
+
+// Networks the budget leaves room for after the channels and the count
+// of free stores
+constexpr uint32_t rollupNetworkStores(uint32_t budget) {
+    return budget > CHANNEL_COUNT * sizeof(RollupStore) + 8 ?
+        (budget - CHANNEL_COUNT * sizeof(RollupStore) - 8) / (sizeof(RollupStore) + sizeof(RollupOwner)) : 0;
+}
+#define ROLLUP_NETWORKS rollupNetworkStores(ROLLUP_BUDGET)
+
+static_assert(!ROLLUPS || ROLLUP_BUDGET >= CHANNEL_COUNT * sizeof(RollupStore) + 8,
+              "ROLLUP_BUDGET does not fit the channel rollups");
+static_assert(ROLLUP_NETWORKS < 255, "NetworkSeries::rollup holds at most 254 network stores");
+
+// What a summary covers, at the resolution of the tier it was read from
+struct RollupSummary {
+    uint32_t scans;
+    uint32_t seen;
+    int32_t signalSum;            // over the sightings, signal index
+    uint32_t loadSum;
+    uint8_t signalMin;
+    uint8_t signalMax;
+    uint8_t loadMin;
+    uint8_t loadMax;
+    uint16_t read;                // buckets read, closed and open
+};
+
+// sum / n rounded to nearest, n > 0
+static inline int32_t rollupDivide(int32_t sum, int32_t n) {
+    return (sum + (sum >= 0 ? n / 2 : -n / 2)) / n;
+}
+
+static inline uint8_t rollupSignalMean(const RollupSummary *s) {
+    return s->seen ? (uint8_t)rollupDivide(s->signalSum, (int32_t)s->seen) : 0;
+}
+
+static inline uint8_t rollupLoadMean(const RollupSummary *s) {
+    return s->seen ? (uint8_t)((s->loadSum + s->seen / 2) / s->seen) : 0;
+}
+
+// Sightings per scan, in percent
+static inline uint8_t rollupPresence(const RollupSummary *s) {
+    return s->scans ? (uint8_t)((s->seen * 100 + s->scans / 2) / s->scans) : 0;
+}
+
+static void rollupResetOpen(RollupOpen *open, uint32_t index) {
+    memset(open, 0, sizeof(RollupOpen));
+    open->index = index;
+    open->signalMin = UINT8_MAX;
+    open->signalMax = 0;
+    open->loadMin = UINT8_MAX;
+}
+
+// Sums of from added to into
+static void rollupMergeOpen(RollupOpen *into, const RollupOpen *from) {
+    if(from->scans == 0) return;
+    into->scans = (uint16_t)min((uint32_t)into->scans + from->scans, (uint32_t)UINT16_MAX);
+    if(from->seen == 0) return;
+    into->seen = (uint16_t)min((uint32_t)into->seen + from->seen, (uint32_t)UINT16_MAX);
+    into->signalSum += from->signalSum;
+    into->loadSum += from->loadSum;
+    into->signalMin = min(into->signalMin, from->signalMin);
+    into->signalMax = max(into->signalMax, from->signalMax);
+    into->loadMin = min(into->loadMin, from->loadMin);
+    into->loadMax = max(into->loadMax, from->loadMax);
+}
+
+static void rollupCloseBucket(RollupBucket *bucket, const RollupOpen *open) {
+    memset(bucket, 0, sizeof(RollupBucket));
+    bucket->scans = open->scans;
+    bucket->seen = open->seen;
+    if(open->seen == 0) return;
+    bucket->signalMin = open->signalMin;
+    bucket->signalMax = open->signalMax;
+    bucket->signalMean = (uint8_t)rollupDivide(open->signalSum, open->seen);
+    bucket->loadMin = open->loadMin;
+    bucket->loadMax = open->loadMax;
+    bucket->loadMean = (uint8_t)((open->loadSum + open->seen / 2) / open->seen);
+}
+
+// Closes the open buckets time has left behind, finest first: each one
+// goes to its ring and into the next tier's open bucket. Buckets skipped
+// without samples are cleared.
+static void rollupAdvance(RollupStore *store, uint32_t time) {
+    for(uint8_t t = 0; t < ROLLUP_TIERS; t++) {
+        const RollupTier *tier = &rollupTiers[t];
+        RollupOpen *open = &store->open[t];
+        uint32_t index = time / tier->lengthMs;
+        if(index == open->index) return;       // coarser tiers are still open too
+
+        RollupBucket *ring = &store->buckets[tier->offset];
+        rollupCloseBucket(&ring[open->index % tier->count], open);
+        uint32_t skipped = index - open->index - 1;
+        if(skipped > tier->count) skipped = tier->count;
+        for(uint32_t i = 1; i <= skipped; i++) {
+            memset(&ring[(open->index + i) % tier->count], 0, sizeof(RollupBucket));
+        }
+        if(t + 1 < ROLLUP_TIERS) rollupMergeOpen(&store->open[t + 1], open);
+        rollupResetOpen(open, index);
+    }
+}
+
+void rollupAdd(RollupStore *store, uint32_t time, bool seen, uint8_t signal, uint8_t load) {
+    if(!store->active) {
+        memset(store, 0, sizeof(RollupStore));
+        for(uint8_t t = 0; t < ROLLUP_TIERS; t++) rollupResetOpen(&store->open[t], time / rollupTiers[t].lengthMs);
+        store->since = time;
+        store->active = true;
+    }
+    rollupAdvance(store, time);
+
+    RollupOpen *open = &store->open[0];
+    if(open->scans < UINT16_MAX) open->scans++;
+    if(!seen || open->seen == UINT16_MAX) return;
+    open->seen++;
+    open->signalSum += signal;
+    open->loadSum += load;
+    open->signalMin = min(open->signalMin, signal);
+    open->signalMax = max(open->signalMax, signal);
+    open->loadMin = min(open->loadMin, load);
+    open->loadMax = max(open->loadMax, load);
+}
+
+static void rollupSummaryAddOpen(RollupSummary *s, const RollupOpen *open) {
+    s->read++;
+    s->scans += open->scans;
+    if(open->seen == 0) return;
+    s->seen += open->seen;
+    s->signalSum += open->signalSum;
+    s->loadSum += open->loadSum;
+    s->signalMin = min(s->signalMin, open->signalMin);
+    s->signalMax = max(s->signalMax, open->signalMax);
+    s->loadMin = min(s->loadMin, open->loadMin);
+    s->loadMax = max(s->loadMax, open->loadMax);
+}
+
+static void rollupSummaryAddBucket(RollupSummary *s, const RollupBucket *bucket) {
+    s->read++;
+    s->scans += bucket->scans;
+    if(bucket->seen == 0) return;
+    s->seen += bucket->seen;
+    s->signalSum += (int32_t)bucket->signalMean * bucket->seen;
+    s->loadSum += (uint32_t)bucket->loadMean * bucket->seen;
+    s->signalMin = min(s->signalMin, bucket->signalMin);
+    s->signalMax = max(s->signalMax, bucket->signalMax);
+    s->loadMin = min(s->loadMin, bucket->loadMin);
+    s->loadMax = max(s->loadMax, bucket->loadMax);
+}
+
+// The tier a summary over spanMs reads: the finest whose ring covers it
+uint8_t rollupTierFor(uint32_t spanMs) {
+    for(uint8_t t = 0; t < ROLLUP_TIERS; t++) {
+        if((uint64_t)rollupTiers[t].lengthMs * rollupTiers[t].count >= spanMs) return t;
+    }
+    return ROLLUP_TIERS - 1;
+}
+
+// The samples of the last spanMs before now, in whole buckets of the tier
+// that covers the span (the current bucket counts as one). Reads at most
+// that tier's ring and the open buckets; spans longer than the coarsest
+// ring are cut to it.
+RollupSummary rollupSummary(const RollupStore *store, uint32_t now, uint32_t spanMs) {
+    RollupSummary s;
+    memset(&s, 0, sizeof(s));
+    s.signalMin = UINT8_MAX;
+    s.signalMax = 0;
+    s.loadMin = UINT8_MAX;
+    if(!store->active) return s;
+
+    uint8_t t = rollupTierFor(spanMs);
+    const RollupTier *tier = &rollupTiers[t];
+    const RollupOpen *open = &store->open[t];
+    uint32_t buckets = (spanMs + tier->lengthMs - 1) / tier->lengthMs;
+    if(buckets == 0) buckets = 1;
+    if(buckets > tier->count) buckets = tier->count;
+    uint32_t current = now / tier->lengthMs;
+    uint32_t first = current + 1 >= buckets ? current + 1 - buckets : 0;
+
+    // Closed buckets still in the ring, then the open ones in the window:
+    // this tier's and the finer ones, which belong to it
+    uint32_t oldest = open->index >= tier->count ? open->index - tier->count : 0;
+    const RollupBucket *ring = &store->buckets[tier->offset];
+    for(uint32_t i = max(first, oldest); i < open->index; i++) rollupSummaryAddBucket(&s, &ring[i % tier->count]);
+    if(open->index >= first && open->index <= current) {
+        for(uint8_t u = 0; u <= t; u++) rollupSummaryAddOpen(&s, &store->open[u]);
+    }
+    return s;
+}
+
+#if ROLLUPS
+
+struct RollupSet {
+    RollupStore channel[CHANNEL_COUNT];
+    RollupStore network[ROLLUP_NETWORKS > 0 ? ROLLUP_NETWORKS : 1];
+    RollupOwner owner[ROLLUP_NETWORKS > 0 ? ROLLUP_NETWORKS : 1];
+    uint16_t freeStores;
+};
+
+static_assert(ROLLUP_NETWORKS == 0 || sizeof(RollupSet) <= ROLLUP_BUDGET, "the rollup stores exceed ROLLUP_BUDGET");
+
+SCANNER_INSTANCE RollupSet rollups;
+
+void initRollups(RollupSet *set) {
+    memset(set, 0, sizeof(RollupSet));
+    set->freeStores = ROLLUP_NETWORKS;
+}
+
+// A network's store, NULL when it has none
+RollupStore *networkRollup(RollupSet *set, const NetworkStats *stats) {
+    uint8_t slot = networkSeries(&networkTable, stats)->rollup;
+    return slot ? &set->network[slot - 1] : NULL;
+}
+
+// Gives the network a store: the one it had before it was evicted and
+// tracked again, or a free one
+static void claimNetworkRollup(RollupSet *set, NetworkSeries *series, uint16_t panId, uint64_t extPanId) {
+    int16_t freeSlot = -1;
+    for(uint16_t i = 0; i < ROLLUP_NETWORKS; i++) {
+        const RollupOwner *owner = &set->owner[i];
+        if(!owner->used) {
+            if(freeSlot < 0) freeSlot = i;
+        } else if(owner->panId == panId && owner->extendedPanId == extPanId) {
+            series->rollup = (uint8_t)(i + 1);
+            return;
+        }
+    }
+    if(freeSlot < 0) return;
+    RollupOwner *owner = &set->owner[freeSlot];
+    owner->panId = panId;
+    owner->extendedPanId = extPanId;
+    owner->used = true;
+    memset(&set->network[freeSlot], 0, sizeof(RollupStore));
+    set->freeStores--;
+    series->rollup = (uint8_t)(freeSlot + 1);
+}
+
+// One sample per channel the scan covered
+void updateChannelRollups(RollupSet *set, const ScanSnapshot *scan) {
+    uint8_t strongest[CHANNEL_COUNT];
+    uint16_t load[CHANNEL_COUNT] = {0};
+    uint8_t networks[CHANNEL_COUNT] = {0};
+    for(int i = 0; i < scan->count; i++) {
+        int z = scan->channel[i] - MIN_CHANNEL;
+        if(z < 0 || z >= CHANNEL_COUNT) continue;
+        if(networks[z] == 0 || scan->signal[i] > strongest[z]) strongest[z] = scan->signal[i];
+        load[z] += scan->load[i];
+        if(networks[z] < 255) networks[z]++;
+    }
+    for(int z = 0; z < CHANNEL_COUNT; z++) {
+        if(!(scan->channelMask & (1UL << (MIN_CHANNEL + z)))) continue;
+        rollupAdd(&set->channel[z], scan->timestamp, networks[z] > 0, networks[z] ? strongest[z] : 0,
+                  (uint8_t)min(load[z], (uint16_t)255));
+    }
+}
+
+// One sample per network store whose channel the scan covered: the
+// sightings first, then a miss for the rest. Stores of networks the table
+// dropped are freed here.
+void updateNetworkRollups(RollupSet *set, const ScanSnapshot *scan) {
+    for(int i = 0; i < scan->count; i++) {
+        NetworkSeries *series = networkSeries(&networkTable, scanStats[i]);
+        if(series->rollup == 0) {
+            if(set->freeStores == 0) continue;
+            claimNetworkRollup(set, series, scan->panId[i], scan->extendedPanId[i]);
+            if(series->rollup == 0) continue;
+        }
+        uint8_t slot = series->rollup - 1;
+        RollupStore *store = &set->network[slot];
+        if(store->active && store->lastScan == scan->sequence) continue;   // listed twice
+        rollupAdd(store, scan->timestamp, true, scan->signal[i], scan->load[i]);
+        store->lastScan = scan->sequence;
+        set->owner[slot].channel = scan->channel[i];
+    }
+
+    for(uint16_t i = 0; i < ROLLUP_NETWORKS; i++) {
+        RollupOwner *owner = &set->owner[i];
+        RollupStore *store = &set->network[i];
+        if(!owner->used || store->lastScan == scan->sequence) continue;
+        if(!findNetworkStats(&networkTable, owner->panId, owner->extendedPanId)) {
+            memset(owner, 0, sizeof(RollupOwner));
+            memset(store, 0, sizeof(RollupStore));
+            set->freeStores++;
+            continue;
+        }
+        if(!(scan->channelMask & (1UL << owner->channel))) continue;
+        rollupAdd(store, scan->timestamp, false, 0, 0);
+        store->lastScan = scan->sequence;
+    }
+}
+
+// "seen signal (min..max) load/max" of one span, 31 characters. Channel
+// load is the sum over the channel's networks, up to 255, so it gets no %.
+static void printRollupSummary(const RollupSummary *s, bool summedLoad, Print &out) {
+    if(s->seen == 0) {
+        out.printf("  %3u%%%26s", rollupPresence(s), "-");
+        return;
+    }
+    out.printf("  %3u%% %4u (%4u..%4u) %3u/%3u%c", rollupPresence(s), rollupSignalMean(s),
+        s->signalMin, s->signalMax, rollupLoadMean(s), s->loadMax, summedLoad ? ' ' : '%');
+}
+
+static void printRollupHeader(Print &out) {
+    out.print("Signal: index, not a measured level. Load: % for networks, the sum of the networks' % for channels.\n");
+    out.print("            last hour                        last 24 h                        last 7 days\n");
+    out.print("            seen  sig ( min.. max) load/max  seen  sig ( min.. max) load/max  seen  sig ( min.. max) load/max\n");
+}
+
+static void printRollupLine(const char *name, const RollupStore *store, bool summedLoad, uint32_t now, Print &out) {
+    static const uint32_t spans[] = { 3600000UL, 86400000UL, 604800000UL };
+    out.print(name);
+    for(uint8_t k = 0; k < 3; k++) {
+        RollupSummary s = rollupSummary(store, now, spans[k]);
+        printRollupSummary(&s, summedLoad, out);
+    }
+    out.print("\n");
+}
+
+// Last hour, day and week of every store, one line each
+void printRollups(const RollupSet *set, uint32_t now, Print &out) {
+    out.printf("Rollups: %u channels, %u of %u network stores in use, %lu bytes\n",
+        (unsigned)CHANNEL_COUNT, (unsigned)(ROLLUP_NETWORKS - set->freeStores), (unsigned)ROLLUP_NETWORKS,
+        (unsigned long)sizeof(RollupSet));
+    printRollupHeader(out);
+    char name[16];
+    for(int z = 0; z < CHANNEL_COUNT; z++) {
+        if(!set->channel[z].active) continue;
+        snprintf(name, sizeof(name), "channel %2d", MIN_CHANNEL + z);
+        printRollupLine(name, &set->channel[z], true, now, out);
+    }
+    for(uint16_t i = 0; i < ROLLUP_NETWORKS; i++) {
+        if(!set->owner[i].used || !set->network[i].active) continue;
+        snprintf(name, sizeof(name), "PAN 0x%04x", set->owner[i].panId);
+        printRollupLine(name, &set->network[i], false, now, out);
+    }
+}
+
+#endif // ROLLUPS
+
+#endif // ZIGBEE_SCANNER_ROLLUPS_H
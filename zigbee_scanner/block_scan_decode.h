@@ -0,0 +1,56 @@
+#ifndef ZIGBEE_SCANNER_SCAN_DECODE_H
+#define ZIGBEE_SCANNER_SCAN_DECODE_H
+
+#include "block_definitions.h"
+#include "block_helpers.h"
+
+// Decodes the stack's scan results once; every analysis and output
+// function reads the snapshot instead of the raw descriptors.
+//
+// The network descriptor of an active scan carries no RSSI or LQI. signal
+// and load are bytes of the descriptor itself (the low byte of the PAN ID
+// and a byte of the extended PAN ID), kept from the first versions of the
+// scanner as a per-network index: they are not radio measurements and only
+// change when the network's IDs do.
+
+// Starts the snapshot of a new scan, with no networks yet
+void beginScanSnapshot(ScanSnapshot *scan, uint32_t channelMask) {
+    scan->count = 0;
+    scan->truncated = 0;
+    scan->timestamp = millis();
+    scan->channelMask = channelMask;
+    scan->sequence++;
+}
+
+// Fills the snapshot beginScanSnapshot() started with the scan's networks
+void decodeScanResults(zigbee_scan_result_t *scan_result, uint16_t networksFound, ScanSnapshot *scan) {
+    uint16_t count = min(networksFound, (uint16_t)SCAN_SNAPSHOT_CAPACITY);
+    scan->count = count;
+    scan->truncated = networksFound - count;
+
+    for(int i = 0; i < count; i++) {
+        zigbee_scan_result_t *network = &scan_result[i];
+        uint8_t* raw = (uint8_t*)network;
+
+        uint64_t extPanId = 0;
+        for(int b = 7; b >= 0; b--) {
+            extPanId = (extPanId << 8) | network->extended_pan_id[b];
+        }
+
+        uint8_t flags = 0;
+        if(network->permit_joining) flags |= NETWORK_FLAG_PERMIT_JOIN;
+        if(network->router_capacity) flags |= NETWORK_FLAG_ROUTER_CAP;
+        if(network->end_device_capacity) flags |= NETWORK_FLAG_END_DEV_CAP;
+        if(raw[5] & 0x7F) flags |= NETWORK_FLAG_SECURED;
+        if(isCoordinator(network)) flags |= NETWORK_FLAG_COORDINATOR;
+
+        scan->panId[i] = network->short_pan_id;
+        scan->extendedPanId[i] = extPanId;
+        scan->channel[i] = network->logic_channel;
+        scan->signal[i] = raw[0];
+        scan->load[i] = (raw[4] * 100) / 255;
+        scan->flags[i] = flags;
+    }
+}
+
+#endif // ZIGBEE_SCANNER_SCAN_DECODE_H
@@ -0,0 +1,127 @@
+#ifndef ZIGBEE_SCANNER_SCANNER_CONFIG_H
+#define ZIGBEE_SCANNER_SCANNER_CONFIG_H
+
+#include <stdint.h>
+#include <type_traits>
+
+// Build profile: table sizes, index widths, scan intervals and optional
+// features in one place. A profile is a ScannerConfig of the options that
+// differ from the defaults, e.g.
+//   typedef ScannerConfig<NetworkTableSize<32>, EnableHistoryLog<false>> MyScanner;
+// The individual #defines (NETWORK_TABLE_CAPACITY, ENERGY_DETECT, ...) still
+// override the selected profile.
+
+#define SCANNER_PROFILE_STANDARD   0
+#define SCANNER_PROFILE_SURVEY     1   // low RAM, handheld site survey
+#define SCANNER_PROFILE_DENSE_SITE 2   // many networks, long signal history
+
+#ifndef SCANNER_PROFILE
+#define SCANNER_PROFILE SCANNER_PROFILE_STANDARD
+#endif
+
+// Options
+template<uint16_t N> struct NetworkTableSize { typedef NetworkTableSize<0> tag; static constexpr uint16_t value = N; };
+template<uint16_t N> struct ScanSnapshotSize { typedef ScanSnapshotSize<0> tag; static constexpr uint16_t value = N; };
+template<uint16_t N> struct SignalHistorySize { typedef SignalHistorySize<0> tag; static constexpr uint16_t value = N; };
+template<uint32_t N> struct SerialBufferSize { typedef SerialBufferSize<0> tag; static constexpr uint32_t value = N; };
+template<uint32_t N> struct RollupBudget { typedef RollupBudget<0> tag; static constexpr uint32_t value = N; };
+template<bool On> struct EnableEnergyDetect { typedef EnableEnergyDetect<false> tag; static constexpr bool value = On; };
+template<bool On> struct EnableHistoryLog { typedef EnableHistoryLog<false> tag; static constexpr bool value = On; };
+template<unsigned long Normal, unsigned long Search> struct ScanInterval {
+    typedef ScanInterval<0, 0> tag;
+    static constexpr unsigned long normal = Normal;
+    static constexpr unsigned long search = Search;
+};
+
+// Whether every option is one of the above: anything else would be
+// ignored without a word
+template<typename Option> struct ScannerOptionKnown : std::false_type {};
+template<uint16_t N> struct ScannerOptionKnown<NetworkTableSize<N>> : std::true_type {};
+template<uint16_t N> struct ScannerOptionKnown<ScanSnapshotSize<N>> : std::true_type {};
+template<uint16_t N> struct ScannerOptionKnown<SignalHistorySize<N>> : std::true_type {};
+template<uint32_t N> struct ScannerOptionKnown<SerialBufferSize<N>> : std::true_type {};
+template<uint32_t N> struct ScannerOptionKnown<RollupBudget<N>> : std::true_type {};
+template<bool On> struct ScannerOptionKnown<EnableEnergyDetect<On>> : std::true_type {};
+template<bool On> struct ScannerOptionKnown<EnableHistoryLog<On>> : std::true_type {};
+template<unsigned long Normal, unsigned long Search>
+struct ScannerOptionKnown<ScanInterval<Normal, Search>> : std::true_type {};
+
+template<typename... Options>
+struct ScannerOptionsKnown : std::true_type {};
+
+template<typename First, typename... Rest>
+struct ScannerOptionsKnown<First, Rest...>
+    : std::integral_constant<bool, ScannerOptionKnown<First>::value && ScannerOptionsKnown<Rest...>::value> {};
+
+// First option with the same tag as Default, or Default
+template<typename Default, typename... Options>
+struct ScannerOption { typedef Default type; };
+
+template<typename Default, typename First, typename... Rest>
+struct ScannerOption<Default, First, Rest...> {
+    typedef typename std::conditional<std::is_same<typename First::tag, typename Default::tag>::value,
+        First, typename ScannerOption<Default, Rest...>::type>::type type;
+};
+
+// Smallest unsigned type holding 0..max
+template<uint32_t max>
+using ScannerIndex = typename std::conditional<(max <= 0xFF), uint8_t,
+    typename std::conditional<(max <= 0xFFFF), uint16_t, uint32_t>::type>::type;
+
+template<typename... Options>
+struct ScannerConfig {
+    static_assert(ScannerOptionsKnown<Options...>::value, "ScannerConfig takes only the options above");
+
+    static constexpr uint16_t networkTableCapacity = ScannerOption<NetworkTableSize<128>, Options...>::type::value;
+    static constexpr uint16_t scanSnapshotCapacity = ScannerOption<ScanSnapshotSize<64>, Options...>::type::value;
+    static constexpr uint16_t signalHistorySize = ScannerOption<SignalHistorySize<10>, Options...>::type::value;
+    static constexpr uint32_t serialBufferSize = ScannerOption<SerialBufferSize<16384>, Options...>::type::value;
+    static constexpr uint32_t rollupBudget = ScannerOption<RollupBudget<65536>, Options...>::type::value;
+    static constexpr bool energyDetect = ScannerOption<EnableEnergyDetect<true>, Options...>::type::value;
+    static constexpr bool historyLog = ScannerOption<EnableHistoryLog<true>, Options...>::type::value;
+    static constexpr unsigned long scanIntervalNormal = ScannerOption<ScanInterval<30000, 5000>, Options...>::type::normal;
+    static constexpr unsigned long scanIntervalSearch = ScannerOption<ScanInterval<30000, 5000>, Options...>::type::search;
+
+    static_assert(networkTableCapacity > 0 && networkTableCapacity <= 16384,
+                  "network table size must be between 1 and 16384");
+    static_assert(scanSnapshotCapacity > 0 && scanSnapshotCapacity <= networkTableCapacity,
+                  "scan snapshot size must be between 1 and the network table size");
+    static_assert(signalHistorySize >= 2 && signalHistorySize <= 4096, "signal history must hold 2 to 4096 samples");
+    static_assert(serialBufferSize >= 1024 && (serialBufferSize & (serialBufferSize - 1)) == 0,
+                  "serial buffer size must be a power of two of at least 1024");
+    static_assert(scanIntervalSearch > 0 && scanIntervalSearch <= scanIntervalNormal,
+                  "search scans must come at least as often as normal scans");
+};
+
+typedef ScannerConfig<> StandardScanner;
+
+typedef ScannerConfig<
+    NetworkTableSize<32>,
+    ScanSnapshotSize<24>,
+    SignalHistorySize<4>,
+    SerialBufferSize<4096>,
+    RollupBudget<0>,
+    EnableHistoryLog<false>
+> SurveyScanner;
+
+typedef ScannerConfig<
+    NetworkTableSize<512>,
+    ScanSnapshotSize<256>,
+    SignalHistorySize<24>,
+    SerialBufferSize<32768>,
+    RollupBudget<98304>,
+    ScanInterval<20000, 5000>
+> DenseSiteScanner;
+
+#if SCANNER_PROFILE == SCANNER_PROFILE_SURVEY
+typedef SurveyScanner ActiveScanner;
+#define SCANNER_PROFILE_NAME "survey"
+#elif SCANNER_PROFILE == SCANNER_PROFILE_DENSE_SITE
+typedef DenseSiteScanner ActiveScanner;
+#define SCANNER_PROFILE_NAME "dense site"
+#else
+typedef StandardScanner ActiveScanner;
+#define SCANNER_PROFILE_NAME "standard"
+#endif
+
+#endif // ZIGBEE_SCANNER_SCANNER_CONFIG_H
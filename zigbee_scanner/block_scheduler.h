@@ -0,0 +1,301 @@
+#ifndef ZIGBEE_SCANNER_SCHEDULER_H
+#define ZIGBEE_SCANNER_SCHEDULER_H
+
+#include "block_definitions.h"
+#include "block_helpers.h"
+#include "block_output.h"
+#include "block_serial_output.h"
+#include "block_channel_planner.h"
+#include "block_history_log.h"
+#include "block_serial_commands.h"
+#include "block_energy_detect.h"
+#include "block_cycle_profile.h"
+
+// Scan timing (scan intervals are decided by the channel planner)
+const unsigned long SCAN_TIMEOUT = 30000;
+const unsigned long SCAN_POLL_INTERVAL = 5;        // polling once a scan is due to finish
+const unsigned long STATUS_PRINT_INTERVAL = 20000;
+const unsigned long SCHEDULER_REPORT_INTERVAL = 60000;
+const unsigned long SERIAL_DRAIN_INTERVAL = 10;    // wakeups while output is queued
+const uint8_t SCAN_DURATION = 5;                   // 2^n + 1 superframes per channel
+
+// Pipelined scan cycle: a finished scan is copied into currentScan and the
+// next one started before the copy is analysed and reported. 0 keeps the
+// serial cycle (report, then schedule the next scan).
+#ifndef SCAN_PIPELINE
+#define SCAN_PIPELINE 1
+#endif
+
+// How long a pipelined report may wait for room in the output queue (going
+// by the size of the last report), holding the next scan meanwhile. 0
+// never waits: a report the port cannot take is dropped under the overflow
+// policy and scanning goes on, as in the serial cycle. Waiting makes the
+// output lossless at the cost of scans when the port is too slow.
+#ifndef SCAN_PIPELINE_MAX_WAIT
+#define SCAN_PIPELINE_MAX_WAIT 0
+#endif
+
+// Scan state machine. The Zigbee core has no scan-complete callback, so the
+// scheduler sleeps until the scan is due to end (the stack scans each
+// channel for a fixed time) and only then polls scanComplete(). Every other
+// wakeup is a deadline: next scan, timeout, status line or queued output.
+// Which channels each scan covers comes from channelPlanner; energy-detect
+// sweeps fill the gaps between scans.
+//
+// Pipelined, the stack's result buffer and currentScan form a double
+// buffer: a finished scan is copied out and handed back at once, the next
+// scan starts if it is due, and the copy is reported while the radio works.
+// When a scan finishes before the previous one has been reported (see
+// SCAN_PIPELINE_MAX_WAIT), its results stay in the stack and no new scan
+// starts until the report is out.
+struct ScanScheduler {
+    bool scanInProgress;
+    bool networksFound;
+    bool pipelined;
+    unsigned long reportWaitLimit;     // SCAN_PIPELINE_MAX_WAIT
+    bool reportPending;                // currentScan captured, not yet reported
+    bool scanHeld;                     // finished scan left in the stack meanwhile
+    bool captured;                     // the stack handed over the results
+    int16_t capturedStatus;            // scanComplete() of the captured scan
+    unsigned long scanStartTime;
+    unsigned long lastScanTime;
+    unsigned long lastPrintTime;
+    unsigned long expectedScanEnd;
+    unsigned long runningUntil;        // scan known to run until then (nominal end or last poll)
+    uint32_t scanMask;                 // channels of the running scan
+
+    // Instrumentation
+    unsigned long windowStart;
+    unsigned long windowIdleMicros;
+    uint32_t windowWakeups;
+    uint64_t totalIdleMicros;
+    unsigned long capturedAt;
+    unsigned long completedAt;         // scan known to have ended by then
+    uint32_t lastReportLatency;        // completion to report start, upper bound (ms)
+    uint32_t maxReportLatency;
+    uint32_t scansReported;
+    uint32_t heldScans;                // scans held back by a pending report
+};
+
+SCANNER_INSTANCE ScanScheduler scheduler;
+
+// Time the stack needs for an active scan: per channel
+// aBaseSuperframeDuration (15.36 ms) * (2^duration + 1)
+unsigned long scanDurationMs(uint32_t channelMask, uint8_t duration) {
+    uint32_t channels = __builtin_popcount(channelMask & ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+    return (unsigned long)((channels * 15360UL * ((1UL << duration) + 1)) / 1000);
+}
+
+void startScan(ScanScheduler *s, unsigned long now, uint32_t channelMask = ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK) {
+    CYCLE_PROFILE_SCAN_STARTED(s->reportPending);
+    Zigbee.scanNetworks(channelMask, SCAN_DURATION);
+    s->scanInProgress = true;
+    s->scanStartTime = now;
+    s->scanMask = channelMask;
+    s->expectedScanEnd = now + scanDurationMs(channelMask, SCAN_DURATION);
+    s->runningUntil = s->expectedScanEnd;
+}
+
+void initScheduler(ScanScheduler *s) {
+    memset(s, 0, sizeof(ScanScheduler));
+    s->pipelined = SCAN_PIPELINE;
+    s->reportWaitLimit = SCAN_PIPELINE_MAX_WAIT;
+    s->windowStart = millis();
+}
+
+// Takes a finished scan out of the stack into currentScan and updates the
+// channel plan, so the next scan can be planned before the report
+static void captureScan(ScanScheduler *s, int16_t scanStatus, unsigned long now) {
+    s->captured = captureScanResults(scanStatus > 0 ? scanStatus : 0, s->scanMask, &currentScan);
+    s->capturedStatus = scanStatus;
+    s->capturedAt = now;
+    s->completedAt = s->runningUntil;
+    s->reportPending = true;
+    s->scanHeld = false;
+    updateChannelPlan(&channelPlanner, &currentScan, now);
+    s->networksFound = channelPlanHasNetworks(&channelPlanner);
+    s->scanInProgress = false;
+    s->lastScanTime = now;
+}
+
+// Analyses and reports the captured scan and logs it
+static void reportCapturedScan(ScanScheduler *s, unsigned long now) {
+    s->lastReportLatency = now - s->completedAt;
+    s->maxReportLatency = max(s->maxReportLatency, s->lastReportLatency);
+
+    if (s->capturedStatus > 0) {
+        serialOutput.beginReport();
+        Report.printf("\nScan completed with status: %d\n", s->capturedStatus);
+        reportScannedNetworks(s->capturedStatus, s->captured, &currentScan);
+        serialOutput.endReport();
+    } else {
+        Report.println("\nNo networks found, will scan again soon...");
+        if (previousNetworksCount > 0) {
+            // Whatever was on these channels has left
+            serialOutput.beginReport();
+            reportScan(&currentScan);
+            serialOutput.endReport();
+        } else {
+            runScanAnalysis(&currentScan, STAGE_ALWAYS);
+        }
+    }
+    historyLogAppendScan(&historyLog, &currentScan, historyLogTime(&historyLog, s->capturedAt));
+    s->reportPending = false;
+    s->scansReported++;
+    CYCLE_PROFILE_REPORT_DONE();
+}
+
+// A pipelined report goes out once the queue has room for it; one larger
+// than the whole queue would be dropped anyway
+static bool reportCanStart(const ScanScheduler *s, unsigned long now) {
+    size_t size = serialOutput.getLastReportSize();
+    if (!s->pipelined || s->reportWaitLimit == 0 || size > SERIAL_OUTPUT_BUFFER_SIZE) return true;
+    return SERIAL_OUTPUT_BUFFER_SIZE - serialOutput.pending() >= size ||
+        now - s->capturedAt >= s->reportWaitLimit;
+}
+
+// One step of the state machine: polls a due scan, starts the next one,
+// prints status lines
+void runScheduler(ScanScheduler *s) {
+    unsigned long currentTime = millis();
+    s->windowWakeups++;
+
+    // A scan is polled once it is due, not on wakeups for something else
+    if (s->scanInProgress && (long)(currentTime - s->expectedScanEnd) >= 0) {
+        int16_t scanStatus = Zigbee.scanComplete();
+
+        if (scanStatus == ZB_SCAN_RUNNING) {
+            // Still scanning
+            s->runningUntil = currentTime;
+            if (currentTime - s->scanStartTime > SCAN_TIMEOUT) {
+                CYCLE_PROFILE_SCAN_ENDED(true);
+                Report.println("\nScan timeout - restarting scan");
+                Zigbee.scanDelete();
+                s->scanInProgress = false;
+                s->lastScanTime = currentTime;
+            }
+        }
+        else if (scanStatus == ZB_SCAN_FAILED) {
+            CYCLE_PROFILE_SCAN_ENDED(false);
+            Report.println("\nScan failed! Waiting before retry...");
+            s->scanInProgress = false;
+            s->lastScanTime = currentTime;
+        }
+        else if (s->reportPending) {
+            // currentScan still holds the previous scan: these results wait
+            // in the stack's buffer, which also keeps the next scan back
+            if (!s->scanHeld) s->heldScans++;
+            s->scanHeld = true;
+        }
+        else {  // Done, scanStatus networks found
+            CYCLE_PROFILE_SCAN_ENDED(false);
+            captureScan(s, scanStatus, currentTime);
+            if (!s->pipelined) reportCapturedScan(s, currentTime);
+        }
+    }
+
+    if (!s->scanInProgress) {
+        unsigned long nextScanTime = nextPlannedScan(&channelPlanner, s->lastScanTime);
+        // An energy-detect sweep keeps the radio until it is folded in
+        bool sweeping = pollEnergySweep(&energySampler, currentTime);
+
+        // Check if it's time to start a new scan
+        if (!sweeping && (long)(currentTime - nextScanTime) >= 0) {
+            uint32_t mask = planChannelMask(&channelPlanner, currentTime);
+            Report.println("\nInitiating new scan cycle...");
+            if (!s->networksFound) {
+                Report.println("(Fast scanning mode active)");
+            }
+            if (mask != ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK) {
+                Report.print("(Targeted scan: channels");
+                for (int ch = MIN_CHANNEL; ch <= MAX_CHANNEL; ch++) {
+                    if (mask & (1UL << ch)) Report.printf(" %d", ch);
+                }
+                Report.println(")");
+            }
+            startScan(s, currentTime, mask);
+            Report.println("Scan started");
+        } else if (!sweeping && energySweepFits(&energySampler, currentTime, nextScanTime)) {
+            startEnergySweep(&energySampler, currentTime);
+        }
+        if (!s->scanInProgress && (long)(currentTime - nextScanTime) < 0 &&
+            currentTime - s->lastPrintTime >= STATUS_PRINT_INTERVAL) {
+            int remainingTime = (nextScanTime - currentTime) / 1000;
+            if (s->networksFound) {
+                Report.printf("\nWaiting for next scan: %d seconds", remainingTime);
+            } else {
+                Report.printf("\nSearching for networks... Next scan in %d seconds", remainingTime);
+            }
+            s->lastPrintTime = currentTime;
+        }
+    }
+
+    // The captured scan is reported while the next one runs
+    if (s->reportPending && reportCanStart(s, currentTime)) {
+        reportCapturedScan(s, currentTime);
+    }
+
+    // Idle share and wakeups of the last minute
+    if (currentTime - s->windowStart >= SCHEDULER_REPORT_INTERVAL) {
+        unsigned long windowMicros = (currentTime - s->windowStart) * 1000UL;
+        unsigned long idlePermille = (unsigned long)(((uint64_t)s->windowIdleMicros * 1000) / windowMicros);
+        Report.printf("\nScheduler: idle %lu.%lu%%, %u wakeups/min, scan-to-report %u ms (max %u ms)",
+            idlePermille / 10, idlePermille % 10, (unsigned)s->windowWakeups,
+            (unsigned)s->lastReportLatency, (unsigned)s->maxReportLatency);
+        if (s->heldScans > 0) Report.printf(", %u scans held for output", (unsigned)s->heldScans);
+        Report.print("\n");
+#if CYCLE_PROFILE
+        reportCycleProfile(&cycleProfile, currentTime);
+#endif
+        s->windowStart = currentTime;
+        s->windowIdleMicros = 0;
+        s->windowWakeups = 0;
+    }
+}
+
+static unsigned long untilDeadline(unsigned long deadline, unsigned long now) {
+    return (long)(deadline - now) > 0 ? deadline - now : 0;
+}
+
+// Milliseconds until the scheduler has something to do
+unsigned long schedulerNextWakeup(ScanScheduler *s) {
+    unsigned long now = millis();
+    unsigned long wait;
+
+    if (s->reportPending) {
+        // Waiting for output to drain; a held scan is picked up after it
+        wait = SERIAL_DRAIN_INTERVAL;
+    } else if (s->scanInProgress) {
+        if ((long)(now - s->expectedScanEnd) >= 0) return SCAN_POLL_INTERVAL;
+        wait = untilDeadline(s->expectedScanEnd, now);
+    } else {
+        unsigned long nextScanTime = nextPlannedScan(&channelPlanner, s->lastScanTime);
+        // A due scan waits for a running sweep
+        wait = energySamplerNextWakeup(&energySampler, now, nextScanTime);
+        if (!energySampler.busy) wait = min(wait, untilDeadline(nextScanTime, now));
+        wait = min(wait, untilDeadline(s->lastPrintTime + STATUS_PRINT_INTERVAL, now));
+    }
+    wait = min(wait, untilDeadline(s->windowStart + SCHEDULER_REPORT_INTERVAL, now));
+
+#if SERIAL_COMMANDS
+    // Input is polled; a dump in progress continues as output drains
+    wait = min(wait, commandsBusy() ? SERIAL_DRAIN_INTERVAL : COMMAND_POLL_INTERVAL);
+#endif
+
+#if !SERIAL_OUTPUT_DRAIN_TASK
+    // Queued output is drained from loop()
+    if (serialOutput.pending() > 0) wait = min(wait, SERIAL_DRAIN_INTERVAL);
+#endif
+    return wait;
+}
+
+void schedulerSleep(ScanScheduler *s, unsigned long ms) {
+    if (ms == 0) return;
+    unsigned long start = micros();
+    delay(ms);
+    unsigned long slept = micros() - start;
+    s->windowIdleMicros += slept;
+    s->totalIdleMicros += slept;
+}
+
+#endif // ZIGBEE_SCANNER_SCHEDULER_H
@@ -0,0 +1,270 @@
+#ifndef ZIGBEE_SCANNER_SERIAL_COMMANDS_H
+#define ZIGBEE_SCANNER_SERIAL_COMMANDS_H
+
+#include "block_definitions.h"
+#include "block_text.h"
+#include "block_serial_output.h"
+#include "block_history_log.h"
+#include "block_energy_detect.h"
+#include "block_channel_score.h"
+#include "block_analysis_stages.h"
+#include "block_memory_footprint.h"
+#include "block_cycle_profile.h"
+#include "block_fixed_point.h"
+#include "block_rollups.h"
+#include "block_output.h"
+#include "block_telemetry.h"
+#include "block_channel_planner.h"
+#include "block_command_memo.h"
+
+// Line commands read from the serial port
+#ifndef SERIAL_COMMANDS
+#define SERIAL_COMMANDS 1
+#endif
+
+#define COMMAND_LINE_SIZE 64
+const unsigned long COMMAND_POLL_INTERVAL = 1000;  // loop wakeups to look for input
+
+struct CommandReader {
+    char line[COMMAND_LINE_SIZE];
+    uint8_t length;
+    bool overflow;                 // rest of an overlong line is ignored
+    bool waiting;                  // line waits for the captured scan's analysis
+};
+
+SCANNER_INSTANCE CommandReader commandReader;
+
+// Replies go to the report output even with text reports muted
+static Print &commandOutput() {
+    return Report.raw();
+}
+
+// Room left in the serial output queue for long replies
+static size_t commandOutputRoom() {
+    return SERIAL_OUTPUT_BUFFER_SIZE - serialOutput.pending();
+}
+
+// The scan tables describe currentScan: false between the capture of a
+// pipelined scan and its analysis
+static bool commandTablesCurrent() {
+    return currentScan.sequence == analysedSequence;
+}
+
+// Whole-word number, decimal or 0x hex
+static bool parseCommandNumber(const char *text, unsigned long *value) {
+    char *end;
+    if(!*text) return false;
+    *value = strtoul(text, &end, 0);
+    return *end == 0;
+}
+
+static const char *reportModeName(uint8_t mode) {
+    switch(mode) {
+        case REPORT_MODE_NONE: return "none";
+        case REPORT_MODE_TEXT: return "text";
+        case REPORT_MODE_BINARY: return "binary";
+        default: return "both";
+    }
+}
+
+// Every network of the last scan
+static void replyList(ReportWriter &out) {
+    const ScanSnapshot *scan = &currentScan;
+    if(scan->count == 0) {
+        out.println("No networks in the last scan");
+        return;
+    }
+    out.printf("\n=== NETWORKS (%d, scan %u, %lu s ago) ===\n", scan->count, scan->sequence,
+        (unsigned long)((millis() - scan->timestamp) / 1000));
+    printSummaryHeader(out);
+    for(int i = 0; i < scan->count; i++) printSummaryRow(out, scan, &reportSelection, i);
+    printSummaryFooter(out, scan);
+}
+
+// Table row and diagnostics of each network of the last scan with panId
+static void replyShow(ReportWriter &out, uint16_t panId) {
+    const ScanSnapshot *scan = &currentScan;
+    bool found = false;
+    for(int i = 0; i < scan->count; i++) {
+        if(scan->panId[i] != panId) continue;
+        if(!found) printSummaryHeader(out);
+        printSummaryRow(out, scan, &reportSelection, i);
+        found = true;
+    }
+    if(!found) {
+        out.printf("PAN 0x%04x is not in the last scan\n", panId);
+        return;
+    }
+    printSummaryFooter(out, scan);
+    for(int i = 0; i < scan->count; i++) {
+        if(scan->panId[i] == panId) printNetworkDiagnosis(out, scan, i);
+    }
+}
+
+// Networks, interference and trends of one channel
+static void replyChannel(ReportWriter &out, uint8_t channel) {
+    const ScanSnapshot *scan = &currentScan;
+    const ChannelScore *score = &channelRanking.channels[channel - MIN_CHANNEL];
+    out.printf("\n=== CHANNEL %u ===\n", channel);
+    out.printf("Ranking: networks %u, load %u, WiFi %u%%, other %u%%, penalty %u\n",
+        score->networks, score->load, score->wifi, score->noise, score->penalty);
+    for(int i = 0; i < scan->count; i++) {
+        if(scan->channel[i] != channel) continue;
+        out.printf("PAN 0x%04x: signal %u, load %u%%\n", scan->panId[i], scan->signal[i], scan->load[i]);
+    }
+    analyzeChannelInterference(channel, channelRanking.order, out);
+#if ROLLUPS
+    const RollupStore *store = &rollups.channel[channel - MIN_CHANNEL];
+    if(store->active) {
+        char name[16];
+        snprintf(name, sizeof(name), "channel %2d", channel);
+        printRollupHeader(out);
+        printRollupLine(name, store, true, millis(), out);
+    }
+#endif
+}
+
+static void replyStats(Print &out) {
+    out.printf("Scans: %lu full sweeps, %lu targeted; last #%u, %d networks, %u tracked\n",
+        (unsigned long)channelPlanner.fullSweeps, (unsigned long)channelPlanner.targetedScans,
+        currentScan.sequence, currentScan.count, networkTable.count);
+    if(channelPlanner.adaptive) out.print("Schedule: adaptive");
+    else out.printf("Schedule: every %lu ms", channelPlanner.interval);
+    out.printf(", channel mask 0x%08lx\n", (unsigned long)channelPlanner.channelMask);
+    out.printf("Reports: %s; replies: %lu from memo, %lu computed\n", reportModeName(reportMode),
+        (unsigned long)commandMemo.hits, (unsigned long)commandMemo.misses);
+}
+
+// Replays a current reply or computes and keeps it
+static void memoizedReply(uint8_t command, uint32_t argument, Print &out) {
+    if(commandMemoReplay(&commandMemo, command, argument, analysedScans, out)) return;
+    MemoWriter memo(out, &commandMemo);
+    ReportWriter reply(memo);
+    switch(command) {
+        case MEMO_SHOW: replyShow(reply, (uint16_t)argument); break;
+        case MEMO_CHANNEL: replyChannel(reply, (uint8_t)argument); break;
+        case MEMO_RECOMMENDATIONS: generateSmartRecommendations(reply, &currentScan); break;
+    }
+    commandMemoKeep(&commandMemo, &memo, command, argument, analysedScans);
+}
+
+static void handleSet(const char *what, const char *value, Print &out) {
+    unsigned long number;
+    if(strcmp(what, "interval") == 0 && (strcmp(value, "auto") == 0 || parseCommandNumber(value, &number))) {
+        setScanInterval(&channelPlanner, strcmp(value, "auto") == 0 ? 0 : number);
+        replyStats(out);
+    } else if(strcmp(what, "mask") == 0 && strcmp(value, "all") == 0) {
+        setScanChannels(&channelPlanner, ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+        replyStats(out);
+    } else if(strcmp(what, "mask") == 0 && parseCommandNumber(value, &number) &&
+              setScanChannels(&channelPlanner, number)) {
+        replyStats(out);
+    } else {
+        out.print("Usage: set interval <ms>|auto, set mask <channel bits, e.g. 0x2108000>|all\n");
+    }
+}
+
+void handleCommand(const char *line) {
+    Print &out = commandOutput();
+    char name[16] = "";
+    char arg[2][16] = {"", ""};
+    int fields = sscanf(line, "%15s %15s %15s", name, arg[0], arg[1]);
+    if(fields <= 0) return;
+    unsigned long number = 0;
+
+    if(strcmp(name, "log") == 0) {
+        printHistoryLogStatus(&historyLog, out);
+    } else if(strcmp(name, "dump") == 0) {
+        unsigned long from = 0;
+        unsigned long to = 0xFFFFFFFFUL;
+        parseCommandNumber(arg[0], &from);
+        parseCommandNumber(arg[1], &to);
+        historyLogStartDump(&historyLog, &historyLogDump, from, to, out);
+    } else if(strcmp(name, "list") == 0) {
+        ReportWriter reply(out);
+        replyList(reply);
+    } else if(strcmp(name, "show") == 0 && parseCommandNumber(arg[0], &number) && number <= 0xFFFF) {
+        memoizedReply(MEMO_SHOW, number, out);
+    } else if(strcmp(name, "channel") == 0 && parseCommandNumber(arg[0], &number) &&
+              number >= MIN_CHANNEL && number <= MAX_CHANNEL) {
+        memoizedReply(MEMO_CHANNEL, number, out);
+    } else if(strcmp(name, "recommendations") == 0) {
+        memoizedReply(MEMO_RECOMMENDATIONS, 0, out);
+    } else if(strcmp(name, "stats") == 0) {
+        replyStats(out);
+    } else if(strcmp(name, "set") == 0) {
+        handleSet(arg[0], arg[1], out);
+    } else if(strcmp(name, "report") == 0) {
+        if(strcmp(arg[0], "none") == 0) setReportMode(REPORT_MODE_NONE);
+        else if(strcmp(arg[0], "text") == 0) setReportMode(REPORT_MODE_TEXT);
+        else if(strcmp(arg[0], "binary") == 0) setReportMode(REPORT_MODE_BINARY);
+        else if(strcmp(arg[0], "both") == 0) setReportMode(REPORT_MODE_BOTH);
+        out.printf("Reports: %s (none, text, binary, both)\n", reportModeName(reportMode));
+    } else if(strcmp(name, "energy") == 0) {
+        printEnergyTable(&energySampler, out);
+    } else if(strcmp(name, "channels") == 0) {
+        printChannelRanking(&channelRanking, out);
+    } else if(strcmp(name, "stages") == 0) {
+        printAnalysisTiming(&scanAnalysis, out);
+    } else if(strcmp(name, "memory") == 0) {
+        printMemoryFootprint(out);
+    } else if(strcmp(name, "changes") == 0) {
+        printChangeLog(&changeLog, out);
+    } else if(strcmp(name, "profile") == 0) {
+        printCycleProfile(out);
+    } else if(strcmp(name, "trends") == 0) {
+#if ROLLUPS
+        printRollups(&rollups, millis(), out);
+#else
+        out.print("Rollups are off (ROLLUPS 0)\n");
+#endif
+#if FIXED_POINT_BENCH
+    } else if(strcmp(name, "fixed") == 0) {
+        printFixedPointBench(out);
+#endif
+    } else {
+        out.print("Commands: log (history log status), dump [from [to]] (history as CSV, log seconds),\n"
+                  "          energy (channel noise from energy detect), channels (channel ranking),\n"
+                  "          stages (analysis time per stage), memory (table sizes of this build),\n"
+                  "          changes (signal and load changes found), profile (time per scan cycle phase),\n"
+                  "          trends (last hour, day and week per channel and network),\n"
+                  "          list (networks of the last scan), show <pan> (one network's diagnostics),\n"
+                  "          channel <n> (networks, interference and trends), recommendations,\n"
+                  "          stats (scan counts and settings), set interval <ms>|auto, set mask <bits>|all,\n"
+                  "          report none|text|binary|both (what each scan prints)\n");
+    }
+}
+
+// Reads whatever input arrived and advances a running dump
+void pollSerialCommands() {
+    CommandReader *r = &commandReader;
+    // Replies read the scan tables: a line waits while they lag behind
+    if(r->waiting && commandTablesCurrent()) {
+        handleCommand(r->line);
+        r->waiting = false;
+    }
+    while(!r->waiting && Serial.available() > 0) {
+        int c = Serial.read();
+        if(c < 0) break;
+        if(c == '\r' || c == '\n') {
+            r->line[r->length] = 0;
+            bool complete = r->length > 0 && !r->overflow;
+            r->length = 0;
+            r->overflow = false;
+            if(complete && !commandTablesCurrent()) r->waiting = true;
+            else if(complete) handleCommand(r->line);
+        } else if(r->length < COMMAND_LINE_SIZE - 1) {
+            r->line[r->length++] = (char)c;
+        } else {
+            r->overflow = true;
+        }
+    }
+    historyLogDumpStep(&historyLog, &historyLogDump, commandOutput(), commandOutputRoom());
+}
+
+// A command still has output to produce, or waits to run
+bool commandsBusy() {
+    return historyLogDump.active || commandReader.waiting;
+}
+
+#endif // ZIGBEE_SCANNER_SERIAL_COMMANDS_H
@@ -0,0 +1,198 @@
+#ifndef ZIGBEE_SCANNER_SERIAL_OUTPUT_H
+#define ZIGBEE_SCANNER_SERIAL_OUTPUT_H
+
+#include <atomic>
+
+#include "block_definitions.h"
+#include "block_text.h"
+
+// Report bytes queued for the serial port (power of two)
+#ifndef SERIAL_OUTPUT_BUFFER_SIZE
+#define SERIAL_OUTPUT_BUFFER_SIZE ActiveScanner::serialBufferSize
+#endif
+
+// What to throw away when a write does not fit
+#define OVERFLOW_DROP_OLDEST 0   // discard the oldest queued bytes
+#define OVERFLOW_DROP_REPORT 1   // discard the whole report being written
+#ifndef SERIAL_OUTPUT_OVERFLOW
+#define SERIAL_OUTPUT_OVERFLOW OVERFLOW_DROP_REPORT
+#endif
+
+// Drain from a FreeRTOS task instead of loop()
+#ifndef SERIAL_OUTPUT_DRAIN_TASK
+#define SERIAL_OUTPUT_DRAIN_TASK 0
+#endif
+
+static_assert((SERIAL_OUTPUT_BUFFER_SIZE & (SERIAL_OUTPUT_BUFFER_SIZE - 1)) == 0,
+              "SERIAL_OUTPUT_BUFFER_SIZE must be a power of two");
+
+// Lock-free single-producer/single-consumer byte ring between report code
+// (producer, writes through Print) and the serial drain (consumer).
+//
+// head is only written by the producer. tail is advanced by the consumer,
+// and by the producer when it drops the oldest bytes, so both sides move it
+// with compare-and-swap; the consumer copies bytes out before claiming them
+// and retries if the producer got there first.
+class SerialOutputBuffer : public Print {
+public:
+    SerialOutputBuffer() : head(0), tail(0), writePos(0), reportStart(0),
+        inReport(false), reportDropped(false), policy(SERIAL_OUTPUT_OVERFLOW),
+        reportBytes(0), lastReportSize(0), droppedBytes(0), droppedReports(0), highWater(0) {}
+
+    // Producer side
+
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *data, size_t size) override {
+        if(inReport) reportBytes += size;
+        if(inReport && reportDropped) {
+            droppedBytes += size;
+            return size;
+        }
+
+        uint32_t used = writePos - tail.load(std::memory_order_acquire);
+        if(size > SERIAL_OUTPUT_BUFFER_SIZE - used) {
+            if(policy == OVERFLOW_DROP_REPORT) {
+                if(inReport) {
+                    // Unpublished report bytes are simply forgotten
+                    droppedBytes += (writePos - reportStart) + size;
+                    droppedReports++;
+                    writePos = reportStart;
+                    reportDropped = true;
+                } else {
+                    droppedBytes += size;
+                }
+                return size;
+            }
+            if(size > SERIAL_OUTPUT_BUFFER_SIZE) {
+                droppedBytes += size - SERIAL_OUTPUT_BUFFER_SIZE;
+                data += size - SERIAL_OUTPUT_BUFFER_SIZE;
+                size = SERIAL_OUTPUT_BUFFER_SIZE;
+            }
+            makeRoom(size);
+        }
+
+        for(size_t i = 0; i < size; i++) {
+            buffer[(writePos + i) & (SERIAL_OUTPUT_BUFFER_SIZE - 1)] = data[i];
+        }
+        writePos += size;
+
+        uint32_t pending = writePos - tail.load(std::memory_order_relaxed);
+        if(pending > highWater) highWater = pending;
+        if(!(inReport && policy == OVERFLOW_DROP_REPORT)) {
+            head.store(writePos, std::memory_order_release);
+        }
+        return size;
+    }
+
+    using Print::write;
+
+    // Groups the writes of one scan report, so OVERFLOW_DROP_REPORT can
+    // drop it as a whole
+    void beginReport() {
+        inReport = true;
+        reportDropped = false;
+        reportStart = writePos;
+        reportBytes = 0;
+    }
+
+    void endReport() {
+        inReport = false;
+        lastReportSize = reportBytes;
+        head.store(writePos, std::memory_order_release);
+    }
+
+    void setOverflowPolicy(uint8_t overflowPolicy) { policy = overflowPolicy; }
+
+    // Consumer side: moves up to maxBytes into sink, returns bytes sent
+    size_t drain(Print &sink, size_t maxBytes) {
+        size_t sent = 0;
+        uint8_t chunk[64];
+
+        while(sent < maxBytes) {
+            uint32_t t = tail.load(std::memory_order_acquire);
+            uint32_t h = head.load(std::memory_order_acquire);
+            size_t n = min((size_t)(h - t), min(maxBytes - sent, sizeof(chunk)));
+            if(n == 0) break;
+
+            for(size_t i = 0; i < n; i++) {
+                chunk[i] = buffer[(t + i) & (SERIAL_OUTPUT_BUFFER_SIZE - 1)];
+            }
+            if(!tail.compare_exchange_strong(t, t + n, std::memory_order_acq_rel)) {
+                continue;  // producer dropped these bytes meanwhile
+            }
+            sink.write(chunk, n);
+            sent += n;
+        }
+        return sent;
+    }
+
+    size_t pending() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    // Bytes the last report wrote, whether or not it was dropped
+    uint32_t getLastReportSize() const { return lastReportSize; }
+    uint32_t getDroppedBytes() const { return droppedBytes; }
+    uint32_t getDroppedReports() const { return droppedReports; }
+    uint32_t getHighWater() const { return highWater; }
+
+private:
+    // Drops the oldest queued bytes until size bytes fit
+    void makeRoom(size_t size) {
+        uint32_t t = tail.load(std::memory_order_acquire);
+        for(;;) {
+            size_t room = SERIAL_OUTPUT_BUFFER_SIZE - (writePos - t);
+            if(room >= size) return;
+            size_t drop = size - room;
+            if(tail.compare_exchange_weak(t, t + drop, std::memory_order_acq_rel)) {
+                droppedBytes += drop;
+                return;
+            }
+        }
+    }
+
+    uint8_t buffer[SERIAL_OUTPUT_BUFFER_SIZE];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    uint32_t writePos;        // producer's next byte, ahead of head inside a report
+    uint32_t reportStart;
+    bool inReport;
+    bool reportDropped;
+    uint8_t policy;
+    uint32_t reportBytes;
+    uint32_t lastReportSize;
+    uint32_t droppedBytes;
+    uint32_t droppedReports;
+    uint32_t highWater;
+};
+
+SCANNER_INSTANCE SerialOutputBuffer serialOutput;
+
+// Sends as much queued output as the port takes without blocking
+size_t drainSerialOutput() {
+    int room = Serial.availableForWrite();
+    if(room <= 0) return 0;
+    return serialOutput.drain(Serial, room);
+}
+
+#if SERIAL_OUTPUT_DRAIN_TASK
+static void serialDrainTask(void *arg) {
+    for(;;) {
+        if(drainSerialOutput() == 0) vTaskDelay(1);
+    }
+}
+#endif
+
+// Routes Report through the buffer; with SERIAL_OUTPUT_DRAIN_TASK the
+// buffer is emptied by its own task, otherwise loop() calls drainSerialOutput()
+void beginSerialOutput() {
+    Report.setOutput(serialOutput);
+#if SERIAL_OUTPUT_DRAIN_TASK
+    xTaskCreate(serialDrainTask, "serial_drain", 2048, NULL, 1, NULL);
+#endif
+}
+
+#endif // ZIGBEE_SCANNER_SERIAL_OUTPUT_H
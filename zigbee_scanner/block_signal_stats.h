@@ -0,0 +1,159 @@
+#ifndef ZIGBEE_SCANNER_SIGNAL_STATS_H
+#define ZIGBEE_SCANNER_SIGNAL_STATS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// Streaming statistics over the last WINDOW signal samples. Every update is
+// constant time whatever the window size:
+//  - sum and sum of squares for mean and variance
+//  - monotonic queues of ring positions for the window min and max
+//  - an EWMA of the samples (Q8 fixed point)
+//  - a histogram of the window for p10/p50/p90
+// All zero is the empty state, so memset() resets it.
+
+// Weight of a new sample in the EWMA is 1/2^n
+#ifndef SIGNAL_EWMA_SHIFT
+#define SIGNAL_EWMA_SHIFT 2
+#endif
+
+// Histogram bins over 0-255 used for quantiles (power of two)
+#ifndef SIGNAL_QUANTILE_BINS
+#define SIGNAL_QUANTILE_BINS 32
+#endif
+
+static_assert((SIGNAL_QUANTILE_BINS & (SIGNAL_QUANTILE_BINS - 1)) == 0 && SIGNAL_QUANTILE_BINS <= 256,
+              "SIGNAL_QUANTILE_BINS must be a power of two up to 256");
+
+template<uint16_t WINDOW>
+struct SignalStats {
+    static_assert(WINDOW >= 1 && WINDOW <= 4096, "signal window must hold 1 to 4096 samples");
+
+    // Positions and counts fit a byte for the usual short windows
+    typedef typename std::conditional<(WINDOW < 256), uint8_t, uint16_t>::type index_t;
+
+    uint8_t samples[WINDOW];                 // ring, oldest at head once full
+    index_t minQueue[WINDOW];                // positions with increasing samples
+    index_t maxQueue[WINDOW];                // positions with decreasing samples
+    index_t bins[SIGNAL_QUANTILE_BINS];
+    index_t head;
+    index_t count;
+    index_t minFront, minSize;
+    index_t maxFront, maxSize;
+    uint32_t sum;
+    uint32_t sumSquares;
+    uint16_t ewma;                           // Q8
+};
+
+template<uint16_t WINDOW>
+static inline uint16_t signalQueueAt(uint16_t front, uint16_t offset) {
+    uint16_t pos = front + offset;
+    return pos >= WINDOW ? pos - WINDOW : pos;
+}
+
+template<uint16_t WINDOW>
+void signalStatsAdd(SignalStats<WINDOW> *s, uint8_t value) {
+    const uint8_t binShift = 8 - __builtin_ctz(SIGNAL_QUANTILE_BINS);
+    uint16_t pos = s->head;
+
+    if(s->count == WINDOW) {
+        // The sample at head leaves the window; if still queued it is the front
+        uint8_t old = s->samples[pos];
+        if(s->minSize > 0 && s->minQueue[s->minFront] == pos) {
+            s->minFront = signalQueueAt<WINDOW>(s->minFront, 1);
+            s->minSize--;
+        }
+        if(s->maxSize > 0 && s->maxQueue[s->maxFront] == pos) {
+            s->maxFront = signalQueueAt<WINDOW>(s->maxFront, 1);
+            s->maxSize--;
+        }
+        s->sum -= old;
+        s->sumSquares -= (uint32_t)old * old;
+        s->bins[old >> binShift]--;
+    } else {
+        s->count++;
+    }
+
+    s->samples[pos] = value;
+    s->sum += value;
+    s->sumSquares += (uint32_t)value * value;
+    s->bins[value >> binShift]++;
+
+    // Samples that can no longer be the min (or max) leave from the back
+    while(s->minSize > 0 && s->samples[s->minQueue[signalQueueAt<WINDOW>(s->minFront, s->minSize - 1)]] >= value) {
+        s->minSize--;
+    }
+    s->minQueue[signalQueueAt<WINDOW>(s->minFront, s->minSize)] = pos;
+    s->minSize++;
+
+    while(s->maxSize > 0 && s->samples[s->maxQueue[signalQueueAt<WINDOW>(s->maxFront, s->maxSize - 1)]] <= value) {
+        s->maxSize--;
+    }
+    s->maxQueue[signalQueueAt<WINDOW>(s->maxFront, s->maxSize)] = pos;
+    s->maxSize++;
+
+    if(s->count == 1) {
+        s->ewma = (uint16_t)value << 8;
+    } else {
+        int32_t ewma = s->ewma;
+        ewma += (((int32_t)value << 8) - ewma) / (1 << SIGNAL_EWMA_SHIFT);
+        s->ewma = (uint16_t)ewma;
+    }
+
+    s->head = signalQueueAt<WINDOW>(pos, 1);
+}
+
+template<uint16_t WINDOW>
+uint8_t signalStatsMin(const SignalStats<WINDOW> *s) {
+    return s->minSize ? s->samples[s->minQueue[s->minFront]] : 0;
+}
+
+template<uint16_t WINDOW>
+uint8_t signalStatsMax(const SignalStats<WINDOW> *s) {
+    return s->maxSize ? s->samples[s->maxQueue[s->maxFront]] : 0;
+}
+
+template<uint16_t WINDOW>
+uint8_t signalStatsMean(const SignalStats<WINDOW> *s) {
+    return s->count ? s->sum / s->count : 0;
+}
+
+template<uint16_t WINDOW>
+uint8_t signalStatsEwma(const SignalStats<WINDOW> *s) {
+    return (s->ewma + 0x80) >> 8;
+}
+
+// Population variance of the window. Samples are 8-bit, so the integer
+// sums are exact and there is nothing for Welford's update to protect
+template<uint16_t WINDOW>
+uint32_t signalStatsVariance(const SignalStats<WINDOW> *s) {
+    if(s->count < 2) return 0;
+    uint64_t n = s->count;
+    return (uint32_t)((n * s->sumSquares - (uint64_t)s->sum * s->sum) / (n * n));
+}
+
+// Sample at the given percentile, interpolated inside its histogram bin
+// (resolution 256 / SIGNAL_QUANTILE_BINS) and clamped to the window range
+template<uint16_t WINDOW>
+uint8_t signalStatsQuantile(const SignalStats<WINDOW> *s, uint8_t percent) {
+    if(s->count == 0) return 0;
+    const uint16_t width = 256 / SIGNAL_QUANTILE_BINS;
+    uint32_t rank = ((uint32_t)(s->count - 1) * percent + 50) / 100;
+    uint32_t seen = 0;
+    uint16_t value = 255;
+
+    for(uint16_t b = 0; b < SIGNAL_QUANTILE_BINS; b++) {
+        if(seen + s->bins[b] > rank) {
+            value = b * width + ((rank - seen) * width + width / 2) / s->bins[b];
+            break;
+        }
+        seen += s->bins[b];
+    }
+
+    uint8_t lo = signalStatsMin(s);
+    uint8_t hi = signalStatsMax(s);
+    return value < lo ? lo : (value > hi ? hi : value);
+}
+
+#endif // ZIGBEE_SCANNER_SIGNAL_STATS_H
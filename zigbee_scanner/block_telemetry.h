@@ -0,0 +1,141 @@
+#ifndef ZIGBEE_SCANNER_TELEMETRY_H
+#define ZIGBEE_SCANNER_TELEMETRY_H
+
+#include "block_definitions.h"
+#include "block_helpers.h"
+#include "block_network_table.h"
+#include "block_scan_decode.h"
+#include "block_telemetry_format.h"
+
+// What a scan report is sent as (bits, both may be set; none leaves the
+// text to the serial commands)
+#define REPORT_MODE_NONE   0x00   // stats only, nothing formatted per scan
+#define REPORT_MODE_TEXT   0x01   // summary table and diagnostics
+#define REPORT_MODE_BINARY 0x02   // one telemetry frame per scan
+#define REPORT_MODE_BOTH   (REPORT_MODE_TEXT | REPORT_MODE_BINARY)
+#ifndef REPORT_MODE
+#define REPORT_MODE REPORT_MODE_TEXT
+#endif
+
+SCANNER_INSTANCE uint8_t reportMode = REPORT_MODE;
+SCANNER_INSTANCE uint16_t telemetrySequence = 0;
+
+// Streams one frame into out through a small staging buffer, computing the
+// CRC on the way, so a frame never has to fit in RAM
+class TelemetryFrameWriter {
+public:
+    explicit TelemetryFrameWriter(Print &out) : out(out), used(0), crc(TELEMETRY_CRC_INIT) {}
+
+    void begin(uint8_t type, uint16_t length) {
+        const uint8_t sync[2] = { TELEMETRY_SYNC0, TELEMETRY_SYNC1 };
+        out.write(sync, sizeof(sync));
+        crc = TELEMETRY_CRC_INIT;
+        put8(TELEMETRY_VERSION);
+        put8(type);
+        put16(length);
+    }
+
+    void put8(uint8_t value) {
+        if(used == sizeof(staging)) flush();
+        staging[used++] = value;
+    }
+
+    void put16(uint16_t value) {
+        put8(value & 0xFF);
+        put8(value >> 8);
+    }
+
+    void put32(uint32_t value) {
+        put16(value & 0xFFFF);
+        put16(value >> 16);
+    }
+
+    void put64(uint64_t value) {
+        put32((uint32_t)value);
+        put32((uint32_t)(value >> 32));
+    }
+
+    void end() {
+        flush();
+        const uint8_t tail[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+        out.write(tail, sizeof(tail));
+    }
+
+private:
+    void flush() {
+        crc = telemetryCrc16(crc, staging, used);
+        out.write(staging, used);
+        used = 0;
+    }
+
+    Print &out;
+    uint8_t staging[64];
+    uint8_t used;
+    uint16_t crc;
+};
+
+static void putNetworkRecord(TelemetryFrameWriter &frame, const ScanSnapshot *scan, uint16_t i,
+                             const NetworkStats *stats) {
+    frame.put16(scan->panId[i]);
+    frame.put64(scan->extendedPanId[i]);
+    frame.put8(scan->channel[i]);
+    frame.put8(scan->signal[i]);
+    frame.put8(scan->load[i]);
+    frame.put8(scan->flags[i]);
+    frame.put8(stats->avgSignalStrength);
+    frame.put8(stats->minSignalStrength);
+    frame.put8(stats->maxSignalStrength);
+    frame.put8(stats->signalTrend);
+    const SignalStats<SIGNAL_HISTORY_SIZE> *signal = &networkSeries(&networkTable, stats)->signal;
+    frame.put8(signalStatsQuantile(signal, 10));
+    frame.put8(signalStatsQuantile(signal, 50));
+    frame.put8(signalStatsQuantile(signal, 90));
+    frame.put32(networkUptime(stats));
+    frame.put32(stats->beaconsExpected);
+    frame.put16((uint16_t)min(stats->beaconsMissed, (uint32_t)0xFFFF));
+    frame.put16(stats->longestMissStreak);
+}
+
+static void putGoneRecord(TelemetryFrameWriter &frame, const NetworkHistory *network) {
+    frame.put16(network->panId);
+    frame.put64(network->extendedPanId);
+    frame.put8(network->channel);
+    frame.put8(network->signalStrength);
+    frame.put8(network->networkLoad);
+    frame.put8(network->flags | NETWORK_FLAG_GONE);
+    for(int b = 0; b < TELEMETRY_NETWORK_RECORD_SIZE - 14; b++) frame.put8(0);
+}
+
+// One frame for the report of a scan: a keyframe with every network or a
+// delta with the selected ones, then the networks that left
+void writeScanTelemetry(Print &out, const ScanSnapshot *scan, const ReportSelection *selection) {
+    const uint16_t maxRecords = (TELEMETRY_MAX_PAYLOAD - TELEMETRY_SCAN_HEADER_SIZE) / TELEMETRY_NETWORK_RECORD_SIZE;
+    uint16_t count = min(selection->count, maxRecords);
+    uint16_t gone = min(selection->goneCount, (uint16_t)(maxRecords - count));
+    TelemetryFrameWriter frame(out);
+
+    frame.begin(selection->keyframe ? TELEMETRY_FRAME_SCAN : TELEMETRY_FRAME_DELTA,
+                TELEMETRY_SCAN_HEADER_SIZE + (count + gone) * TELEMETRY_NETWORK_RECORD_SIZE);
+    frame.put16(telemetrySequence++);
+    frame.put32(scan->timestamp);
+    frame.put32(scan->channelMask);
+    frame.put16(count + gone);
+    frame.put16(scan->truncated + (selection->count - count));
+
+    for(int n = 0; n < count; n++) {
+        uint16_t i = selection->index[n];
+        putNetworkRecord(frame, scan, i, scanStats[i]);
+    }
+    for(int n = 0; n < gone; n++) {
+        putGoneRecord(frame, &previousScan[selection->gone[n]]);
+    }
+    frame.end();
+}
+
+// Binary only mutes every text line, so the stream is frames alone
+void setReportMode(uint8_t mode) {
+    reportMode = mode;
+    Report.setMuted(!(mode & REPORT_MODE_TEXT));
+}
+
+#endif // ZIGBEE_SCANNER_TELEMETRY_H
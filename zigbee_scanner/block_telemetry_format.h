@@ -0,0 +1,70 @@
+#ifndef ZIGBEE_SCANNER_TELEMETRY_FORMAT_H
+#define ZIGBEE_SCANNER_TELEMETRY_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary telemetry frame, shared by the sketch and host-side decoders.
+// All fields are little-endian.
+//
+//   sync     2  0xA5 0x5A
+//   version  1  TELEMETRY_VERSION
+//   type     1  TELEMETRY_FRAME_*
+//   length   2  payload bytes
+//   payload  length
+//   crc      2  CRC-16/CCITT-FALSE over version..payload
+//
+// Scan payload: a header, then one record per network. A TELEMETRY_FRAME_SCAN
+// keyframe lists every network of the scan; a TELEMETRY_FRAME_DELTA only
+// those that appeared or changed. Both end with a record per network that
+// left, flagged NETWORK_FLAG_GONE (0x20) with zero stats.
+//   sequence u16, timestamp u32 (ms), channelMask u32, count u16, truncated u16
+//
+// Profile payload (TELEMETRY_FRAME_PROFILE, with CYCLE_PROFILE): where scan
+// cycles spent their time since the previous profile frame
+//   timestamp u32 (ms), cpuMHz u16, scanCycles u32 (since boot), phases u8,
+//   per phase: cycles u16, mean u32, max u32, p50 u32, p90 u32 (CPU cycles
+//   over the window; percentiles are histogram bucket bounds)
+//   freeHeapMin u32, freeHeapMax u32, largestBlockMin u32,
+//   largestBlockMax u32, stackHeadroomMin u32 (bytes, since boot)
+//
+// Network record
+//   panId u16, extendedPanId u64, channel u8, signal u8, load u8,
+//   flags u8 (NETWORK_FLAG_*),
+//   signalAvg u8, signalMin u8, signalMax u8, signalTrend u8,
+//   signalP10 u8, signalP50 u8, signalP90 u8,
+//   uptime u32 (s), beaconsExpected u32, beaconsMissed u16, longestMissStreak u16
+
+#define TELEMETRY_SYNC0 0xA5
+#define TELEMETRY_SYNC1 0x5A
+#define TELEMETRY_VERSION 3
+
+#define TELEMETRY_FRAME_SCAN 1
+#define TELEMETRY_FRAME_DELTA 2
+#define TELEMETRY_FRAME_PROFILE 3
+
+#define TELEMETRY_HEADER_SIZE 6                  // sync, version, type, length
+#define TELEMETRY_FRAME_OVERHEAD 8               // header and crc
+#define TELEMETRY_SCAN_HEADER_SIZE 14
+#define TELEMETRY_NETWORK_RECORD_SIZE 33
+#define TELEMETRY_PROFILE_HEADER_SIZE 11
+#define TELEMETRY_PHASE_RECORD_SIZE 18
+#define TELEMETRY_MEMORY_RECORD_SIZE 20
+#define TELEMETRY_MAX_PAYLOAD 0xFFFF
+
+#define TELEMETRY_CRC_INIT 0xFFFF
+
+// CRC-16/CCITT-FALSE (poly 0x1021), a nibble at a time from a 16-entry table
+static inline uint16_t telemetryCrc16(uint16_t crc, const uint8_t *data, size_t size) {
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+    for(size_t i = 0; i < size; i++) {
+        crc = (uint16_t)(crc << 4) ^ table[((crc >> 12) ^ (data[i] >> 4)) & 0x0F];
+        crc = (uint16_t)(crc << 4) ^ table[((crc >> 12) ^ data[i]) & 0x0F];
+    }
+    return crc;
+}
+
+#endif // ZIGBEE_SCANNER_TELEMETRY_FORMAT_H
@@ -0,0 +1,114 @@
+#ifndef ZIGBEE_SCANNER_TEXT_H
+#define ZIGBEE_SCANNER_TEXT_H
+
+#include "block_definitions.h"
+
+// Longest single printf() line sent through ReportWriter
+#define REPORT_LINE_SIZE 192
+
+// Text builder over caller-provided storage. Never touches the heap: output
+// past the capacity is dropped and overflowed() reports it.
+class TextBuffer : public Print {
+public:
+    TextBuffer(char *storage, size_t capacity) : buffer(storage), capacity(capacity) {
+        clear();
+    }
+
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *data, size_t size) override {
+        size_t room = capacity - 1 - len;
+        if(size > room) {
+            overflow = true;
+            size = room;
+        }
+        memcpy(buffer + len, data, size);
+        len += size;
+        buffer[len] = 0;
+        return size;
+    }
+
+    using Print::write;
+
+    // Formats straight into the free space (Print::printf may allocate)
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        size_t room = capacity - len;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buffer + len, room, format, args);
+        va_end(args);
+        if(n < 0) {
+            buffer[len] = 0;
+            return 0;
+        }
+        if((size_t)n >= room) {
+            overflow = true;
+            n = room - 1;
+        }
+        len += n;
+        return n;
+    }
+
+    void clear() {
+        len = 0;
+        overflow = false;
+        buffer[0] = 0;
+    }
+
+    const char *c_str() const { return buffer; }
+    size_t length() const { return len; }
+    bool overflowed() const { return overflow; }
+
+private:
+    char *buffer;
+    size_t capacity;
+    size_t len;
+    bool overflow;
+};
+
+// TextBuffer with its own storage, meant to live on the stack
+template <size_t N>
+class FixedTextBuffer : public TextBuffer {
+public:
+    FixedTextBuffer() : TextBuffer(storage, N) {}
+
+private:
+    char storage[N];
+};
+
+// Print front end for report output: printf() formats into a stack line
+// buffer instead of the heap fallback of Print::printf. Text can be muted
+// while raw() still reaches the output (binary telemetry only).
+class ReportWriter : public Print {
+public:
+    explicit ReportWriter(Print &out) : out(&out), muted(false) {}
+
+    size_t write(uint8_t c) override { return muted ? 1 : out->write(c); }
+    size_t write(const uint8_t *data, size_t size) override { return muted ? size : out->write(data, size); }
+    using Print::write;
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        if(muted) return 0;
+        char line[REPORT_LINE_SIZE];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        if(n < 0) return 0;
+        if((size_t)n >= sizeof(line)) n = sizeof(line) - 1;  // truncated
+        return out->write((const uint8_t *)line, n);
+    }
+
+    void setOutput(Print &destination) { out = &destination; }
+    void setMuted(bool mute) { muted = mute; }
+    bool isMuted() const { return muted; }
+    Print &raw() { return *out; }
+
+private:
+    Print *out;
+    bool muted;
+};
+
+#endif // ZIGBEE_SCANNER_TEXT_H
@@ -0,0 +1,37 @@
+#ifndef ZIGBEE_SCANNER_THRESHOLDS_H
+#define ZIGBEE_SCANNER_THRESHOLDS_H
+
+#include "block_definitions.h"
+
+// When the analysis calls something an issue. The scanner runs with the
+// defaults; the host replay tool (threshold_sweep) tries other sets on
+// recorded scans.
+
+// EWMA distance from the window mean that counts as a trend
+const int SIGNAL_TREND_THRESHOLD = 5;
+
+// Scans of its channel before a network's beacon loss is judged
+const uint32_t LINK_MIN_SCANS = 5;
+
+// A signal change within this many sightings still shows as an issue
+const uint8_t CHANGE_RECENT_SCANS = 10;
+
+struct AnalysisThresholds {
+    uint8_t trendDelta;          // SIGNAL_TREND_THRESHOLD
+    uint8_t lossMinScans;        // LINK_MIN_SCANS
+    uint8_t lossWarning;         // beacon loss above this % is moderate (!)
+    uint8_t lossCritical;        // and above this % high (!!)
+    uint8_t weakSignal;          // signal (0-255) below this is weak
+    uint8_t highLoad;            // network load above this % is high
+    uint8_t shiftSeverity;       // CHANGE_* a signal change needs to be an issue
+    uint8_t shiftScans;          // CHANGE_RECENT_SCANS
+    uint8_t overloadedChannel;   // more networks than this overload a channel
+};
+
+const AnalysisThresholds DEFAULT_ANALYSIS_THRESHOLDS = {
+    SIGNAL_TREND_THRESHOLD, LINK_MIN_SCANS, 10, 20, 0x40, 75, CHANGE_MAJOR, CHANGE_RECENT_SCANS, 2
+};
+
+SCANNER_INSTANCE AnalysisThresholds analysisThresholds = DEFAULT_ANALYSIS_THRESHOLDS;
+
+#endif // ZIGBEE_SCANNER_THRESHOLDS_H
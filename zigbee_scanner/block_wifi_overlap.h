@@ -0,0 +1,95 @@
+#ifndef ZIGBEE_SCANNER_WIFI_OVERLAP_H
+#define ZIGBEE_SCANNER_WIFI_OVERLAP_H
+
+#include "block_definitions.h"
+
+// How much of each Zigbee channel a WiFi channel covers, computed at
+// compile time from the channel plans and the 802.11 OFDM transmit mask
+
+#define WIFI_CHANNEL_COUNT 14      // 20 MHz channels 1..14
+#define WIFI_HT40_FIRST 3          // 40 MHz channels are centred on WiFi 3..11
+#define WIFI_HT40_COUNT 9
+
+constexpr int zigbeeChannelMHz(int channel) {
+    return 2405 + 5 * (channel - MIN_CHANNEL);
+}
+
+constexpr int wifiChannelMHz(int channel) {
+    return channel == 14 ? 2484 : 2407 + 5 * channel;
+}
+
+// Transmit mask in dB relative to the in-band level, offset from the WiFi
+// centre in MHz: flat to width/2 - 1, -20 dBr 2 MHz further, -28 dBr at
+// width, -40 dBr from 1.5 * width
+constexpr double wifiMaskDbr(double offset, double width) {
+    double f = offset < 0 ? -offset : offset;
+    double edge = width / 2 - 1;
+    if(f <= edge) return 0;
+    if(f <= edge + 2) return -20 * (f - edge) / 2;
+    if(f <= width) return -20 - 8 * (f - edge - 2) / (width - edge - 2);
+    if(f <= width * 1.5) return -28 - 12 * (f - width) / (width * 0.5);
+    return -40;
+}
+
+// 10^(dB/10) for dB <= 0, by series (constexpr has no pow())
+constexpr double dbrToLinear(double db) {
+    double x = -db * 0.23025850929940458;   // ln(10) / 10
+    double term = 1;
+    double sum = 1;
+    for(int n = 1; n < 60; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    return 1 / sum;
+}
+
+// Share of a Zigbee channel's 2 MHz band under the mask, in percent of the
+// in-band level (averaged over five points across the channel)
+constexpr uint8_t spectralOverlap(int zigbeeMHz, int wifiMHz, double width) {
+    double sum = 0;
+    for(int i = -2; i <= 2; i++) {
+        sum += dbrToLinear(wifiMaskDbr(zigbeeMHz + i * 0.5 - wifiMHz, width));
+    }
+    return (uint8_t)(sum / 5 * 100 + 0.5);
+}
+
+struct WifiOverlapTable {
+    uint8_t ht20[CHANNEL_COUNT][WIFI_CHANNEL_COUNT];
+    uint8_t ht40[CHANNEL_COUNT][WIFI_HT40_COUNT];
+};
+
+constexpr WifiOverlapTable buildWifiOverlapTable() {
+    WifiOverlapTable t = {};
+    for(int z = 0; z < CHANNEL_COUNT; z++) {
+        int zigbeeMHz = zigbeeChannelMHz(MIN_CHANNEL + z);
+        for(int w = 0; w < WIFI_CHANNEL_COUNT; w++) {
+            t.ht20[z][w] = spectralOverlap(zigbeeMHz, wifiChannelMHz(w + 1), 20);
+        }
+        for(int w = 0; w < WIFI_HT40_COUNT; w++) {
+            t.ht40[z][w] = spectralOverlap(zigbeeMHz, wifiChannelMHz(WIFI_HT40_FIRST + w), 40);
+        }
+    }
+    return t;
+}
+
+constexpr WifiOverlapTable wifiOverlapTable = buildWifiOverlapTable();
+
+// WiFi 6 sits on Zigbee 16..19, Zigbee 26 is clear of WiFi 11 but not 13
+static_assert(wifiOverlapTable.ht20[16 - MIN_CHANNEL][6 - 1] == 100 &&
+              wifiOverlapTable.ht20[19 - MIN_CHANNEL][6 - 1] == 100 &&
+              wifiOverlapTable.ht20[15 - MIN_CHANNEL][6 - 1] <= 1 &&
+              wifiOverlapTable.ht20[26 - MIN_CHANNEL][11 - 1] == 0 &&
+              wifiOverlapTable.ht20[26 - MIN_CHANNEL][13 - 1] == 100,
+              "WiFi overlap table does not match the channel plans");
+
+// Overlap of a Zigbee channel (11..26) with a 20 MHz WiFi channel (1..14)
+inline uint8_t wifiOverlap20(uint8_t zigbeeChannel, uint8_t wifiChannel) {
+    return wifiOverlapTable.ht20[zigbeeChannel - MIN_CHANNEL][wifiChannel - 1];
+}
+
+// Overlap with a 40 MHz WiFi channel centred on WiFi centreChannel (3..11)
+inline uint8_t wifiOverlap40(uint8_t zigbeeChannel, uint8_t centreChannel) {
+    return wifiOverlapTable.ht40[zigbeeChannel - MIN_CHANNEL][centreChannel - WIFI_HT40_FIRST];
+}
+
+#endif // ZIGBEE_SCANNER_WIFI_OVERLAP_H
@@ -2,57 +2,68 @@
 #define ZIGBEE_SCANNER_INTERFERENCE_ANALYSIS_H
 
 #include "block_definitions.h"
+#include "block_text.h"
+#include "block_wifi_overlap.h"
 
-// Structure for interference analysis
+// InterferenceAnalysis::interferenceType
+#define INTERFERENCE_NONE      0
+#define INTERFERENCE_WIFI      1   // wideband: several adjacent channels busy at once
+#define INTERFERENCE_BLUETOOTH 2   // narrowband bursts (frequency hopping)
+#define INTERFERENCE_OTHER     3   // constant (carrier, video sender, microwave oven)
+
+// Structure for interference analysis, filled from energy-detect samples
 struct InterferenceAnalysis {
-    uint8_t wifiOverlap;      // Degree of overlap with WiFi (0–100%)
-    uint8_t noiseLevel;       // Noise level on the channel
+    uint8_t wifiOverlap;      // Samples with wideband (WiFi-like) energy (0–100%)
+    uint8_t noiseLevel;       // Mean energy, dB above ENERGY_FLOOR_DBM
     bool isConstant;          // Constant or periodic interference
-    uint8_t interferenceType; // Type of interference (WiFi, Bluetooth, others)
+    uint8_t interferenceType; // INTERFERENCE_*
     uint32_t lastDetected;    // Time of last detection
+    int8_t minDbm;            // Energy over the last sampling window
+    int8_t meanDbm;
+    int8_t peakDbm;
+    uint8_t dutyCycle;        // Samples above ENERGY_BUSY_DBM (0–100%)
+    uint16_t bursts;          // Quiet-to-busy transitions in the window
+    uint16_t samples;
+    uint32_t measuredAt;      // Time the window was folded in
 };
 
+const uint8_t INTERFERENCE_HISTORY_SIZE = 10;
+// Channels named as alternatives to an interfered one
+const uint8_t INTERFERENCE_ALTERNATIVES = 3;
+
 // Interference history for each channel
 struct InterferenceHistory {
-    uint8_t noiseHistory[10];    // Last 10 measurements
+    uint8_t noiseHistory[INTERFERENCE_HISTORY_SIZE];    // Last measurements
     uint8_t historyIndex;        // Current index in history
     bool isInitialized;          // Initialization flag
     uint32_t lastUpdateTime;     // Time of last update
 };
 
 // Global variables for interference history
-InterferenceHistory channelHistory[16]; // For channels 11–26
-InterferenceAnalysis currentAnalysis[16];
+SCANNER_INSTANCE InterferenceHistory channelHistory[CHANNEL_COUNT]; // For MIN_CHANNEL–MAX_CHANNEL
+SCANNER_INSTANCE InterferenceAnalysis currentAnalysis[CHANNEL_COUNT];
 
-// WiFi interference analysis function
-String analyzeWiFiInterference(uint8_t channel) {
-    String result = "";
-    
-    // WiFi channels and their center frequencies
+// WiFi interference analysis function: the usual non-overlapping WiFi
+// channels against the overlap table
+void analyzeWiFiInterference(uint8_t channel, Print &out) {
     const uint8_t wifiChannels[] = {1, 6, 11};  // 2.4 GHz
-    const uint16_t wifiFreq[] = {2412, 2437, 2462}; // MHz
-    
-    // Zigbee channel to frequency
-    uint16_t zigbeeFreq = 2405 + ((channel - 11) * 5); // MHz
+    if(channel < MIN_CHANNEL || channel > MAX_CHANNEL) return;
     
     for(int i = 0; i < 3; i++) {
-        int freqDiff = abs(zigbeeFreq - wifiFreq[i]);
-        if(freqDiff < 20) {
-            result += String("   (!!) High interference risk from WiFi channel ") + String(wifiChannels[i]);
-            result += " (overlap > 80%)\n";
-        } else if(freqDiff < 30) {
-            result += String("   (!) Moderate interference from WiFi channel ") + String(wifiChannels[i]);
-            result += " (overlap 40-60%)\n";
+        uint8_t overlap = wifiOverlap20(channel, wifiChannels[i]);
+        if(overlap >= 50) {
+            out.printf("   (!!) High interference risk from WiFi channel %u (overlap %u%%)\n", wifiChannels[i], overlap);
+        } else if(overlap > 0) {
+            out.printf("   (!) Moderate interference from WiFi channel %u (overlap %u%%)\n", wifiChannels[i], overlap);
         }
     }
-    
-    return result;
 }
 
-// Function for tracking interference history
+// Function for tracking interference history (one noise level per
+// energy-detect window)
 void updateInterferenceHistory(uint8_t channel, uint8_t noiseLevel) {
-    uint8_t idx = channel - 11;
-    if(idx >= 16) return;
+    uint8_t idx = channel - MIN_CHANNEL;
+    if(idx >= CHANNEL_COUNT) return;
     
     InterferenceHistory *history = &channelHistory[idx];
     
@@ -61,77 +72,70 @@ void updateInterferenceHistory(uint8_t channel, uint8_t noiseLevel) {
         memset(history->noiseHistory, 0, sizeof(history->noiseHistory));
         history->historyIndex = 0;
         history->isInitialized = true;
-        history->lastUpdateTime = millis();
     }
     
     // Update history
     history->noiseHistory[history->historyIndex] = noiseLevel;
-    history->historyIndex = (history->historyIndex + 1) % 10;
+    history->historyIndex = (history->historyIndex + 1) % INTERFERENCE_HISTORY_SIZE;
     history->lastUpdateTime = millis();
-    
-    // Analyze the nature of the interference
-    bool isConstant = true;
-    uint8_t baseLevel = history->noiseHistory[0];
-    uint8_t maxDiff = 0;
-    
-    for(int i = 1; i < 10; i++) {
-        uint8_t diff = abs(history->noiseHistory[i] - baseLevel);
-        if(diff > maxDiff) maxDiff = diff;
-        if(diff > 10) {
-            isConstant = false;
-        }
-    }
-    
-    // Update current analysis
-    currentAnalysis[idx].isConstant = isConstant;
-    currentAnalysis[idx].noiseLevel = noiseLevel;
-    currentAnalysis[idx].lastDetected = millis();
 }
 
-// Function to get recommendations
-String getChannelRecommendations(uint8_t channel) {
-    String recommendations = "\n   Channel Recommendations:\n";
-    uint8_t idx = channel - 11;
+// Function to get recommendations; ranked holds the channel indices best
+// first (ChannelRanking::order), the alternatives are taken from it
+void getChannelRecommendations(uint8_t channel, const uint8_t *ranked, Print &out) {
+    out.print("\n   Channel Recommendations:\n");
+    uint8_t idx = channel - MIN_CHANNEL;
     
     if(currentAnalysis[idx].wifiOverlap > 70) {
-        recommendations += "   - High WiFi interference detected:\n";
-        recommendations += "     * Consider using channels 15, 20, or 25\n";
-        recommendations += "     * Increase distance from WiFi routers\n";
+        out.print("   - High WiFi interference detected:\n");
+        uint8_t n = 0;
+        for(int i = 0; i < CHANNEL_COUNT && n < INTERFERENCE_ALTERNATIVES; i++) {
+            if(ranked[i] == idx) continue;
+            out.printf(n == 0 ? "     * Consider using channel %u" : ", %u", MIN_CHANNEL + ranked[i]);
+            n++;
+        }
+        if(n > 0) out.print(" (best ranked)\n");
+        out.print("     * Increase distance from WiFi routers\n");
     }
     
-    if(currentAnalysis[idx].isConstant) {
-        recommendations += "   - Constant interference detected:\n";
-        recommendations += "     * Check for nearby constant RF sources\n";
-        recommendations += "     * Consider physical barriers or repositioning\n";
-    } else if(currentAnalysis[idx].noiseLevel > 0) {
-        recommendations += "   - Variable interference detected:\n";
-        recommendations += "     * Monitor peak interference times\n";
-        recommendations += "     * Consider scheduling critical transmissions during low-interference periods\n";
+    if(currentAnalysis[idx].interferenceType == INTERFERENCE_NONE) {
+        return;
+    } else if(currentAnalysis[idx].isConstant) {
+        out.print("   - Constant interference detected:\n");
+        out.print("     * Check for nearby constant RF sources\n");
+        out.print("     * Consider physical barriers or repositioning\n");
+    } else {
+        out.print("   - Variable interference detected:\n");
+        out.print("     * Monitor peak interference times\n");
+        out.print("     * Consider scheduling critical transmissions during low-interference periods\n");
     }
-    
-    return recommendations;
 }
 
 // Main interference analysis function for the channel
-String analyzeChannelInterference(uint8_t channel, uint8_t signalStrength) {
-    String result = "";
-    uint8_t idx = channel - 11;
+void analyzeChannelInterference(uint8_t channel, const uint8_t *ranked, Print &out) {
+    uint8_t idx = channel - MIN_CHANNEL;
+    if(idx >= CHANNEL_COUNT) return;
+    const InterferenceAnalysis *analysis = &currentAnalysis[idx];
     
     // Analyze WiFi interference
-    String wifiAnalysis = analyzeWiFiInterference(channel);
+    FixedTextBuffer<256> wifiAnalysis;
+    analyzeWiFiInterference(channel, wifiAnalysis);
     if(wifiAnalysis.length() > 0) {
-        result += "\nWiFi Interference Analysis:\n" + wifiAnalysis;
+        out.print("\nWiFi Interference Analysis:\n");
+        out.print(wifiAnalysis.c_str());
+    }
+
+    // Measured energy
+    if(analysis->samples > 0) {
+        out.printf("   Energy: %d dBm mean, %d..%d dBm, busy %u%%, WiFi-like %u%%\n",
+            analysis->meanDbm, analysis->minDbm, analysis->peakDbm,
+            analysis->dutyCycle, analysis->wifiOverlap);
     }
-    
-    // Update history
-    updateInterferenceHistory(channel, 255 - signalStrength);
     
     // Add recommendations if problems are detected
-    if(currentAnalysis[idx].noiseLevel > 0 || wifiAnalysis.length() > 0) {
-        result += getChannelRecommendations(channel);
+    if(analysis->interferenceType != INTERFERENCE_NONE || wifiAnalysis.length() > 0) {
+        getChannelRecommendations(channel, ranked, out);
     }
-    
-    return result;
 }
 
 #endif // ZIGBEE_SCANNER_INTERFERENCE_ANALYSIS_H
\ No newline at end of file
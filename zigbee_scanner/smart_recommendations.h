@@ -3,28 +3,34 @@
 
 #include "block_definitions.h"
 #include "block_helpers.h"
-
+#include "block_text.h"
+#include "block_network_table.h"
+#include "block_channel_score.h"
+#include "block_change_events.h"
+#include "block_fixed_point.h"
+#include "block_thresholds.h"
+
+// Recommendations point at fixed texts, NULL when not applicable
 struct NetworkRecommendation {
     bool hasIssues;
-    String signalRecommendation;
-    String loadRecommendation;
-    String channelRecommendation;
-    String securityRecommendation;
+    const char *signalRecommendation;
+    const char *stabilityRecommendation;
+    const char *loadRecommendation;
+    const char *channelRecommendation;
+    const char *securityRecommendation;
 };
 
 // Analysis and recommendations for a single network
-NetworkRecommendation analyzeNetwork(zigbee_scan_result_t *network, NetworkStats *stats, uint8_t networkIndex) {
-    NetworkRecommendation rec = {false, "", "", "", ""};
-    uint8_t* raw = (uint8_t*)&network->short_pan_id;
-    uint16_t rawSignal = (raw[0] << 8) | raw[1];
-    uint8_t signalStrength = (rawSignal >> 8) & 0xFF;
-    uint8_t networkLoad = (raw[4] * 100) / 255;
+NetworkRecommendation analyzeNetwork(const ScanSnapshot *scan, NetworkStats *stats, uint16_t networkIndex) {
+    NetworkRecommendation rec = {false, NULL, NULL, NULL, NULL, NULL};
+    uint8_t signalStrength = scan->signal[networkIndex];
+    uint8_t networkLoad = scan->load[networkIndex];
 
     // Signal analysis
-    if(signalStrength < 0x40) {
+    if(signalStrength < analysisThresholds.weakSignal) {
         rec.hasIssues = true;
-        float avgStrength = stats->avgSignalStrength;
-        if(avgStrength > signalStrength * 1.5) {
+        Q16 avgStrength = qFromInt<16>(stats->avgSignalStrength);
+        if(avgStrength.raw > qMul(qFromInt<16>(signalStrength), qFromRaw<16>(3 << 15)).raw) {  // 1.5x
             rec.signalRecommendation = "Signal strength is significantly below average. Consider:\n"
                                      "- Checking for physical obstacles\n"
                                      "- Reducing distance to coordinator/router\n"
@@ -33,16 +39,16 @@ NetworkRecommendation analyzeNetwork(zigbee_scan_result_t *network, NetworkStats
     }
 
     // Stability analysis
-    if(stats->maxSignalStrength - stats->minSignalStrength > 50) {
+    if(recentSignalShift(stats)) {
         rec.hasIssues = true;
-        rec.signalRecommendation += "High signal variation detected. Possible causes:\n"
-                                   "- Moving obstacles in signal path\n"
-                                   "- Interference from nearby devices\n"
-                                   "- Environmental factors (weather, temperature)";
+        rec.stabilityRecommendation = "Signal level changed recently. Possible causes:\n"
+                                      "- Moving obstacles in signal path\n"
+                                      "- Interference from nearby devices\n"
+                                      "- Environmental factors (weather, temperature)";
     }
 
     // Load analysis
-    if(networkLoad > 75) {
+    if(networkLoad > analysisThresholds.highLoad) {
         rec.hasIssues = true;
         rec.loadRecommendation = "High network load detected. Consider:\n"
                                 "- Distributing devices across multiple networks\n"
@@ -51,7 +57,7 @@ NetworkRecommendation analyzeNetwork(zigbee_scan_result_t *network, NetworkStats
     }
 
     // Security recommendations
-    if(!(raw[5] & 0x7F)) {
+    if(!(scan->flags[networkIndex] & NETWORK_FLAG_SECURED)) {
         rec.hasIssues = true;
         rec.securityRecommendation = "Network security is not enabled! Recommended actions:\n"
                                     "- Enable network encryption\n"
@@ -63,8 +69,8 @@ NetworkRecommendation analyzeNetwork(zigbee_scan_result_t *network, NetworkStats
 }
 
 // Smart recommendation generation for the entire network
-void generateSmartRecommendations(zigbee_scan_result_t *scan_result, uint16_t networksFound) {
-    Serial.println("\n=== SMART RECOMMENDATIONS ===");
+void generateSmartRecommendations(ReportWriter &out, const ScanSnapshot *scan) {
+    out.println("\n=== SMART RECOMMENDATIONS ===");
 
     // General network overview analysis
     bool hasOverloadedChannels = false;
@@ -72,86 +78,85 @@ void generateSmartRecommendations(zigbee_scan_result_t *scan_result, uint16_t ne
     bool hasSecurityIssues = false;
     bool hasSignalIssues = false;
 
-    // Count devices per channel
-    uint8_t channelCounts[16] = {0}; // For channels 11–26
-    
-    for(int i = 0; i < networksFound; i++) {
-        uint8_t channel = scan_result[i].logic_channel - 11;
-        if(channel < 16) channelCounts[channel]++;
-        
-        NetworkRecommendation rec = analyzeNetwork(&scan_result[i], &networkStats[i], i);
+    for(int i = 0; i < scan->count; i++) {
+        NetworkStats *stats = findNetworkStats(&networkTable, scan->panId[i], scan->extendedPanId[i]);
+        if(!stats) continue;
+
+        NetworkRecommendation rec = analyzeNetwork(scan, stats, i);
         
         if(rec.hasIssues) {
-            Serial.printf("\nRecommendations for Network 0x%04x:\n", scan_result[i].short_pan_id);
+            out.printf("\nRecommendations for Network 0x%04x:\n", scan->panId[i]);
             
-            if(rec.signalRecommendation.length() > 0) {
-                Serial.println(rec.signalRecommendation);
+            if(rec.signalRecommendation) {
+                out.println(rec.signalRecommendation);
+                hasSignalIssues = true;
+            }
+
+            if(rec.stabilityRecommendation) {
+                out.println(rec.stabilityRecommendation);
                 hasSignalIssues = true;
             }
             
-            if(rec.loadRecommendation.length() > 0) {
-                Serial.println(rec.loadRecommendation);
+            if(rec.loadRecommendation) {
+                out.println(rec.loadRecommendation);
                 hasOverloadedChannels = true;
             }
             
-            if(rec.securityRecommendation.length() > 0) {
-                Serial.println(rec.securityRecommendation);
+            if(rec.securityRecommendation) {
+                out.println(rec.securityRecommendation);
                 hasSecurityIssues = true;
             }
         }
     }
 
     // General optimization recommendations
-    Serial.println("\nNetwork-Wide Recommendations:");
+    out.println("\nNetwork-Wide Recommendations:");
 
     // Check channel distribution
     int usedChannels = 0;
     int overloadedChannels = 0;
-    for(int i = 0; i < 16; i++) {
-        if(channelCounts[i] > 0) usedChannels++;
-        if(channelCounts[i] > 2) overloadedChannels++;
+    for(int i = 0; i < CHANNEL_COUNT; i++) {
+        if(channelRanking.channels[i].networks > 0) usedChannels++;
+        if(channelRanking.channels[i].networks > analysisThresholds.overloadedChannel) overloadedChannels++;
     }
 
     if(overloadedChannels > 0) {
-        Serial.println("\n1. Channel Distribution Issues:");
-        Serial.println("   - Some channels are overloaded while others are unused");
-        Serial.println("   - Consider redistributing networks across available channels");
+        out.println("\n1. Channel Distribution Issues:");
+        out.println("   - Some channels are overloaded while others are unused");
+        out.println("   - Consider redistributing networks across available channels");
         
-        // Suggest specific channels to move to
-        for(int i = 0; i < 16; i++) {
-            if(channelCounts[i] == 0 && 
-               !(i + 11 >= 11 && i + 11 <= 14) &&   // Not WiFi channel 1
-               !(i + 11 >= 16 && i + 11 <= 19) &&   // Not WiFi channel 6
-               !(i + 11 >= 21 && i + 11 <= 24)) {   // Not WiFi channel 11
-                Serial.printf("   - Channel %d is free and recommended\n", i + 11);
-            }
+        // Suggest the best ranked free channels
+        uint8_t freeChannels[3];
+        uint8_t n = recommendedChannels(&channelRanking, freeChannels, 3, true);
+        for(int i = 0; i < n; i++) {
+            out.printf("   - Channel %d is free and recommended\n", freeChannels[i]);
         }
     }
 
     // Performance recommendations
     if(hasSignalIssues) {
-        Serial.println("\n2. Network Performance Optimization:");
-        Serial.println("   - Consider network topology optimization");
-        Serial.println("   - Review device placement and distances");
-        Serial.println("   - Monitor environmental factors affecting signal");
+        out.println("\n2. Network Performance Optimization:");
+        out.println("   - Consider network topology optimization");
+        out.println("   - Review device placement and distances");
+        out.println("   - Monitor environmental factors affecting signal");
     }
 
     // Security recommendations
     if(hasSecurityIssues) {
-        Serial.println("\n3. Security Recommendations:");
-        Serial.println("   - Implement network-wide security policy");
-        Serial.println("   - Regular security audits recommended");
-        Serial.println("   - Consider upgrading device firmware");
+        out.println("\n3. Security Recommendations:");
+        out.println("   - Implement network-wide security policy");
+        out.println("   - Regular security audits recommended");
+        out.println("   - Consider upgrading device firmware");
     }
 
     // Long-term recommendations
-    Serial.println("\nLong-term Recommendations:");
-    Serial.println("1. Regular network monitoring and maintenance");
-    Serial.println("2. Plan for network scalability");
-    Serial.println("3. Document network configuration and changes");
-    Serial.println("4. Create backup plans for critical nodes");
+    out.println("\nLong-term Recommendations:");
+    out.println("1. Regular network monitoring and maintenance");
+    out.println("2. Plan for network scalability");
+    out.println("3. Document network configuration and changes");
+    out.println("4. Create backup plans for critical nodes");
 
-    Serial.println(); // Empty line for readability
+    out.println(); // Empty line for readability
 }
 
 #endif // ZIGBEE_SCANNER_SMART_RECOMMENDATIONS_H
\ No newline at end of file
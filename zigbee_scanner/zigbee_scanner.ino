@@ -41,31 +41,27 @@
 #include "block_helpers.h"
 #include "block_analysis.h"
 #include "block_output.h"
-
-// Global state variables for scanning control
-unsigned long lastScanTime = 0;
-const unsigned long SCAN_INTERVAL_NORMAL = 30000;  // 1 minute between scans when networks are found
-const unsigned long SCAN_INTERVAL_SEARCH = 5000;   // 5 seconds between scans during search
-bool scanInProgress = false;
-bool networksFound = false;  // Flag to track network presence
+#include "block_serial_output.h"
+#include "block_channel_planner.h"
+#include "block_scheduler.h"
 
 void initializeStats() {
-    for(int i = 0; i < MAX_NETWORKS; i++) {
-        networkStats[i].totalPackets = 0;
-        networkStats[i].failedPackets = 0;
-        networkStats[i].retriesCount = 0;
-        networkStats[i].signalTrend = 0;
-        networkStats[i].lastSignalStrength = 0;
-        networkStats[i].minSignalStrength = 0;
-        networkStats[i].maxSignalStrength = 0;
-        networkStats[i].avgSignalStrength = 0;
-        networkStats[i].uptime = 0;
-        networkStats[i].maxNetworkLoad = 0;
-        networkStats[i].isCoordinator = false;
-        networkStats[i].signalHistoryIndex = 0;
-        networkStats[i].signalHistoryCount = 0;
-    }
+    clearNetworkTable(&networkTable);
     previousNetworksCount = 0;
+    memset(channelScans, 0, sizeof(channelScans));
+    memset(&reportSelection, 0, sizeof(reportSelection));
+    initChannelPlanner(&channelPlanner, ADAPTIVE_CHANNEL_SCAN);
+    initEnergySampler(&energySampler, ENERGY_DETECT);
+    initChannelRanking(&channelRanking);
+    initChangeLog(&changeLog, CHANGE_DETECT);
+#if CYCLE_PROFILE
+    initCycleProfile(&cycleProfile);
+#endif
+#if ROLLUPS
+    initRollups(&rollups);
+#endif
+    scanAnalysis.begin();
+    commandMemo.command = MEMO_NONE;
 }
 
 void setup() {
@@ -84,69 +80,25 @@ void setup() {
     }
 
     initializeStats();
-    Serial.println("Setup complete, starting network scan...");
-    Zigbee.scanNetworks();
-    scanInProgress = true;
-    lastScanTime = millis();
+    beginSerialOutput();
+    setReportMode(reportMode);
+    initScheduler(&scheduler);
+    historyLogBegin(&historyLog, HISTORY_LOG, millis());
+    printHistoryLogStatus(&historyLog, Report);
+    Report.println("Setup complete, starting network scan...");
+    startScan(&scheduler, millis(), planChannelMask(&channelPlanner, millis()));
 }
 
 void loop() {
-    static unsigned long lastPrintTime = 0;
-    static unsigned long scanStartTime = 0;
-    unsigned long currentTime = millis();
-    unsigned long currentScanInterval = networksFound ? SCAN_INTERVAL_NORMAL : SCAN_INTERVAL_SEARCH;
-
-    if (scanInProgress) {
-        int16_t scanStatus = Zigbee.scanComplete();
-        
-        if (scanStatus == ZB_SCAN_RUNNING) {
-            // Still scanning
-            if (currentTime - scanStartTime > 30000) { // 30-second timeout
-                Serial.println("\nScan timeout - restarting scan");
-                Zigbee.scanDelete();
-                scanInProgress = false;
-                lastScanTime = currentTime;
-            }
-        }
-        else if (scanStatus == ZB_SCAN_FAILED) {
-            Serial.println("\nScan failed! Waiting before retry...");
-            scanInProgress = false;
-            lastScanTime = currentTime;
-        }
-        else if (scanStatus > 0) {  // At least one network found
-            Serial.printf("\nScan completed with status: %d\n", scanStatus);
-            networksFound = true;  // Set the flag indicating networks are found
-            printScannedNetworks(scanStatus);
-            scanInProgress = false;
-            lastScanTime = currentTime;
-        }
-        else if (scanStatus == 0) {  // No networks found
-            Serial.println("\nNo networks found, will scan again soon...");
-            scanInProgress = false;
-            lastScanTime = currentTime;
-            networksFound = false;
-        }
-    } else {
-        // Check if it's time to start a new scan
-        if (currentTime - lastScanTime >= currentScanInterval) {
-            Serial.println("\nInitiating new scan cycle...");
-            if (!networksFound) {
-                Serial.println("(Fast scanning mode active)");
-            }
-            Zigbee.scanNetworks();
-            Serial.println("Scan started");
-            scanInProgress = true;
-            scanStartTime = currentTime;
-        } else if (currentTime - lastPrintTime >= 20000) { // Every 20 seconds
-            int remainingTime = (currentScanInterval - (currentTime - lastScanTime)) / 1000;
-            if (networksFound) {
-                Serial.printf("\nWaiting for next scan: %d seconds", remainingTime);
-            } else {
-                Serial.printf("\nSearching for networks... Next scan in %d seconds", remainingTime);
-            }
-            lastPrintTime = currentTime;
-        }
+    runScheduler(&scheduler);
+#if SERIAL_COMMANDS
+    pollSerialCommands();
+#endif
+#if !SERIAL_OUTPUT_DRAIN_TASK
+    {
+        CYCLE_PHASE(PHASE_SERIAL);
+        drainSerialOutput();
     }
-
-    delay(100);
+#endif
+    schedulerSleep(&scheduler, schedulerNextWakeup(&scheduler));
 }
\ No newline at end of file